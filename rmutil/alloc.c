@@ -1,4 +1,5 @@
 #include <string.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include "alloc.h"
@@ -30,3 +31,309 @@ void RMUTil_InitAlloc() {
   RedisModule_Free = free;
   RedisModule_Strdup = strdup;
 }
+
+#ifdef RMUTIL_ALLOC_PROFILE
+#include <pthread.h>
+
+/* The allocator under the profiler. The parentheses keep the libc names from being expanded by the
+ * macros in alloc.h */
+#ifdef REDIS_MODULE_TARGET
+#define RAW_MALLOC(n) RedisModule_Alloc(n)
+#define RAW_CALLOC(c, n) RedisModule_Calloc(c, n)
+#define RAW_REALLOC(p, n) RedisModule_Realloc(p, n)
+#define RAW_FREE(p) RedisModule_Free(p)
+#else
+#define RAW_MALLOC(n) (malloc)(n)
+#define RAW_CALLOC(c, n) (calloc)(c, n)
+#define RAW_REALLOC(p, n) (realloc)(p, n)
+#define RAW_FREE(p) (free)(p)
+#endif
+
+// Every allocation is preceded by a header. It's 16 bytes to keep the allocation aligned
+typedef struct {
+  uint64_t size;
+  uint32_t site;
+  uint32_t bucket;
+} profHeader;
+
+typedef struct {
+  uint64_t allocs;
+  uint64_t frees;
+  uint64_t allocBytes;
+  uint64_t freeBytes;
+} profCounters;
+
+/* The counters of a thread. Only the owning thread writes them, readers sum them up from all the
+ * threads, so the updates are relaxed stores rather than atomic increments */
+typedef struct profThread {
+  profCounters sites[RMUTIL_ALLOC_MAX_SITES];
+  profCounters buckets[RMUTIL_ALLOC_NUM_BUCKETS];
+  struct profThread *next, *prev;
+} profThread;
+
+static pthread_mutex_t profLock = PTHREAD_MUTEX_INITIALIZER;
+static RMUtilAllocSite profOtherSite = {"(other)", 0, 0};
+static RMUtilAllocSite *profSites[RMUTIL_ALLOC_MAX_SITES] = {&profOtherSite};
+static int profNumSites = 1;
+static profThread *profThreads;
+// the counters of threads that exited
+static profThread profRetired;
+
+static __thread profThread *profTls;
+static pthread_key_t profKey;
+static pthread_once_t profKeyOnce = PTHREAD_ONCE_INIT;
+
+static void prof_AddCounters(profCounters *dst, const profCounters *src) {
+  dst->allocs += __atomic_load_n(&src->allocs, __ATOMIC_RELAXED);
+  dst->frees += __atomic_load_n(&src->frees, __ATOMIC_RELAXED);
+  dst->allocBytes += __atomic_load_n(&src->allocBytes, __ATOMIC_RELAXED);
+  dst->freeBytes += __atomic_load_n(&src->freeBytes, __ATOMIC_RELAXED);
+}
+
+static void prof_ThreadExit(void *p) {
+  profThread *t = p;
+  profTls = NULL;
+  pthread_mutex_lock(&profLock);
+  for (int i = 0; i < RMUTIL_ALLOC_MAX_SITES; i++) {
+    prof_AddCounters(&profRetired.sites[i], &t->sites[i]);
+  }
+  for (int i = 0; i < RMUTIL_ALLOC_NUM_BUCKETS; i++) {
+    prof_AddCounters(&profRetired.buckets[i], &t->buckets[i]);
+  }
+  if (t->prev) t->prev->next = t->next;
+  if (t->next) t->next->prev = t->prev;
+  if (profThreads == t) profThreads = t->next;
+  pthread_mutex_unlock(&profLock);
+  RAW_FREE(t);
+}
+
+static void prof_InitKey(void) {
+  pthread_key_create(&profKey, prof_ThreadExit);
+}
+
+static profThread *prof_Thread(void) {
+  profThread *t = profTls;
+  if (__builtin_expect(t != NULL, 1)) return t;
+
+  pthread_once(&profKeyOnce, prof_InitKey);
+  t = RAW_CALLOC(1, sizeof(profThread));
+  pthread_mutex_lock(&profLock);
+  t->next = profThreads;
+  if (profThreads) profThreads->prev = t;
+  profThreads = t;
+  pthread_mutex_unlock(&profLock);
+  pthread_setspecific(profKey, t);
+  return profTls = t;
+}
+
+static int prof_SiteId(RMUtilAllocSite *site) {
+  int id = __atomic_load_n(&site->id, __ATOMIC_ACQUIRE);
+  if (__builtin_expect(id != 0, 1)) return id;
+
+  pthread_mutex_lock(&profLock);
+  if ((id = site->id) == 0) {
+    if (profNumSites < RMUTIL_ALLOC_MAX_SITES) {
+      id = profNumSites++;
+      profSites[id] = site;
+    } else {
+      id = -1;  // accounted to the "(other)" site
+    }
+    __atomic_store_n(&site->id, id, __ATOMIC_RELEASE);
+  }
+  pthread_mutex_unlock(&profLock);
+  return id;
+}
+
+static inline uint32_t prof_Bucket(size_t size) {
+  uint32_t b = size <= 1 ? 0 : 64 - __builtin_clzll(size - 1);
+  return b < RMUTIL_ALLOC_NUM_BUCKETS ? b : RMUTIL_ALLOC_NUM_BUCKETS - 1;
+}
+
+#define PROF_ADD(field, n) __atomic_store_n(&(field), (field) + (n), __ATOMIC_RELAXED)
+
+static void *prof_Track(RMUtilAllocSite *site, profHeader *h, size_t size) {
+  if (!h) return NULL;
+  int id = prof_SiteId(site);
+  h->size = size;
+  h->site = id > 0 ? id : 0;
+  h->bucket = prof_Bucket(size);
+
+  profThread *t = prof_Thread();
+  PROF_ADD(t->sites[h->site].allocs, 1);
+  PROF_ADD(t->sites[h->site].allocBytes, size);
+  PROF_ADD(t->buckets[h->bucket].allocs, 1);
+  PROF_ADD(t->buckets[h->bucket].allocBytes, size);
+  return h + 1;
+}
+
+static void prof_Untrack(profHeader *h) {
+  profThread *t = prof_Thread();
+  PROF_ADD(t->sites[h->site].frees, 1);
+  PROF_ADD(t->sites[h->site].freeBytes, h->size);
+  PROF_ADD(t->buckets[h->bucket].frees, 1);
+  PROF_ADD(t->buckets[h->bucket].freeBytes, h->size);
+}
+
+void *rmutil_profMalloc(RMUtilAllocSite *site, size_t size) {
+  return prof_Track(site, RAW_MALLOC(sizeof(profHeader) + size), size);
+}
+
+void *rmutil_profCalloc(RMUtilAllocSite *site, size_t count, size_t size) {
+  // fail like calloc when the total, with the header in front of it, does not fit a size_t
+  if (size && count > (SIZE_MAX - sizeof(profHeader)) / size) return NULL;
+  return prof_Track(site, RAW_CALLOC(1, sizeof(profHeader) + count * size), count * size);
+}
+
+void *rmutil_profRealloc(RMUtilAllocSite *site, void *ptr, size_t size) {
+  if (!ptr) return rmutil_profMalloc(site, size);
+
+  // a reallocation is accounted as freeing the old block and allocating the new one at this site
+  profHeader *h = (profHeader *)ptr - 1;
+  profHeader old = *h;
+  h = RAW_REALLOC(h, sizeof(profHeader) + size);
+  if (!h) return NULL;
+  prof_Untrack(&old);
+  return prof_Track(site, h, size);
+}
+
+void rmutil_profFree(void *ptr) {
+  if (!ptr) return;
+  profHeader *h = (profHeader *)ptr - 1;
+  prof_Untrack(h);
+  RAW_FREE(h);
+}
+
+char *rmutil_profStrndup(RMUtilAllocSite *site, const char *s, size_t n) {
+  size_t len = strnlen(s, n);
+  char *ret = rmutil_profMalloc(site, len + 1);
+  if (ret) {
+    memcpy(ret, s, len);
+    ret[len] = '\0';
+  }
+  return ret;
+}
+
+char *rmutil_profStrdup(RMUtilAllocSite *site, const char *s) {
+  return rmutil_profStrndup(site, s, strlen(s));
+}
+
+// Sum up the counters of all the threads. Called with the lock held
+static void prof_Collect(profThread *sum) {
+  memcpy(sum->sites, profRetired.sites, sizeof(sum->sites));
+  memcpy(sum->buckets, profRetired.buckets, sizeof(sum->buckets));
+  for (profThread *t = profThreads; t; t = t->next) {
+    for (int i = 0; i < profNumSites; i++) {
+      prof_AddCounters(&sum->sites[i], &t->sites[i]);
+    }
+    for (int i = 0; i < RMUTIL_ALLOC_NUM_BUCKETS; i++) {
+      prof_AddCounters(&sum->buckets[i], &t->buckets[i]);
+    }
+  }
+}
+
+static int cmpLiveBytes(const void *a, const void *b) {
+  const RMUtilAllocSiteStats *x = a, *y = b;
+  return (x->liveBytes < y->liveBytes) - (x->liveBytes > y->liveBytes);
+}
+
+size_t RMUtil_AllocProfileSites(RMUtilAllocSiteStats *out, size_t max) {
+  profThread *sum = RAW_MALLOC(sizeof(profThread));
+  RMUtilAllocSiteStats *all = RAW_MALLOC(RMUTIL_ALLOC_MAX_SITES * sizeof(RMUtilAllocSiteStats));
+
+  pthread_mutex_lock(&profLock);
+  prof_Collect(sum);
+  size_t n = 0;
+  for (int i = 0; i < profNumSites; i++) {
+    profCounters *c = &sum->sites[i];
+    if (!c->allocs) continue;
+    all[n++] = (RMUtilAllocSiteStats){
+        .file = profSites[i]->file,
+        .line = profSites[i]->line,
+        .allocs = c->allocs,
+        .frees = c->frees,
+        .totalBytes = c->allocBytes,
+        .liveBytes = (int64_t)(c->allocBytes - c->freeBytes),
+    };
+  }
+  pthread_mutex_unlock(&profLock);
+
+  qsort(all, n, sizeof(*all), cmpLiveBytes);
+  if (n > max) n = max;
+  memcpy(out, all, n * sizeof(*all));
+  RAW_FREE(all);
+  RAW_FREE(sum);
+  return n;
+}
+
+void RMUtil_AllocProfileBuckets(RMUtilAllocBucketStats *out) {
+  profThread *sum = RAW_MALLOC(sizeof(profThread));
+  pthread_mutex_lock(&profLock);
+  prof_Collect(sum);
+  pthread_mutex_unlock(&profLock);
+
+  for (int i = 0; i < RMUTIL_ALLOC_NUM_BUCKETS; i++) {
+    profCounters *c = &sum->buckets[i];
+    out[i] = (RMUtilAllocBucketStats){
+        .maxSize = (size_t)1 << i,
+        .allocs = c->allocs,
+        .frees = c->frees,
+        .liveBytes = (int64_t)(c->allocBytes - c->freeBytes),
+    };
+  }
+  RAW_FREE(sum);
+}
+
+#ifdef REDISMODULE_EVENT_FLUSHDB
+
+// the number of call sites listed in INFO
+#define PROF_INFO_SITES 20
+
+void RMUtil_AllocProfileInfo(RedisModuleInfoCtx *ctx, int for_crash_report) {
+  RMUtilAllocBucketStats buckets[RMUTIL_ALLOC_NUM_BUCKETS];
+  RMUtil_AllocProfileBuckets(buckets);
+  RMUtilAllocSiteStats sites[PROF_INFO_SITES];
+  size_t numSites = RMUtil_AllocProfileSites(sites, PROF_INFO_SITES);
+
+  long long allocs = 0, frees = 0, live = 0;
+  for (int i = 0; i < RMUTIL_ALLOC_NUM_BUCKETS; i++) {
+    allocs += buckets[i].allocs;
+    frees += buckets[i].frees;
+    live += buckets[i].liveBytes;
+  }
+
+  RedisModule_InfoAddSection(ctx, "allocprofile");
+  RedisModule_InfoAddFieldLongLong(ctx, "live_bytes", live);
+  RedisModule_InfoAddFieldLongLong(ctx, "live_allocations", allocs - frees);
+  RedisModule_InfoAddFieldLongLong(ctx, "total_allocations", allocs);
+
+  char name[64];
+  for (int i = 0; i < RMUTIL_ALLOC_NUM_BUCKETS; i++) {
+    if (!buckets[i].allocs) continue;
+    snprintf(name, sizeof(name), "size_le_%zu", buckets[i].maxSize);
+    RedisModule_InfoBeginDictField(ctx, name);
+    RedisModule_InfoAddFieldULongLong(ctx, "allocs", buckets[i].allocs);
+    RedisModule_InfoAddFieldULongLong(ctx, "frees", buckets[i].frees);
+    RedisModule_InfoAddFieldLongLong(ctx, "live_bytes", buckets[i].liveBytes);
+    RedisModule_InfoEndDictField(ctx);
+  }
+
+  for (size_t i = 0; i < numSites; i++) {
+    snprintf(name, sizeof(name), "site_%zu", i);
+    RedisModule_InfoBeginDictField(ctx, name);
+    RedisModule_InfoAddFieldCString(ctx, "file", (char *)sites[i].file);
+    RedisModule_InfoAddFieldLongLong(ctx, "line", sites[i].line);
+    RedisModule_InfoAddFieldULongLong(ctx, "allocs", sites[i].allocs);
+    RedisModule_InfoAddFieldULongLong(ctx, "frees", sites[i].frees);
+    RedisModule_InfoAddFieldULongLong(ctx, "total_bytes", sites[i].totalBytes);
+    RedisModule_InfoAddFieldLongLong(ctx, "live_bytes", sites[i].liveBytes);
+    RedisModule_InfoEndDictField(ctx);
+  }
+}
+
+int RMUtil_RegisterAllocProfileInfo(RedisModuleCtx *ctx) {
+  return RedisModule_RegisterInfoFunc(ctx, RMUtil_AllocProfileInfo);
+}
+
+#endif /* REDISMODULE_EVENT_FLUSHDB */
+
+#endif /* RMUTIL_ALLOC_PROFILE */
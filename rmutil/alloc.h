@@ -21,7 +21,99 @@
 
 char *rmalloc_strndup(const char *s, size_t n);
 
-#ifdef REDIS_MODULE_TARGET /* Set this when compiling your code as a module */
+#ifdef RMUTIL_ALLOC_PROFILE
+/* Allocation profiling.
+ *
+ * Compiling with RMUTIL_ALLOC_PROFILE defined records the allocations of every call site (file and
+ * line) and size bucket, on top of RedisModule_Alloc when REDIS_MODULE_TARGET is defined or the
+ * libc allocator otherwise. Each allocation carries a small header with its size and call site, so
+ * all the code that allocates or frees the same memory, including librmutil, must be compiled with
+ * the flag, and RedisModule_MallocSize does not apply to the returned pointers.
+ *
+ * The counters are kept per thread so allocating stays cheap, and are summed up when read with
+ * RMUtil_AllocProfileSites / RMUtil_AllocProfileBuckets, or from the module's INFO section, see
+ * RMUtil_RegisterAllocProfileInfo.
+ */
+#include <stdint.h>
+
+// A call site, defined statically at every allocation call
+typedef struct {
+  const char *file;
+  int line;
+  int id;
+} RMUtilAllocSite;
+
+#define RMUTIL_ALLOC_SITE()                                               \
+  ({                                                                      \
+    static RMUtilAllocSite __rmutil_alloc_site = {__FILE__, __LINE__, 0}; \
+    &__rmutil_alloc_site;                                                 \
+  })
+
+/* The maximum number of call sites tracked. Allocations from further sites are accounted to the
+ * first site, "(other)" */
+#define RMUTIL_ALLOC_MAX_SITES 1024
+
+/* Allocations are bucketed by size in powers of two, bucket i holding sizes up to 2^i bytes */
+#define RMUTIL_ALLOC_NUM_BUCKETS 32
+
+void *rmutil_profMalloc(RMUtilAllocSite *site, size_t size);
+void *rmutil_profCalloc(RMUtilAllocSite *site, size_t count, size_t size);
+void *rmutil_profRealloc(RMUtilAllocSite *site, void *ptr, size_t size);
+void rmutil_profFree(void *ptr);
+char *rmutil_profStrndup(RMUtilAllocSite *site, const char *s, size_t n);
+char *rmutil_profStrdup(RMUtilAllocSite *site, const char *s);
+
+#define malloc(size) rmutil_profMalloc(RMUTIL_ALLOC_SITE(), size)
+#define calloc(count, size) rmutil_profCalloc(RMUTIL_ALLOC_SITE(), count, size)
+#define realloc(ptr, size) rmutil_profRealloc(RMUTIL_ALLOC_SITE(), ptr, size)
+#define free(ptr) rmutil_profFree(ptr)
+
+#ifdef strdup
+#undef strdup
+#endif
+#define strdup(s) rmutil_profStrdup(RMUTIL_ALLOC_SITE(), s)
+
+#ifdef strndup
+#undef strndup
+#endif
+#define strndup(s, n) rmutil_profStrndup(RMUTIL_ALLOC_SITE(), s, n)
+
+typedef struct {
+  const char *file;
+  int line;
+  uint64_t allocs;
+  uint64_t frees;
+  // bytes allocated over time, and bytes allocated and not freed yet
+  uint64_t totalBytes;
+  int64_t liveBytes;
+} RMUtilAllocSiteStats;
+
+typedef struct {
+  // the largest allocation size in the bucket
+  size_t maxSize;
+  uint64_t allocs;
+  uint64_t frees;
+  int64_t liveBytes;
+} RMUtilAllocBucketStats;
+
+/* Fill `out` with the stats of up to `max` call sites, the ones holding the most live bytes first.
+ * Returns the number of sites written */
+size_t RMUtil_AllocProfileSites(RMUtilAllocSiteStats *out, size_t max);
+
+/* Fill `out` with the stats of the RMUTIL_ALLOC_NUM_BUCKETS size buckets */
+void RMUtil_AllocProfileBuckets(RMUtilAllocBucketStats *out);
+
+#ifdef REDISMODULE_EVENT_FLUSHDB /* redismodule.h from 6.0 on has module INFO sections */
+/* Add an "allocprofile" section with the totals, the size buckets and the top call sites to the
+ * module's INFO output. Call it from the module's own info function, or register it as the info
+ * function with RMUtil_RegisterAllocProfileInfo */
+void RMUtil_AllocProfileInfo(RedisModuleInfoCtx *ctx, int for_crash_report);
+
+/* Register RMUtil_AllocProfileInfo as the module's info function */
+int RMUtil_RegisterAllocProfileInfo(RedisModuleCtx *ctx);
+#endif
+
+#elif defined(REDIS_MODULE_TARGET) /* Set this when compiling your code as a module */
 
 #define malloc(size) RedisModule_Alloc(size)
 #define calloc(count, size) RedisModule_Calloc(count, size)
@@ -43,6 +135,33 @@ char *rmalloc_strndup(const char *s, size_t n);
 #else
 
 #endif /* REDIS_MODULE_TARGET */
+
+/* Temporary allocations.
+ *
+ * RMUTIL_TMPALLOC and friends are meant for memory that does not outlive the current command. By
+ * default they are the regular allocation functions. When compiling with RMUTIL_ARENA_TMPALLOC
+ * defined, inside a command wrapped with RMUTIL_ARENA_CMD they allocate from the thread's command
+ * arena (see arena.h), and RMUTIL_TMPFREE does nothing since the arena is reset when the command
+ * returns. Outside of a command they fall back to the regular functions, so memory must be freed in
+ * the same scope it was allocated in.
+ */
+#ifdef RMUTIL_ARENA_TMPALLOC
+void *RMUtil_TmpAlloc(size_t size);
+void *RMUtil_TmpCalloc(size_t count, size_t size);
+char *RMUtil_TmpStrdup(const char *s);
+void RMUtil_TmpFree(void *p);
+
+#define RMUTIL_TMPALLOC(size) RMUtil_TmpAlloc(size)
+#define RMUTIL_TMPCALLOC(count, size) RMUtil_TmpCalloc(count, size)
+#define RMUTIL_TMPSTRDUP(s) RMUtil_TmpStrdup(s)
+#define RMUTIL_TMPFREE(p) RMUtil_TmpFree(p)
+#else
+#define RMUTIL_TMPALLOC(size) malloc(size)
+#define RMUTIL_TMPCALLOC(count, size) calloc(count, size)
+#define RMUTIL_TMPSTRDUP(s) strdup(s)
+#define RMUTIL_TMPFREE(p) free(p)
+#endif /* RMUTIL_ARENA_TMPALLOC */
+
 /* This function should be called if you are working with malloc-patched code
  * outside of redis, usually for unit tests. Call it once when entering your unit
  * tests' main() */
@@ -0,0 +1,198 @@
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "arena.h"
+#include "alloc.h"
+
+#define ALIGN_UP(n) (((n) + RMUTIL_ARENA_ALIGN - 1) & ~((size_t)RMUTIL_ARENA_ALIGN - 1))
+
+/* The largest allocation, whose aligned size and chunk header still fit a size_t */
+#define ARENA_MAX_SIZE (SIZE_MAX - sizeof(RMUtilArenaChunk) - RMUTIL_ARENA_ALIGN)
+
+void RMUtilArena_Init(RMUtilArena *a, size_t chunkSize) {
+  memset(a, 0, sizeof(*a));
+  a->chunkSize = chunkSize ? chunkSize : RMUTIL_ARENA_DEFAULT_CHUNK;
+}
+
+void RMUtilArena_InitPool(RMUtilArena *a, RedisModuleCtx *ctx, size_t chunkSize) {
+  RMUtilArena_Init(a, chunkSize);
+  a->poolCtx = ctx;
+}
+
+// Make room for at least `size` bytes in a new current chunk. Returns 0 if it can't be allocated
+static int arena_Grow(RMUtilArena *a, size_t size) {
+  RMUtilArenaChunk *c = NULL;
+
+  if (size <= a->chunkSize && a->freeChunks) {
+    c = a->freeChunks;
+    a->freeChunks = c->next;
+  } else {
+    // oversized requests get a chunk of their own, which is not recycled
+    size_t csize = size > a->chunkSize ? size : a->chunkSize;
+    if (a->poolCtx) {
+      c = RedisModule_PoolAlloc(a->poolCtx, sizeof(RMUtilArenaChunk) + csize);
+    } else {
+      c = malloc(sizeof(RMUtilArenaChunk) + csize);
+    }
+    if (!c) return 0;
+    c->size = csize;
+    a->numChunkAllocs++;
+  }
+
+  c->next = a->chunks;
+  a->chunks = c;
+  a->ptr = c->data;
+  a->end = c->data + c->size;
+  return 1;
+}
+
+void *RMUtilArena_Alloc(RMUtilArena *a, size_t size) {
+  if (size > ARENA_MAX_SIZE) return NULL;
+  size = ALIGN_UP(size ? size : 1);
+  if ((size_t)(a->end - a->ptr) < size && !arena_Grow(a, size)) {
+    return NULL;
+  }
+  void *p = a->ptr;
+  a->ptr += size;
+  a->numAllocs++;
+  return p;
+}
+
+void *RMUtilArena_Calloc(RMUtilArena *a, size_t count, size_t size) {
+  // fail like calloc when the total does not fit a size_t
+  if (size && count > SIZE_MAX / size) return NULL;
+  void *p = RMUtilArena_Alloc(a, count * size);
+  if (p) memset(p, 0, count * size);
+  return p;
+}
+
+void *RMUtilArena_Realloc(RMUtilArena *a, void *ptr, size_t oldSize, size_t newSize) {
+  if (ptr == NULL) {
+    return RMUtilArena_Alloc(a, newSize);
+  }
+
+  if (newSize > ARENA_MAX_SIZE) return NULL;
+
+  // the last allocation ends at the current pointer, so it can be resized in place
+  char *p = ptr;
+  // the check covers the aligned size, as chunk sizes need not be a multiple of the alignment
+  size_t alignedSize = ALIGN_UP(newSize ? newSize : 1);
+  if (p + ALIGN_UP(oldSize ? oldSize : 1) == a->ptr && alignedSize <= (size_t)(a->end - p)) {
+    a->ptr = p + alignedSize;
+    return p;
+  }
+  if (newSize <= oldSize) {
+    return p;
+  }
+
+  void *np = RMUtilArena_Alloc(a, newSize);
+  if (np) memcpy(np, p, oldSize);
+  return np;
+}
+
+char *RMUtilArena_Strndup(RMUtilArena *a, const char *s, size_t n) {
+  char *p = RMUtilArena_Alloc(a, n + 1);
+  memcpy(p, s, n);
+  p[n] = '\0';
+  return p;
+}
+
+char *RMUtilArena_Strdup(RMUtilArena *a, const char *s) {
+  return RMUtilArena_Strndup(a, s, strlen(s));
+}
+
+void RMUtilArena_Reset(RMUtilArena *a) {
+  RMUtilArenaChunk *c = a->chunks;
+  while (c) {
+    RMUtilArenaChunk *next = c->next;
+    if (a->poolCtx) {
+      // pool memory is released by redis
+    } else if (c->size > a->chunkSize) {
+      free(c);
+    } else {
+      c->next = a->freeChunks;
+      a->freeChunks = c;
+    }
+    c = next;
+  }
+  a->chunks = NULL;
+  a->ptr = a->end = NULL;
+}
+
+void RMUtilArena_Destroy(RMUtilArena *a) {
+  RMUtilArena_Reset(a);
+  RMUtilArenaChunk *c = a->freeChunks;
+  while (c) {
+    RMUtilArenaChunk *next = c->next;
+    free(c);
+    c = next;
+  }
+  a->freeChunks = NULL;
+}
+
+/* The per thread command arena. The thread local pointer makes the lookup cheap, and the key's
+ * destructor frees the arena when a thread that used it exits */
+typedef struct {
+  RMUtilArena arena;
+  int depth;
+} commandArena;
+
+static __thread commandArena *tlsArena;
+static pthread_key_t arenaKey;
+static pthread_once_t arenaKeyOnce = PTHREAD_ONCE_INIT;
+
+static void commandArena_Free(void *p) {
+  commandArena *ca = p;
+  RMUtilArena_Destroy(&ca->arena);
+  free(ca);
+}
+
+static void commandArena_InitKey(void) {
+  pthread_key_create(&arenaKey, commandArena_Free);
+}
+
+RMUtilArena *RMUtil_CommandArena(void) {
+  return tlsArena && tlsArena->depth > 0 ? &tlsArena->arena : NULL;
+}
+
+RMUtilArena *RMUtilArena_EnterCommand(void) {
+  if (!tlsArena) {
+    pthread_once(&arenaKeyOnce, commandArena_InitKey);
+    tlsArena = calloc(1, sizeof(commandArena));
+    RMUtilArena_Init(&tlsArena->arena, 0);
+    pthread_setspecific(arenaKey, tlsArena);
+  }
+  tlsArena->depth++;
+  return &tlsArena->arena;
+}
+
+void RMUtilArena_LeaveCommand(void) {
+  if (--tlsArena->depth == 0) {
+    RMUtilArena_Reset(&tlsArena->arena);
+  }
+}
+
+#ifdef RMUTIL_ARENA_TMPALLOC
+
+void *RMUtil_TmpAlloc(size_t size) {
+  RMUtilArena *a = RMUtil_CommandArena();
+  return a ? RMUtilArena_Alloc(a, size) : malloc(size);
+}
+
+void *RMUtil_TmpCalloc(size_t count, size_t size) {
+  RMUtilArena *a = RMUtil_CommandArena();
+  return a ? RMUtilArena_Calloc(a, count, size) : calloc(count, size);
+}
+
+char *RMUtil_TmpStrdup(const char *s) {
+  RMUtilArena *a = RMUtil_CommandArena();
+  return a ? RMUtilArena_Strdup(a, s) : strdup(s);
+}
+
+void RMUtil_TmpFree(void *p) {
+  if (!RMUtil_CommandArena()) {
+    free(p);
+  }
+}
+
+#endif
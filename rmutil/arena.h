@@ -0,0 +1,106 @@
+#ifndef RMUTIL_ARENA_H_
+#define RMUTIL_ARENA_H_
+#include <stddef.h>
+#include <redismodule.h>
+
+/** arena.h - A bump pointer allocator for short lived scratch memory.
+ *
+ * Allocating from an arena is a pointer increment, individual allocations are never freed, and
+ * resetting the arena releases everything at once. Chunks are kept on a free list when the arena
+ * is reset, so an arena that is reset after every command stops calling malloc once it has grown
+ * to the size the commands need.
+ *
+ * Each thread has a command arena, which is reset when the outermost command wrapped with
+ * RMUTIL_ARENA_CMD returns:
+ *
+ *   int MyCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+ *     const char **strs = RMUtilArena_Alloc(RMUtil_CommandArena(), argc * sizeof(char *));
+ *     ...
+ *   }
+ *   RMUTIL_ARENA_CMD(MyCommand_Arena, MyCommand)
+ *
+ *   // in RedisModule_OnLoad:
+ *   RMUtil_RegisterReadCmd(ctx, "my.command", MyCommand_Arena);
+ */
+
+/* Allocations are aligned to this many bytes */
+#define RMUTIL_ARENA_ALIGN 16
+
+/* The default size of the arena's chunks */
+#define RMUTIL_ARENA_DEFAULT_CHUNK 4096
+
+typedef struct RMUtilArenaChunk {
+  struct RMUtilArenaChunk *next;
+  size_t size;
+  char data[] __attribute__((aligned(RMUTIL_ARENA_ALIGN)));
+} RMUtilArenaChunk;
+
+typedef struct {
+  char *ptr;
+  char *end;
+  // the chunks in use, most recent first
+  RMUtilArenaChunk *chunks;
+  // chunks kept from before the last reset
+  RMUtilArenaChunk *freeChunks;
+  size_t chunkSize;
+  // when set, memory is taken from RedisModule_PoolAlloc and released when the command returns
+  RedisModuleCtx *poolCtx;
+
+  // the number of times memory was actually allocated for chunks
+  size_t numChunkAllocs;
+  // the number of allocations served by the arena
+  size_t numAllocs;
+} RMUtilArena;
+
+/* Initialize an arena allocating chunks of `chunkSize` bytes, or the default if it is 0 */
+void RMUtilArena_Init(RMUtilArena *a, size_t chunkSize);
+
+/* Initialize an arena on top of RedisModule_PoolAlloc. The memory belongs to `ctx` and is released
+ * automatically when the command returns, so the arena must not be used after that. Reset and
+ * Destroy only forget the memory, and chunks are not recycled */
+void RMUtilArena_InitPool(RMUtilArena *a, RedisModuleCtx *ctx, size_t chunkSize);
+
+/* Allocate `size` bytes aligned to RMUTIL_ARENA_ALIGN. Returns NULL only if the size is too large
+ * to allocate with a chunk header in front of it */
+void *RMUtilArena_Alloc(RMUtilArena *a, size_t size);
+
+/* Allocate zeroed memory for `count` elements of `size` bytes. Returns NULL like calloc if the
+ * total size overflows */
+void *RMUtilArena_Calloc(RMUtilArena *a, size_t count, size_t size);
+
+/* Resize an allocation of `oldSize` bytes. The last allocation is grown in place when there is room
+ * in its chunk, otherwise the data is copied to a new allocation. Returns NULL, leaving the
+ * allocation as it is, if the new size is too large */
+void *RMUtilArena_Realloc(RMUtilArena *a, void *ptr, size_t oldSize, size_t newSize);
+
+/* Copy a C string or the first `n` bytes of a buffer into the arena, NULL terminated */
+char *RMUtilArena_Strdup(RMUtilArena *a, const char *s);
+char *RMUtilArena_Strndup(RMUtilArena *a, const char *s, size_t n);
+
+/* Release all the allocations made from the arena. Chunks are kept for reuse, except for the ones
+ * that were allocated for requests larger than the chunk size */
+void RMUtilArena_Reset(RMUtilArena *a);
+
+/* Free all the memory held by the arena */
+void RMUtilArena_Destroy(RMUtilArena *a);
+
+/* Get the calling thread's command arena. Returns NULL outside of a command wrapped with
+ * RMUTIL_ARENA_CMD */
+RMUtilArena *RMUtil_CommandArena(void);
+
+/* Enter and leave a command scope on the calling thread. The command arena is created on the first
+ * call, and reset when the outermost scope is left. Scopes nest, so commands calling other wrapped
+ * commands through RedisModule_Call keep their memory */
+RMUtilArena *RMUtilArena_EnterCommand(void);
+void RMUtilArena_LeaveCommand(void);
+
+/* Define a command handler `name` that runs `handler` inside a command arena scope */
+#define RMUTIL_ARENA_CMD(name, handler)                                          \
+  static int name(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {     \
+    RMUtilArena_EnterCommand();                                                  \
+    int __rc = handler(ctx, argv, argc);                                         \
+    RMUtilArena_LeaveCommand();                                                  \
+    return __rc;                                                                 \
+  }
+
+#endif
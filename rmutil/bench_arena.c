@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+// define the module API pointers here, they are left NULL outside of redis
+#define REDISMODULE_MAIN
+#define REDISMODULE_EXPERIMENTAL_API
+#include "arena.h"
+
+/* Benchmark of the scratch memory a typical command handler needs: an argument array, and a copy
+ * of every argument, as done by RMUtil_MakeArgs and RMUtil_StringConvert with COPY. Each command
+ * is run with malloc/free pairs, and with the command arena */
+
+#define COMMANDS 1000000
+
+static size_t numMallocs;
+
+static void *countedMalloc(size_t size) {
+  numMallocs++;
+  return malloc(size);
+}
+
+static char *countedStrdup(const char *s) {
+  size_t n = strlen(s) + 1;
+  char *p = countedMalloc(n);
+  memcpy(p, s, n);
+  return p;
+}
+
+static double nowSec() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static size_t mallocCommand(const char **args, int argc) {
+  const char **copies = countedMalloc(argc * sizeof(char *));
+  size_t total = 0;
+  for (int i = 0; i < argc; i++) {
+    copies[i] = countedStrdup(args[i]);
+    total += copies[i][0];
+  }
+  for (int i = 0; i < argc; i++) {
+    free((char *)copies[i]);
+  }
+  free(copies);
+  return total;
+}
+
+static size_t arenaCommand(const char **args, int argc) {
+  RMUtilArena *a = RMUtilArena_EnterCommand();
+  const char **copies = RMUtilArena_Alloc(a, argc * sizeof(char *));
+  size_t total = 0;
+  for (int i = 0; i < argc; i++) {
+    copies[i] = RMUtilArena_Strdup(a, args[i]);
+    total += copies[i][0];
+  }
+  RMUtilArena_LeaveCommand();
+  return total;
+}
+
+static void report(const char *name, int argc, double start, size_t allocs, size_t check) {
+  double elapsed = nowSec() - start;
+  printf("  %-8s %3d args: %7.1f ns/command, %8.4f allocations/command (checksum %zu)\n", name,
+         argc, elapsed * 1e9 / COMMANDS, (double)allocs / COMMANDS, check);
+}
+
+int main(int argc, char **argv) {
+  static const char *words[] = {"FT.SEARCH", "idx",   "@title:hello", "LIMIT",  "0",
+                                "10",        "SORTBY", "price",       "ASC",    "RETURN",
+                                "2",         "title", "price",        "FILTER", "price"};
+  static const int sizes[] = {3, 15, 150};
+  const char *args[150];
+  for (int i = 0; i < 150; i++) {
+    args[i] = words[i % 15];
+  }
+
+  printf("Per command scratch allocations, %d commands:\n", COMMANDS);
+  for (int s = 0; s < 3; s++) {
+    int n = sizes[s];
+
+    size_t check = 0;
+    numMallocs = 0;
+    double start = nowSec();
+    for (int i = 0; i < COMMANDS; i++) {
+      check += mallocCommand(args, n);
+    }
+    report("malloc", n, start, numMallocs, check);
+
+    check = 0;
+    RMUtilArena *a = RMUtilArena_EnterCommand();
+    size_t chunks = a->numChunkAllocs;
+    RMUtilArena_LeaveCommand();
+    start = nowSec();
+    for (int i = 0; i < COMMANDS; i++) {
+      check += arenaCommand(args, n);
+    }
+    report("arena", n, start, a->numChunkAllocs - chunks, check);
+  }
+  return 0;
+}
@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+// define the module API pointers here, they are left NULL outside of redis
+#define REDISMODULE_MAIN
+#define REDISMODULE_EXPERIMENTAL_API
+#include <redismodule.h>
+#include "util.h"
+
+/* Benchmark of locating a command's optional keywords with repeated RMUtil_ParseArgsAfter calls,
+ * against a single pass with a compiled RMUtilArgSchema */
+
+#define ITERATIONS 1000000
+
+/* Outside of redis, RedisModuleString objects are stubbed by plain C strings */
+typedef struct {
+  const char *str;
+  size_t len;
+} stubString;
+
+static const char *stubStringPtrLen(const RedisModuleString *str, size_t *len) {
+  const stubString *s = (const stubString *)str;
+  if (len) *len = s->len;
+  return s->str;
+}
+
+static int stubStringToLongLong(const RedisModuleString *str, long long *ll) {
+  *ll = strtoll(((const stubString *)str)->str, NULL, 10);
+  return REDISMODULE_OK;
+}
+
+static double nowSec() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+enum { KW_LIMIT, KW_WITHSCORES, KW_FILTER, KW_SORTBY, KW_RETURN, KW_INKEYS, KW_SLOP, KW_NUM };
+static const char *keywords[] = {"LIMIT",  "WITHSCORES", "FILTER", "SORTBY",
+                                 "RETURN", "INKEYS",     "SLOP"};
+
+int main(int argc, char **argv) {
+  RedisModule_StringPtrLen = stubStringPtrLen;
+  RedisModule_StringToLongLong = stubStringToLongLong;
+
+  const char *args[] = {"FT.SEARCH", "idx",   "hello world", "FILTER", "price", "10",
+                        "100",       "SLOP",  "2",           "SORTBY", "price", "LIMIT",
+                        "0",         "10",    "INKEYS",      "2",      "k1",    "k2"};
+  int nargs = sizeof(args) / sizeof(args[0]);
+  stubString strs[nargs];
+  RedisModuleString *cmdArgv[nargs];
+  for (int i = 0; i < nargs; i++) {
+    strs[i] = (stubString){args[i], strlen(args[i])};
+    cmdArgv[i] = (RedisModuleString *)&strs[i];
+  }
+
+  printf("Argument parsing benchmark, %d args, %d keywords:\n", nargs, KW_NUM);
+
+  long long sum = 0, a, b;
+  double start = nowSec();
+  for (int it = 0; it < ITERATIONS; it++) {
+    for (int k = 0; k < KW_NUM; k++) {
+      if (RMUtil_ParseArgsAfter(keywords[k], cmdArgv, nargs, "ll", &a, &b) == REDISMODULE_OK) {
+        sum += a + b;
+      }
+    }
+  }
+  double elapsed = nowSec() - start;
+  printf("  RMUtil_ParseArgsAfter x%d: %7.1f ns/command (checksum %lld)\n", KW_NUM,
+         elapsed * 1e9 / ITERATIONS, sum);
+
+  RMUtilArgSchema *schema = RMUtil_NewArgSchema(keywords, KW_NUM);
+  sum = 0;
+  start = nowSec();
+  for (int it = 0; it < ITERATIONS; it++) {
+    int pos[KW_NUM];
+    RMUtilArgSchema_Parse(schema, cmdArgv, nargs, 2, pos);
+    for (int k = 0; k < KW_NUM; k++) {
+      if (pos[k] >= 0 && RMUtil_ParseArgs(cmdArgv, nargs, pos[k] + 1, "ll", &a, &b) ==
+                             REDISMODULE_OK) {
+        sum += a + b;
+      }
+    }
+  }
+  elapsed = nowSec() - start;
+  printf("  RMUtilArgSchema_Parse:     %7.1f ns/command (checksum %lld)\n",
+         elapsed * 1e9 / ITERATIONS, sum);
+
+  RMUtilArgSchema_Free(schema);
+  return 0;
+}
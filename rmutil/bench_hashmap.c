@@ -0,0 +1,217 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "hashmap.h"
+
+/* Benchmark of the open addressing hash map against a chained hash table laid out like the Redis
+ * dict, with an allocation per entry, and binary search over a sorted array standing in for an
+ * ordered index. RedisModule_DictGetC is a radix tree that only runs inside redis; lookups in it
+ * walk nodes like the chained table does, and are at best as fast as the binary search.
+ *
+ * It inserts, looks up (hits and misses) and deletes 1M random 64 bit keys, and reports the slowest
+ * single insert, which shows the cost of growing the tables */
+
+#define NUM_KEYS (1 << 20)
+
+RMUTIL_HASHMAP_DECLARE(IdMap, uint64_t, uint64_t, RMUtil_HashU64(k), a == b)
+
+static double nowSec() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t rnd = 88172645463325252ULL;
+static uint64_t nextRand() {
+  rnd ^= rnd << 13;
+  rnd ^= rnd >> 7;
+  rnd ^= rnd << 17;
+  return rnd;
+}
+
+static void report(const char *impl, const char *op, size_t n, double elapsed, size_t check) {
+  printf("  %-12s %-8s %8.2f ns/op (checksum %zu)\n", impl, op, elapsed * 1e9 / n, check);
+}
+
+/* A chained hash table like dict.c: a power of 2 array of buckets holding linked entries. It grows
+ * in one go rather than incrementally, as dict.c does when rehashing is not driven by a cron */
+typedef struct chainEntry {
+  uint64_t key, value;
+  struct chainEntry *next;
+} chainEntry;
+
+typedef struct {
+  chainEntry **table;
+  size_t size, used;
+} chainDict;
+
+static void chainExpand(chainDict *d) {
+  size_t size = d->size ? d->size * 2 : 4;
+  chainEntry **table = calloc(size, sizeof(*table));
+  for (size_t i = 0; i < d->size; i++) {
+    chainEntry *e = d->table[i];
+    while (e) {
+      chainEntry *next = e->next;
+      size_t b = RMUtil_HashU64(e->key) & (size - 1);
+      e->next = table[b];
+      table[b] = e;
+      e = next;
+    }
+  }
+  free(d->table);
+  d->table = table;
+  d->size = size;
+}
+
+static chainEntry *chainFind(chainDict *d, uint64_t key) {
+  if (!d->size) return NULL;
+  for (chainEntry *e = d->table[RMUtil_HashU64(key) & (d->size - 1)]; e; e = e->next) {
+    if (e->key == key) return e;
+  }
+  return NULL;
+}
+
+static void chainPut(chainDict *d, uint64_t key, uint64_t value) {
+  chainEntry *e = chainFind(d, key);
+  if (e) {
+    e->value = value;
+    return;
+  }
+  if (d->used >= d->size) chainExpand(d);
+  size_t b = RMUtil_HashU64(key) & (d->size - 1);
+  e = malloc(sizeof(*e));
+  e->key = key;
+  e->value = value;
+  e->next = d->table[b];
+  d->table[b] = e;
+  d->used++;
+}
+
+static void chainDel(chainDict *d, uint64_t key) {
+  chainEntry **pe = &d->table[RMUtil_HashU64(key) & (d->size - 1)];
+  for (; *pe; pe = &(*pe)->next) {
+    if ((*pe)->key == key) {
+      chainEntry *e = *pe;
+      *pe = e->next;
+      free(e);
+      d->used--;
+      return;
+    }
+  }
+}
+
+static int cmpU64(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+  return x < y ? -1 : x > y;
+}
+
+static uint64_t *sortedFind(uint64_t *arr, size_t n, uint64_t key) {
+  size_t lo = 0;
+  while (n > 1) {
+    size_t half = n / 2;
+    if (arr[lo + half] <= key) lo += half;
+    n -= half;
+  }
+  return arr[lo] == key ? &arr[lo] : NULL;
+}
+
+int main(int argc, char **argv) {
+  uint64_t *keys = malloc(NUM_KEYS * sizeof(*keys)), *misses = malloc(NUM_KEYS * sizeof(*keys));
+  for (size_t i = 0; i < NUM_KEYS; i++) {
+    keys[i] = nextRand();
+    misses[i] = nextRand();
+  }
+  // look the keys up in another order than they were inserted, so the entries the chained table
+  // allocated one after the other are not read in sequence
+  uint64_t *lookups = malloc(NUM_KEYS * sizeof(*lookups));
+  memcpy(lookups, keys, NUM_KEYS * sizeof(*lookups));
+  for (size_t i = NUM_KEYS - 1; i > 0; i--) {
+    size_t j = nextRand() % (i + 1);
+    uint64_t tmp = lookups[i];
+    lookups[i] = lookups[j];
+    lookups[j] = tmp;
+  }
+  double start, t, slowest;
+  size_t check;
+
+  printf("Hash map of %d random 64 bit keys:\n", NUM_KEYS);
+
+  // time each insert on a first map to find the slowest one, then all of them on a second one
+  IdMap m;
+  IdMap_Init(&m, 0);
+  slowest = 0;
+  for (size_t i = 0; i < NUM_KEYS; i++) {
+    t = nowSec();
+    IdMap_Put(&m, keys[i], i);
+    t = nowSec() - t;
+    if (t > slowest) slowest = t;
+  }
+  IdMap_Free(&m);
+  IdMap_Init(&m, 0);
+  start = nowSec();
+  for (size_t i = 0; i < NUM_KEYS; i++) IdMap_Put(&m, keys[i], i);
+  report("hashmap", "insert", NUM_KEYS, nowSec() - start, IdMap_Size(&m));
+  printf("  %-12s slowest insert %.1f us\n", "hashmap", slowest * 1e6);
+  while (IdMap_RehashStep(&m, 1024))
+    ;
+  check = 0;
+  start = nowSec();
+  for (size_t i = 0; i < NUM_KEYS; i++) check += *IdMap_Get(&m, lookups[i]);
+  report("hashmap", "hit", NUM_KEYS, nowSec() - start, check);
+  check = 0;
+  start = nowSec();
+  for (size_t i = 0; i < NUM_KEYS; i++) check += IdMap_Get(&m, misses[i]) != NULL;
+  report("hashmap", "miss", NUM_KEYS, nowSec() - start, check);
+  start = nowSec();
+  for (size_t i = 0; i < NUM_KEYS; i++) IdMap_Del(&m, lookups[i], NULL);
+  report("hashmap", "delete", NUM_KEYS, nowSec() - start, IdMap_Size(&m));
+  IdMap_Free(&m);
+
+  chainDict d = {0};
+  slowest = 0;
+  for (size_t i = 0; i < NUM_KEYS; i++) {
+    t = nowSec();
+    chainPut(&d, keys[i], i);
+    t = nowSec() - t;
+    if (t > slowest) slowest = t;
+  }
+  for (size_t i = 0; i < NUM_KEYS; i++) chainDel(&d, keys[i]);
+  free(d.table);
+  memset(&d, 0, sizeof(d));
+  start = nowSec();
+  for (size_t i = 0; i < NUM_KEYS; i++) chainPut(&d, keys[i], i);
+  report("chained", "insert", NUM_KEYS, nowSec() - start, d.used);
+  printf("  %-12s slowest insert %.1f us\n", "chained", slowest * 1e6);
+  check = 0;
+  start = nowSec();
+  for (size_t i = 0; i < NUM_KEYS; i++) check += chainFind(&d, lookups[i])->value;
+  report("chained", "hit", NUM_KEYS, nowSec() - start, check);
+  check = 0;
+  start = nowSec();
+  for (size_t i = 0; i < NUM_KEYS; i++) check += chainFind(&d, misses[i]) != NULL;
+  report("chained", "miss", NUM_KEYS, nowSec() - start, check);
+  start = nowSec();
+  for (size_t i = 0; i < NUM_KEYS; i++) chainDel(&d, lookups[i]);
+  report("chained", "delete", NUM_KEYS, nowSec() - start, d.used);
+  free(d.table);
+
+  uint64_t *sorted = malloc(NUM_KEYS * sizeof(*sorted));
+  memcpy(sorted, keys, NUM_KEYS * sizeof(*sorted));
+  qsort(sorted, NUM_KEYS, sizeof(*sorted), cmpU64);
+  check = 0;
+  start = nowSec();
+  for (size_t i = 0; i < NUM_KEYS; i++) check += sortedFind(sorted, NUM_KEYS, lookups[i]) != NULL;
+  report("sorted array", "hit", NUM_KEYS, nowSec() - start, check);
+  check = 0;
+  start = nowSec();
+  for (size_t i = 0; i < NUM_KEYS; i++) check += sortedFind(sorted, NUM_KEYS, misses[i]) != NULL;
+  report("sorted array", "miss", NUM_KEYS, nowSec() - start, check);
+
+  free(sorted);
+  free(lookups);
+  free(keys);
+  free(misses);
+  return 0;
+}
@@ -0,0 +1,91 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include "heap.h"
+
+/* Benchmark of the generic Vector based heap against the typed heap template, with binary and
+ * 4-ary layouts. Each round builds a heap of N doubles, pushes N more one by one and pops them
+ * all */
+
+RMUTIL_HEAP_DECLARE_ARY(BinaryHeap, double, 2, (a > b) - (a < b))
+RMUTIL_HEAP_DECLARE_ARY(QuadHeap, double, 4, (a > b) - (a < b))
+
+static int cmpDouble(void *a, void *b) {
+    double x = *(double *)a, y = *(double *)b;
+    return (x > y) - (x < y);
+}
+
+static double nowSec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double *randomDoubles(size_t n) {
+    double *ret = malloc(n * sizeof(double));
+    uint64_t x = 88172645463325252ULL;
+    for (size_t i = 0; i < n; i++) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        ret[i] = (double)(x >> 11) / (double)(1ULL << 53);
+    }
+    return ret;
+}
+
+static void report(const char *name, size_t n, double start, double check) {
+    double elapsed = nowSec() - start;
+    printf("  %-16s %10zu elements: %8.3f sec, %7.2f ns/element (checksum %f)\n", name, n,
+           elapsed, elapsed * 1e9 / (2 * n), check);
+}
+
+static void benchGeneric(double *in, size_t n) {
+    Vector *v = NewVector(double, 2 * n);
+    double start = nowSec();
+    for (size_t i = 0; i < n; i++) {
+        __vector_PushPtr(v, &in[i]);
+    }
+    Make_Heap(v, 0, v->top, cmpDouble);
+    for (size_t i = n; i < 2 * n; i++) {
+        __vector_PushPtr(v, &in[i]);
+        Heap_Push(v, 0, v->top, cmpDouble);
+    }
+    for (size_t top = v->top; top > 0; top--) {
+        Heap_Pop(v, 0, top, cmpDouble);
+    }
+    double d;
+    Vector_Get(v, 0, &d);
+    report("Heap (generic)", n, start, d);
+    Vector_Free(v);
+}
+
+#define BENCH_TYPED(heap, label)                                \
+    {                                                           \
+        double *h = malloc(2 * n * sizeof(double));             \
+        double start = nowSec();                                \
+        memcpy(h, in, n * sizeof(double));                      \
+        heap##_Make(h, n);                                      \
+        for (size_t i = n; i < 2 * n; i++) {                    \
+            h[i] = in[i];                                       \
+            heap##_Push(h, i + 1);                              \
+        }                                                       \
+        for (size_t top = 2 * n; top > 0; top--) {              \
+            heap##_Pop(h, top);                                 \
+        }                                                       \
+        report(label, n, start, h[0]);                          \
+        free(h);                                                \
+    }
+
+int main(int argc, char **argv) {
+    size_t sizes[] = {1000, 1000000, 10000000};
+    for (int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        size_t n = sizes[i];
+        double *in = randomDoubles(2 * n);
+        printf("Heap benchmark, %zu elements:\n", n);
+        benchGeneric(in, n);
+        BENCH_TYPED(BinaryHeap, "Heap (2-ary)");
+        BENCH_TYPED(QuadHeap, "Heap (4-ary)");
+        free(in);
+    }
+    return 0;
+}
@@ -0,0 +1,151 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+// define the module API pointers here, they are left NULL outside of redis
+#define REDISMODULE_MAIN
+#include "ring.h"
+
+/* Microbenchmark handing pointers between threads through an RMUtilRing in each mode, pushing
+ * and popping one at a time and in batches, over a range of producer counts, against a ring
+ * guarded by a mutex. Threads yield when the queue is full or empty, so the numbers stay
+ * meaningful with fewer cores than threads */
+
+#define ITEMS (1 << 21)
+#define CAPACITY 1024
+#define BATCH 32
+
+static double nowSec() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* The baseline: a ring of pointers under a mutex */
+typedef struct {
+  pthread_mutex_t lock;
+  void **items;
+  size_t head, tail;
+} lockedQueue;
+
+static size_t lockedPush(void *q, void *const *items, size_t n) {
+  lockedQueue *lq = q;
+  pthread_mutex_lock(&lq->lock);
+  size_t k = 0;
+  for (; k < n && lq->tail - lq->head < CAPACITY; k++) {
+    lq->items[lq->tail++ % CAPACITY] = items[k];
+  }
+  pthread_mutex_unlock(&lq->lock);
+  return k;
+}
+
+static size_t lockedPop(void *q, void **items, size_t n) {
+  lockedQueue *lq = q;
+  pthread_mutex_lock(&lq->lock);
+  size_t k = 0;
+  for (; k < n && lq->head < lq->tail; k++) items[k] = lq->items[lq->head++ % CAPACITY];
+  pthread_mutex_unlock(&lq->lock);
+  return k;
+}
+
+static size_t ringPush(void *q, void *const *items, size_t n) {
+  return RMUtilRing_PushMany(q, items, n);
+}
+
+static size_t ringPop(void *q, void **items, size_t n) {
+  return RMUtilRing_PopMany(q, items, n);
+}
+
+typedef struct {
+  void *q;
+  size_t (*push)(void *q, void *const *items, size_t n);
+  size_t (*pop)(void *q, void **items, size_t n);
+  size_t batch;
+  // the items each producer pushes, and those left for the consumers to pop
+  size_t perProducer;
+  size_t left;
+  uint64_t sum;
+} benchQueue;
+
+static void *producer(void *p) {
+  benchQueue *b = p;
+  void *items[BATCH];
+  for (size_t i = 0; i < b->perProducer;) {
+    size_t n = b->perProducer - i < b->batch ? b->perProducer - i : b->batch;
+    for (size_t j = 0; j < n; j++) items[j] = (void *)(uintptr_t)(i + j + 1);
+    size_t pushed = b->push(b->q, items, n);
+    if (!pushed) sched_yield();
+    i += pushed;
+  }
+  return NULL;
+}
+
+static void *consumer(void *p) {
+  benchQueue *b = p;
+  void *items[BATCH];
+  uint64_t sum = 0;
+  while (__atomic_load_n(&b->left, __ATOMIC_RELAXED)) {
+    size_t n = b->pop(b->q, items, b->batch);
+    if (!n) {
+      sched_yield();
+      continue;
+    }
+    for (size_t i = 0; i < n; i++) sum += (uintptr_t)items[i];
+    __atomic_fetch_sub(&b->left, n, __ATOMIC_RELAXED);
+  }
+  __atomic_fetch_add(&b->sum, sum, __ATOMIC_RELAXED);
+  return NULL;
+}
+
+static void run(const char *name, benchQueue b, int producers, int consumers) {
+  pthread_t threads[16];
+  b.perProducer = ITEMS / producers;
+  b.left = b.perProducer * producers;
+  b.sum = 0;
+  double start = nowSec();
+  for (int i = 0; i < producers; i++) pthread_create(&threads[i], NULL, producer, &b);
+  for (int i = 0; i < consumers; i++) {
+    pthread_create(&threads[producers + i], NULL, consumer, &b);
+  }
+  for (int i = 0; i < producers + consumers; i++) pthread_join(threads[i], NULL);
+  double elapsed = nowSec() - start;
+
+  uint64_t expected = (uint64_t)producers * b.perProducer * (b.perProducer + 1) / 2;
+  printf("  %-8s %dP/%dC batch %-3zu %8.2f Mitems/s%s\n", name, producers, consumers, b.batch,
+         producers * b.perProducer / elapsed / 1e6, b.sum == expected ? "" : " (LOST ITEMS)");
+}
+
+static void runRing(RMUtilRingMode mode, const char *name, int producers, int consumers) {
+  for (size_t batch = 1; batch <= BATCH; batch *= BATCH) {
+    RMUtilRing *r = RMUtil_NewRing(mode, CAPACITY, 0);
+    run(name, (benchQueue){.q = r, .push = ringPush, .pop = ringPop, .batch = batch}, producers,
+        consumers);
+    RMUtilRing_Free(r);
+  }
+}
+
+static void runLocked(int producers, int consumers) {
+  for (size_t batch = 1; batch <= BATCH; batch *= BATCH) {
+    lockedQueue q = {.items = malloc(CAPACITY * sizeof(void *))};
+    pthread_mutex_init(&q.lock, NULL);
+    run("mutex", (benchQueue){.q = &q, .push = lockedPush, .pop = lockedPop, .batch = batch},
+        producers, consumers);
+    pthread_mutex_destroy(&q.lock);
+    free(q.items);
+  }
+}
+
+int main(int argc, char **argv) {
+  printf("Handing %d items between threads\n", ITEMS);
+  runRing(RMUTIL_RING_SPSC, "SPSC", 1, 1);
+  runLocked(1, 1);
+  for (int producers = 1; producers <= 8; producers *= 2) {
+    runRing(RMUTIL_RING_MPSC, "MPSC", producers, 1);
+    runLocked(producers, 1);
+  }
+  runRing(RMUTIL_RING_MPMC, "MPMC", 4, 4);
+  runLocked(4, 4);
+  return 0;
+}
@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "sds.h"
+
+/* Benchmark of the sds number formatting and parsing functions against the generic formatting of
+ * sdscatprintf and sdscatfmt, and against strtoll and strtod */
+
+#define N 2000000
+
+static double nowSec() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const char *name, double start, size_t check) {
+  printf("  %-28s %7.2f ns/op (checksum %zu)\n", name, (nowSec() - start) * 1e9 / N, check);
+}
+
+static uint64_t rnd = 88172645463325252ULL;
+static uint64_t nextRand() {
+  rnd ^= rnd << 13;
+  rnd ^= rnd >> 7;
+  rnd ^= rnd << 17;
+  return rnd;
+}
+
+int main(int argc, char **argv) {
+  long long *ints = malloc(N * sizeof(*ints));
+  double *doubles = malloc(N * sizeof(*doubles));
+  for (int i = 0; i < N; i++) {
+    // numbers of every length, and scores as found in sorted sets
+    ints[i] = (long long)nextRand() >> (nextRand() % 64);
+    doubles[i] = i % 2 ? (double)(nextRand() % 1000000) / 100 : (double)nextRand() / 3e9;
+  }
+
+  sds s = sdsempty();
+  size_t check;
+  double start;
+
+  printf("Formatting, appending to a cleared string:\n");
+  check = 0, start = nowSec();
+  for (int i = 0; i < N; i++) {
+    sdsclear(s);
+    s = sdscatprintf(s, "%lld", ints[i]);
+    check += sdslen(s);
+  }
+  report("sdscatprintf(\"%lld\")", start, check);
+
+  check = 0, start = nowSec();
+  for (int i = 0; i < N; i++) {
+    sdsclear(s);
+    s = sdscatfmt(s, "%I", ints[i]);
+    check += sdslen(s);
+  }
+  report("sdscatfmt(\"%I\")", start, check);
+
+  check = 0, start = nowSec();
+  for (int i = 0; i < N; i++) {
+    sdsclear(s);
+    s = sdscatll(s, ints[i]);
+    check += sdslen(s);
+  }
+  report("sdscatll", start, check);
+
+  check = 0, start = nowSec();
+  for (int i = 0; i < N; i++) {
+    sdsclear(s);
+    s = sdscatprintf(s, "%.17g", doubles[i]);
+    check += sdslen(s);
+  }
+  report("sdscatprintf(\"%.17g\")", start, check);
+
+  check = 0, start = nowSec();
+  for (int i = 0; i < N; i++) {
+    sdsclear(s);
+    s = sdscatdouble(s, doubles[i]);
+    check += sdslen(s);
+  }
+  report("sdscatdouble", start, check);
+
+  printf("Parsing:\n");
+  sds *intStrs = malloc(N * sizeof(sds)), *doubleStrs = malloc(N * sizeof(sds));
+  for (int i = 0; i < N; i++) {
+    intStrs[i] = sdscatll(sdsempty(), ints[i]);
+    doubleStrs[i] = sdscatdouble(sdsempty(), doubles[i]);
+  }
+
+  check = 0, start = nowSec();
+  for (int i = 0; i < N; i++) {
+    check += strtoll(intStrs[i], NULL, 10) & 0xff;
+  }
+  report("strtoll", start, check);
+
+  check = 0, start = nowSec();
+  for (int i = 0; i < N; i++) {
+    long long v = 0;
+    sdstoll(intStrs[i], &v);
+    check += v & 0xff;
+  }
+  report("sdstoll", start, check);
+
+  check = 0, start = nowSec();
+  for (int i = 0; i < N; i++) {
+    check += (size_t)strtod(doubleStrs[i], NULL) & 0xff;
+  }
+  report("strtod", start, check);
+
+  check = 0, start = nowSec();
+  for (int i = 0; i < N; i++) {
+    double v = 0;
+    sdstod(doubleStrs[i], &v);
+    check += (size_t)v & 0xff;
+  }
+  report("sdstod", start, check);
+
+  for (int i = 0; i < N; i++) {
+    sdsfree(intStrs[i]);
+    sdsfree(doubleStrs[i]);
+  }
+  free(intStrs);
+  free(doubleStrs);
+  free(ints);
+  free(doubles);
+  sdsfree(s);
+  return 0;
+}
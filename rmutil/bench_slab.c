@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+// define the module API pointers here, they are left NULL outside of redis
+#define REDISMODULE_MAIN
+#define REDISMODULE_EXPERIMENTAL_API
+#include "slab.h"
+
+/* Benchmark of allocating the nodes of a data structure from the slab allocator against malloc.
+ * Each round allocates N 48 byte nodes, frees them in random order, and allocates them again */
+
+#define NODE_SIZE 48
+
+static double nowSec() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static size_t *shuffled(size_t n) {
+  size_t *ret = malloc(n * sizeof(size_t));
+  uint64_t x = 88172645463325252ULL;
+  for (size_t i = 0; i < n; i++) ret[i] = i;
+  for (size_t i = n - 1; i > 0; i--) {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    size_t j = x % (i + 1), t = ret[i];
+    ret[i] = ret[j];
+    ret[j] = t;
+  }
+  return ret;
+}
+
+static void report(const char *name, size_t n, double start, size_t check) {
+  double elapsed = nowSec() - start;
+  printf("  %-6s %10zu nodes: %8.3f sec, %6.2f ns/operation (checksum %zu)\n", name, n, elapsed,
+         elapsed * 1e9 / (3 * n), check);
+}
+
+int main(int argc, char **argv) {
+  static const size_t sizes[] = {10000, 1000000, 5000000};
+  printf("Node allocation benchmark, %d byte nodes:\n", NODE_SIZE);
+
+  for (int t = 0; t < 3; t++) {
+    size_t n = sizes[t];
+    size_t *order = shuffled(n);
+    void **nodes = malloc(n * sizeof(void *));
+
+    size_t check = 0;
+    double start = nowSec();
+    for (size_t i = 0; i < n; i++) {
+      nodes[i] = malloc(NODE_SIZE);
+      *(size_t *)nodes[i] = i;
+    }
+    for (size_t i = 0; i < n; i++) {
+      check += *(size_t *)nodes[order[i]];
+      free(nodes[order[i]]);
+    }
+    for (size_t i = 0; i < n; i++) {
+      nodes[i] = malloc(NODE_SIZE);
+      *(size_t *)nodes[i] = i;
+    }
+    report("malloc", n, start, check);
+    for (size_t i = 0; i < n; i++) free(nodes[i]);
+
+    RMUtilSlab *s = RMUtil_NewSlab(0);
+    check = 0;
+    start = nowSec();
+    for (size_t i = 0; i < n; i++) {
+      nodes[i] = RMUtilSlab_Alloc(s, NODE_SIZE);
+      *(size_t *)nodes[i] = i;
+    }
+    for (size_t i = 0; i < n; i++) {
+      check += *(size_t *)nodes[order[i]];
+      RMUtilSlab_Dealloc(s, nodes[order[i]], NODE_SIZE);
+    }
+    for (size_t i = 0; i < n; i++) {
+      nodes[i] = RMUtilSlab_Alloc(s, NODE_SIZE);
+      *(size_t *)nodes[i] = i;
+    }
+    report("slab", n, start, check);
+    RMUtilSlab_Free(s);
+
+    free(nodes);
+    free(order);
+  }
+  return 0;
+}
@@ -0,0 +1,120 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "sds.h"
+
+/* Benchmark of splitting into spans against sdssplitlen and sdssplitargs, which allocate a string
+ * per token, on 1KB and 1MB inputs */
+
+#define TOTAL_BYTES (64 * 1024 * 1024)
+#define BATCH 256
+
+static double nowSec() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const char *name, size_t len, size_t iters, double start, size_t check) {
+  double elapsed = nowSec() - start;
+  printf("  %-20s %8zu bytes: %8.1f MB/s (checksum %zu)\n", name, len,
+         (double)len * iters / elapsed / 1e6, check);
+}
+
+static uint64_t rnd = 88172645463325252ULL;
+static uint64_t nextRand() {
+  rnd ^= rnd << 13;
+  rnd ^= rnd >> 7;
+  rnd ^= rnd << 17;
+  return rnd;
+}
+
+/* Fill `buf` with fields of 1 to 16 bytes separated by `sep`, quoting some of them when `quote` */
+static void makeInput(char *buf, size_t len, char sep, int quote) {
+  size_t i = 0;
+  while (i < len) {
+    size_t n = 1 + nextRand() % 16;
+    int q = quote && nextRand() % 4 == 0 && i + n + 2 < len;
+    if (q) buf[i++] = '"';
+    for (size_t j = 0; j < n && i < len; j++) buf[i++] = 'a' + nextRand() % 26;
+    if (q) buf[i++] = '"';
+    if (i < len) buf[i++] = sep;
+  }
+}
+
+int main(int argc, char **argv) {
+  static const size_t lens[] = {1024, 1024 * 1024};
+  sdsspan *spans = malloc((1024 * 1024 / 2 + 1) * sizeof(sdsspan));
+
+  for (int l = 0; l < 2; l++) {
+    size_t len = lens[l], iters = TOTAL_BYTES / len;
+    char *buf = malloc(len), *out = malloc(len);
+    size_t check;
+    double start;
+
+    printf("Split on a single byte separator:\n");
+    makeInput(buf, len, ',', 0);
+    check = 0, start = nowSec();
+    for (size_t i = 0; i < iters; i++) {
+      int count;
+      sds *tokens = sdssplitlen(buf, len, ",", 1, &count);
+      check += count;
+      sdsfreesplitres(tokens, count);
+    }
+    report("sdssplitlen", len, iters, start, check);
+
+    check = 0, start = nowSec();
+    for (size_t i = 0; i < iters; i++) {
+      size_t pos = 0;
+      while (pos <= len) check += sdssplitspans(buf, len, ",", 1, spans, BATCH, &pos);
+    }
+    report("sdssplitspans", len, iters, start, check);
+
+    printf("Split on a multi byte separator:\n");
+    for (size_t i = 0; i < len; i++) {
+      if (buf[i] == ',') buf[i] = '|';
+    }
+    check = 0, start = nowSec();
+    for (size_t i = 0; i < iters; i++) {
+      int count;
+      sds *tokens = sdssplitlen(buf, len, "|a", 2, &count);
+      check += count;
+      sdsfreesplitres(tokens, count);
+    }
+    report("sdssplitlen", len, iters, start, check);
+
+    check = 0, start = nowSec();
+    for (size_t i = 0; i < iters; i++) {
+      size_t pos = 0;
+      while (pos <= len) check += sdssplitspans(buf, len, "|a", 2, spans, BATCH, &pos);
+    }
+    report("sdssplitspans", len, iters, start, check);
+
+    printf("Split arguments:\n");
+    makeInput(buf, len, ' ', 1);
+    // sdssplitargs needs a null terminated line
+    sds line = sdsnewlen(buf, len);
+    check = 0, start = nowSec();
+    for (size_t i = 0; i < iters; i++) {
+      int count;
+      sds *args = sdssplitargs(line, &count);
+      check += count;
+      sdsfreesplitres(args, count);
+    }
+    report("sdssplitargs", len, iters, start, check);
+
+    check = 0, start = nowSec();
+    for (size_t i = 0; i < iters; i++) {
+      check += sdssplitargsspans(line, len, out, spans, len / 2 + 1);
+    }
+    report("sdssplitargsspans", len, iters, start, check);
+
+    sdsfree(line);
+    free(buf);
+    free(out);
+  }
+  free(spans);
+  return 0;
+}
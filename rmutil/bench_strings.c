@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+// define the module API pointers here, they are left NULL outside of redis
+#define REDISMODULE_MAIN
+#define REDISMODULE_EXPERIMENTAL_API
+#include <redismodule.h>
+#include "strings.h"
+
+/* Benchmark of ASCII case conversion and case insensitive comparison, with the byte by byte libc
+ * functions and the scalar, SSE2 and AVX2 implementations, over short and long strings */
+
+#define TOTAL_BYTES (256 * 1024 * 1024)
+
+static double nowSec() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void libcToLower(char *s, size_t len) {
+  for (size_t i = 0; i < len; i++) s[i] = tolower(s[i]);
+}
+
+static void report(const char *op, const char *impl, size_t len, size_t iters, double start,
+                   size_t check) {
+  double elapsed = nowSec() - start;
+  printf("  %-9s %-8s %6zu bytes: %8.2f ns/string, %6.2f GB/s (checksum %zu)\n", op, impl, len,
+         elapsed * 1e9 / iters, (double)len * iters / elapsed / 1e9, check);
+}
+
+int main(int argc, char **argv) {
+  static const size_t lens[] = {8, 32, 256, 4096};
+  static const char *names[] = {"scalar", "sse2", "avx2"};
+  char *a = malloc(4096), *b = malloc(4096);
+  for (int i = 0; i < 4096; i++) {
+    a[i] = "Hello, World! Some-KEY:1234 "[i % 28];
+  }
+
+  printf("ASCII case benchmark:\n");
+  for (int l = 0; l < 4; l++) {
+    size_t len = lens[l], iters = TOTAL_BYTES / len / 4;
+    size_t check = 0;
+
+    double start = nowSec();
+    for (size_t i = 0; i < iters; i++) {
+      memcpy(b, a, len);
+      libcToLower(b, len);
+      check += b[i % len];
+    }
+    report("tolower", "libc", len, iters, start, check);
+
+    for (int level = RMUTIL_SIMD_NONE; level <= RMUTIL_SIMD_AVX2; level++) {
+      if (RMUtil_SetStringSIMD(level) != level) continue;
+      check = 0;
+      start = nowSec();
+      for (size_t i = 0; i < iters; i++) {
+        memcpy(b, a, len);
+        RMUtil_StrToLower(b, len);
+        check += b[i % len];
+      }
+      report("tolower", names[level], len, iters, start, check);
+    }
+
+    memcpy(b, a, len);
+    RMUtil_StrToUpper(b, len);
+    check = 0;
+    start = nowSec();
+    for (size_t i = 0; i < iters; i++) {
+      check += strncasecmp(a, b, len) == 0;
+      __asm__ volatile("" ::: "memory");
+    }
+    report("caseequal", "libc", len, iters, start, check);
+
+    for (int level = RMUTIL_SIMD_NONE; level <= RMUTIL_SIMD_AVX2; level++) {
+      if (RMUtil_SetStringSIMD(level) != level) continue;
+      check = 0;
+      start = nowSec();
+      for (size_t i = 0; i < iters; i++) {
+        check += RMUtil_StrCaseEqual(a, b, len);
+        __asm__ volatile("" ::: "memory");
+      }
+      report("caseequal", names[level], len, iters, start, check);
+    }
+  }
+
+  free(a);
+  free(b);
+  return 0;
+}
@@ -0,0 +1,134 @@
+#include "vector.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+/* Microbenchmark comparing the generic memcpy based Vector with the typed vector template, for
+ * 64-bit scalar elements (scores) and pointers, and the slowest resizes of a Vector growing in one
+ * go and incrementally. Note that glibc grows large buffers without copying them, with mremap,
+ * while jemalloc, used by redis, copies them */
+
+RMUTIL_VECTOR_DECLARE(U64Vector, uint64_t)
+
+#define N (1 << 24)
+
+static double nowSec() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const char *name, double start, size_t ops, uint64_t sum) {
+  double elapsed = nowSec() - start;
+  printf("  %-24s %8.2f ns/op (checksum %llu)\n", name, elapsed * 1e9 / ops,
+         (unsigned long long)sum);
+}
+
+static void benchGeneric() {
+  Vector *v = NewVector(uint64_t, 0);
+  uint64_t sum = 0;
+
+  double start = nowSec();
+  for (uint64_t i = 0; i < N; i++) {
+    Vector_Push(v, i);
+  }
+  report("Vector_Push", start, N, Vector_Size(v));
+
+  start = nowSec();
+  for (size_t i = 0; i < N; i++) {
+    uint64_t x;
+    Vector_Get(v, i, &x);
+    sum += x;
+  }
+  report("Vector_Get", start, N, sum);
+
+  start = nowSec();
+  sum = 0;
+  uint64_t x;
+  while (Vector_Pop(v, &x)) {
+    sum += x;
+  }
+  report("Vector_Pop", start, N, sum);
+
+  Vector_Free(v);
+}
+
+static void benchTyped() {
+  U64Vector v;
+  U64Vector_Init(&v, 0);
+  uint64_t sum = 0;
+
+  double start = nowSec();
+  for (uint64_t i = 0; i < N; i++) {
+    U64Vector_Push(&v, i);
+  }
+  report("RMUTIL_VECTOR Push", start, N, U64Vector_Size(&v));
+
+  start = nowSec();
+  for (size_t i = 0; i < N; i++) {
+    uint64_t x;
+    U64Vector_Get(&v, i, &x);
+    sum += x;
+  }
+  report("RMUTIL_VECTOR Get", start, N, sum);
+
+  start = nowSec();
+  sum = 0;
+  uint64_t x;
+  while (U64Vector_Pop(&v, &x)) {
+    sum += x;
+  }
+  report("RMUTIL_VECTOR Pop", start, N, sum);
+
+  U64Vector_Free(&v);
+}
+
+/* The slowest push that grew the vector or moved elements after growing. Other pushes may be as slow
+ * when they touch new pages, this does not depend on how the vector grows */
+static void benchGrowth(const char *name, size_t incrementalBytes) {
+  Vector *v = NewVector(uint64_t, 0);
+  Vector_SetIncremental(v, incrementalBytes);
+  double slowest = 0;
+  for (uint64_t i = 0; i < N; i++) {
+    size_t cap = Vector_Cap(v);
+    int migrating = Vector_IsMigrating(v);
+    double t = nowSec();
+    Vector_Push(v, i);
+    t = nowSec() - t;
+    if ((cap != Vector_Cap(v) || migrating) && t > slowest) slowest = t;
+  }
+  printf("  %-24s %8.1f us slowest growing push\n", name, slowest * 1e6);
+  Vector_Free(v);
+}
+
+/* The slowest of the Vector_Resize calls doubling a vector of 1M elements up to N elements, which
+ * zero the added capacity, filling the vector between them */
+static void benchResize(const char *name, size_t incrementalBytes) {
+  Vector *v = NewVector(uint64_t, 1 << 20);
+  Vector_SetIncremental(v, incrementalBytes);
+  double slowest = 0;
+  for (uint64_t i = 0; Vector_Cap(v) < N; i++) {
+    if (Vector_Size(v) == Vector_Cap(v)) {
+      double t = nowSec();
+      Vector_Resize(v, Vector_Cap(v) * 2);
+      t = nowSec() - t;
+      if (t > slowest) slowest = t;
+    }
+    Vector_Push(v, i);
+  }
+  printf("  %-24s %8.1f us slowest resize\n", name, slowest * 1e6);
+  Vector_Free(v);
+}
+
+int main(int argc, char **argv) {
+  printf("Vector benchmark, %d 64-bit elements\n", N);
+  benchGeneric();
+  benchTyped();
+  // incremental resizes first: once glibc freed large buffers it raises its mmap threshold, and
+  // calloc then needs to zero the memory rather than getting fresh pages
+  benchResize("Vector_Resize (incremental)", 1 << 20);
+  benchResize("Vector_Resize (realloc)", 0);
+  benchGrowth("Vector_Push (incremental)", 1 << 20);
+  benchGrowth("Vector_Push (realloc)", 0);
+  return 0;
+}
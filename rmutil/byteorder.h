@@ -0,0 +1,18 @@
+#ifndef RMUTIL_BYTEORDER_H_
+#define RMUTIL_BYTEORDER_H_
+#include <stdint.h>
+
+/** byteorder.h - Reading and writing integers of 1 to 8 bytes in little endian, for the RDB formats
+ * of the containers that save their contents as a single string buffer */
+
+static inline void RMUtil_PutLE(uint8_t *p, uint64_t x, int bytes) {
+  for (int i = 0; i < bytes; i++) p[i] = x >> (8 * i);
+}
+
+static inline uint64_t RMUtil_GetLE(const uint8_t *p, int bytes) {
+  uint64_t x = 0;
+  for (int i = 0; i < bytes; i++) x |= (uint64_t)p[i] << (8 * i);
+  return x;
+}
+
+#endif
@@ -0,0 +1,394 @@
+#ifndef RMUTIL_HASHMAP_H_
+#define RMUTIL_HASHMAP_H_
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/** hashmap.h - An open addressing hash map template.
+ *
+ * The layout follows Swiss tables: slots are split into groups of 16, and each slot has a control
+ * byte holding 7 bits of its key's hash, or a marker for empty and deleted slots. A lookup loads
+ * the 16 control bytes of a group at once and compares them to the hash with SSE2, so only the
+ * slots whose hash bits match are compared by key, and it stops at the first group with an empty
+ * slot. Keys and values are stored inline, in a single allocation with the control bytes.
+ *
+ * Growing the map never rehashes everything at once: a new table twice the size is allocated, and
+ * the entries of the old table are moved to it a few groups at a time by the following inserts and
+ * deletes, or by RehashStep. Lookups check both tables meanwhile.
+ */
+
+/* The number of slots in a group */
+#define RMUTIL_HASHMAP_GROUP 16
+
+/* The number of groups moved to the new table by each insert and delete while growing */
+#define RMUTIL_HASHMAP_MIGRATE_GROUPS 2
+
+/* Control bytes of the slots that are not in use. Used slots hold 7 bits of the hash with the high
+ * bit set. Empty slots are zero so that tables can be allocated with calloc: large tables then come
+ * as zeroed pages from the system, and allocating the new table when growing costs nothing until
+ * it is filled */
+#define RMUTIL_HASHMAP_EMPTY ((int8_t)0)
+#define RMUTIL_HASHMAP_DELETED ((int8_t)1)
+#define RMUTIL_HASHMAP_USED(h) ((int8_t)(0x80 | ((h)&0x7f)))
+
+/* Hash functions for common key types */
+static inline uint64_t RMUtil_HashU64(uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return x;
+}
+
+/* MurmurHash64A */
+static inline uint64_t RMUtil_HashBytes(const void *p, size_t len) {
+  const uint64_t m = 0xc6a4a7935bd1e995ULL;
+  const unsigned char *data = (const unsigned char *)p, *end = data + (len & ~(size_t)7);
+  uint64_t h = 0x5bd1e995ULL ^ (len * m);
+
+  for (; data != end; data += 8) {
+    uint64_t k;
+    memcpy(&k, data, sizeof(k));
+    k *= m;
+    k ^= k >> 47;
+    k *= m;
+    h ^= k;
+    h *= m;
+  }
+  switch (len & 7) {
+    case 7: h ^= (uint64_t)data[6] << 48; /* fall through */
+    case 6: h ^= (uint64_t)data[5] << 40; /* fall through */
+    case 5: h ^= (uint64_t)data[4] << 32; /* fall through */
+    case 4: h ^= (uint64_t)data[3] << 24; /* fall through */
+    case 3: h ^= (uint64_t)data[2] << 16; /* fall through */
+    case 2: h ^= (uint64_t)data[1] << 8;  /* fall through */
+    case 1:
+      h ^= (uint64_t)data[0];
+      h *= m;
+  }
+  h ^= h >> 47;
+  h *= m;
+  h ^= h >> 47;
+  return h;
+}
+
+/* Bit masks of the slots of a group whose control byte is `h2`, that are empty, or that are free,
+ * i.e. empty or deleted */
+static inline uint32_t __hashmap_Match(const int8_t *ctrl, int8_t h2) {
+#ifdef __SSE2__
+  __m128i g = _mm_loadu_si128((const __m128i *)ctrl);
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8(h2)));
+#else
+  uint32_t mask = 0;
+  for (int i = 0; i < RMUTIL_HASHMAP_GROUP; i++) mask |= (uint32_t)(ctrl[i] == h2) << i;
+  return mask;
+#endif
+}
+
+static inline uint32_t __hashmap_MatchEmpty(const int8_t *ctrl) {
+  return __hashmap_Match(ctrl, RMUTIL_HASHMAP_EMPTY);
+}
+
+static inline uint32_t __hashmap_MatchFree(const int8_t *ctrl) {
+#ifdef __SSE2__
+  // the free slots are those without the sign bit set
+  return ~_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)ctrl)) & 0xffff;
+#else
+  uint32_t mask = 0;
+  for (int i = 0; i < RMUTIL_HASHMAP_GROUP; i++) mask |= (uint32_t)(ctrl[i] >= 0) << i;
+  return mask;
+#endif
+}
+
+/* Mark slot `s` free. It can only be made empty if its group has an empty slot: then no probe ever
+ * went past the group, and no key depends on the slot being in use */
+static inline void __hashmap_Erase(int8_t *ctrl, size_t s, size_t *growthLeft) {
+  if (__hashmap_MatchEmpty(ctrl + (s & ~(size_t)(RMUTIL_HASHMAP_GROUP - 1)))) {
+    ctrl[s] = RMUTIL_HASHMAP_EMPTY;
+    ++*growthLeft;
+  } else {
+    ctrl[s] = RMUTIL_HASHMAP_DELETED;
+  }
+}
+
+/* The index of the first free slot on the probe sequence of hash `h` */
+static inline size_t __hashmap_FindFree(const int8_t *ctrl, size_t cap, uint64_t h) {
+  size_t groupMask = cap / RMUTIL_HASHMAP_GROUP - 1;
+  size_t g = (h >> 7) & groupMask;
+  for (size_t i = 1;; i++) {
+    uint32_t m = __hashmap_MatchFree(ctrl + g * RMUTIL_HASHMAP_GROUP);
+    if (m) return g * RMUTIL_HASHMAP_GROUP + __builtin_ctz(m);
+    // triangular probing visits every group when their number is a power of 2
+    g = (g + i) & groupMask;
+  }
+}
+
+/*
+* Typed hash map template.
+* RMUTIL_HASHMAP_DECLARE(name, K, V, hash_expr, eq_expr) declares a map struct called `name` from
+* keys of type K to values of type V, and static inline functions operating on it, prefixed with
+* `name_`. `hash_expr` computes the uint64_t hash of a key `k`, and `eq_expr` tells whether two keys
+* `a` and `b` are equal. Both are inlined into the generated functions, e.g.:
+*
+*   RMUTIL_HASHMAP_DECLARE(IdMap, uint64_t, double, RMUtil_HashU64(k), a == b)
+*   RMUTIL_HASHMAP_DECLARE(StrMap, const char *, int, RMUtil_HashBytes(k, strlen(k)),
+*                          !strcmp(a, b))
+*
+*   IdMap m;
+*   IdMap_Init(&m, 0);
+*   IdMap_Put(&m, 42, 3.14);
+*   double *d = IdMap_Get(&m, 42);
+*   IdMap_Free(&m);
+*
+* The map stores the keys as they are: pointer keys must stay valid while they are in the map.
+*
+* The generated functions are:
+*   void   name_Init(name *m, size_t cap)        - initialize an empty map with room for cap entries
+*   void   name_Free(name *m)                    - release the map's memory
+*   size_t name_Size(const name *m)              - number of entries in the map
+*   V     *name_Get(const name *m, K key)        - pointer to the value of key, or NULL
+*   V     *name_Insert(name *m, K key, int *isNew) - pointer to the value of key, inserting it with
+*                                                  an uninitialized value if it is new
+*   int    name_Put(name *m, K key, V value)     - set the value of key, 1 if it is new, 0 otherwise
+*   int    name_Del(name *m, K key, V *value)    - remove key, copying its value to value unless it
+*                                                  is NULL. Returns 0 if the key was not found
+*   void   name_Reserve(name *m, size_t n)       - make room for n entries
+*   int    name_RehashStep(name *m, size_t groups) - move up to `groups` groups of the old table,
+*                                                  returns 1 while there are more to move
+*   int    name_IsRehashing(const name *m)       - 1 while entries remain in the old table
+*   int    name_Next(const name *m, name_Iterator *it, K *key, V **value) - iterate the map, see
+*                                                  below
+*
+* Iterating starts from a zeroed name_Iterator, and visits each entry once as long as the map is
+* not changed meanwhile:
+*
+*   IdMap_Iterator it = {0};
+*   uint64_t id;
+*   double *score;
+*   while (IdMap_Next(&m, &it, &id, &score)) { ... }
+*/
+#define RMUTIL_HASHMAP_DECLARE(name, K, V, hash_expr, eq_expr)                                    \
+  typedef struct {                                                                                \
+    K key;                                                                                        \
+    V value;                                                                                      \
+  } name##_Entry;                                                                                 \
+                                                                                                  \
+  typedef struct {                                                                                \
+    int8_t *ctrl;                                                                                 \
+    name##_Entry *slots;                                                                          \
+    size_t cap;                                                                                   \
+    size_t used;                                                                                  \
+    size_t growthLeft;                                                                            \
+  } name##_Table;                                                                                 \
+                                                                                                  \
+  typedef struct {                                                                                \
+    name##_Table cur;                                                                             \
+    /* the table being moved to cur while growing, and the number of its groups moved so far */   \
+    name##_Table old;                                                                             \
+    size_t migrated;                                                                              \
+  } name;                                                                                         \
+                                                                                                  \
+  typedef struct {                                                                                \
+    size_t pos;                                                                                   \
+    int inOld;                                                                                    \
+  } name##_Iterator;                                                                              \
+                                                                                                  \
+  static inline uint64_t name##__Hash(K k) {                                                      \
+    return (hash_expr);                                                                           \
+  }                                                                                               \
+                                                                                                  \
+  static inline int name##__Eq(K a, K b) {                                                        \
+    return (eq_expr);                                                                             \
+  }                                                                                               \
+                                                                                                  \
+  static inline void name##__TableInit(name##_Table *t, size_t cap) {                             \
+    /* the slots follow the control bytes, cap being a multiple of 16 keeps them aligned */       \
+    t->ctrl = (int8_t *)calloc(1, cap + cap * sizeof(name##_Entry));                              \
+    t->slots = (name##_Entry *)(t->ctrl + cap);                                                   \
+    t->cap = cap;                                                                                 \
+    t->used = 0;                                                                                  \
+    t->growthLeft = cap - cap / 8;                                                                \
+  }                                                                                               \
+                                                                                                  \
+  static inline void name##__TableFree(name##_Table *t) {                                         \
+    free(t->ctrl);                                                                                \
+    memset(t, 0, sizeof(*t));                                                                     \
+  }                                                                                               \
+                                                                                                  \
+  static inline size_t name##__TableFind(const name##_Table *t, K key, uint64_t h) {              \
+    if (!t->cap) return (size_t)-1;                                                               \
+    size_t groupMask = t->cap / RMUTIL_HASHMAP_GROUP - 1;                                         \
+    size_t g = (h >> 7) & groupMask;                                                              \
+    int8_t h2 = RMUTIL_HASHMAP_USED(h);                                                           \
+    for (size_t i = 1;; i++) {                                                                    \
+      const int8_t *ctrl = t->ctrl + g * RMUTIL_HASHMAP_GROUP;                                    \
+      uint32_t m = __hashmap_Match(ctrl, h2);                                                     \
+      while (m) {                                                                                 \
+        size_t s = g * RMUTIL_HASHMAP_GROUP + __builtin_ctz(m);                                   \
+        if (__builtin_expect(name##__Eq(t->slots[s].key, key), 1)) return s;                      \
+        m &= m - 1;                                                                               \
+      }                                                                                           \
+      if (__builtin_expect(__hashmap_MatchEmpty(ctrl) != 0, 1)) return (size_t)-1;                \
+      g = (g + i) & groupMask;                                                                    \
+    }                                                                                             \
+  }                                                                                               \
+                                                                                                  \
+  /* Put a key known not to be in the table in a free slot. The table must have room for it */    \
+  static inline name##_Entry *name##__TableAdd(name##_Table *t, K key, uint64_t h) {              \
+    size_t s = __hashmap_FindFree(t->ctrl, t->cap, h);                                            \
+    if (t->ctrl[s] == RMUTIL_HASHMAP_EMPTY) t->growthLeft--;                                      \
+    t->ctrl[s] = RMUTIL_HASHMAP_USED(h);                                                          \
+    t->used++;                                                                                    \
+    t->slots[s].key = key;                                                                        \
+    return &t->slots[s];                                                                          \
+  }                                                                                               \
+                                                                                                  \
+  static inline void name##_Init(name *m, size_t cap);                                            \
+                                                                                                  \
+  static inline int name##_IsRehashing(const name *m) {                                           \
+    return m->old.cap != 0;                                                                       \
+  }                                                                                               \
+                                                                                                  \
+  static inline int name##_RehashStep(name *m, size_t groups) {                                   \
+    if (!m->old.cap) return 0;                                                                    \
+    size_t ngroups = m->old.cap / RMUTIL_HASHMAP_GROUP;                                           \
+    while (groups-- && m->migrated < ngroups && m->old.used) {                                    \
+      size_t s = m->migrated++ * RMUTIL_HASHMAP_GROUP;                                            \
+      for (size_t end = s + RMUTIL_HASHMAP_GROUP; s < end; s++) {                                 \
+        if (m->old.ctrl[s] >= 0) continue;                                                        \
+        name##_Entry *e = &m->old.slots[s];                                                       \
+        name##__TableAdd(&m->cur, e->key, name##__Hash(e->key))->value = e->value;                \
+        /* lookups, deletes and iteration of the old table must not see the entry again */         \
+        m->old.ctrl[s] = RMUTIL_HASHMAP_DELETED;                                                  \
+        m->old.used--;                                                                            \
+      }                                                                                           \
+    }                                                                                             \
+    if (m->migrated == ngroups || !m->old.used) {                                                 \
+      name##__TableFree(&m->old);                                                                 \
+      m->migrated = 0;                                                                            \
+      return 0;                                                                                   \
+    }                                                                                             \
+    return 1;                                                                                     \
+  }                                                                                               \
+                                                                                                  \
+  /* Start moving the entries to a new table of `cap` slots */                                    \
+  static inline void name##__Grow(name *m, size_t cap) {                                          \
+    name##_RehashStep(m, (size_t)-1);                                                             \
+    m->old = m->cur;                                                                              \
+    m->migrated = 0;                                                                              \
+    name##__TableInit(&m->cur, cap);                                                              \
+    if (!m->old.used) name##__TableFree(&m->old);                                                 \
+  }                                                                                               \
+                                                                                                  \
+  static inline void name##_Reserve(name *m, size_t n) {                                          \
+    size_t cap = RMUTIL_HASHMAP_GROUP;                                                            \
+    while (cap - cap / 8 < n) cap *= 2;                                                           \
+    if (cap > m->cur.cap && n > m->cur.used + m->cur.growthLeft) name##__Grow(m, cap);            \
+  }                                                                                               \
+                                                                                                  \
+  static inline void name##_Init(name *m, size_t cap) {                                           \
+    memset(m, 0, sizeof(*m));                                                                     \
+    if (cap) name##_Reserve(m, cap);                                                              \
+  }                                                                                               \
+                                                                                                  \
+  static inline void name##_Free(name *m) {                                                       \
+    free(m->cur.ctrl);                                                                            \
+    free(m->old.ctrl);                                                                            \
+    memset(m, 0, sizeof(*m));                                                                     \
+  }                                                                                               \
+                                                                                                  \
+  static inline size_t name##_Size(const name *m) {                                               \
+    return m->cur.used + m->old.used;                                                             \
+  }                                                                                               \
+                                                                                                  \
+  static inline V *name##_Get(const name *m, K key) {                                             \
+    uint64_t h = name##__Hash(key);                                                               \
+    size_t s = name##__TableFind(&m->cur, key, h);                                                \
+    if (s != (size_t)-1) return &m->cur.slots[s].value;                                           \
+    if (__builtin_expect(m->old.cap != 0, 0)) {                                                   \
+      s = name##__TableFind(&m->old, key, h);                                                     \
+      if (s != (size_t)-1) return &m->old.slots[s].value;                                         \
+    }                                                                                             \
+    return NULL;                                                                                  \
+  }                                                                                               \
+                                                                                                  \
+  static inline V *name##_Insert(name *m, K key, int *isNew) {                                    \
+    if (__builtin_expect(m->old.cap != 0, 0)) {                                                   \
+      name##_RehashStep(m, RMUTIL_HASHMAP_MIGRATE_GROUPS);                                        \
+    }                                                                                             \
+    V *v = name##_Get(m, key);                                                                    \
+    if (v) {                                                                                      \
+      if (isNew) *isNew = 0;                                                                      \
+      return v;                                                                                   \
+    }                                                                                             \
+    if (isNew) *isNew = 1;                                                                        \
+                                                                                                  \
+    uint64_t h = name##__Hash(key);                                                               \
+    /* the new table keeps room for the entries left in the old one, which makes sure moving them \
+     * never runs out of space. It takes far more inserts than there are groups left to move for  \
+     * this to be needed, so finishing the move here does not happen in practice */               \
+    if (__builtin_expect(m->cur.growthLeft <= m->old.used, 0)) {                                  \
+      name##_RehashStep(m, (size_t)-1);                                                           \
+      if (m->cur.growthLeft == 0) {                                                               \
+        /* a free slot may be a deleted one, which can be reused without growing */               \
+        if (m->cur.cap) {                                                                         \
+          size_t s = __hashmap_FindFree(m->cur.ctrl, m->cur.cap, h);                              \
+          if (m->cur.ctrl[s] == RMUTIL_HASHMAP_DELETED) {                                         \
+            return &name##__TableAdd(&m->cur, key, h)->value;                                     \
+          }                                                                                       \
+        }                                                                                         \
+        /* double the table, unless most of it is deleted slots that rehashing drops */           \
+        size_t live = m->cur.used, cap = m->cur.cap ? m->cur.cap : RMUTIL_HASHMAP_GROUP;          \
+        while (cap - cap / 8 < live + live / 2 + 1) cap *= 2;                                     \
+        name##__Grow(m, cap);                                                                     \
+      }                                                                                           \
+    }                                                                                             \
+    return &name##__TableAdd(&m->cur, key, h)->value;                                             \
+  }                                                                                               \
+                                                                                                  \
+  static inline int name##_Put(name *m, K key, V value) {                                         \
+    int isNew;                                                                                    \
+    *name##_Insert(m, key, &isNew) = value;                                                       \
+    return isNew;                                                                                 \
+  }                                                                                               \
+                                                                                                  \
+  static inline int name##_Del(name *m, K key, V *value) {                                        \
+    if (__builtin_expect(m->old.cap != 0, 0)) {                                                   \
+      name##_RehashStep(m, RMUTIL_HASHMAP_MIGRATE_GROUPS);                                        \
+    }                                                                                             \
+    uint64_t h = name##__Hash(key);                                                               \
+    name##_Table *t = &m->cur;                                                                    \
+    size_t s = name##__TableFind(t, key, h);                                                      \
+    if (s == (size_t)-1 && m->old.cap) {                                                          \
+      t = &m->old;                                                                                \
+      s = name##__TableFind(t, key, h);                                                           \
+    }                                                                                             \
+    if (s == (size_t)-1) return 0;                                                                \
+    if (value) *value = t->slots[s].value;                                                        \
+    __hashmap_Erase(t->ctrl, s, &t->growthLeft);                                                  \
+    t->used--;                                                                                    \
+    return 1;                                                                                     \
+  }                                                                                               \
+                                                                                                  \
+  static inline int name##_Next(const name *m, name##_Iterator *it, K *key, V **value) {          \
+    for (;;) {                                                                                    \
+      const name##_Table *t = it->inOld ? &m->old : &m->cur;                                      \
+      for (; it->pos < t->cap; it->pos++) {                                                       \
+        if (t->ctrl[it->pos] < 0) {                                                               \
+          if (key) *key = t->slots[it->pos].key;                                                  \
+          if (value) *value = &t->slots[it->pos].value;                                           \
+          it->pos++;                                                                              \
+          return 1;                                                                               \
+        }                                                                                         \
+      }                                                                                           \
+      if (it->inOld) return 0;                                                                    \
+      it->inOld = 1;                                                                              \
+      it->pos = 0;                                                                                \
+    }                                                                                             \
+  }
+
+#endif
@@ -14,8 +14,8 @@
         } while (--__size > 0);               \
     } while (0)
 
-inline char *__vector_GetPtr(Vector *v, size_t pos) {
-    return v->data + (pos * v->elemSize);
+static inline char *__vector_GetPtr(Vector *v, size_t pos) {
+    return __vector_ElemPtr(v, pos);
 }
 
 void __sift_up(Vector *v, size_t first, size_t last, int (*cmp)(void *, void *)) {
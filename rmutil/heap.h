@@ -35,4 +35,88 @@ void Heap_Push(Vector *v, size_t first, size_t last, int (*cmp)(void *, void *))
  */
 void Heap_Pop(Vector *v, size_t first, size_t last, int (*cmp)(void *, void *));
 
+
+/* Typed d-ary heap template
+ * RMUTIL_HEAP_DECLARE_ARY(name, T, D, cmp_expr) declares static inline heap functions over a plain
+ * array of T, prefixed with `name_`. The heap has D children per node (D=4 keeps the children of a
+ * node within one or two cache lines, and halves the depth compared to a binary heap).
+ * cmp_expr is an expression over the two values `a` and `b` of type T, returning a negative value,
+ * zero or a positive value like the cmp functions above. It is inlined into the sift loops, and
+ * elements are moved by plain assignment. Like Make_Heap, the greatest element is kept at the top.
+ *
+ * RMUTIL_HEAP_DECLARE(name, T, cmp_expr) declares a 4-ary heap.
+ *
+ * The generated functions are:
+ *   void name_Make(T *h, size_t n) - rearrange h[0,n) into a heap
+ *   void name_Push(T *h, size_t n) - given a heap in h[0,n-1), push h[n-1] into it
+ *   void name_Pop(T *h, size_t n)  - move the top of the heap h[0,n) to h[n-1], and restore the
+ *                                    heap over h[0,n-1)
+ *   void name_SiftUp(T *h, size_t i) and name_SiftDown(T *h, size_t n, size_t i) - restore the heap
+ *                                    property after changing h[i]
+ *
+ * It works naturally with the typed vector template, e.g:
+ *
+ *   RMUTIL_VECTOR_DECLARE(ScoreVector, double)
+ *   RMUTIL_HEAP_DECLARE(ScoreHeap, double, (a > b) - (a < b))
+ *
+ *   ScoreVector_Push(&sv, 3.14);
+ *   ScoreHeap_Push(sv.data, ScoreVector_Size(&sv));
+ *   ...
+ *   ScoreHeap_Pop(sv.data, ScoreVector_Size(&sv));
+ *   ScoreVector_Pop(&sv, &top);
+ */
+#define RMUTIL_HEAP_DECLARE_ARY(name, T, D, cmp_expr)                       \
+    static inline int name##_Cmp(T a, T b) {                                \
+        return (cmp_expr);                                                  \
+    }                                                                       \
+                                                                            \
+    static inline void name##_SiftUp(T *h, size_t i) {                      \
+        T x = h[i];                                                         \
+        while (i > 0) {                                                     \
+            size_t parent = (i - 1) / (D);                                  \
+            if (name##_Cmp(h[parent], x) >= 0) break;                       \
+            h[i] = h[parent];                                               \
+            i = parent;                                                     \
+        }                                                                   \
+        h[i] = x;                                                           \
+    }                                                                       \
+                                                                            \
+    static inline void name##_SiftDown(T *h, size_t n, size_t i) {          \
+        T x = h[i];                                                         \
+        for (;;) {                                                          \
+            size_t first = (D) * i + 1;                                     \
+            if (first >= n) break;                                          \
+            size_t last = first + (D) < n ? first + (D) : n;                \
+            size_t best = first;                                            \
+            for (size_t c = first + 1; c < last; c++) {                     \
+                if (name##_Cmp(h[best], h[c]) < 0) best = c;                \
+            }                                                               \
+            if (name##_Cmp(h[best], x) <= 0) break;                         \
+            h[i] = h[best];                                                 \
+            i = best;                                                       \
+        }                                                                   \
+        h[i] = x;                                                           \
+    }                                                                       \
+                                                                            \
+    static inline void name##_Make(T *h, size_t n) {                        \
+        if (n < 2) return;                                                  \
+        for (size_t i = (n - 2) / (D) + 1; i-- > 0;) {                      \
+            name##_SiftDown(h, n, i);                                       \
+        }                                                                   \
+    }                                                                       \
+                                                                            \
+    static inline void name##_Push(T *h, size_t n) {                        \
+        if (n > 1) name##_SiftUp(h, n - 1);                                 \
+    }                                                                       \
+                                                                            \
+    static inline void name##_Pop(T *h, size_t n) {                         \
+        if (n < 2) return;                                                  \
+        T top = h[0];                                                       \
+        h[0] = h[n - 1];                                                    \
+        h[n - 1] = top;                                                     \
+        name##_SiftDown(h, n - 1, 0);                                       \
+    }
+
+#define RMUTIL_HEAP_DECLARE(name, T, cmp_expr) RMUTIL_HEAP_DECLARE_ARY(name, T, 4, cmp_expr)
+
 #endif //__HEAP_H__
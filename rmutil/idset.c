@@ -0,0 +1,657 @@
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#include <immintrin.h>
+#define RMUTIL_IDSET_X86 1
+#endif
+#include "idset.h"
+#include "byteorder.h"
+#include "alloc.h"
+
+/* Bytes of zeros after the packed gaps, so a gap is read with two unaligned 64-bit loads at most */
+#define IDSET_PAD 16
+
+/* The size of a block header saved to RDB: first, last, offset, bits and n in little endian */
+#define IDSET_HEADER_BYTES 22
+
+typedef struct {
+  uint64_t first, last;
+  // the offset of the packed gaps in the set's data
+  uint32_t offset;
+  // the bits per gap, 0 when the IDs are consecutive
+  uint8_t bits;
+  uint8_t n;
+} idsetBlock;
+
+struct RMUtilIdSet {
+  size_t size;
+  size_t numBlocks;
+  idsetBlock *blocks;
+  uint8_t *data;
+  size_t dataLen;
+};
+
+struct RMUtilIdSetBuilder {
+  RMUtilIdSet *set;
+  size_t blocksCap;
+  size_t dataCap;
+  size_t numPending;
+  uint64_t pending[RMUTIL_IDSET_BLOCK];
+};
+
+static inline uint64_t idset_Load64(const uint8_t *p) {
+  uint64_t x;
+  memcpy(&x, p, sizeof(x));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  x = __builtin_bswap64(x);
+#endif
+  return x;
+}
+
+/* The number of bytes the gaps of a block take */
+static inline size_t idset_PackedBytes(size_t n, int bits) {
+  return ((n - 1) * bits + 7) / 8;
+}
+
+/* Decode block i of the set to `out`, returning the number of IDs */
+static size_t idset_DecodeBlock(const RMUtilIdSet *s, size_t i, uint64_t *out) {
+  const idsetBlock *b = &s->blocks[i];
+  const uint8_t *p = s->data + b->offset;
+  size_t n = b->n;
+  uint64_t id = b->first;
+  out[0] = id;
+
+  if (b->bits == 0) {
+    for (size_t j = 1; j < n; j++) out[j] = ++id;
+  } else if (b->bits <= 57) {
+    // a gap is within the 8 bytes from its first byte
+    uint64_t mask = (1ULL << b->bits) - 1;
+    for (size_t j = 1, pos = 0; j < n; j++, pos += b->bits) {
+      id += ((idset_Load64(p + (pos >> 3)) >> (pos & 7)) & mask) + 1;
+      out[j] = id;
+    }
+  } else {
+    uint64_t mask = b->bits == 64 ? ~0ULL : (1ULL << b->bits) - 1;
+    for (size_t j = 1, pos = 0; j < n; j++, pos += b->bits) {
+      unsigned shift = pos & 7;
+      uint64_t gap = idset_Load64(p + (pos >> 3)) >> shift;
+      if (shift + b->bits > 64) gap |= idset_Load64(p + (pos >> 3) + 8) << (64 - shift);
+      id += (gap & mask) + 1;
+      out[j] = id;
+    }
+  }
+  return n;
+}
+
+/* The first index in a[0..n) holding an ID >= x, or n */
+static inline size_t idset_LowerBound(const uint64_t *a, size_t n, uint64_t x) {
+  size_t lo = 0;
+  while (n > 0) {
+    size_t half = n / 2;
+    if (a[lo + half] < x) {
+      lo += half + 1;
+      n -= half + 1;
+    } else {
+      n = half;
+    }
+  }
+  return lo;
+}
+
+/* The first block from `from` whose last ID is >= x, galloping from `from` since the callers move
+ * forward in small steps. Returns numBlocks if there is none */
+static size_t idset_SeekBlock(const RMUtilIdSet *s, size_t from, uint64_t x) {
+  size_t lo = from, n = s->numBlocks;
+  if (lo >= n || s->blocks[lo].last >= x) return lo;
+  size_t step = 1;
+  while (lo + step < n && s->blocks[lo + step].last < x) {
+    lo += step;
+    step *= 2;
+  }
+  // blocks[lo] is below x, and blocks[hi] is not if it exists
+  size_t hi = lo + step < n ? lo + step : n;
+  lo++;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (s->blocks[mid].last < x) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+/******************************************************************************
+ * Building
+ ******************************************************************************/
+
+/* Encode the pending IDs as a new block */
+static void idset_Flush(RMUtilIdSetBuilder *b) {
+  RMUtilIdSet *s = b->set;
+  size_t n = b->numPending;
+  if (!n) return;
+
+  uint64_t maxGap = 0;
+  for (size_t i = 1; i < n; i++) {
+    uint64_t gap = b->pending[i] - b->pending[i - 1] - 1;
+    if (gap > maxGap) maxGap = gap;
+  }
+  int bits = maxGap ? 64 - __builtin_clzll(maxGap) : 0;
+  size_t bytes = idset_PackedBytes(n, bits);
+
+  if (s->numBlocks == b->blocksCap) {
+    b->blocksCap = b->blocksCap ? b->blocksCap * 2 : 16;
+    s->blocks = realloc(s->blocks, b->blocksCap * sizeof(*s->blocks));
+  }
+  if (s->dataLen + bytes + IDSET_PAD > b->dataCap) {
+    b->dataCap = b->dataCap ? b->dataCap * 2 : 1024;
+    if (b->dataCap < s->dataLen + bytes + IDSET_PAD) b->dataCap = s->dataLen + bytes + IDSET_PAD;
+    s->data = realloc(s->data, b->dataCap);
+  }
+
+  uint8_t *p = s->data + s->dataLen;
+  memset(p, 0, bytes + IDSET_PAD);
+  if (bits) {
+    for (size_t i = 1, pos = 0; i < n; i++, pos += bits) {
+      uint64_t gap = b->pending[i] - b->pending[i - 1] - 1;
+      size_t byte = pos >> 3;
+      unsigned shift = pos & 7;
+      p[byte] |= (uint8_t)(gap << shift);
+      for (int done = 8 - shift; done < bits; done += 8) {
+        p[++byte] |= (uint8_t)(gap >> done);
+      }
+    }
+  }
+
+  s->blocks[s->numBlocks++] = (idsetBlock){
+      .first = b->pending[0],
+      .last = b->pending[n - 1],
+      .offset = s->dataLen,
+      .bits = bits,
+      .n = n,
+  };
+  s->dataLen += bytes;
+  s->size += n;
+  b->numPending = 0;
+}
+
+/* Add IDs known to be ascending and above the last ID added */
+static void idset_Append(RMUtilIdSetBuilder *b, const uint64_t *ids, size_t n) {
+  while (n) {
+    size_t room = RMUTIL_IDSET_BLOCK - b->numPending;
+    size_t k = n < room ? n : room;
+    memcpy(b->pending + b->numPending, ids, k * sizeof(*ids));
+    b->numPending += k;
+    ids += k;
+    n -= k;
+    if (b->numPending == RMUTIL_IDSET_BLOCK) idset_Flush(b);
+  }
+}
+
+RMUtilIdSetBuilder *RMUtil_NewIdSetBuilder(void) {
+  RMUtilIdSetBuilder *b = calloc(1, sizeof(*b));
+  b->set = calloc(1, sizeof(*b->set));
+  return b;
+}
+
+int RMUtilIdSetBuilder_Add(RMUtilIdSetBuilder *b, uint64_t id) {
+  uint64_t last;
+  if (b->numPending) {
+    last = b->pending[b->numPending - 1];
+  } else if (b->set->numBlocks) {
+    last = b->set->blocks[b->set->numBlocks - 1].last;
+  } else {
+    idset_Append(b, &id, 1);
+    return REDISMODULE_OK;
+  }
+  if (id < last) return REDISMODULE_ERR;
+  if (id > last) idset_Append(b, &id, 1);
+  return REDISMODULE_OK;
+}
+
+RMUtilIdSet *RMUtilIdSetBuilder_Finish(RMUtilIdSetBuilder *b) {
+  idset_Flush(b);
+  RMUtilIdSet *s = b->set;
+  // drop the spare room, keeping the padding
+  if (s->numBlocks) s->blocks = realloc(s->blocks, s->numBlocks * sizeof(*s->blocks));
+  s->data = realloc(s->data, s->dataLen + IDSET_PAD);
+  if (!s->dataLen) memset(s->data, 0, IDSET_PAD);
+  free(b);
+  return s;
+}
+
+RMUtilIdSet *RMUtil_NewIdSet(const uint64_t *ids, size_t n) {
+  for (size_t i = 1; i < n; i++) {
+    if (ids[i] < ids[i - 1]) return NULL;
+  }
+  RMUtilIdSetBuilder *b = RMUtil_NewIdSetBuilder();
+  for (size_t i = 0; i < n; i++) {
+    RMUtilIdSetBuilder_Add(b, ids[i]);
+  }
+  return RMUtilIdSetBuilder_Finish(b);
+}
+
+void RMUtilIdSet_Free(RMUtilIdSet *s) {
+  if (!s) return;
+  free(s->blocks);
+  free(s->data);
+  free(s);
+}
+
+/******************************************************************************
+ * Reading
+ ******************************************************************************/
+
+size_t RMUtilIdSet_Size(const RMUtilIdSet *s) {
+  return s->size;
+}
+
+size_t RMUtilIdSet_MemUsage(const RMUtilIdSet *s) {
+  return sizeof(*s) + s->numBlocks * sizeof(*s->blocks) + s->dataLen + IDSET_PAD;
+}
+
+int RMUtilIdSet_Contains(const RMUtilIdSet *s, uint64_t id) {
+  size_t i = idset_SeekBlock(s, 0, id);
+  if (i == s->numBlocks || s->blocks[i].first > id) return 0;
+  uint64_t buf[RMUTIL_IDSET_BLOCK];
+  size_t n = idset_DecodeBlock(s, i, buf);
+  size_t pos = idset_LowerBound(buf, n, id);
+  return pos < n && buf[pos] == id;
+}
+
+size_t RMUtilIdSet_Decode(const RMUtilIdSet *s, uint64_t *out) {
+  size_t n = 0;
+  for (size_t i = 0; i < s->numBlocks; i++) {
+    n += idset_DecodeBlock(s, i, out + n);
+  }
+  return n;
+}
+
+void RMUtilIdSet_Iterate(const RMUtilIdSet *s, RMUtilIdSetIterator *it) {
+  it->set = s;
+  it->block = 0;
+  it->pos = it->len = 0;
+}
+
+/* Decode the next block if the current one is done. Returns 0 at the end of the set */
+static inline int idset_Fill(RMUtilIdSetIterator *it) {
+  if (it->pos < it->len) return 1;
+  if (it->block == it->set->numBlocks) return 0;
+  it->len = idset_DecodeBlock(it->set, it->block++, it->buf);
+  it->pos = 0;
+  return 1;
+}
+
+/* Move the iterator to the first ID >= target without consuming it. Returns 0 if there is none */
+static int idset_Seek(RMUtilIdSetIterator *it, uint64_t target) {
+  if (it->pos == it->len || it->buf[it->len - 1] < target) {
+    size_t i = idset_SeekBlock(it->set, it->block, target);
+    if (i == it->set->numBlocks) {
+      it->block = i;
+      it->pos = it->len = 0;
+      return 0;
+    }
+    it->len = idset_DecodeBlock(it->set, i, it->buf);
+    it->block = i + 1;
+    it->pos = 0;
+  }
+  it->pos += idset_LowerBound(it->buf + it->pos, it->len - it->pos, target);
+  return 1;
+}
+
+int RMUtilIdSetIterator_Next(RMUtilIdSetIterator *it, uint64_t *id) {
+  if (!idset_Fill(it)) return 0;
+  *id = it->buf[it->pos++];
+  return 1;
+}
+
+int RMUtilIdSetIterator_SkipTo(RMUtilIdSetIterator *it, uint64_t target, uint64_t *id) {
+  if (!idset_Seek(it, target)) return 0;
+  *id = it->buf[it->pos++];
+  return 1;
+}
+
+/******************************************************************************
+ * Set algebra
+ ******************************************************************************/
+
+/* The number of IDs of the iterator's current block up to `limit` */
+static inline size_t idset_CountUpTo(const RMUtilIdSetIterator *it, uint64_t limit) {
+  if (it->buf[it->len - 1] <= limit) return it->len - it->pos;
+  return idset_LowerBound(it->buf + it->pos, it->len - it->pos, limit + 1);
+}
+
+RMUtilIdSet *RMUtilIdSet_Intersect(const RMUtilIdSet *a, const RMUtilIdSet *b) {
+  RMUtilIdSetBuilder *out = RMUtil_NewIdSetBuilder();
+  RMUtilIdSetIterator ia, ib;
+  RMUtilIdSet_Iterate(a, &ia);
+  RMUtilIdSet_Iterate(b, &ib);
+  uint64_t buf[RMUTIL_IDSET_BLOCK];
+
+  while (idset_Fill(&ia) && idset_Fill(&ib)) {
+    uint64_t amax = ia.buf[ia.len - 1], bmax = ib.buf[ib.len - 1];
+    // skip the blocks of one side below the other's current ID, without decoding them
+    if (amax < ib.buf[ib.pos]) {
+      if (!idset_Seek(&ia, ib.buf[ib.pos])) break;
+      continue;
+    }
+    if (bmax < ia.buf[ia.pos]) {
+      if (!idset_Seek(&ib, ia.buf[ia.pos])) break;
+      continue;
+    }
+    // intersect up to the end of the block ending first
+    uint64_t limit = amax < bmax ? amax : bmax;
+    size_t na = idset_CountUpTo(&ia, limit), nb = idset_CountUpTo(&ib, limit);
+    size_t n = RMUtil_IntersectSorted(ia.buf + ia.pos, na, ib.buf + ib.pos, nb, buf);
+    idset_Append(out, buf, n);
+    ia.pos += na;
+    ib.pos += nb;
+  }
+  return RMUtilIdSetBuilder_Finish(out);
+}
+
+/* Add the rest of the iterator's IDs */
+static void idset_AppendRest(RMUtilIdSetBuilder *out, RMUtilIdSetIterator *it) {
+  while (idset_Fill(it)) {
+    idset_Append(out, it->buf + it->pos, it->len - it->pos);
+    it->pos = it->len;
+  }
+}
+
+RMUtilIdSet *RMUtilIdSet_Union(const RMUtilIdSet *a, const RMUtilIdSet *b) {
+  RMUtilIdSetBuilder *out = RMUtil_NewIdSetBuilder();
+  RMUtilIdSetIterator ia, ib;
+  RMUtilIdSet_Iterate(a, &ia);
+  RMUtilIdSet_Iterate(b, &ib);
+  uint64_t buf[2 * RMUTIL_IDSET_BLOCK];
+
+  while (idset_Fill(&ia) && idset_Fill(&ib)) {
+    uint64_t amax = ia.buf[ia.len - 1], bmax = ib.buf[ib.len - 1];
+    uint64_t limit = amax < bmax ? amax : bmax;
+    size_t na = idset_CountUpTo(&ia, limit), nb = idset_CountUpTo(&ib, limit);
+    size_t n = RMUtil_UnionSorted(ia.buf + ia.pos, na, ib.buf + ib.pos, nb, buf);
+    idset_Append(out, buf, n);
+    ia.pos += na;
+    ib.pos += nb;
+  }
+  idset_AppendRest(out, &ia);
+  idset_AppendRest(out, &ib);
+  return RMUtilIdSetBuilder_Finish(out);
+}
+
+/******************************************************************************
+ * Sorted array kernels
+ ******************************************************************************/
+
+/* Galloping is used when one side is this many times larger than the other */
+#define IDSET_GALLOP_RATIO 32
+
+/* Look up every ID of the smaller array in the larger one, galloping from the last match */
+static size_t gallop_Intersect(const uint64_t *small, size_t ns, const uint64_t *large, size_t nl,
+                               uint64_t *out) {
+  size_t k = 0, lo = 0;
+  for (size_t i = 0; i < ns && lo < nl; i++) {
+    uint64_t x = small[i];
+    if (large[lo] < x) {
+      size_t step = 1;
+      while (lo + step < nl && large[lo + step] < x) {
+        lo += step;
+        step *= 2;
+      }
+      size_t hi = lo + step < nl ? lo + step : nl;
+      lo++;
+      lo += idset_LowerBound(large + lo, hi - lo, x);
+    }
+    if (lo < nl && large[lo] == x) out[k++] = x;
+  }
+  return k;
+}
+
+/* A merge without unpredictable branches, writing every ID and keeping it on a match. A match
+ * moves both sides, so out[k] stays within the smaller array's room */
+static size_t scalar_Intersect(const uint64_t *a, size_t na, const uint64_t *b, size_t nb,
+                               uint64_t *out) {
+  size_t i = 0, j = 0, k = 0;
+  while (i < na && j < nb) {
+    uint64_t x = a[i], y = b[j];
+    out[k] = x;
+    k += x == y;
+    i += x <= y;
+    j += y <= x;
+  }
+  return k;
+}
+
+#ifdef RMUTIL_IDSET_X86
+
+/* After comparing blocks, the side whose block was not passed may still hold IDs already matched
+ * against the other. Skip them before finishing with the scalar merge, which needs each match to
+ * move both sides */
+static inline void idset_SkipCompared(const uint64_t *a, size_t na, size_t *i, const uint64_t *b,
+                                      size_t nb, size_t *j) {
+  while (*j > 0 && *i < na && a[*i] <= b[*j - 1]) (*i)++;
+  while (*i > 0 && *j < nb && b[*j] <= a[*i - 1]) (*j)++;
+}
+
+/* Compare 2 IDs of each side at once, moving the side with the smaller largest ID */
+__attribute__((target("sse4.1"))) static size_t sse41_Intersect(const uint64_t *a, size_t na,
+                                                                 const uint64_t *b, size_t nb,
+                                                                 uint64_t *out) {
+  size_t i = 0, j = 0, k = 0, cap = na < nb ? na : nb;
+  while (i + 2 <= na && j + 2 <= nb) {
+    __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+    __m128i vb = _mm_loadu_si128((const __m128i *)(b + j));
+    __m128i eq = _mm_or_si128(_mm_cmpeq_epi64(va, vb),
+                              _mm_cmpeq_epi64(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2))));
+    int m = _mm_movemask_pd(_mm_castsi128_pd(eq));
+    if (__builtin_expect(k + 2 <= cap, 1)) {
+      // write both IDs, keeping the matches
+      out[k] = a[i];
+      k += m & 1;
+      out[k] = a[i + 1];
+      k += m >> 1;
+    } else {
+      if (m & 1) out[k++] = a[i];
+      if (m & 2) out[k++] = a[i + 1];
+    }
+    uint64_t amax = a[i + 1], bmax = b[j + 1];
+    i += (amax <= bmax) * 2;
+    j += (bmax <= amax) * 2;
+  }
+  idset_SkipCompared(a, na, &i, b, nb, &j);
+  return k + scalar_Intersect(a + i, na - i, b + j, nb - j, out + k);
+}
+
+/* The 32-bit lanes to permute so the 64-bit lanes set in a 4-bit mask come first */
+static const uint8_t avx2_Compress[16][8] = {
+    {0, 1, 2, 3, 4, 5, 6, 7}, {0, 1, 2, 3, 4, 5, 6, 7}, {2, 3, 0, 1, 4, 5, 6, 7},
+    {0, 1, 2, 3, 4, 5, 6, 7}, {4, 5, 0, 1, 2, 3, 6, 7}, {0, 1, 4, 5, 2, 3, 6, 7},
+    {2, 3, 4, 5, 0, 1, 6, 7}, {0, 1, 2, 3, 4, 5, 6, 7}, {6, 7, 0, 1, 2, 3, 4, 5},
+    {0, 1, 6, 7, 2, 3, 4, 5}, {2, 3, 6, 7, 0, 1, 4, 5}, {0, 1, 2, 3, 6, 7, 4, 5},
+    {4, 5, 6, 7, 0, 1, 2, 3}, {0, 1, 4, 5, 6, 7, 2, 3}, {2, 3, 4, 5, 6, 7, 0, 1},
+    {0, 1, 2, 3, 4, 5, 6, 7},
+};
+
+/* Compare 4 IDs of each side at once, against the rotations of the other side's 4 */
+__attribute__((target("avx2"))) static size_t avx2_Intersect(const uint64_t *a, size_t na,
+                                                              const uint64_t *b, size_t nb,
+                                                              uint64_t *out) {
+  size_t i = 0, j = 0, k = 0, cap = na < nb ? na : nb;
+  while (i + 4 <= na && j + 4 <= nb) {
+    __m256i va = _mm256_loadu_si256((const __m256i *)(a + i));
+    __m256i vb = _mm256_loadu_si256((const __m256i *)(b + j));
+    __m256i eq = _mm256_cmpeq_epi64(va, vb);
+    eq = _mm256_or_si256(
+        eq, _mm256_cmpeq_epi64(va, _mm256_permute4x64_epi64(vb, _MM_SHUFFLE(0, 3, 2, 1))));
+    eq = _mm256_or_si256(
+        eq, _mm256_cmpeq_epi64(va, _mm256_permute4x64_epi64(vb, _MM_SHUFFLE(1, 0, 3, 2))));
+    eq = _mm256_or_si256(
+        eq, _mm256_cmpeq_epi64(va, _mm256_permute4x64_epi64(vb, _MM_SHUFFLE(2, 1, 0, 3))));
+    unsigned m = _mm256_movemask_pd(_mm256_castsi256_pd(eq));
+    if (__builtin_expect(k + 4 <= cap, 1)) {
+      // move the matches to the front and write all 4 IDs
+      __m256i perm = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)avx2_Compress[m]));
+      _mm256_storeu_si256((__m256i *)(out + k), _mm256_permutevar8x32_epi32(va, perm));
+      k += __builtin_popcount(m);
+    } else {
+      while (m) {
+        out[k++] = a[i + __builtin_ctz(m)];
+        m &= m - 1;
+      }
+    }
+    uint64_t amax = a[i + 3], bmax = b[j + 3];
+    i += (amax <= bmax) * 4;
+    j += (bmax <= amax) * 4;
+  }
+  idset_SkipCompared(a, na, &i, b, nb, &j);
+  return k + scalar_Intersect(a + i, na - i, b + j, nb - j, out + k);
+}
+
+#endif
+
+static struct {
+  int level;
+  size_t (*intersect)(const uint64_t *a, size_t na, const uint64_t *b, size_t nb, uint64_t *out);
+} idsetImpl = {-1, scalar_Intersect};
+
+static int idset_MaxSIMD(void) {
+#ifdef RMUTIL_IDSET_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return RMUTIL_IDSET_AVX2;
+  if (__builtin_cpu_supports("sse4.1")) return RMUTIL_IDSET_SSE41;
+#endif
+  return RMUTIL_IDSET_SCALAR;
+}
+
+int RMUtil_SetIdSetSIMD(int level) {
+  int max = idset_MaxSIMD();
+  if (level < 0 || level > max) level = max;
+
+  switch (level) {
+#ifdef RMUTIL_IDSET_X86
+    case RMUTIL_IDSET_AVX2:
+      idsetImpl.intersect = avx2_Intersect;
+      break;
+    case RMUTIL_IDSET_SSE41:
+      idsetImpl.intersect = sse41_Intersect;
+      break;
+#endif
+    default:
+      idsetImpl.intersect = scalar_Intersect;
+      level = RMUTIL_IDSET_SCALAR;
+  }
+  __atomic_store_n(&idsetImpl.level, level, __ATOMIC_RELEASE);
+  return level;
+}
+
+size_t RMUtil_IntersectSorted(const uint64_t *a, size_t na, const uint64_t *b, size_t nb,
+                              uint64_t *out) {
+  if (!na || !nb) return 0;
+  if (na * IDSET_GALLOP_RATIO < nb) return gallop_Intersect(a, na, b, nb, out);
+  if (nb * IDSET_GALLOP_RATIO < na) return gallop_Intersect(b, nb, a, na, out);
+  if (__builtin_expect(__atomic_load_n(&idsetImpl.level, __ATOMIC_ACQUIRE) < 0, 0)) {
+    RMUtil_SetIdSetSIMD(-1);
+  }
+  return idsetImpl.intersect(a, na, b, nb, out);
+}
+
+size_t RMUtil_UnionSorted(const uint64_t *a, size_t na, const uint64_t *b, size_t nb,
+                          uint64_t *out) {
+  size_t i = 0, j = 0, k = 0;
+  while (i < na && j < nb) {
+    uint64_t x = a[i], y = b[j];
+    out[k++] = x < y ? x : y;
+    i += x <= y;
+    j += y <= x;
+  }
+  memcpy(out + k, a + i, (na - i) * sizeof(*a));
+  k += na - i;
+  memcpy(out + k, b + j, (nb - j) * sizeof(*b));
+  return k + nb - j;
+}
+
+/******************************************************************************
+ * RDB
+ ******************************************************************************/
+
+void RMUtilIdSet_Save(RedisModuleIO *io, const RMUtilIdSet *s) {
+  RedisModule_SaveUnsigned(io, s->size);
+  RedisModule_SaveUnsigned(io, s->numBlocks);
+  uint8_t *hdr = malloc(s->numBlocks * IDSET_HEADER_BYTES + 1);
+  for (size_t i = 0; i < s->numBlocks; i++) {
+    uint8_t *p = hdr + i * IDSET_HEADER_BYTES;
+    RMUtil_PutLE(p, s->blocks[i].first, 8);
+    RMUtil_PutLE(p + 8, s->blocks[i].last, 8);
+    RMUtil_PutLE(p + 16, s->blocks[i].offset, 4);
+    p[20] = s->blocks[i].bits;
+    p[21] = s->blocks[i].n;
+  }
+  RedisModule_SaveStringBuffer(io, (const char *)hdr, s->numBlocks * IDSET_HEADER_BYTES);
+  RedisModule_SaveStringBuffer(io, (const char *)s->data, s->dataLen);
+  free(hdr);
+}
+
+/* Check that the blocks are laid out one after the other in the data, and decode them to check
+ * they are ascending and end with their last ID, since lookups rely on it */
+static int idset_Validate(const RMUtilIdSet *s) {
+  size_t offset = 0, size = 0;
+  uint64_t buf[RMUTIL_IDSET_BLOCK];
+  for (size_t i = 0; i < s->numBlocks; i++) {
+    const idsetBlock *b = &s->blocks[i];
+    if (b->n == 0 || b->n > RMUTIL_IDSET_BLOCK || b->bits > 64 || b->offset != offset) return 0;
+    if (i > 0 && b->first <= s->blocks[i - 1].last) return 0;
+    offset += idset_PackedBytes(b->n, b->bits);
+    if (offset > s->dataLen) return 0;
+
+    size_t n = idset_DecodeBlock(s, i, buf);
+    for (size_t j = 1; j < n; j++) {
+      if (buf[j] <= buf[j - 1]) return 0;
+    }
+    if (buf[n - 1] != b->last) return 0;
+    size += n;
+  }
+  return offset == s->dataLen && size == s->size;
+}
+
+RMUtilIdSet *RMUtilIdSet_Load(RedisModuleIO *io) {
+  uint64_t size = RedisModule_LoadUnsigned(io);
+  uint64_t numBlocks = RedisModule_LoadUnsigned(io);
+  size_t hdrLen, dataLen;
+  char *hdr = RedisModule_LoadStringBuffer(io, &hdrLen);
+  char *data = RedisModule_LoadStringBuffer(io, &dataLen);
+  RMUtilIdSet *s = NULL;
+  if (!hdr || !data || numBlocks > hdrLen / IDSET_HEADER_BYTES ||
+      numBlocks * IDSET_HEADER_BYTES != hdrLen || dataLen > UINT32_MAX) {
+    goto done;
+  }
+
+  s = calloc(1, sizeof(*s));
+  s->size = size;
+  s->numBlocks = numBlocks;
+  s->blocks = malloc(numBlocks * sizeof(*s->blocks) + 1);
+  s->dataLen = dataLen;
+  s->data = malloc(dataLen + IDSET_PAD);
+  memcpy(s->data, data, dataLen);
+  memset(s->data + dataLen, 0, IDSET_PAD);
+  for (size_t i = 0; i < numBlocks; i++) {
+    const uint8_t *p = (const uint8_t *)hdr + i * IDSET_HEADER_BYTES;
+    s->blocks[i] = (idsetBlock){
+        .first = RMUtil_GetLE(p, 8),
+        .last = RMUtil_GetLE(p + 8, 8),
+        .offset = RMUtil_GetLE(p + 16, 4),
+        .bits = p[20],
+        .n = p[21],
+    };
+  }
+  if (!idset_Validate(s)) {
+    RMUtilIdSet_Free(s);
+    s = NULL;
+  }
+
+done:
+  if (hdr) RedisModule_Free(hdr);
+  if (data) RedisModule_Free(data);
+  return s;
+}
@@ -0,0 +1,116 @@
+#ifndef RMUTIL_IDSET_H_
+#define RMUTIL_IDSET_H_
+#include <stddef.h>
+#include <stdint.h>
+#include <redismodule.h>
+
+/** idset.h - A compressed set of sorted 64 bit IDs.
+ *
+ * An RMUtilIdSet holds a set of uint64_t IDs, like a posting list, in blocks of up to
+ * RMUTIL_IDSET_BLOCK IDs in ascending order. Each block keeps its first ID, and bit packs the gaps
+ * between the following ones with as many bits as the block's largest gap needs, so lists of close
+ * IDs take a few bits per ID rather than 64. The first and last ID of every block are kept apart
+ * from the packed gaps: lookups and intersections find the blocks that may match without decoding
+ * the others.
+ *
+ * Sets are immutable. They are built from a sorted array or ID by ID with a builder, and combined
+ * into new sets:
+ *
+ *   RMUtilIdSet *a = RMUtil_NewIdSet(ids, n);
+ *   RMUtilIdSet *both = RMUtilIdSet_Intersect(a, b);
+ *
+ *   RMUtilIdSetIterator it;
+ *   RMUtilIdSet_Iterate(both, &it);
+ *   uint64_t id;
+ *   while (RMUtilIdSetIterator_Next(&it, &id)) { ... }
+ *
+ * The kernels combining blocks work on plain sorted arrays, and are usable on their own. The
+ * intersection gallops through the larger side when the other one is much smaller, and otherwise
+ * compares 4x4 IDs at once with AVX2, or 2x2 with SSE4.1, depending on the CPU.
+ */
+
+/* The most IDs in a block */
+#define RMUTIL_IDSET_BLOCK 128
+
+typedef struct RMUtilIdSet RMUtilIdSet;
+typedef struct RMUtilIdSetBuilder RMUtilIdSetBuilder;
+
+/* An iterator over a set, see RMUtilIdSet_Iterate. It holds the decoded block it is in */
+typedef struct {
+  const RMUtilIdSet *set;
+  // the next block to decode, and the position in the current one
+  size_t block;
+  size_t pos, len;
+  uint64_t buf[RMUTIL_IDSET_BLOCK];
+} RMUtilIdSetIterator;
+
+/* Create a set from `n` IDs sorted in ascending order. Repeated IDs are kept once. Returns NULL if
+ * the IDs are not sorted */
+RMUtilIdSet *RMUtil_NewIdSet(const uint64_t *ids, size_t n);
+
+/* Build a set by adding IDs in ascending order */
+RMUtilIdSetBuilder *RMUtil_NewIdSetBuilder(void);
+
+/* Add an ID to the set being built. Adding the last ID again does nothing, and adding a smaller one
+ * returns REDISMODULE_ERR */
+int RMUtilIdSetBuilder_Add(RMUtilIdSetBuilder *b, uint64_t id);
+
+/* Return the set built, freeing the builder */
+RMUtilIdSet *RMUtilIdSetBuilder_Finish(RMUtilIdSetBuilder *b);
+
+void RMUtilIdSet_Free(RMUtilIdSet *s);
+
+/* The number of IDs in the set */
+size_t RMUtilIdSet_Size(const RMUtilIdSet *s);
+
+/* The memory used by the set, in bytes */
+size_t RMUtilIdSet_MemUsage(const RMUtilIdSet *s);
+
+/* Return 1 if the set contains `id` */
+int RMUtilIdSet_Contains(const RMUtilIdSet *s, uint64_t id);
+
+/* Decode all the IDs of the set to `out`, which has room for RMUtilIdSet_Size(s) IDs. Returns the
+ * number of IDs */
+size_t RMUtilIdSet_Decode(const RMUtilIdSet *s, uint64_t *out);
+
+/* Start iterating the set in ascending order */
+void RMUtilIdSet_Iterate(const RMUtilIdSet *s, RMUtilIdSetIterator *it);
+
+/* Get the next ID. Returns 0 at the end of the set */
+int RMUtilIdSetIterator_Next(RMUtilIdSetIterator *it, uint64_t *id);
+
+/* Get the next ID greater than or equal to `target`, skipping the blocks below it. Returns 0 if
+ * there is none */
+int RMUtilIdSetIterator_SkipTo(RMUtilIdSetIterator *it, uint64_t target, uint64_t *id);
+
+/* Create the intersection and the union of two sets */
+RMUtilIdSet *RMUtilIdSet_Intersect(const RMUtilIdSet *a, const RMUtilIdSet *b);
+RMUtilIdSet *RMUtilIdSet_Union(const RMUtilIdSet *a, const RMUtilIdSet *b);
+
+/* Intersect two arrays of IDs sorted in ascending order without repeats, into `out`, which has room
+ * for the smaller one. Returns the number of IDs written */
+size_t RMUtil_IntersectSorted(const uint64_t *a, size_t na, const uint64_t *b, size_t nb,
+                              uint64_t *out);
+
+/* Merge two arrays of IDs sorted in ascending order without repeats, into `out`, which has room for
+ * both. IDs in both arrays are written once. Returns the number of IDs written */
+size_t RMUtil_UnionSorted(const uint64_t *a, size_t na, const uint64_t *b, size_t nb,
+                          uint64_t *out);
+
+/* The implementations of the intersection kernel */
+#define RMUTIL_IDSET_SCALAR 0
+#define RMUTIL_IDSET_SSE41 1
+#define RMUTIL_IDSET_AVX2 2
+
+/* Choose the implementation of the intersection kernel, e.g. to compare them. Levels the CPU does
+ * not support, or -1, select the best supported one. Returns the level selected */
+int RMUtil_SetIdSetSIMD(int level);
+
+/* Save a set to an RDB file, e.g. from a type's rdb_save callback. The set is saved as its size
+ * and two string buffers, holding the block headers and the packed gaps as they are */
+void RMUtilIdSet_Save(RedisModuleIO *io, const RMUtilIdSet *s);
+
+/* Load a set saved with RMUtilIdSet_Save. Returns NULL if the data is not a valid set */
+RMUtilIdSet *RMUtilIdSet_Load(RedisModuleIO *io);
+
+#endif
@@ -0,0 +1,64 @@
+#define REDISMODULE_EXPERIMENTAL_API
+#include <time.h>
+#include "incremental.h"
+#include "alloc.h"
+
+struct RMUtilStepper {
+  RMUtilStepFunc step;
+  void *container;
+  size_t budget;
+  long long maxUs;
+  long long periodMs;
+  const char *event;
+  RedisModuleTimerID timer;
+};
+
+static long long nowUs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+int RMUtil_StepFor(RMUtilStepFunc step, void *container, size_t budget, long long maxUs,
+                   const char *event) {
+  long long start = nowUs();
+  int more;
+  do {
+    more = step(container, budget);
+  } while (more && nowUs() - start < maxUs);
+
+  // the latency monitor counts whole milliseconds, and ignores anything below its threshold
+  long long ms = (nowUs() - start) / 1000;
+  if (ms && event && RedisModule_LatencyAddSample) {
+    RedisModule_LatencyAddSample(event, ms);
+  }
+  return more;
+}
+
+static void stepperRun(RedisModuleCtx *ctx, void *data) {
+  RMUtilStepper *s = data;
+  RMUtil_StepFor(s->step, s->container, s->budget, s->maxUs, s->event);
+  // timers fire once, schedule the next run
+  s->timer = RedisModule_CreateTimer(ctx, s->periodMs, stepperRun, s);
+}
+
+RMUtilStepper *RMUtil_NewStepper(RedisModuleCtx *ctx, RMUtilStepFunc step, void *container,
+                                 size_t budget, long long maxUs, long long periodMs,
+                                 const char *event) {
+  if (!RedisModule_CreateTimer) return NULL;
+  RMUtilStepper *s = malloc(sizeof(*s));
+  s->step = step;
+  s->container = container;
+  s->budget = budget;
+  s->maxUs = maxUs;
+  s->periodMs = periodMs;
+  s->event = event;
+  s->timer = RedisModule_CreateTimer(ctx, periodMs, stepperRun, s);
+  return s;
+}
+
+void RMUtilStepper_Stop(RedisModuleCtx *ctx, RMUtilStepper *s) {
+  if (!s) return;
+  RedisModule_StopTimer(ctx, s->timer, NULL);
+  free(s);
+}
@@ -0,0 +1,49 @@
+#ifndef RMUTIL_INCREMENTAL_H_
+#define RMUTIL_INCREMENTAL_H_
+#include <stddef.h>
+#include <redismodule.h>
+
+/** incremental.h - Finishing the incremental work of containers from a redis timer.
+ *
+ * Vectors set up with Vector_SetIncremental, priority queues over them, and the maps of hashmap.h
+ * grow without copying their elements at once: the elements are moved to the new buffer a little
+ * at a time by the following changes. A container that stops changing after growing keeps both
+ * buffers until its step function (Vector_Step, Priority_Queue_Step, name_RehashStep) is called.
+ * Step functions take a budget of work, and return 1 while there is more to do.
+ *
+ * A stepper calls a step function from a RedisModule timer on the main thread, within a time
+ * budget per run, and reports the time each run took to the latency monitor, so the work shows in
+ * LATENCY LATEST / LATENCY HISTORY under the given event name:
+ *
+ *   static int stepQueue(void *pq, size_t budget) {
+ *     return Priority_Queue_Step(pq, budget);
+ *   }
+ *
+ *   // in RedisModule_OnLoad:
+ *   Vector_SetIncremental(pq->v, 1 << 20);
+ *   RMUtilStepper *st = RMUtil_NewStepper(ctx, stepQueue, pq, 64 * 1024, 500, 10, "queue-grow");
+ *   ...
+ *   RMUtilStepper_Stop(ctx, st);
+ */
+
+/* Do up to `budget` units of work on `container`, returning 1 while there is more to do */
+typedef int (*RMUtilStepFunc)(void *container, size_t budget);
+
+typedef struct RMUtilStepper RMUtilStepper;
+
+/* Call `step` with `budget` until it is done or `maxUs` microseconds passed, and report the time it
+ * took in milliseconds to RedisModule_LatencyAddSample under `event`, unless it is NULL or it took
+ * less than a millisecond. Returns 1 while there is more to do */
+int RMUtil_StepFor(RMUtilStepFunc step, void *container, size_t budget, long long maxUs,
+                   const char *event);
+
+/* Run RMUtil_StepFor every `periodMs` milliseconds from a RedisModule timer, until the stepper is
+ * stopped. The event name is not copied. Returns NULL if redis does not support timers */
+RMUtilStepper *RMUtil_NewStepper(RedisModuleCtx *ctx, RMUtilStepFunc step, void *container,
+                                 size_t budget, long long maxUs, long long periodMs,
+                                 const char *event);
+
+/* Stop the stepper's timer and free it. The container is not freed */
+void RMUtilStepper_Stop(RedisModuleCtx *ctx, RMUtilStepper *s);
+
+#endif
@@ -1,88 +1,451 @@
 #define REDISMODULE_EXPERIMENTAL_API
 #include "periodic.h"
 #include <pthread.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <errno.h>
 
+/* All timers are kept in hierarchical timer wheels, each serviced by a single worker thread.
+ * Level 0 of a wheel holds the timers due within the next WHEEL_SIZE ticks, one slot per tick.
+ * Each level above it covers WHEEL_SIZE times the range of the level below, and its timers are
+ * cascaded down when the wheel's cursor reaches their slot. Adding and cancelling a timer is O(1),
+ * and all the timers due in the same tick are fired together as one batch */
+
+#define RMUTIL_TIMER_TICK_NS 1000000LL  // 1ms wheel resolution
+#define WHEEL_BITS 6
+#define WHEEL_SIZE (1 << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SIZE - 1)
+#define WHEEL_LEVELS 4
+// timers further away than this are parked in the last slot reachable and re-cascaded
+#define WHEEL_MAX_DELTA ((1ULL << (WHEEL_BITS * WHEEL_LEVELS)) - 1)
+
+struct rmutilTimerShard;
+
 typedef struct RMUtilTimer {
   RMutilTimerFunc cb;
   RMUtilTimerTerminationFunc onTerm;
   void *privdata;
   struct timespec interval;
+  RMUtilTimerOptions opts;
+
+  // the deadline of the next run in nanoseconds since the shard's tick 0, and the tick it falls on
+  uint64_t deadline;
+  uint64_t expires;
+  // links in a wheel slot or a batch list
+  struct RMUtilTimer *next;
+  struct RMUtilTimer **pprev;
+  int level, slot;
+
+  struct rmutilTimerShard *shard;
+  int running;
+  int terminated;
+
+  // start and end time of the current run, and the accumulated stats
+  uint64_t runStart, runEnd;
+  RMUtilTimerStats stats;
+} RMUtilTimer;
+
+typedef struct rmutilTimerShard {
   pthread_t thread;
   pthread_mutex_t lock;
   pthread_cond_t cond;
-} RMUtilTimer;
 
-static struct timespec timespecAdd(struct timespec *a, struct timespec *b) {
-  struct timespec ret;
-  ret.tv_sec = a->tv_sec + b->tv_sec;
+  // the monotonic time of tick 0, and the next tick to be processed
+  struct timespec base;
+  uint64_t now;
 
-  long long ns = a->tv_nsec + b->tv_nsec;
-  ret.tv_sec += ns / 1000000000;
-  ret.tv_nsec = ns % 1000000000;
-  return ret;
+  RMUtilTimer *slots[WHEEL_LEVELS][WHEEL_SIZE];
+  // bitmap of non empty slots per level
+  uint64_t occupied[WHEEL_LEVELS];
+
+  // terminated timers waiting for their termination callback
+  RMUtilTimer *terminated;
+} rmutilTimerShard;
+
+static rmutilTimerShard timerShards_g[RMUTIL_TIMER_MAX_THREADS];
+static int numTimerShards_g = 1;
+static unsigned nextTimerShard_g = 0;
+static pthread_once_t timerShardsOnce_g = PTHREAD_ONCE_INIT;
+static int timerShardsStarted_g = 0;
+static uint64_t timerLockBudgetNs_g = 1000000;
+
+static uint64_t timespecToNs(const struct timespec *ts) {
+  return (uint64_t)ts->tv_sec * 1000000000ULL + ts->tv_nsec;
 }
 
-static void *rmutilTimer_Loop(void *ctx) {
-  RMUtilTimer *tm = ctx;
+static struct timespec nsToTimespec(uint64_t ns) {
+  return (struct timespec){.tv_sec = ns / 1000000000ULL, .tv_nsec = ns % 1000000000ULL};
+}
 
-  int rc = ETIMEDOUT;
+/* Nanoseconds elapsed since the shard's tick 0 */
+static uint64_t shard_Elapsed(rmutilTimerShard *s) {
   struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return timespecToNs(&ts) - timespecToNs(&s->base);
+}
+
+/* The tick the shard's clock is currently at */
+static uint64_t shard_CurrentTick(rmutilTimerShard *s) {
+  return shard_Elapsed(s) / RMUTIL_TIMER_TICK_NS;
+}
 
-  pthread_mutex_lock(&tm->lock);
-  while (rc != 0) {
-    clock_gettime(CLOCK_REALTIME, &ts);
-    struct timespec timeout = timespecAdd(&ts, &tm->interval);
-    if ((rc = pthread_cond_timedwait(&tm->cond, &tm->lock, &timeout)) == ETIMEDOUT) {
+/* Set the deadline of a timer, and the tick it is due at. Timers never fire before their deadline
+ * so the tick is rounded up */
+static void timer_SetDeadline(RMUtilTimer *t, uint64_t deadline) {
+  t->deadline = deadline;
+  t->expires = (deadline + RMUTIL_TIMER_TICK_NS - 1) / RMUTIL_TIMER_TICK_NS;
+}
+
+/* Compute the next deadline of a timer after a run.
+ * In fixed delay mode the next run is one interval after the callback returned. In fixed rate mode
+ * runs are aligned to the timer's first deadline, regardless of how long the callbacks take. If
+ * the timer fell behind, missed runs are either skipped or run back to back */
+static void timer_Reschedule(RMUtilTimer *t) {
+  uint64_t interval = timespecToNs(&t->interval);
+  if (t->opts.mode != RMUTIL_TIMER_FIXED_RATE) {
+    timer_SetDeadline(t, t->runEnd + interval);
+    return;
+  }
 
-      // Create a thread safe context if we're running inside redis
-      RedisModuleCtx *rctx = NULL;
-      if (RedisModule_GetThreadSafeContext) rctx = RedisModule_GetThreadSafeContext(NULL);
+  if (interval == 0) interval = 1;
+  uint64_t deadline = t->deadline + interval;
+  if (t->opts.catchup == RMUTIL_TIMER_CATCHUP_SKIP && deadline <= t->runEnd) {
+    uint64_t missed = (t->runEnd - deadline) / interval + 1;
+    t->stats.missed += missed;
+    deadline += missed * interval;
+  }
+  timer_SetDeadline(t, deadline);
+}
 
-      // call our callback...
-      tm->cb(rctx, tm->privdata);
+/* Account for a finished run in the timer's stats */
+static void timer_UpdateStats(RMUtilTimer *t) {
+  RMUtilTimerStats *st = &t->stats;
+  uint64_t lateness = t->runStart > t->deadline ? t->runStart - t->deadline : 0;
+  uint64_t duration = t->runEnd - t->runStart;
 
-      // If needed - free the thread safe context.
-      // It's up to the user to decide whether automemory is active there
-      if (rctx) RedisModule_FreeThreadSafeContext(rctx);
+  st->runs++;
+  st->lastLatenessNs = lateness;
+  st->totalLatenessNs += lateness;
+  if (lateness > st->maxLatenessNs) st->maxLatenessNs = lateness;
+  st->lastDurationNs = duration;
+  st->totalDurationNs += duration;
+  if (duration > st->maxDurationNs) st->maxDurationNs = duration;
+}
+
+static void shard_Link(rmutilTimerShard *s, RMUtilTimer *t, int level, int slot) {
+  RMUtilTimer **head = &s->slots[level][slot];
+  t->level = level;
+  t->slot = slot;
+  t->next = *head;
+  if (t->next) t->next->pprev = &t->next;
+  t->pprev = head;
+  *head = t;
+  s->occupied[level] |= 1ULL << slot;
+}
+
+static void shard_Unlink(rmutilTimerShard *s, RMUtilTimer *t) {
+  if (!t->pprev) return;
+  *t->pprev = t->next;
+  if (t->next) t->next->pprev = t->pprev;
+  if (!s->slots[t->level][t->slot]) {
+    s->occupied[t->level] &= ~(1ULL << t->slot);
+  }
+  t->next = NULL;
+  t->pprev = NULL;
+}
+
+/* Put a timer in the wheel slot matching its expiry tick */
+static void shard_Insert(rmutilTimerShard *s, RMUtilTimer *t) {
+  if (t->expires < s->now) t->expires = s->now;
+  uint64_t delta = t->expires - s->now;
+  uint64_t expires = t->expires;
+  if (delta > WHEEL_MAX_DELTA) {
+    expires = s->now + WHEEL_MAX_DELTA;
+    delta = WHEEL_MAX_DELTA;
+  }
+
+  int level = 0;
+  while (level < WHEEL_LEVELS - 1 && delta >= (1ULL << (WHEEL_BITS * (level + 1)))) {
+    level++;
+  }
+  shard_Link(s, t, level, (expires >> (WHEEL_BITS * level)) & WHEEL_MASK);
+}
+
+/* Move the timers of the upper level slots reached by the cursor down the wheel */
+static void shard_Cascade(rmutilTimerShard *s) {
+  for (int level = 1; level < WHEEL_LEVELS; level++) {
+    if (s->now & ((1ULL << (WHEEL_BITS * level)) - 1)) break;
+
+    int slot = (s->now >> (WHEEL_BITS * level)) & WHEEL_MASK;
+    RMUtilTimer *t = s->slots[level][slot];
+    s->slots[level][slot] = NULL;
+    s->occupied[level] &= ~(1ULL << slot);
+    while (t) {
+      RMUtilTimer *next = t->next;
+      t->pprev = NULL;
+      shard_Insert(s, t);
+      t = next;
+    }
+  }
+}
+
+/* Advance the wheel's cursor up to and including tick `until`, detaching all the timers that are
+ * due and returning them as a list linked by their next pointers. Timers that run with the global
+ * lock held are put at the end of the list, so they can all run in one critical section */
+static RMUtilTimer *shard_Advance(rmutilTimerShard *s, uint64_t until) {
+  RMUtilTimer *batch = NULL, **tail = &batch;
+  RMUtilTimer *locked = NULL, **lockedTail = &locked;
+
+  while (s->now <= until) {
+    if (!(s->now & WHEEL_MASK)) {
+      shard_Cascade(s);
+    }
+
+    int slot = s->now & WHEEL_MASK;
+    if (s->occupied[0] & (1ULL << slot)) {
+      RMUtilTimer *t = s->slots[0][slot];
+      s->slots[0][slot] = NULL;
+      s->occupied[0] &= ~(1ULL << slot);
+      while (t) {
+        RMUtilTimer *next = t->next;
+        t->next = NULL;
+        t->pprev = NULL;
+        t->running = 1;
+        if (t->opts.lock) {
+          *lockedTail = t;
+          lockedTail = &t->next;
+        } else {
+          *tail = t;
+          tail = &t->next;
+        }
+        t = next;
+      }
+    }
+
+    if (!s->occupied[0]) {
+      // nothing left in level 0 - skip straight to the next cascade
+      uint64_t next = (s->now | WHEEL_MASK) + 1;
+      s->now = next < until + 1 ? next : until + 1;
+    } else {
+      s->now++;
+    }
+  }
+  *tail = locked;
+  return batch;
+}
+
+/* Compute the tick at which the worker needs to wake up next. Returns 0 if the wheel is empty */
+static int shard_NextWakeup(rmutilTimerShard *s, uint64_t *tick) {
+  int found = 0;
+  for (int level = 1; level < WHEEL_LEVELS; level++) {
+    if (s->occupied[level]) {
+      // timers in the upper levels may be due before those of level 0 once cascaded
+      *tick = (s->now | WHEEL_MASK) + 1;
+      found = 1;
+      break;
+    }
+  }
+  if (s->occupied[0]) {
+    // rotate the bitmap so that the slot of the cursor is bit 0, and find the first due slot
+    int cur = s->now & WHEEL_MASK;
+    uint64_t rotated = cur ? (s->occupied[0] >> cur) | (s->occupied[0] << (WHEEL_SIZE - cur))
+                           : s->occupied[0];
+    uint64_t due = s->now + __builtin_ctzll(rotated);
+    if (!found || due < *tick) *tick = due;
+    found = 1;
+  }
+  return found;
+}
+
+/* Call the termination callbacks of terminated timers and free them. Called with the lock held */
+static void shard_ReapTerminated(rmutilTimerShard *s) {
+  while (s->terminated) {
+    RMUtilTimer *t = s->terminated;
+    s->terminated = t->next;
+
+    pthread_mutex_unlock(&s->lock);
+    if (t->onTerm != NULL) {
+      t->onTerm(t->privdata);
+    }
+    free(t);
+    pthread_mutex_lock(&s->lock);
+  }
+}
+
+/* Run the callbacks of a batch of due timers. Called without the shard's lock */
+static void shard_RunBatch(rmutilTimerShard *s, RMUtilTimer *batch) {
+  // Create one thread safe context for the whole batch if we're running inside redis
+  RedisModuleCtx *rctx = NULL;
+  if (RedisModule_GetThreadSafeContext) rctx = RedisModule_GetThreadSafeContext(NULL);
+
+  int locked = 0;
+  uint64_t lockedAt = 0;
+  uint64_t budget = __atomic_load_n(&timerLockBudgetNs_g, __ATOMIC_RELAXED);
+
+  // call our callbacks...
+  for (RMUtilTimer *t = batch; t; t = t->next) {
+    // timers with the lock option come last, and run within a single critical section as long as
+    // it stays within the time budget
+    if (t->opts.lock && rctx && !locked) {
+      RedisModule_ThreadSafeContextLock(rctx);
+      locked = 1;
+      lockedAt = shard_Elapsed(s);
+    }
+
+    t->runStart = shard_Elapsed(s);
+    t->cb(rctx, t->privdata);
+    t->runEnd = shard_Elapsed(s);
+
+    // yield the lock once the budget is exhausted, to let the main thread run
+    if (locked && t->runEnd - lockedAt >= budget) {
+      RedisModule_ThreadSafeContextUnlock(rctx);
+      locked = 0;
+    }
+  }
+  if (locked) RedisModule_ThreadSafeContextUnlock(rctx);
+
+  // If needed - free the thread safe context.
+  // It's up to the user to decide whether automemory is active there
+  if (rctx) RedisModule_FreeThreadSafeContext(rctx);
+}
+
+static void *rmutilTimer_Loop(void *ctx) {
+  rmutilTimerShard *s = ctx;
+
+  pthread_mutex_lock(&s->lock);
+  for (;;) {
+    shard_ReapTerminated(s);
+
+    RMUtilTimer *batch = shard_Advance(s, shard_CurrentTick(s));
+    if (batch) {
+      pthread_mutex_unlock(&s->lock);
+      shard_RunBatch(s, batch);
+
+      // reschedule the timers according to their mode
+      pthread_mutex_lock(&s->lock);
+      while (batch) {
+        RMUtilTimer *t = batch;
+        batch = t->next;
+        t->next = NULL;
+        t->running = 0;
+        timer_UpdateStats(t);
+        if (t->terminated) {
+          t->next = s->terminated;
+          s->terminated = t;
+        } else {
+          timer_Reschedule(t);
+          shard_Insert(s, t);
+        }
+      }
+      continue;
+    }
+
+    if (s->terminated) continue;
+
+    uint64_t tick;
+    int rc;
+    if (shard_NextWakeup(s, &tick)) {
+      struct timespec timeout =
+          nsToTimespec(timespecToNs(&s->base) + tick * RMUTIL_TIMER_TICK_NS);
+      rc = pthread_cond_timedwait(&s->cond, &s->lock, &timeout);
+    } else {
+      rc = pthread_cond_wait(&s->cond, &s->lock);
     }
     if (rc == EINVAL) {
       perror("Error waiting for condition");
       break;
     }
   }
+  pthread_mutex_unlock(&s->lock);
+  return NULL;
+}
+
+static void rmutilTimer_StartShards(void) {
+  struct timespec base;
+  clock_gettime(CLOCK_MONOTONIC, &base);
+
+  for (int i = 0; i < numTimerShards_g; i++) {
+    rmutilTimerShard *s = &timerShards_g[i];
+    s->base = base;
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&s->cond, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_mutex_init(&s->lock, NULL);
 
-  // call the termination callback if needed
-  if (tm->onTerm != NULL) {
-    tm->onTerm(tm->privdata);
+    pthread_create(&s->thread, NULL, rmutilTimer_Loop, s);
+    pthread_detach(s->thread);
   }
+  __atomic_store_n(&timerShardsStarted_g, 1, __ATOMIC_RELEASE);
+}
 
-  // free resources associated with the timer
-  pthread_cond_destroy(&tm->cond);
-  free(tm);
+int RMUtilTimer_SetNumThreads(int n) {
+  if (n < 1 || n > RMUTIL_TIMER_MAX_THREADS ||
+      __atomic_load_n(&timerShardsStarted_g, __ATOMIC_ACQUIRE)) {
+    return REDISMODULE_ERR;
+  }
+  numTimerShards_g = n;
+  return REDISMODULE_OK;
+}
 
-  return NULL;
+void RMUtilTimer_SetLockBudget(struct timespec budget) {
+  __atomic_store_n(&timerLockBudgetNs_g, timespecToNs(&budget), __ATOMIC_RELAXED);
 }
 
 /* set a new frequency for the timer. This will take effect AFTER the next trigger */
 void RMUtilTimer_SetInterval(struct RMUtilTimer *t, struct timespec newInterval) {
+  pthread_mutex_lock(&t->shard->lock);
   t->interval = newInterval;
+  pthread_mutex_unlock(&t->shard->lock);
 }
 
 RMUtilTimer *RMUtil_NewPeriodicTimer(RMutilTimerFunc cb, RMUtilTimerTerminationFunc onTerm,
                                      void *privdata, struct timespec interval) {
+  return RMUtil_NewPeriodicTimerEx(cb, onTerm, privdata, interval, NULL);
+}
+
+RMUtilTimer *RMUtil_NewPeriodicTimerEx(RMutilTimerFunc cb, RMUtilTimerTerminationFunc onTerm,
+                                       void *privdata, struct timespec interval,
+                                       const RMUtilTimerOptions *opts) {
+  pthread_once(&timerShardsOnce_g, rmutilTimer_StartShards);
+
   RMUtilTimer *ret = malloc(sizeof(*ret));
   *ret = (RMUtilTimer){
       .privdata = privdata, .interval = interval, .cb = cb, .onTerm = onTerm,
   };
-  pthread_cond_init(&ret->cond, NULL);
-  pthread_mutex_init(&ret->lock, NULL);
+  if (opts) ret->opts = *opts;
+
+  unsigned idx = __atomic_fetch_add(&nextTimerShard_g, 1, __ATOMIC_RELAXED);
+  rmutilTimerShard *s = ret->shard = &timerShards_g[idx % numTimerShards_g];
 
-  pthread_create(&ret->thread, NULL, rmutilTimer_Loop, ret);
+  pthread_mutex_lock(&s->lock);
+  timer_SetDeadline(ret, shard_Elapsed(s) + timespecToNs(&interval));
+  shard_Insert(s, ret);
+  // wake the worker up, as this timer may be due before whatever it is waiting for
+  pthread_cond_signal(&s->cond);
+  pthread_mutex_unlock(&s->lock);
   return ret;
 }
 
+void RMUtilTimer_GetStats(struct RMUtilTimer *t, RMUtilTimerStats *stats) {
+  pthread_mutex_lock(&t->shard->lock);
+  *stats = t->stats;
+  pthread_mutex_unlock(&t->shard->lock);
+}
+
 int RMUtilTimer_Terminate(struct RMUtilTimer *t) {
-  return pthread_cond_signal(&t->cond);
+  rmutilTimerShard *s = t->shard;
+  pthread_mutex_lock(&s->lock);
+  t->terminated = 1;
+  // a running timer is handed to the termination list by the worker once its callback returns
+  if (!t->running) {
+    shard_Unlink(s, t);
+    t->next = s->terminated;
+    s->terminated = t;
+  }
+  int rc = pthread_cond_signal(&s->cond);
+  pthread_mutex_unlock(&s->lock);
+  return rc;
 }
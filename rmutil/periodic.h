@@ -15,21 +15,91 @@ typedef void (*RMutilTimerFunc)(RedisModuleCtx *ctx, void *privdata);
 
 typedef void (*RMUtilTimerTerminationFunc)(void *privdata);
 
-/* Create and start a new periodic timer. Each timer has its own thread and can only be run and
- * stopped once. The timer runs `cb` every `interval` with `privdata` passed to the callback. */
+/* RMUtilTimerMode - how the next run of a timer is scheduled */
+typedef enum {
+  // the next run is one interval after the callback returned, so the period drifts by the time
+  // the callback takes. This is the default
+  RMUTIL_TIMER_FIXED_DELAY = 0,
+  // runs are scheduled at fixed monotonic deadlines, one interval apart from the first one,
+  // regardless of how long the callback takes
+  RMUTIL_TIMER_FIXED_RATE = 1,
+} RMUtilTimerMode;
+
+/* RMUtilTimerCatchup - what a fixed rate timer does with runs it missed because it fell behind */
+typedef enum {
+  // skip the missed runs and continue at the next deadline in the future
+  RMUTIL_TIMER_CATCHUP_SKIP = 0,
+  // run the missed runs back to back until the timer caught up
+  RMUTIL_TIMER_CATCHUP_BURST = 1,
+} RMUtilTimerCatchup;
+
+/* RMUtilTimerOptions - optional scheduling options for RMUtil_NewPeriodicTimerEx */
+typedef struct {
+  RMUtilTimerMode mode;
+  RMUtilTimerCatchup catchup;
+  // if set, the callback is called with the redis global lock already held, and must not lock or
+  // unlock the context itself. All such timers due in the same tick run in a single critical
+  // section, which is yielded whenever it exceeds the lock budget (see RMUtilTimer_SetLockBudget)
+  int lock;
+} RMUtilTimerOptions;
+
+/* RMUtilTimerStats - run statistics of a timer. Lateness is how long after its deadline a run
+ * started, and duration is how long the callback took */
+typedef struct {
+  unsigned long long runs;
+  // runs skipped by a fixed rate timer with RMUTIL_TIMER_CATCHUP_SKIP
+  unsigned long long missed;
+  unsigned long long lastLatenessNs;
+  unsigned long long maxLatenessNs;
+  unsigned long long totalLatenessNs;
+  unsigned long long lastDurationNs;
+  unsigned long long maxDurationNs;
+  unsigned long long totalDurationNs;
+} RMUtilTimerStats;
+
+/* Create and start a new periodic timer. The timer can only be run and stopped once. The timer runs
+ * `cb` every `interval` with `privdata` passed to the callback.
+ *
+ * Timers do not have threads of their own: all timers are kept in a shared hierarchical timer
+ * wheel with a 1ms resolution, serviced by a single worker thread (see RMUtilTimer_SetNumThreads).
+ * Timers due in the same tick are fired together, sharing one thread-safe context. Since callbacks
+ * run one after the other on the worker thread, a slow callback delays the other timers. */
 struct RMUtilTimer *RMUtil_NewPeriodicTimer(RMutilTimerFunc cb, RMUtilTimerTerminationFunc onTerm,
                                             void *privdata, struct timespec interval);
 
+/* Same as RMUtil_NewPeriodicTimer, with scheduling options. If opts is NULL the defaults are used,
+ * i.e. a fixed delay timer */
+struct RMUtilTimer *RMUtil_NewPeriodicTimerEx(RMutilTimerFunc cb, RMUtilTimerTerminationFunc onTerm,
+                                              void *privdata, struct timespec interval,
+                                              const RMUtilTimerOptions *opts);
+
+/* Set how long timers created with the lock option may hold the redis global lock in one critical
+ * section. Once a callback returns after the budget is exhausted, the lock is released and taken
+ * again for the next callback, letting the main thread run in between. The default is 1ms */
+void RMUtilTimer_SetLockBudget(struct timespec budget);
+
+/* Copy the run statistics of the timer to stats */
+void RMUtilTimer_GetStats(struct RMUtilTimer *t, RMUtilTimerStats *stats);
+
+/* The maximal number of timer worker threads */
+#define RMUTIL_TIMER_MAX_THREADS 16
+
+/* Set the number of worker threads servicing the timers, each with its own timer wheel. New timers
+ * are spread between the workers round robin. This must be called before the first timer is
+ * created, and returns REDISMODULE_ERR otherwise, or if n is not between 1 and
+ * RMUTIL_TIMER_MAX_THREADS. The default is a single worker thread */
+int RMUtilTimer_SetNumThreads(int n);
+
 /* set a new frequency for the timer. This will take effect AFTER the next trigger */
 void RMUtilTimer_SetInterval(struct RMUtilTimer *t, struct timespec newInterval);
 
 /* Stop the timer loop, call the termination callbck to free up any resources linked to the timer,
  * and free the timer after stopping.
  *
- * This function doesn't wait for the thread to terminate, as it may cause a race condition if the
+ * This function doesn't wait for the timer to terminate, as it may cause a race condition if the
  * timer's callback is waiting for the redis global lock.
- * Instead you should make sure any resources are freed by the callback after the thread loop is
- * finished.
+ * Instead you should make sure any resources are freed by the termination callback, which is called
+ * from the timer's worker thread once the timer's callback is no longer running.
  *
  * The timer is freed automatically, so the callback doesn't need to do anything about it.
  * The callback gets the timer's associated privdata as its argument.
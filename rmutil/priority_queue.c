@@ -30,7 +30,226 @@ inline void Priority_Queue_Pop(PriorityQueue *pq) {
     pq->v->top--;
 }
 
+void Priority_Queue_PushMany(PriorityQueue *pq, void *elems, size_t n) {
+    if (n == 0) {
+        return;
+    }
+    Vector *v = pq->v;
+    size_t size = v->top, total = size + n;
+    __vector_TrimMigration(v);
+    if (total > v->cap) {
+        Vector_Reserve(v, __vector_GrowCap(v->cap, total, v->growth, v->minChunk));
+    }
+    // past the end of the vector, so in the new buffer if it is growing incrementally
+    memcpy(v->data + size * v->elemSize, elems, n * v->elemSize);
+    v->top = total;
+
+    // n sift-ups cost up to n*log2(total) comparisons, while rebuilding the heap costs about
+    // 2*total. Rebuild when the batch is large compared to the queue.
+    size_t log2total = 8 * sizeof(unsigned long) - __builtin_clzl(total);
+    if (n * log2total >= 2 * total) {
+        Make_Heap(v, 0, total, pq->cmp);
+    } else {
+        for (size_t last = size + 1; last <= total; last++) {
+            Heap_Push(v, 0, last, pq->cmp);
+        }
+    }
+}
+
+size_t Priority_Queue_PopMany(PriorityQueue *pq, void *out, size_t k) {
+    Vector *v = pq->v;
+    size_t i;
+    for (i = 0; i < k && v->top > 0; i++) {
+        if (out) {
+            memcpy((char *)out + i * v->elemSize, __vector_ElemPtr(v, 0), v->elemSize);
+        }
+        Heap_Pop(v, 0, v->top, pq->cmp);
+        v->top--;
+    }
+    return i;
+}
+
+int Priority_Queue_Step(PriorityQueue *pq, size_t budget) {
+    return Vector_Step(pq->v, budget);
+}
+
 void Priority_Queue_Free(PriorityQueue *pq) {
     Vector_Free(pq->v);
     free(pq);
 }
+
+#define __IPQ_SLOT_BITS 32
+
+static inline uint32_t __ipq_Slot(PriorityQueueHandle handle) {
+    return (uint32_t)handle;
+}
+
+static inline PriorityQueueHandle __ipq_Handle(IndexedPriorityQueue *pq, uint32_t slot) {
+    return (PriorityQueueHandle)pq->gens[slot] << __IPQ_SLOT_BITS | slot;
+}
+
+static inline void *__ipq_Elem(IndexedPriorityQueue *pq, uint32_t h) {
+    return pq->elems + h * pq->elemSize;
+}
+
+static inline int __ipq_Less(IndexedPriorityQueue *pq, size_t i, size_t j) {
+    return pq->cmp(__ipq_Elem(pq, pq->heap[i]), __ipq_Elem(pq, pq->heap[j])) < 0;
+}
+
+static inline void __ipq_Place(IndexedPriorityQueue *pq, size_t i, uint32_t h) {
+    pq->heap[i] = h;
+    pq->pos[h] = i;
+}
+
+/* Move the slot at heap position i up until its parent is not less than it */
+static size_t __ipq_SiftUp(IndexedPriorityQueue *pq, size_t i) {
+    uint32_t h = pq->heap[i];
+    void *e = __ipq_Elem(pq, h);
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (pq->cmp(__ipq_Elem(pq, pq->heap[parent]), e) >= 0) break;
+        __ipq_Place(pq, i, pq->heap[parent]);
+        i = parent;
+    }
+    __ipq_Place(pq, i, h);
+    return i;
+}
+
+/* Move the slot at heap position i down until none of its children is greater than it */
+static void __ipq_SiftDown(IndexedPriorityQueue *pq, size_t i) {
+    uint32_t h = pq->heap[i];
+    void *e = __ipq_Elem(pq, h);
+    for (;;) {
+        size_t child = 2 * i + 1;
+        if (child >= pq->size) break;
+        if (child + 1 < pq->size && __ipq_Less(pq, child, child + 1)) {
+            child++;
+        }
+        if (pq->cmp(__ipq_Elem(pq, pq->heap[child]), e) <= 0) break;
+        __ipq_Place(pq, i, pq->heap[child]);
+        i = child;
+    }
+    __ipq_Place(pq, i, h);
+}
+
+/* Restore the heap property around position i, after the element there changed */
+static void __ipq_Fix(IndexedPriorityQueue *pq, size_t i) {
+    if (__ipq_SiftUp(pq, i) == i) {
+        __ipq_SiftDown(pq, i);
+    }
+}
+
+IndexedPriorityQueue *__newIndexedPriorityQueueSize(size_t elemSize, size_t cap,
+                                                    int (*cmp)(void *, void *)) {
+    IndexedPriorityQueue *pq = calloc(1, sizeof(IndexedPriorityQueue));
+    pq->elemSize = elemSize;
+    pq->cmp = cmp;
+    pq->cap = cap ? cap : 1;
+    pq->elems = malloc(pq->cap * elemSize);
+    pq->heap = malloc(pq->cap * sizeof(uint32_t));
+    pq->pos = malloc(pq->cap * sizeof(size_t));
+    pq->gens = malloc(pq->cap * sizeof(uint32_t));
+    pq->freeHandles = malloc(pq->cap * sizeof(uint32_t));
+    return pq;
+}
+
+inline size_t Indexed_Priority_Queue_Size(IndexedPriorityQueue *pq) {
+    return pq->size;
+}
+
+int Indexed_Priority_Queue_Top(IndexedPriorityQueue *pq, void *ptr, PriorityQueueHandle *handle) {
+    if (pq->size == 0) {
+        return 0;
+    }
+    if (ptr) memcpy(ptr, __ipq_Elem(pq, pq->heap[0]), pq->elemSize);
+    if (handle) *handle = __ipq_Handle(pq, pq->heap[0]);
+    return 1;
+}
+
+PriorityQueueHandle __indexed_Priority_Queue_PushPtr(IndexedPriorityQueue *pq, void *elem) {
+    uint32_t h;
+    if (pq->numFree) {
+        h = pq->freeHandles[--pq->numFree];
+    } else {
+        if (pq->numHandles == pq->cap) {
+            pq->cap *= 2;
+            pq->elems = realloc(pq->elems, pq->cap * pq->elemSize);
+            pq->heap = realloc(pq->heap, pq->cap * sizeof(uint32_t));
+            pq->pos = realloc(pq->pos, pq->cap * sizeof(size_t));
+            pq->gens = realloc(pq->gens, pq->cap * sizeof(uint32_t));
+            pq->freeHandles = realloc(pq->freeHandles, pq->cap * sizeof(uint32_t));
+        }
+        h = pq->numHandles++;
+        pq->gens[h] = 0;
+    }
+
+    memcpy(__ipq_Elem(pq, h), elem, pq->elemSize);
+    __ipq_Place(pq, pq->size++, h);
+    __ipq_SiftUp(pq, pq->size - 1);
+    return __ipq_Handle(pq, h);
+}
+
+inline int Indexed_Priority_Queue_Contains(IndexedPriorityQueue *pq, PriorityQueueHandle handle) {
+    uint32_t h = __ipq_Slot(handle);
+    return h < pq->numHandles && pq->gens[h] == handle >> __IPQ_SLOT_BITS &&
+           pq->pos[h] != PRIORITY_QUEUE_INVALID_HANDLE;
+}
+
+int Indexed_Priority_Queue_Get(IndexedPriorityQueue *pq, PriorityQueueHandle handle, void *ptr) {
+    if (!Indexed_Priority_Queue_Contains(pq, handle)) {
+        return 0;
+    }
+    memcpy(ptr, __ipq_Elem(pq, __ipq_Slot(handle)), pq->elemSize);
+    return 1;
+}
+
+int __indexed_Priority_Queue_UpdatePtr(IndexedPriorityQueue *pq, PriorityQueueHandle handle,
+                                       void *elem) {
+    if (!Indexed_Priority_Queue_Contains(pq, handle)) {
+        return 0;
+    }
+    uint32_t h = __ipq_Slot(handle);
+    memcpy(__ipq_Elem(pq, h), elem, pq->elemSize);
+    __ipq_Fix(pq, pq->pos[h]);
+    return 1;
+}
+
+/* Remove the element of a queued slot, and release the slot with a new generation */
+static void __ipq_Remove(IndexedPriorityQueue *pq, uint32_t h) {
+    // move the last slot into the removed position and restore the heap around it
+    size_t i = pq->pos[h];
+    uint32_t last = pq->heap[--pq->size];
+    if (i != pq->size) {
+        __ipq_Place(pq, i, last);
+        __ipq_Fix(pq, i);
+    }
+
+    pq->pos[h] = PRIORITY_QUEUE_INVALID_HANDLE;
+    pq->gens[h]++;
+    pq->freeHandles[pq->numFree++] = h;
+}
+
+int Indexed_Priority_Queue_Remove(IndexedPriorityQueue *pq, PriorityQueueHandle handle, void *ptr) {
+    if (!Indexed_Priority_Queue_Contains(pq, handle)) {
+        return 0;
+    }
+    if (ptr) memcpy(ptr, __ipq_Elem(pq, __ipq_Slot(handle)), pq->elemSize);
+    __ipq_Remove(pq, __ipq_Slot(handle));
+    return 1;
+}
+
+void Indexed_Priority_Queue_Pop(IndexedPriorityQueue *pq) {
+    if (pq->size == 0) {
+        return;
+    }
+    __ipq_Remove(pq, pq->heap[0]);
+}
+
+void Indexed_Priority_Queue_Free(IndexedPriorityQueue *pq) {
+    free(pq->elems);
+    free(pq->heap);
+    free(pq->pos);
+    free(pq->gens);
+    free(pq->freeHandles);
+    free(pq);
+}
@@ -1,6 +1,7 @@
 #ifndef __PRIORITY_QUEUE_H__
 #define __PRIORITY_QUEUE_H__
 
+#include <stdint.h>
 #include "vector.h"
 
 /* Priority queue
@@ -48,8 +49,108 @@ size_t __priority_Queue_PushPtr(PriorityQueue *pq, void *elem);
  */
 void Priority_Queue_Pop(PriorityQueue *pq);
 
+/* Insert a batch of elements
+ * Appends n elements from the array elems to the priority_queue. Depending on the size of the batch
+ * relative to the queue, the elements are either sifted up one by one, or the whole queue is
+ * rebuilt with Make_Heap, whichever needs fewer comparisons.
+ */
+void Priority_Queue_PushMany(PriorityQueue *pq, void *elems, size_t n);
+
+/* Remove up to k top elements
+ * Pops up to k elements in order of priority, copying them to the array out (if it is not NULL).
+ * Returns the number of elements popped, which is less than k if the queue ran out of elements.
+ */
+size_t Priority_Queue_PopMany(PriorityQueue *pq, void *out, size_t k);
+
+/* Move elements of a queue growing incrementally to its new buffer
+ * The queue grows incrementally once its vector is set up with Vector_SetIncremental, e.g.
+ * `Vector_SetIncremental(pq->v, 1 << 20)`. See Vector_Step for the budget and the return value.
+ */
+int Priority_Queue_Step(PriorityQueue *pq, size_t budget);
+
 /* free the priority queue and the underlying data. Does not release its elements if
  * they are pointers */
 void Priority_Queue_Free(PriorityQueue *pq);
 
+/* Indexed priority queue
+ * An addressable priority queue: pushing an element returns a stable handle that can later be used
+ * to change the element's priority, remove it or check whether it is still queued, all in
+ * O(log n). This avoids rebuilding the queue or leaving tombstones when an expiry time or a score
+ * changes.
+ * Elements are stored in slots, and the heap orders slots. A position map from slot to heap
+ * position is kept in sync during sifts. Slots of popped or removed elements are reused by later
+ * pushes, so a handle holds its slot in the low 32 bits and the slot's generation in the high
+ * ones. The generation changes when the slot is released, which makes stale handles invalid
+ * instead of referring to the element that took their slot.
+ */
+typedef uint64_t PriorityQueueHandle;
+
+#define PRIORITY_QUEUE_INVALID_HANDLE ((PriorityQueueHandle)-1)
+
+typedef struct {
+    // element storage, indexed by slot
+    char *elems;
+    size_t elemSize;
+    // the heap of slots
+    uint32_t *heap;
+    size_t size;
+    // slot -> position in heap, or PRIORITY_QUEUE_INVALID_HANDLE if the slot is not queued
+    size_t *pos;
+    // slot -> generation of the handle currently using it
+    uint32_t *gens;
+    // stack of released slots, reused by pushes
+    uint32_t *freeHandles;
+    size_t numFree;
+    // number of slots ever allocated, and the capacity of the arrays above
+    size_t numHandles;
+    size_t cap;
+
+    int (*cmp)(void *, void *);
+} IndexedPriorityQueue;
+
+IndexedPriorityQueue *__newIndexedPriorityQueueSize(size_t elemSize, size_t cap,
+                                                    int (*cmp)(void *, void *));
+
+#define NewIndexedPriorityQueue(type, cap, cmp) \
+    __newIndexedPriorityQueueSize(sizeof(type), cap, cmp)
+
+/* Return the number of elements in the queue */
+size_t Indexed_Priority_Queue_Size(IndexedPriorityQueue *pq);
+
+/* Copy the top element to ptr, and its handle to handle (either may be NULL).
+ * Returns 0 if the queue is empty, 1 otherwise */
+int Indexed_Priority_Queue_Top(IndexedPriorityQueue *pq, void *ptr, PriorityQueueHandle *handle);
+
+/* Insert an element, returning its handle */
+PriorityQueueHandle __indexed_Priority_Queue_PushPtr(IndexedPriorityQueue *pq, void *elem);
+
+#define Indexed_Priority_Queue_Push(pq, elem) \
+    __indexed_Priority_Queue_PushPtr(pq, &(typeof(elem)){elem})
+
+/* Remove the top element. Its handle becomes invalid */
+void Indexed_Priority_Queue_Pop(IndexedPriorityQueue *pq);
+
+/* Return 1 if handle refers to an element currently in the queue, 0 otherwise. Handles of popped
+ * or removed elements never do, even once their slot is reused */
+int Indexed_Priority_Queue_Contains(IndexedPriorityQueue *pq, PriorityQueueHandle handle);
+
+/* Copy the element referred to by handle to ptr. Returns 0 if the handle is not in the queue */
+int Indexed_Priority_Queue_Get(IndexedPriorityQueue *pq, PriorityQueueHandle handle, void *ptr);
+
+/* Replace the element referred to by handle with elem, moving it up or down the queue according
+ * to its new priority. Returns 0 if the handle is not in the queue, 1 otherwise */
+int __indexed_Priority_Queue_UpdatePtr(IndexedPriorityQueue *pq, PriorityQueueHandle handle,
+                                       void *elem);
+
+#define Indexed_Priority_Queue_UpdatePriority(pq, handle, elem) \
+    __indexed_Priority_Queue_UpdatePtr(pq, handle, &(typeof(elem)){elem})
+
+/* Remove the element referred to by handle from the queue, copying it to ptr if ptr is not NULL.
+ * Returns 0 if the handle is not in the queue, 1 otherwise */
+int Indexed_Priority_Queue_Remove(IndexedPriorityQueue *pq, PriorityQueueHandle handle, void *ptr);
+
+/* free the indexed priority queue and the underlying data. Does not release its elements if
+ * they are pointers */
+void Indexed_Priority_Queue_Free(IndexedPriorityQueue *pq);
+
 #endif //__PRIORITY_QUEUE_H__
@@ -0,0 +1,216 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+#include "ring.h"
+#include "alloc.h"
+
+/* The padding between the fields written by different threads, at least a cache line */
+#define RING_PAD 64
+
+/* A slot holds the item of position seq - 1 once published, and is free for position seq */
+typedef struct {
+  size_t seq;
+  void *item;
+} ringSlot;
+
+struct RMUtilRing {
+  ringSlot *slots;
+  size_t mask;
+  int sharedProducers, sharedConsumers;
+  // the wakeup descriptor, and the end of the pipe to write to where there is no eventfd
+  int fd, writeFd;
+  char pad0[RING_PAD];
+  // the next position to push to
+  size_t tail;
+  char pad1[RING_PAD];
+  // the next position to pop from
+  size_t head;
+  char pad2[RING_PAD];
+};
+
+RMUtilRing *RMUtil_NewRing(RMUtilRingMode mode, size_t capacity, int flags) {
+  RMUtilRing *r = calloc(1, sizeof(*r));
+  r->fd = r->writeFd = -1;
+  if (flags & RMUTIL_RING_WAKEUP) {
+#ifdef __linux__
+    r->fd = r->writeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#else
+    int fds[2];
+    if (pipe(fds) == 0) {
+      for (int i = 0; i < 2; i++) {
+        fcntl(fds[i], F_SETFL, fcntl(fds[i], F_GETFL) | O_NONBLOCK);
+        fcntl(fds[i], F_SETFD, FD_CLOEXEC);
+      }
+      r->fd = fds[0];
+      r->writeFd = fds[1];
+    }
+#endif
+    if (r->fd < 0) {
+      free(r);
+      return NULL;
+    }
+  }
+
+  // a single slot could not tell a published item from a free slot of the next round
+  size_t cap = 2;
+  while (cap < capacity) cap *= 2;
+  r->slots = malloc(cap * sizeof(*r->slots));
+  for (size_t i = 0; i < cap; i++) r->slots[i] = (ringSlot){.seq = i};
+  r->mask = cap - 1;
+  r->sharedProducers = mode != RMUTIL_RING_SPSC;
+  r->sharedConsumers = mode == RMUTIL_RING_MPMC;
+  return r;
+}
+
+void RMUtilRing_Free(RMUtilRing *r) {
+  if (!r) return;
+  if (r->fd >= 0) close(r->fd);
+  if (r->writeFd >= 0 && r->writeFd != r->fd) close(r->writeFd);
+  free(r->slots);
+  free(r);
+}
+
+size_t RMUtilRing_Cap(const RMUtilRing *r) {
+  return r->mask + 1;
+}
+
+size_t RMUtilRing_Size(const RMUtilRing *r) {
+  size_t head = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+  size_t tail = __atomic_load_n(&r->tail, __ATOMIC_RELAXED);
+  // the positions are read apart, the head may have passed the tail read before it
+  return tail > head ? (tail - head > r->mask ? r->mask + 1 : tail - head) : 0;
+}
+
+int RMUtilRing_Fd(const RMUtilRing *r) {
+  return r->fd;
+}
+
+/* Claim up to n slots from the position in `counter` on, that are free for producers (offset 0)
+ * or hold items for consumers (offset 1). A shared side claims them with a compare-and-swap,
+ * retrying when another thread got there first. Returns the number of slots claimed, from *start */
+static size_t ring_Claim(RMUtilRing *r, size_t *counter, int shared, size_t offset, size_t n,
+                         size_t *start) {
+  ringSlot *slots = r->slots;
+  size_t mask = r->mask, pos = __atomic_load_n(counter, __ATOMIC_RELAXED);
+  int fenced = 0;
+  for (;;) {
+    size_t k = 0;
+    intptr_t dif = 0;
+    while (k < n) {
+      size_t seq = __atomic_load_n(&slots[(pos + k) & mask].seq, __ATOMIC_ACQUIRE);
+      dif = (intptr_t)(seq - (pos + k + offset));
+      if (dif) break;
+      k++;
+    }
+
+    if (k == 0) {
+      if (dif > 0) {
+        // another thread claimed the slot, catch up
+        pos = __atomic_load_n(counter, __ATOMIC_RELAXED);
+        continue;
+      }
+      // a consumer finding the ring empty checks again after a full fence, pairing with the one
+      // in ring_Notify: either it sees the item, or the producer sees it drained and signals
+      if (offset && r->fd >= 0 && !fenced) {
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        fenced = 1;
+        continue;
+      }
+      return 0;
+    }
+
+    if (!shared) {
+      __atomic_store_n(counter, pos + k, __ATOMIC_RELAXED);
+      *start = pos;
+      return k;
+    }
+    if (__atomic_compare_exchange_n(counter, &pos, pos + k, 1, __ATOMIC_RELAXED,
+                                    __ATOMIC_RELAXED)) {
+      *start = pos;
+      return k;
+    }
+  }
+}
+
+/* Signal the wakeup descriptor if the consumers had drained the ring up to pos, the first position
+ * just published */
+static void ring_Notify(RMUtilRing *r, size_t pos) {
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&r->head, __ATOMIC_RELAXED) != pos) return;
+  uint64_t one = 1;
+  // a full eventfd counter or pipe is readable already
+  ssize_t rc = write(r->writeFd, &one, r->writeFd == r->fd ? sizeof(one) : 1);
+  (void)rc;
+}
+
+/* The slots are read into locals, as the stores to the items could alias the ring */
+size_t RMUtilRing_PushMany(RMUtilRing *r, void *const *items, size_t n) {
+  size_t pos, k = ring_Claim(r, &r->tail, r->sharedProducers, 0, n, &pos);
+  ringSlot *slots = r->slots;
+  size_t mask = r->mask;
+  for (size_t i = 0; i < k; i++) {
+    ringSlot *s = &slots[(pos + i) & mask];
+    s->item = items[i];
+    __atomic_store_n(&s->seq, pos + i + 1, __ATOMIC_RELEASE);
+  }
+  if (k && r->fd >= 0) ring_Notify(r, pos);
+  return k;
+}
+
+size_t RMUtilRing_PopMany(RMUtilRing *r, void **items, size_t n) {
+  size_t pos, k = ring_Claim(r, &r->head, r->sharedConsumers, 1, n, &pos);
+  ringSlot *slots = r->slots;
+  size_t mask = r->mask;
+  for (size_t i = 0; i < k; i++) {
+    ringSlot *s = &slots[(pos + i) & mask];
+    items[i] = s->item;
+    // free the slot for the next round
+    __atomic_store_n(&s->seq, pos + i + mask + 1, __ATOMIC_RELEASE);
+  }
+  return k;
+}
+
+int RMUtilRing_Push(RMUtilRing *r, void *item) {
+  return RMUtilRing_PushMany(r, &item, 1) ? REDISMODULE_OK : REDISMODULE_ERR;
+}
+
+int RMUtilRing_Pop(RMUtilRing *r, void **item) {
+  return RMUtilRing_PopMany(r, item, 1) == 1;
+}
+
+/* Whether the slot at the head holds an item */
+static int ring_HasItems(RMUtilRing *r) {
+  size_t head = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+  return __atomic_load_n(&r->slots[head & r->mask].seq, __ATOMIC_ACQUIRE) == head + 1;
+}
+
+static long long nowMs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+int RMUtilRing_Wait(RMUtilRing *r, int timeoutMs) {
+  if (r->fd < 0) return ring_HasItems(r);
+  long long deadline = nowMs() + timeoutMs;
+  for (;;) {
+    uint64_t buf;
+    while (read(r->fd, &buf, sizeof(buf)) > 0 && r->fd != r->writeFd)
+      ;
+    // pairs with the fence in ring_Notify, as in ring_Claim
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (ring_HasItems(r)) return 1;
+
+    int left = timeoutMs < 0 ? -1 : (int)(deadline - nowMs());
+    if (timeoutMs >= 0 && left <= 0) return 0;
+    struct pollfd p = {.fd = r->fd, .events = POLLIN};
+    if (poll(&p, 1, left) < 0 && errno != EINTR) return ring_HasItems(r);
+  }
+}
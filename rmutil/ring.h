@@ -0,0 +1,84 @@
+#ifndef RMUTIL_RING_H_
+#define RMUTIL_RING_H_
+#include <stddef.h>
+#include <redismodule.h>
+
+/** ring.h - Bounded lock-free queues of pointers, for handing work between threads.
+ *
+ * An RMUtilRing is a fixed size ring of slots, each with a sequence number telling whether it
+ * holds an item for the current round. Producers and consumers claim the slots with a
+ * compare-and-swap of the ring's tail and head, or with a plain store on a side with a single
+ * thread, so the modes differ only in which side is shared:
+ *
+ *   - RMUTIL_RING_SPSC: one producer thread and one consumer thread
+ *   - RMUTIL_RING_MPSC: any number of producers, e.g. workers reporting to the main thread
+ *   - RMUTIL_RING_MPMC: any number of producers and consumers
+ *
+ * The tail, the head and the slots are on cache lines of their own, so producers and consumers
+ * do not invalidate each other's lines until they touch the same slots. Batches claim as many
+ * slots as they can with a single compare-and-swap.
+ *
+ * With RMUTIL_RING_WAKEUP, the ring has a file descriptor (an eventfd on linux) that becomes
+ * readable when an item is pushed to a ring the consumers had drained. Consumers sleep in
+ * RMUtilRing_Wait, or watch the descriptor with poll or an event loop, calling RMUtilRing_Wait
+ * with a timeout of 0 before popping. Pushes to a ring that is not drained make no system call.
+ *
+ *   RMUtilRing *r = RMUtil_NewRing(RMUTIL_RING_MPSC, 1024, RMUTIL_RING_WAKEUP);
+ *
+ *   // on the workers
+ *   while (RMUtilRing_Push(r, result) != REDISMODULE_OK) sched_yield();
+ *
+ *   // on the consumer
+ *   void *batch[64];
+ *   while (RMUtilRing_Wait(r, -1)) {
+ *     size_t n = RMUtilRing_PopMany(r, batch, 64);
+ *     ...
+ *   }
+ */
+
+typedef enum {
+  RMUTIL_RING_SPSC = 0,
+  RMUTIL_RING_MPSC = 1,
+  RMUTIL_RING_MPMC = 2,
+} RMUtilRingMode;
+
+/* Flags for RMUtil_NewRing */
+#define RMUTIL_RING_WAKEUP 0x01
+
+typedef struct RMUtilRing RMUtilRing;
+
+/* Create a ring holding up to `capacity` items, rounded up to a power of 2. Returns NULL if the
+ * wakeup descriptor could not be created */
+RMUtilRing *RMUtil_NewRing(RMUtilRingMode mode, size_t capacity, int flags);
+
+/* Free the ring. The items left in it are not freed */
+void RMUtilRing_Free(RMUtilRing *r);
+
+/* The number of items the ring holds at most */
+size_t RMUtilRing_Cap(const RMUtilRing *r);
+
+/* The number of items in the ring, which may be out of date by the time it returns */
+size_t RMUtilRing_Size(const RMUtilRing *r);
+
+/* Push an item. Returns REDISMODULE_ERR without pushing it if the ring is full */
+int RMUtilRing_Push(RMUtilRing *r, void *item);
+
+/* Pop the oldest item. Returns 0 if the ring is empty */
+int RMUtilRing_Pop(RMUtilRing *r, void **item);
+
+/* Push up to `n` items in order, as many as there is room for. Returns the number pushed */
+size_t RMUtilRing_PushMany(RMUtilRing *r, void *const *items, size_t n);
+
+/* Pop up to `n` items, oldest first. Returns the number popped. Items from several producers
+ * are popped in the order their slots were claimed, which keeps the order of each producer */
+size_t RMUtilRing_PopMany(RMUtilRing *r, void **items, size_t n);
+
+/* The wakeup descriptor of a ring created with RMUTIL_RING_WAKEUP, or -1 */
+int RMUtilRing_Fd(const RMUtilRing *r);
+
+/* Wait up to `timeoutMs` milliseconds, or forever if it is negative, for the ring to have items,
+ * clearing the wakeup descriptor. Returns 1 if the ring has items, which other consumers may pop
+ * first, and 0 on timeout. Rings without RMUTIL_RING_WAKEUP only check for items */
+int RMUtilRing_Wait(RMUtilRing *r, int timeoutMs);
+
+#endif
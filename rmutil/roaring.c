@@ -0,0 +1,895 @@
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "roaring.h"
+#include "byteorder.h"
+#include "alloc.h"
+
+#define ROARING_ARRAY 0
+#define ROARING_BITMAP 1
+#define ROARING_RUN 2
+
+/* Arrays hold up to 4096 IDs, the size of a bitmap in 16-bit entries */
+#define ROARING_ARRAY_MAX 4096
+#define ROARING_WORDS 1024
+/* Containers with more runs than this take less memory as a bitmap */
+#define ROARING_RUNS_MAX 2048
+
+#define ROARING_AND 0
+#define ROARING_OR 1
+#define ROARING_XOR 2
+#define ROARING_ANDNOT 3
+
+/* The IDs from start to start + length, both included */
+typedef struct {
+  uint16_t start, length;
+} roaringRun;
+
+typedef struct {
+  uint8_t type;
+  uint32_t card;
+  // the array entries or runs, and the room for them
+  uint32_t n, cap;
+  union {
+    uint16_t *array;
+    uint64_t *words;
+    roaringRun *runs;
+  };
+} roaringContainer;
+
+struct RMUtilRoaring {
+  // the upper 16 bits of the IDs of each container, ascending
+  uint16_t *keys;
+  roaringContainer *containers;
+  size_t n, cap;
+};
+
+/******************************************************************************
+ * Containers
+ ******************************************************************************/
+
+/* The first index in a[0..n) holding a value >= x, or n. The search halves the range without
+ * branching, since lookups of random IDs would mispredict half of the branches */
+static inline uint32_t array_LowerBound(const uint16_t *a, uint32_t n, uint32_t x) {
+  if (n == 0) return 0;
+  const uint16_t *base = a;
+  while (n > 1) {
+    uint32_t half = n / 2;
+    base += (base[half - 1] < x) * half;
+    n -= half;
+  }
+  return (base - a) + (*base < x);
+}
+
+/* The number of runs starting at or below x: x may be in the run before that index */
+static inline uint32_t run_UpperBound(const roaringRun *runs, uint32_t n, uint32_t x) {
+  if (n == 0) return 0;
+  const roaringRun *base = runs;
+  while (n > 1) {
+    uint32_t half = n / 2;
+    base += (base[half - 1].start <= x) * half;
+    n -= half;
+  }
+  return (base - runs) + (base->start <= x);
+}
+
+static inline int bitmap_Get(const uint64_t *words, uint32_t x) {
+  return (words[x >> 6] >> (x & 63)) & 1;
+}
+
+/* Set the bits from lo to hi, both included */
+static void bitmap_SetRange(uint64_t *words, uint32_t lo, uint32_t hi) {
+  uint32_t first = lo >> 6, last = hi >> 6;
+  uint64_t firstMask = ~0ULL << (lo & 63), lastMask = ~0ULL >> (63 - (hi & 63));
+  if (first == last) {
+    words[first] |= firstMask & lastMask;
+    return;
+  }
+  words[first] |= firstMask;
+  for (uint32_t i = first + 1; i < last; i++) words[i] = ~0ULL;
+  words[last] |= lastMask;
+}
+
+static uint32_t bitmap_Count(const uint64_t *words) {
+  uint32_t card = 0;
+  for (int i = 0; i < ROARING_WORDS; i++) card += __builtin_popcountll(words[i]);
+  return card;
+}
+
+/* Append a value above the last one to runs, extending the last run if it follows it */
+static inline void run_Push(roaringRun *runs, uint32_t *n, uint32_t x) {
+  if (*n && runs[*n - 1].start + runs[*n - 1].length + 1 == x) {
+    runs[*n - 1].length++;
+  } else {
+    runs[(*n)++] = (roaringRun){x, 0};
+  }
+}
+
+static void container_Free(roaringContainer *c) {
+  free(c->array);
+}
+
+static int container_Contains(const roaringContainer *c, uint32_t x) {
+  switch (c->type) {
+    case ROARING_ARRAY: {
+      uint32_t i = array_LowerBound(c->array, c->n, x);
+      return i < c->n && c->array[i] == x;
+    }
+    case ROARING_BITMAP:
+      return bitmap_Get(c->words, x);
+    default: {
+      uint32_t i = run_UpperBound(c->runs, c->n, x);
+      return i > 0 && x <= (uint32_t)c->runs[i - 1].start + c->runs[i - 1].length;
+    }
+  }
+}
+
+/* Fill the 1024 words of `buf` with the container's bits, or return its own words */
+static const uint64_t *container_Words(const roaringContainer *c, uint64_t *buf) {
+  if (c->type == ROARING_BITMAP) return c->words;
+  memset(buf, 0, ROARING_WORDS * sizeof(*buf));
+  if (c->type == ROARING_ARRAY) {
+    for (uint32_t i = 0; i < c->n; i++) buf[c->array[i] >> 6] |= 1ULL << (c->array[i] & 63);
+  } else {
+    for (uint32_t i = 0; i < c->n; i++) {
+      bitmap_SetRange(buf, c->runs[i].start, c->runs[i].start + c->runs[i].length);
+    }
+  }
+  return buf;
+}
+
+/* Write the container's values to `out`, which has room for its cardinality */
+static void container_Values(const roaringContainer *c, uint16_t *out) {
+  uint32_t k = 0;
+  switch (c->type) {
+    case ROARING_ARRAY:
+      memcpy(out, c->array, c->n * sizeof(*out));
+      break;
+    case ROARING_BITMAP:
+      for (uint32_t i = 0; i < ROARING_WORDS; i++) {
+        for (uint64_t w = c->words[i]; w; w &= w - 1) out[k++] = i * 64 + __builtin_ctzll(w);
+      }
+      break;
+    default:
+      for (uint32_t i = 0; i < c->n; i++) {
+        for (uint32_t x = c->runs[i].start; x <= (uint32_t)c->runs[i].start + c->runs[i].length;
+             x++) {
+          out[k++] = x;
+        }
+      }
+  }
+}
+
+static void container_ToBitmap(roaringContainer *c) {
+  uint64_t *words = malloc(ROARING_WORDS * sizeof(*words));
+  if (container_Words(c, words) == words) {
+    container_Free(c);
+    c->words = words;
+  } else {
+    free(words);
+  }
+  c->type = ROARING_BITMAP;
+  c->n = c->cap = 0;
+}
+
+static void container_ToArray(roaringContainer *c) {
+  uint16_t *array = malloc(c->card * sizeof(*array));
+  container_Values(c, array);
+  container_Free(c);
+  c->type = ROARING_ARRAY;
+  c->array = array;
+  c->n = c->cap = c->card;
+}
+
+/* The number of runs the container's IDs make */
+static uint32_t container_NumRuns(const roaringContainer *c) {
+  uint32_t runs = 0;
+  switch (c->type) {
+    case ROARING_ARRAY:
+      for (uint32_t i = 0; i < c->n; i++) runs += i == 0 || c->array[i] != c->array[i - 1] + 1;
+      return runs;
+    case ROARING_BITMAP: {
+      // count the set bits following a clear one
+      uint64_t carry = 0;
+      for (uint32_t i = 0; i < ROARING_WORDS; i++) {
+        uint64_t w = c->words[i];
+        runs += __builtin_popcountll(w & ~((w << 1) | carry));
+        carry = w >> 63;
+      }
+      return runs;
+    }
+    default:
+      return c->n;
+  }
+}
+
+static void container_ToRuns(roaringContainer *c, uint32_t numRuns) {
+  roaringRun *runs = malloc(numRuns * sizeof(*runs));
+  uint32_t n = 0;
+  if (c->type == ROARING_ARRAY) {
+    for (uint32_t i = 0; i < c->n; i++) run_Push(runs, &n, c->array[i]);
+  } else {
+    for (uint32_t i = 0; i < ROARING_WORDS; i++) {
+      for (uint64_t w = c->words[i]; w; w &= w - 1) run_Push(runs, &n, i * 64 + __builtin_ctzll(w));
+    }
+  }
+  container_Free(c);
+  c->type = ROARING_RUN;
+  c->runs = runs;
+  c->n = c->cap = n;
+}
+
+/* Switch between an array and a bitmap after the cardinality changed */
+static void container_Fit(roaringContainer *c) {
+  if (c->type == ROARING_BITMAP && c->card <= ROARING_ARRAY_MAX) {
+    container_ToArray(c);
+  } else if (c->type == ROARING_ARRAY && c->card > ROARING_ARRAY_MAX) {
+    container_ToBitmap(c);
+  } else if (c->type == ROARING_RUN && c->n > ROARING_RUNS_MAX) {
+    if (c->card <= ROARING_ARRAY_MAX) {
+      container_ToArray(c);
+    } else {
+      container_ToBitmap(c);
+    }
+  }
+}
+
+/* Make room for one more array entry or run */
+static void container_Grow(roaringContainer *c, size_t elemSize) {
+  if (c->n < c->cap) return;
+  c->cap = c->cap ? c->cap * 2 : 4;
+  c->array = realloc(c->array, c->cap * elemSize);
+}
+
+static int run_Add(roaringContainer *c, uint32_t x) {
+  uint32_t i = run_UpperBound(c->runs, c->n, x);
+  if (i > 0) {
+    roaringRun *r = &c->runs[i - 1];
+    uint32_t end = r->start + r->length;
+    if (x <= end) return 0;
+    if (x == end + 1) {
+      r->length++;
+      // the run now reaches the next one
+      if (i < c->n && c->runs[i].start == x + 1) {
+        r->length += c->runs[i].length + 1;
+        memmove(c->runs + i, c->runs + i + 1, (c->n - i - 1) * sizeof(*c->runs));
+        c->n--;
+      }
+      c->card++;
+      return 1;
+    }
+  }
+  if (i < c->n && c->runs[i].start == x + 1) {
+    c->runs[i].start--;
+    c->runs[i].length++;
+  } else {
+    container_Grow(c, sizeof(*c->runs));
+    memmove(c->runs + i + 1, c->runs + i, (c->n - i) * sizeof(*c->runs));
+    c->runs[i] = (roaringRun){x, 0};
+    c->n++;
+  }
+  c->card++;
+  return 1;
+}
+
+static int run_Remove(roaringContainer *c, uint32_t x) {
+  uint32_t i = run_UpperBound(c->runs, c->n, x);
+  if (i == 0) return 0;
+  roaringRun *r = &c->runs[i - 1];
+  uint32_t end = r->start + r->length;
+  if (x > end) return 0;
+  if (r->length == 0) {
+    memmove(c->runs + i - 1, c->runs + i, (c->n - i) * sizeof(*c->runs));
+    c->n--;
+  } else if (x == r->start) {
+    r->start++;
+    r->length--;
+  } else if (x == end) {
+    r->length--;
+  } else {
+    // split the run around x
+    r->length = x - r->start - 1;
+    container_Grow(c, sizeof(*c->runs));
+    memmove(c->runs + i + 1, c->runs + i, (c->n - i) * sizeof(*c->runs));
+    c->runs[i] = (roaringRun){x + 1, end - x - 1};
+    c->n++;
+  }
+  c->card--;
+  return 1;
+}
+
+static int container_Add(roaringContainer *c, uint32_t x) {
+  int added;
+  switch (c->type) {
+    case ROARING_ARRAY: {
+      uint32_t i = array_LowerBound(c->array, c->n, x);
+      if (i < c->n && c->array[i] == x) return 0;
+      if (c->n == ROARING_ARRAY_MAX) {
+        container_ToBitmap(c);
+        return container_Add(c, x);
+      }
+      container_Grow(c, sizeof(*c->array));
+      memmove(c->array + i + 1, c->array + i, (c->n - i) * sizeof(*c->array));
+      c->array[i] = x;
+      c->n++;
+      c->card++;
+      return 1;
+    }
+    case ROARING_BITMAP: {
+      uint64_t bit = 1ULL << (x & 63);
+      if (c->words[x >> 6] & bit) return 0;
+      c->words[x >> 6] |= bit;
+      c->card++;
+      return 1;
+    }
+    default:
+      added = run_Add(c, x);
+      container_Fit(c);
+      return added;
+  }
+}
+
+static int container_Remove(roaringContainer *c, uint32_t x) {
+  int removed;
+  switch (c->type) {
+    case ROARING_ARRAY: {
+      uint32_t i = array_LowerBound(c->array, c->n, x);
+      if (i == c->n || c->array[i] != x) return 0;
+      memmove(c->array + i, c->array + i + 1, (c->n - i - 1) * sizeof(*c->array));
+      c->n--;
+      c->card--;
+      return 1;
+    }
+    case ROARING_BITMAP: {
+      uint64_t bit = 1ULL << (x & 63);
+      if (!(c->words[x >> 6] & bit)) return 0;
+      c->words[x >> 6] &= ~bit;
+      c->card--;
+      container_Fit(c);
+      return 1;
+    }
+    default:
+      removed = run_Remove(c, x);
+      container_Fit(c);
+      return removed;
+  }
+}
+
+/* The number of IDs lower than or equal to x */
+static uint32_t container_Rank(const roaringContainer *c, uint32_t x) {
+  switch (c->type) {
+    case ROARING_ARRAY:
+      return array_LowerBound(c->array, c->n, x + 1);
+    case ROARING_BITMAP: {
+      uint32_t rank = 0;
+      for (uint32_t i = 0; i < x >> 6; i++) rank += __builtin_popcountll(c->words[i]);
+      uint64_t mask = (x & 63) == 63 ? ~0ULL : (2ULL << (x & 63)) - 1;
+      return rank + __builtin_popcountll(c->words[x >> 6] & mask);
+    }
+    default: {
+      uint32_t rank = 0, i = run_UpperBound(c->runs, c->n, x);
+      for (uint32_t j = 0; j + 1 < i; j++) rank += c->runs[j].length + 1;
+      if (i > 0) {
+        uint32_t end = c->runs[i - 1].start + c->runs[i - 1].length;
+        rank += (x < end ? x : end) - c->runs[i - 1].start + 1;
+      }
+      return rank;
+    }
+  }
+}
+
+/* The value of the given rank, below the container's cardinality */
+static uint32_t container_Select(const roaringContainer *c, uint32_t rank) {
+  switch (c->type) {
+    case ROARING_ARRAY:
+      return c->array[rank];
+    case ROARING_BITMAP:
+      for (uint32_t i = 0;; i++) {
+        uint32_t count = __builtin_popcountll(c->words[i]);
+        if (rank < count) {
+          uint64_t w = c->words[i];
+          while (rank--) w &= w - 1;
+          return i * 64 + __builtin_ctzll(w);
+        }
+        rank -= count;
+      }
+    default:
+      for (uint32_t i = 0;; i++) {
+        if (rank <= c->runs[i].length) return c->runs[i].start + rank;
+        rank -= c->runs[i].length + 1;
+      }
+  }
+}
+
+static roaringContainer container_Copy(const roaringContainer *c) {
+  roaringContainer copy = *c;
+  size_t bytes = c->type == ROARING_ARRAY    ? c->n * sizeof(*c->array)
+                 : c->type == ROARING_BITMAP ? ROARING_WORDS * sizeof(*c->words)
+                                             : c->n * sizeof(*c->runs);
+  copy.array = malloc(bytes);
+  memcpy(copy.array, c->array, bytes);
+  copy.cap = copy.n;
+  return copy;
+}
+
+static size_t container_MemUsage(const roaringContainer *c) {
+  switch (c->type) {
+    case ROARING_ARRAY:
+      return c->cap * sizeof(*c->array);
+    case ROARING_BITMAP:
+      return ROARING_WORDS * sizeof(*c->words);
+    default:
+      return c->cap * sizeof(*c->runs);
+  }
+}
+
+/* Set `out` to an array of the k values in res, allocating nothing when it is empty */
+static uint32_t array_Result(const uint16_t *res, uint32_t k, roaringContainer *out) {
+  *out = (roaringContainer){.type = ROARING_ARRAY, .card = k, .n = k, .cap = k};
+  if (k) {
+    out->array = malloc(k * sizeof(*res));
+    memcpy(out->array, res, k * sizeof(*res));
+  }
+  return k;
+}
+
+/* Merge two arrays. The result may need a bitmap for OR and XOR */
+static uint32_t array_Op(int op, const roaringContainer *a, const roaringContainer *b,
+                         roaringContainer *out) {
+  uint32_t na = a->n, nb = b->n, i = 0, j = 0, k = 0;
+  uint16_t res[2 * ROARING_ARRAY_MAX];
+  int keepA = op != ROARING_AND, keepB = op == ROARING_OR || op == ROARING_XOR,
+      keepBoth = op == ROARING_AND || op == ROARING_OR;
+  while (i < na && j < nb) {
+    uint16_t x = a->array[i], y = b->array[j];
+    if (x < y) {
+      if (keepA) res[k++] = x;
+      i++;
+    } else if (y < x) {
+      if (keepB) res[k++] = y;
+      j++;
+    } else {
+      if (keepBoth) res[k++] = x;
+      i++;
+      j++;
+    }
+  }
+  if (keepA) {
+    memcpy(res + k, a->array + i, (na - i) * sizeof(*res));
+    k += na - i;
+  }
+  if (keepB) {
+    memcpy(res + k, b->array + j, (nb - j) * sizeof(*res));
+    k += nb - j;
+  }
+  array_Result(res, k, out);
+  container_Fit(out);
+  return k;
+}
+
+/* Keep the array entries of `a` that are in `b`, or that are not */
+static uint32_t array_Filter(const roaringContainer *a, const roaringContainer *b, int keepIn,
+                             roaringContainer *out) {
+  uint16_t res[ROARING_ARRAY_MAX];
+  uint32_t k = 0;
+  for (uint32_t i = 0; i < a->n; i++) {
+    res[k] = a->array[i];
+    k += container_Contains(b, a->array[i]) == keepIn;
+  }
+  return array_Result(res, k, out);
+}
+
+/* Combine two containers into `out`, returning its cardinality. Nothing is allocated when it is
+ * empty. Arrays are merged or filtered, everything else is combined a word at a time */
+static uint32_t container_Op(int op, const roaringContainer *a, const roaringContainer *b,
+                             roaringContainer *out) {
+  uint32_t card;
+  if (a->type == ROARING_ARRAY && b->type == ROARING_ARRAY) {
+    card = array_Op(op, a, b, out);
+  } else if (a->type == ROARING_ARRAY && (op == ROARING_AND || op == ROARING_ANDNOT)) {
+    card = array_Filter(a, b, op == ROARING_AND, out);
+  } else if (b->type == ROARING_ARRAY && op == ROARING_AND) {
+    card = array_Filter(b, a, 1, out);
+  } else {
+    uint64_t bufA[ROARING_WORDS], bufB[ROARING_WORDS];
+    const uint64_t *wa = container_Words(a, bufA), *wb = container_Words(b, bufB);
+    uint64_t *w = malloc(ROARING_WORDS * sizeof(*w));
+    card = 0;
+    switch (op) {
+      case ROARING_AND:
+        for (int i = 0; i < ROARING_WORDS; i++) card += __builtin_popcountll(w[i] = wa[i] & wb[i]);
+        break;
+      case ROARING_OR:
+        for (int i = 0; i < ROARING_WORDS; i++) card += __builtin_popcountll(w[i] = wa[i] | wb[i]);
+        break;
+      case ROARING_XOR:
+        for (int i = 0; i < ROARING_WORDS; i++) card += __builtin_popcountll(w[i] = wa[i] ^ wb[i]);
+        break;
+      default:
+        for (int i = 0; i < ROARING_WORDS; i++) card += __builtin_popcountll(w[i] = wa[i] & ~wb[i]);
+    }
+    *out = (roaringContainer){.type = ROARING_BITMAP, .card = card, .words = w};
+    if (card) container_Fit(out);
+  }
+  if (!card) container_Free(out);
+  return card;
+}
+
+/******************************************************************************
+ * Bitmaps
+ ******************************************************************************/
+
+RMUtilRoaring *RMUtil_NewRoaring(void) {
+  return calloc(1, sizeof(RMUtilRoaring));
+}
+
+void RMUtilRoaring_Free(RMUtilRoaring *r) {
+  if (!r) return;
+  for (size_t i = 0; i < r->n; i++) container_Free(&r->containers[i]);
+  free(r->keys);
+  free(r->containers);
+  free(r);
+}
+
+/* The index of the container of `key`, or where to insert it */
+static size_t roaring_KeyIndex(const RMUtilRoaring *r, uint16_t key) {
+  return array_LowerBound(r->keys, r->n, key);
+}
+
+static void roaring_Insert(RMUtilRoaring *r, size_t i, uint16_t key, roaringContainer c) {
+  if (r->n == r->cap) {
+    r->cap = r->cap ? r->cap * 2 : 4;
+    r->keys = realloc(r->keys, r->cap * sizeof(*r->keys));
+    r->containers = realloc(r->containers, r->cap * sizeof(*r->containers));
+  }
+  memmove(r->keys + i + 1, r->keys + i, (r->n - i) * sizeof(*r->keys));
+  memmove(r->containers + i + 1, r->containers + i, (r->n - i) * sizeof(*r->containers));
+  r->keys[i] = key;
+  r->containers[i] = c;
+  r->n++;
+}
+
+static void roaring_Delete(RMUtilRoaring *r, size_t i) {
+  container_Free(&r->containers[i]);
+  memmove(r->keys + i, r->keys + i + 1, (r->n - i - 1) * sizeof(*r->keys));
+  memmove(r->containers + i, r->containers + i + 1, (r->n - i - 1) * sizeof(*r->containers));
+  r->n--;
+}
+
+/* The container of `key`, or NULL */
+static const roaringContainer *roaring_Find(const RMUtilRoaring *r, uint16_t key) {
+  size_t i = roaring_KeyIndex(r, key);
+  return i < r->n && r->keys[i] == key ? &r->containers[i] : NULL;
+}
+
+int RMUtilRoaring_Add(RMUtilRoaring *r, uint32_t id) {
+  uint16_t key = id >> 16;
+  size_t i = roaring_KeyIndex(r, key);
+  if (i == r->n || r->keys[i] != key) {
+    roaring_Insert(r, i, key, (roaringContainer){.type = ROARING_ARRAY});
+  }
+  return container_Add(&r->containers[i], id & 0xffff);
+}
+
+void RMUtilRoaring_AddRange(RMUtilRoaring *r, uint32_t start, uint32_t end) {
+  if (start > end) return;
+  for (uint32_t key = start >> 16; key <= end >> 16; key++) {
+    uint32_t lo = key == start >> 16 ? start & 0xffff : 0;
+    uint32_t hi = key == end >> 16 ? end & 0xffff : 0xffff;
+    size_t i = roaring_KeyIndex(r, key);
+    int exists = i < r->n && r->keys[i] == key;
+    if (!exists || (lo == 0 && hi == 0xffff)) {
+      // a new or full container is a single run
+      roaringRun *run = malloc(sizeof(*run));
+      *run = (roaringRun){lo, hi - lo};
+      roaringContainer c = {
+          .type = ROARING_RUN, .card = hi - lo + 1, .n = 1, .cap = 1, .runs = run};
+      if (exists) {
+        container_Free(&r->containers[i]);
+        r->containers[i] = c;
+      } else {
+        roaring_Insert(r, i, key, c);
+      }
+    } else {
+      roaringContainer *c = &r->containers[i];
+      if (c->type != ROARING_BITMAP) container_ToBitmap(c);
+      bitmap_SetRange(c->words, lo, hi);
+      c->card = bitmap_Count(c->words);
+      container_Fit(c);
+    }
+    if (key == 0xffff) break;
+  }
+}
+
+int RMUtilRoaring_Remove(RMUtilRoaring *r, uint32_t id) {
+  uint16_t key = id >> 16;
+  size_t i = roaring_KeyIndex(r, key);
+  if (i == r->n || r->keys[i] != key) return 0;
+  int removed = container_Remove(&r->containers[i], id & 0xffff);
+  if (!r->containers[i].card) roaring_Delete(r, i);
+  return removed;
+}
+
+int RMUtilRoaring_Contains(const RMUtilRoaring *r, uint32_t id) {
+  const roaringContainer *c = roaring_Find(r, id >> 16);
+  return c && container_Contains(c, id & 0xffff);
+}
+
+uint64_t RMUtilRoaring_Cardinality(const RMUtilRoaring *r) {
+  uint64_t card = 0;
+  for (size_t i = 0; i < r->n; i++) card += r->containers[i].card;
+  return card;
+}
+
+uint64_t RMUtilRoaring_Rank(const RMUtilRoaring *r, uint32_t id) {
+  uint16_t key = id >> 16;
+  uint64_t rank = 0;
+  size_t i;
+  for (i = 0; i < r->n && r->keys[i] < key; i++) rank += r->containers[i].card;
+  if (i < r->n && r->keys[i] == key) rank += container_Rank(&r->containers[i], id & 0xffff);
+  return rank;
+}
+
+int RMUtilRoaring_Select(const RMUtilRoaring *r, uint64_t rank, uint32_t *id) {
+  for (size_t i = 0; i < r->n; i++) {
+    if (rank < r->containers[i].card) {
+      *id = (uint32_t)r->keys[i] << 16 | container_Select(&r->containers[i], rank);
+      return 1;
+    }
+    rank -= r->containers[i].card;
+  }
+  return 0;
+}
+
+static RMUtilRoaring *roaring_Op(int op, const RMUtilRoaring *a, const RMUtilRoaring *b) {
+  RMUtilRoaring *r = RMUtil_NewRoaring();
+  size_t i = 0, j = 0;
+  while (i < a->n || j < b->n) {
+    if (op == ROARING_AND && (i == a->n || j == b->n)) break;
+    if (j == b->n || (i < a->n && a->keys[i] < b->keys[j])) {
+      // only in a
+      if (op != ROARING_AND) roaring_Insert(r, r->n, a->keys[i], container_Copy(&a->containers[i]));
+      i++;
+    } else if (i == a->n || b->keys[j] < a->keys[i]) {
+      // only in b
+      if (op == ROARING_OR || op == ROARING_XOR) {
+        roaring_Insert(r, r->n, b->keys[j], container_Copy(&b->containers[j]));
+      }
+      j++;
+    } else {
+      roaringContainer c;
+      if (container_Op(op, &a->containers[i], &b->containers[j], &c)) {
+        roaring_Insert(r, r->n, a->keys[i], c);
+      }
+      i++;
+      j++;
+    }
+  }
+  return r;
+}
+
+RMUtilRoaring *RMUtilRoaring_And(const RMUtilRoaring *a, const RMUtilRoaring *b) {
+  return roaring_Op(ROARING_AND, a, b);
+}
+
+RMUtilRoaring *RMUtilRoaring_Or(const RMUtilRoaring *a, const RMUtilRoaring *b) {
+  return roaring_Op(ROARING_OR, a, b);
+}
+
+RMUtilRoaring *RMUtilRoaring_Xor(const RMUtilRoaring *a, const RMUtilRoaring *b) {
+  return roaring_Op(ROARING_XOR, a, b);
+}
+
+RMUtilRoaring *RMUtilRoaring_AndNot(const RMUtilRoaring *a, const RMUtilRoaring *b) {
+  return roaring_Op(ROARING_ANDNOT, a, b);
+}
+
+void RMUtilRoaring_RunOptimize(RMUtilRoaring *r) {
+  for (size_t i = 0; i < r->n; i++) {
+    roaringContainer *c = &r->containers[i];
+    uint32_t runs = container_NumRuns(c);
+    size_t runBytes = runs * sizeof(roaringRun);
+    size_t otherBytes = c->card <= ROARING_ARRAY_MAX ? c->card * sizeof(uint16_t)
+                                                     : ROARING_WORDS * sizeof(uint64_t);
+    if (c->type != ROARING_RUN && runBytes < otherBytes) {
+      container_ToRuns(c, runs);
+    } else if (c->type == ROARING_RUN && runBytes >= otherBytes) {
+      if (c->card <= ROARING_ARRAY_MAX) {
+        container_ToArray(c);
+      } else {
+        container_ToBitmap(c);
+      }
+    }
+  }
+}
+
+size_t RMUtilRoaring_MemUsage(const RMUtilRoaring *r) {
+  size_t bytes = sizeof(*r) + r->cap * (sizeof(*r->keys) + sizeof(*r->containers));
+  for (size_t i = 0; i < r->n; i++) bytes += container_MemUsage(&r->containers[i]);
+  return bytes;
+}
+
+/* Position the iterator at the start of its container */
+static void roaring_IterStart(RMUtilRoaringIterator *it) {
+  it->pos = 0;
+  it->word = 0;
+  if (it->container < it->r->n && it->r->containers[it->container].type == ROARING_BITMAP) {
+    it->word = it->r->containers[it->container].words[0];
+  }
+}
+
+void RMUtilRoaring_Iterate(const RMUtilRoaring *r, RMUtilRoaringIterator *it) {
+  it->r = r;
+  it->container = 0;
+  roaring_IterStart(it);
+}
+
+int RMUtilRoaringIterator_Next(RMUtilRoaringIterator *it, uint32_t *id) {
+  while (it->container < it->r->n) {
+    const roaringContainer *c = &it->r->containers[it->container];
+    uint32_t key = (uint32_t)it->r->keys[it->container] << 16;
+    switch (c->type) {
+      case ROARING_ARRAY:
+        if (it->pos < c->n) {
+          *id = key | c->array[it->pos++];
+          return 1;
+        }
+        break;
+      case ROARING_BITMAP:
+        while (!it->word && ++it->pos < ROARING_WORDS) it->word = c->words[it->pos];
+        if (it->word) {
+          *id = key | (it->pos * 64 + __builtin_ctzll(it->word));
+          it->word &= it->word - 1;
+          return 1;
+        }
+        break;
+      default:
+        if (it->pos < c->n) {
+          *id = key | (c->runs[it->pos].start + it->word);
+          if (it->word == c->runs[it->pos].length) {
+            it->pos++;
+            it->word = 0;
+          } else {
+            it->word++;
+          }
+          return 1;
+        }
+    }
+    it->container++;
+    roaring_IterStart(it);
+  }
+  return 0;
+}
+
+/******************************************************************************
+ * RDB
+ ******************************************************************************/
+
+/* Containers are saved as their key (2 bytes), type (1 byte), number of array entries, runs or
+ * bits set (4 bytes) and contents, all in little endian */
+#define ROARING_CONTAINER_HEADER 7
+
+static size_t roaring_SavedBytes(const roaringContainer *c) {
+  switch (c->type) {
+    case ROARING_ARRAY:
+      return c->n * 2;
+    case ROARING_BITMAP:
+      return ROARING_WORDS * 8;
+    default:
+      return c->n * 4;
+  }
+}
+
+void RMUtilRoaring_Save(RedisModuleIO *io, const RMUtilRoaring *r) {
+  size_t len = 0;
+  for (size_t i = 0; i < r->n; i++) {
+    len += ROARING_CONTAINER_HEADER + roaring_SavedBytes(&r->containers[i]);
+  }
+  uint8_t *buf = malloc(len + 1), *p = buf;
+  for (size_t i = 0; i < r->n; i++) {
+    const roaringContainer *c = &r->containers[i];
+    RMUtil_PutLE(p, r->keys[i], 2);
+    p[2] = c->type;
+    RMUtil_PutLE(p + 3, c->type == ROARING_BITMAP ? c->card : c->n, 4);
+    p += ROARING_CONTAINER_HEADER;
+    switch (c->type) {
+      case ROARING_ARRAY:
+        for (uint32_t j = 0; j < c->n; j++, p += 2) RMUtil_PutLE(p, c->array[j], 2);
+        break;
+      case ROARING_BITMAP:
+        for (uint32_t j = 0; j < ROARING_WORDS; j++, p += 8) RMUtil_PutLE(p, c->words[j], 8);
+        break;
+      default:
+        for (uint32_t j = 0; j < c->n; j++, p += 4) {
+          RMUtil_PutLE(p, c->runs[j].start, 2);
+          RMUtil_PutLE(p + 2, c->runs[j].length, 2);
+        }
+    }
+  }
+  RedisModule_SaveUnsigned(io, r->n);
+  RedisModule_SaveStringBuffer(io, (const char *)buf, len);
+  free(buf);
+}
+
+/* Read a container at p, checking it is well formed. Returns the bytes read, or 0 if it is not
+ * valid or does not fit in the len bytes left */
+static size_t roaring_LoadContainer(const uint8_t *p, size_t len, roaringContainer *c) {
+  if (len < ROARING_CONTAINER_HEADER) return 0;
+  uint32_t count = RMUtil_GetLE(p + 3, 4);
+  *c = (roaringContainer){.type = p[2]};
+  const uint8_t *data = p + ROARING_CONTAINER_HEADER;
+  len -= ROARING_CONTAINER_HEADER;
+
+  switch (c->type) {
+    case ROARING_ARRAY:
+      if (count == 0 || count > ROARING_ARRAY_MAX || len < count * 2) return 0;
+      c->array = malloc(count * sizeof(*c->array));
+      for (uint32_t i = 0; i < count; i++) {
+        c->array[i] = RMUtil_GetLE(data + 2 * i, 2);
+        if (i > 0 && c->array[i] <= c->array[i - 1]) goto err;
+      }
+      c->n = c->cap = c->card = count;
+      return ROARING_CONTAINER_HEADER + count * 2;
+
+    case ROARING_BITMAP:
+      if (len < ROARING_WORDS * 8) return 0;
+      c->words = malloc(ROARING_WORDS * sizeof(*c->words));
+      for (uint32_t i = 0; i < ROARING_WORDS; i++) {
+        c->words[i] = RMUtil_GetLE(data + 8 * i, 8);
+      }
+      c->card = bitmap_Count(c->words);
+      if (c->card == 0 || c->card != count) goto err;
+      return ROARING_CONTAINER_HEADER + ROARING_WORDS * 8;
+
+    case ROARING_RUN:
+      if (count == 0 || count > ROARING_RUNS_MAX || len < count * 4) return 0;
+      c->runs = malloc(count * sizeof(*c->runs));
+      for (uint32_t i = 0; i < count; i++) {
+        const uint8_t *q = data + 4 * i;
+        roaringRun run = {RMUtil_GetLE(q, 2), RMUtil_GetLE(q + 2, 2)};
+        // runs are apart from each other, and end within the container
+        if ((uint32_t)run.start + run.length > 0xffff) goto err;
+        if (i > 0 && run.start <= (uint32_t)c->runs[i - 1].start + c->runs[i - 1].length + 1) {
+          goto err;
+        }
+        c->runs[i] = run;
+        c->card += run.length + 1;
+      }
+      c->n = c->cap = count;
+      return ROARING_CONTAINER_HEADER + count * 4;
+  }
+  return 0;
+
+err:
+  container_Free(c);
+  return 0;
+}
+
+RMUtilRoaring *RMUtilRoaring_Load(RedisModuleIO *io) {
+  uint64_t n = RedisModule_LoadUnsigned(io);
+  size_t len;
+  char *buf = RedisModule_LoadStringBuffer(io, &len);
+  if (!buf) return NULL;
+
+  RMUtilRoaring *r = RMUtil_NewRoaring();
+  const uint8_t *p = (const uint8_t *)buf, *end = p + len;
+  for (uint64_t i = 0; i < n; i++) {
+    roaringContainer c;
+    size_t read = roaring_LoadContainer(p, end - p, &c);
+    uint16_t key = read ? RMUtil_GetLE(p, 2) : 0;
+    if (!read || (r->n && key <= r->keys[r->n - 1])) {
+      if (read) container_Free(&c);
+      goto err;
+    }
+    roaring_Insert(r, r->n, key, c);
+    p += read;
+  }
+  if (p != end) goto err;
+  RedisModule_Free(buf);
+  return r;
+
+err:
+  RedisModule_Free(buf);
+  RMUtilRoaring_Free(r);
+  return NULL;
+}
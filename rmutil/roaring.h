@@ -0,0 +1,92 @@
+#ifndef RMUTIL_ROARING_H_
+#define RMUTIL_ROARING_H_
+#include <stddef.h>
+#include <stdint.h>
+#include <redismodule.h>
+
+/** roaring.h - A roaring bitmap of 32-bit IDs.
+ *
+ * An RMUtilRoaring holds a set of uint32_t IDs, split by their upper 16 bits into containers of up
+ * to 65536 IDs. Each container takes the cheapest of three forms:
+ *
+ *   - an array: the sorted lower 16 bits of its IDs, 2 bytes per ID, up to 4096 IDs
+ *   - a bitmap: 65536 bits, 8KB, for containers of more than 4096 IDs
+ *   - runs: ranges of consecutive IDs, 4 bytes per range
+ *
+ * Adding and removing IDs switches between arrays and bitmaps as containers fill up and empty.
+ * Runs are made by RMUtilRoaring_AddRange, and by RMUtilRoaring_RunOptimize for the containers
+ * they hold in less memory, and are updated in place.
+ *
+ *   RMUtilRoaring *r = RMUtil_NewRoaring();
+ *   RMUtilRoaring_Add(r, 42);
+ *   RMUtilRoaring *both = RMUtilRoaring_And(r, other);
+ *
+ *   RMUtilRoaringIterator it;
+ *   RMUtilRoaring_Iterate(both, &it);
+ *   uint32_t id;
+ *   while (RMUtilRoaringIterator_Next(&it, &id)) { ... }
+ */
+
+typedef struct RMUtilRoaring RMUtilRoaring;
+
+/* An iterator over a bitmap, see RMUtilRoaring_Iterate. The bitmap must not change while
+ * iterating */
+typedef struct {
+  const RMUtilRoaring *r;
+  size_t container;
+  // the array index, bitmap word or run in the container, and the bits of the word left or the
+  // offset in the run
+  uint32_t pos;
+  uint64_t word;
+} RMUtilRoaringIterator;
+
+RMUtilRoaring *RMUtil_NewRoaring(void);
+void RMUtilRoaring_Free(RMUtilRoaring *r);
+
+/* Add an ID, returning 1 if it was not in the bitmap */
+int RMUtilRoaring_Add(RMUtilRoaring *r, uint32_t id);
+
+/* Add the IDs from `start` to `end`, both included. Nothing is added if `start` > `end` */
+void RMUtilRoaring_AddRange(RMUtilRoaring *r, uint32_t start, uint32_t end);
+
+/* Remove an ID, returning 1 if it was in the bitmap */
+int RMUtilRoaring_Remove(RMUtilRoaring *r, uint32_t id);
+
+int RMUtilRoaring_Contains(const RMUtilRoaring *r, uint32_t id);
+
+/* The number of IDs in the bitmap */
+uint64_t RMUtilRoaring_Cardinality(const RMUtilRoaring *r);
+
+/* The number of IDs lower than or equal to `id` */
+uint64_t RMUtilRoaring_Rank(const RMUtilRoaring *r, uint32_t id);
+
+/* Get the ID of the given rank, starting at 0. Returns 0 if the bitmap holds fewer IDs */
+int RMUtilRoaring_Select(const RMUtilRoaring *r, uint64_t rank, uint32_t *id);
+
+/* Create new bitmaps from two bitmaps: the IDs in both, in either, in only one, and in the first
+ * but not the second */
+RMUtilRoaring *RMUtilRoaring_And(const RMUtilRoaring *a, const RMUtilRoaring *b);
+RMUtilRoaring *RMUtilRoaring_Or(const RMUtilRoaring *a, const RMUtilRoaring *b);
+RMUtilRoaring *RMUtilRoaring_Xor(const RMUtilRoaring *a, const RMUtilRoaring *b);
+RMUtilRoaring *RMUtilRoaring_AndNot(const RMUtilRoaring *a, const RMUtilRoaring *b);
+
+/* Convert the containers holding long ranges of IDs to runs where it saves memory, and back */
+void RMUtilRoaring_RunOptimize(RMUtilRoaring *r);
+
+/* The memory used by the bitmap, in bytes */
+size_t RMUtilRoaring_MemUsage(const RMUtilRoaring *r);
+
+/* Start iterating the bitmap in ascending order */
+void RMUtilRoaring_Iterate(const RMUtilRoaring *r, RMUtilRoaringIterator *it);
+
+/* Get the next ID. Returns 0 at the end of the bitmap */
+int RMUtilRoaringIterator_Next(RMUtilRoaringIterator *it, uint32_t *id);
+
+/* Save a bitmap to an RDB file, e.g. from a type's rdb_save callback, as its number of containers
+ * and a string buffer holding them in little endian */
+void RMUtilRoaring_Save(RedisModuleIO *io, const RMUtilRoaring *r);
+
+/* Load a bitmap saved with RMUtilRoaring_Save. Returns NULL if the data is not a valid bitmap */
+RMUtilRoaring *RMUtilRoaring_Load(RedisModuleIO *io);
+
+#endif
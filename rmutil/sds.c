@@ -35,8 +35,15 @@
 #include <string.h>
 #include <ctype.h>
 #include <assert.h>
+#include <errno.h>
+#include <float.h>
+#include <limits.h>
+#include <math.h>
 #include "sds.h"
 #include "sdsalloc.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 static inline int sdsHdrSize(char type) {
     switch(type&SDS_TYPE_MASK) {
@@ -54,16 +61,23 @@ static inline int sdsHdrSize(char type) {
     return 0;
 }
 
+/* Return the smallest header type able to hold a string of 'string_size'
+ * bytes. The limits are inclusive: a type 8 header holds lengths up to 255,
+ * and so on. Type 64 is only used where size_t is 64 bits wide. */
 static inline char sdsReqType(size_t string_size) {
-    if (string_size < 32)
+    if (string_size < 1<<5)
         return SDS_TYPE_5;
-    if (string_size < 0xff)
+    if (string_size < 1<<8)
         return SDS_TYPE_8;
-    if (string_size < 0xffff)
+    if (string_size < 1<<16)
         return SDS_TYPE_16;
-    if (string_size < 0xffffffff)
+#if (LONG_MAX == LLONG_MAX)
+    if (string_size < 1ll<<32)
         return SDS_TYPE_32;
     return SDS_TYPE_64;
+#else
+    return SDS_TYPE_32;
+#endif
 }
 
 /* Create a new sds string with the content specified by the 'init' pointer
@@ -88,10 +102,11 @@ sds sdsnewlen(const void *init, size_t initlen) {
     int hdrlen = sdsHdrSize(type);
     unsigned char *fp; /* flags pointer. */
 
+    assert(hdrlen+initlen+1 > initlen); /* Catch size_t overflow */
     sh = s_malloc(hdrlen+initlen+1);
+    if (sh == NULL) return NULL;
     if (!init)
         memset(sh, 0, hdrlen+initlen+1);
-    if (sh == NULL) return NULL;
     s = (char*)sh+hdrlen;
     fp = ((unsigned char*)s)-1;
     switch(type) {
@@ -204,6 +219,7 @@ sds sdsMakeRoomFor(sds s, size_t addlen) {
     len = sdslen(s);
     sh = (char*)s-sdsHdrSize(oldtype);
     newlen = (len+addlen);
+    assert(newlen > len); /* Catch size_t overflow */
     if (newlen < SDS_MAX_PREALLOC)
         newlen *= 2;
     else
@@ -217,6 +233,7 @@ sds sdsMakeRoomFor(sds s, size_t addlen) {
     if (type == SDS_TYPE_5) type = SDS_TYPE_8;
 
     hdrlen = sdsHdrSize(type);
+    assert(hdrlen+newlen+1 > len+addlen); /* Catch size_t overflow */
     if (oldtype==type) {
         newsh = s_realloc(sh, hdrlen+newlen+1);
         if (newsh == NULL) return NULL;
@@ -245,16 +262,23 @@ sds sdsMakeRoomFor(sds s, size_t addlen) {
 sds sdsRemoveFreeSpace(sds s) {
     void *sh, *newsh;
     char type, oldtype = s[-1] & SDS_TYPE_MASK;
-    int hdrlen;
+    int hdrlen, oldhdrlen = sdsHdrSize(oldtype);
     size_t len = sdslen(s);
-    sh = (char*)s-sdsHdrSize(oldtype);
+    size_t avail = sdsavail(s);
+    sh = (char*)s-oldhdrlen;
+
+    /* Return ASAP if there is no space left. */
+    if (avail == 0) return s;
 
     type = sdsReqType(len);
     hdrlen = sdsHdrSize(type);
-    if (oldtype==type) {
-        newsh = s_realloc(sh, hdrlen+len+1);
+    /* If the type is the same, or a large header is needed anyway, just
+     * realloc(), letting the allocator shrink the block in place. Moving
+     * the string is only worth it to save most of the header. */
+    if (oldtype==type || type > SDS_TYPE_8) {
+        newsh = s_realloc(sh, oldhdrlen+len+1);
         if (newsh == NULL) return NULL;
-        s = (char*)newsh+hdrlen;
+        s = (char*)newsh+oldhdrlen;
     } else {
         newsh = s_malloc(hdrlen+len+1);
         if (newsh == NULL) return NULL;
@@ -419,71 +443,65 @@ sds sdscpy(sds s, const char *t) {
     return sdscpylen(s, t, strlen(t));
 }
 
-/* Helper for sdscatlonglong() doing the actual number -> string
+/* Two digits at a time lookup table for the integer to string conversions.
+ * Emitting two digits per division halves the number of divisions. */
+static const char sdsDigitPairs[201] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+/* Return the number of decimal digits of 'v'. */
+static int sdsDigits10(unsigned long long v) {
+    int n = 1;
+    for (;;) {
+        if (v < 10) return n;
+        if (v < 100) return n+1;
+        if (v < 1000) return n+2;
+        if (v < 10000) return n+3;
+        v /= 10000U;
+        n += 4;
+    }
+}
+
+/* Helper for sdscatull() doing the actual number -> string
  * conversion. 's' must point to a string with room for at least
  * SDS_LLSTR_SIZE bytes.
  *
  * The function returns the length of the null-terminated string
- * representation stored at 's'. */
-#define SDS_LLSTR_SIZE 21
-int sdsll2str(char *s, long long value) {
-    char *p, aux;
-    unsigned long long v;
-    size_t l;
-
-    /* Generate the string representation, this method produces
-     * an reversed string. */
-    v = (value < 0) ? -value : value;
-    p = s;
-    do {
-        *p++ = '0'+(v%10);
-        v /= 10;
-    } while(v);
-    if (value < 0) *p++ = '-';
-
-    /* Compute length and add null term. */
-    l = p-s;
-    *p = '\0';
-
-    /* Reverse the string. */
-    p--;
-    while(s < p) {
-        aux = *s;
-        *s = *p;
-        *p = aux;
-        s++;
-        p--;
+ * representation stored at 's'. The digits are written from the end,
+ * once the length is known, so the string does not need reversing. */
+int sdsull2str(char *s, unsigned long long v) {
+    int l = sdsDigits10(v);
+    int next = l-1;
+
+    s[l] = '\0';
+    while (v >= 100) {
+        int i = (v % 100) * 2;
+        v /= 100;
+        s[next] = sdsDigitPairs[i+1];
+        s[next-1] = sdsDigitPairs[i];
+        next -= 2;
+    }
+    if (v < 10) {
+        s[next] = '0'+(char)v;
+    } else {
+        int i = (int)v*2;
+        s[next] = sdsDigitPairs[i+1];
+        s[next-1] = sdsDigitPairs[i];
     }
     return l;
 }
 
-/* Identical sdsll2str(), but for unsigned long long type. */
-int sdsull2str(char *s, unsigned long long v) {
-    char *p, aux;
-    size_t l;
-
-    /* Generate the string representation, this method produces
-     * an reversed string. */
-    p = s;
-    do {
-        *p++ = '0'+(v%10);
-        v /= 10;
-    } while(v);
-
-    /* Compute length and add null term. */
-    l = p-s;
-    *p = '\0';
-
-    /* Reverse the string. */
-    p--;
-    while(s < p) {
-        aux = *s;
-        *s = *p;
-        *p = aux;
-        s++;
-        p--;
+/* Identical sdsull2str(), but for long long type. */
+int sdsll2str(char *s, long long value) {
+    if (value < 0) {
+        /* Negate as unsigned, so that LLONG_MIN does not overflow. */
+        *s = '-';
+        return sdsull2str(s+1,-(unsigned long long)value)+1;
     }
-    return l;
+    return sdsull2str(s,value);
 }
 
 /* Create an sds string from a long long value. It is much faster than:
@@ -497,6 +515,424 @@ sds sdsfromlonglong(long long value) {
     return sdsnewlen(buf,len);
 }
 
+/* Append the decimal representation of a long long to the sds string 's'.
+ * It is much faster than sdscatprintf(s,"%lld",value), and the digits are
+ * written in place, without a temporary buffer.
+ *
+ * After the call, the passed sds string is no longer valid and all the
+ * references must be substituted with the new pointer returned by the call. */
+sds sdscatll(sds s, long long value) {
+    size_t len;
+
+    s = sdsMakeRoomFor(s,SDS_LLSTR_SIZE);
+    if (s == NULL) return NULL;
+    len = sdslen(s);
+    sdssetlen(s, len+sdsll2str(s+len,value));
+    return s;
+}
+
+/* Like sdscatll() but for an unsigned long long. */
+sds sdscatull(sds s, unsigned long long value) {
+    size_t len;
+
+    s = sdsMakeRoomFor(s,SDS_LLSTR_SIZE);
+    if (s == NULL) return NULL;
+    len = sdslen(s);
+    sdssetlen(s, len+sdsull2str(s+len,value));
+    return s;
+}
+
+/* Double to string conversion, with the Grisu2 algorithm from Florian
+ * Loitsch's "Printing Floating-Point Numbers Quickly and Accurately with
+ * Integers" (2010). The digits produced always read back as the same double,
+ * and are the shortest such digits for all but about 0.1% of doubles, which
+ * get a digit or two more. Only 64 bit integer arithmetic is used.
+ *
+ * A double is handled as a "do it yourself" floating point number: a 64 bit
+ * significand 'f' and a binary exponent 'e', for a value of f * 2^e. */
+typedef struct {
+    uint64_t f;
+    int e;
+} sdsDiyFp;
+
+#define SDS_DP_SIGNIFICAND_MASK 0x000FFFFFFFFFFFFFULL
+#define SDS_DP_EXPONENT_MASK 0x7FF0000000000000ULL
+#define SDS_DP_HIDDEN_BIT 0x0010000000000000ULL
+#define SDS_DP_EXPONENT_BIAS (0x3FF + 52)
+
+/* The cached powers of ten, 10^-348 to 10^340 in steps of 8, as normalized
+ * significands and binary exponents. */
+static const uint64_t sdsCachedPowersF[] = {
+    0xfa8fd5a0081c0288ULL, 0xbaaee17fa23ebf76ULL, 0x8b16fb203055ac76ULL,
+    0xcf42894a5dce35eaULL, 0x9a6bb0aa55653b2dULL, 0xe61acf033d1a45dfULL,
+    0xab70fe17c79ac6caULL, 0xff77b1fcbebcdc4fULL, 0xbe5691ef416bd60cULL,
+    0x8dd01fad907ffc3cULL, 0xd3515c2831559a83ULL, 0x9d71ac8fada6c9b5ULL,
+    0xea9c227723ee8bcbULL, 0xaecc49914078536dULL, 0x823c12795db6ce57ULL,
+    0xc21094364dfb5637ULL, 0x9096ea6f3848984fULL, 0xd77485cb25823ac7ULL,
+    0xa086cfcd97bf97f4ULL, 0xef340a98172aace5ULL, 0xb23867fb2a35b28eULL,
+    0x84c8d4dfd2c63f3bULL, 0xc5dd44271ad3cdbaULL, 0x936b9fcebb25c996ULL,
+    0xdbac6c247d62a584ULL, 0xa3ab66580d5fdaf6ULL, 0xf3e2f893dec3f126ULL,
+    0xb5b5ada8aaff80b8ULL, 0x87625f056c7c4a8bULL, 0xc9bcff6034c13053ULL,
+    0x964e858c91ba2655ULL, 0xdff9772470297ebdULL, 0xa6dfbd9fb8e5b88fULL,
+    0xf8a95fcf88747d94ULL, 0xb94470938fa89bcfULL, 0x8a08f0f8bf0f156bULL,
+    0xcdb02555653131b6ULL, 0x993fe2c6d07b7facULL, 0xe45c10c42a2b3b06ULL,
+    0xaa242499697392d3ULL, 0xfd87b5f28300ca0eULL, 0xbce5086492111aebULL,
+    0x8cbccc096f5088ccULL, 0xd1b71758e219652cULL, 0x9c40000000000000ULL,
+    0xe8d4a51000000000ULL, 0xad78ebc5ac620000ULL, 0x813f3978f8940984ULL,
+    0xc097ce7bc90715b3ULL, 0x8f7e32ce7bea5c70ULL, 0xd5d238a4abe98068ULL,
+    0x9f4f2726179a2245ULL, 0xed63a231d4c4fb27ULL, 0xb0de65388cc8ada8ULL,
+    0x83c7088e1aab65dbULL, 0xc45d1df942711d9aULL, 0x924d692ca61be758ULL,
+    0xda01ee641a708deaULL, 0xa26da3999aef774aULL, 0xf209787bb47d6b85ULL,
+    0xb454e4a179dd1877ULL, 0x865b86925b9bc5c2ULL, 0xc83553c5c8965d3dULL,
+    0x952ab45cfa97a0b3ULL, 0xde469fbd99a05fe3ULL, 0xa59bc234db398c25ULL,
+    0xf6c69a72a3989f5cULL, 0xb7dcbf5354e9beceULL, 0x88fcf317f22241e2ULL,
+    0xcc20ce9bd35c78a5ULL, 0x98165af37b2153dfULL, 0xe2a0b5dc971f303aULL,
+    0xa8d9d1535ce3b396ULL, 0xfb9b7cd9a4a7443cULL, 0xbb764c4ca7a44410ULL,
+    0x8bab8eefb6409c1aULL, 0xd01fef10a657842cULL, 0x9b10a4e5e9913129ULL,
+    0xe7109bfba19c0c9dULL, 0xac2820d9623bf429ULL, 0x80444b5e7aa7cf85ULL,
+    0xbf21e44003acdd2dULL, 0x8e679c2f5e44ff8fULL, 0xd433179d9c8cb841ULL,
+    0x9e19db92b4e31ba9ULL, 0xeb96bf6ebadf77d9ULL, 0xaf87023b9bf0ee6bULL,
+};
+static const int16_t sdsCachedPowersE[] = {
+    -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980,
+    -954, -927, -901, -874, -847, -821, -794, -768, -741, -715,
+    -688, -661, -635, -608, -582, -555, -529, -502, -475, -449,
+    -422, -396, -369, -343, -316, -289, -263, -236, -210, -183,
+    -157, -130, -103, -77, -50, -24, 3, 30, 56, 83,
+    109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+    375, 402, 428, 455, 481, 508, 534, 561, 588, 614,
+    641, 667, 694, 720, 747, 774, 800, 827, 853, 880,
+    907, 933, 960, 986, 1013, 1039, 1066,
+};
+
+static const uint32_t sdsPow10U32[] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+/* Multiply two diy floats, rounding the lower 64 bits of the product. */
+static sdsDiyFp sdsDiyFpMul(sdsDiyFp x, sdsDiyFp y) {
+    const uint64_t M32 = 0xFFFFFFFFULL;
+    uint64_t a = x.f >> 32, b = x.f & M32, c = y.f >> 32, d = y.f & M32;
+    uint64_t ac = a*c, bc = b*c, ad = a*d, bd = b*d;
+    uint64_t tmp = (bd >> 32) + (ad & M32) + (bc & M32) + (1ULL << 31);
+    sdsDiyFp r = {ac + (ad >> 32) + (bc >> 32) + (tmp >> 32), x.e + y.e + 64};
+    return r;
+}
+
+static sdsDiyFp sdsDiyFpNormalize(sdsDiyFp x) {
+    int shift = __builtin_clzll(x.f);
+    x.f <<= shift;
+    x.e -= shift;
+    return x;
+}
+
+/* Write the digits of the positive finite double 'value' to 'digits', and
+ * return their number. The value is digits * 10^(*K). */
+static int sdsGrisu2(uint64_t bits, char *digits, int *K) {
+    sdsDiyFp v, plus, minus, c, w, wp, wm, one;
+    int biased = (bits & SDS_DP_EXPONENT_MASK) >> 52;
+    uint64_t delta, p2, wpw;
+    uint32_t p1;
+    int kappa, len = 0;
+
+    if (biased) {
+        v.f = (bits & SDS_DP_SIGNIFICAND_MASK) + SDS_DP_HIDDEN_BIT;
+        v.e = biased - SDS_DP_EXPONENT_BIAS;
+    } else {
+        v.f = bits & SDS_DP_SIGNIFICAND_MASK;
+        v.e = 1 - SDS_DP_EXPONENT_BIAS;
+    }
+
+    /* The boundaries of the interval of numbers rounding to 'value', with
+     * the same exponent as the normalized upper one. */
+    plus.f = (v.f << 1) + 1;
+    plus.e = v.e - 1;
+    plus = sdsDiyFpNormalize(plus);
+    if (v.f == SDS_DP_HIDDEN_BIT) {
+        minus.f = (v.f << 2) - 1;
+        minus.e = v.e - 2;
+    } else {
+        minus.f = (v.f << 1) - 1;
+        minus.e = v.e - 1;
+    }
+    minus.f <<= minus.e - plus.e;
+    minus.e = plus.e;
+
+    /* Scale by the cached power of ten bringing the exponent of the upper
+     * boundary in the range [-60, -32]. */
+    {
+        double dk = (-61 - plus.e) * 0.30102999566398114 + 347;
+        int k = (int)dk;
+        if (dk - k > 0.0) k++;
+        unsigned index = (k >> 3) + 1;
+        *K = -(-348 + (int)(index << 3));
+        c.f = sdsCachedPowersF[index];
+        c.e = sdsCachedPowersE[index];
+    }
+    w = sdsDiyFpMul(sdsDiyFpNormalize(v), c);
+    wp = sdsDiyFpMul(plus, c);
+    wm = sdsDiyFpMul(minus, c);
+    /* Shrink the interval by the error of the multiplications, so that any
+     * number in it is guaranteed to read back as 'value'. */
+    wm.f++;
+    wp.f--;
+    delta = wp.f - wm.f;
+    wpw = wp.f - w.f;
+
+    /* Generate the digits of the upper boundary until the rest is within
+     * the interval: first the integral part 'p1', then the fraction 'p2'. */
+    one.e = wp.e;
+    one.f = 1ULL << -one.e;
+    p1 = (uint32_t)(wp.f >> -one.e);
+    p2 = wp.f & (one.f - 1);
+    kappa = 1;
+    while (kappa < 10 && p1 >= sdsPow10U32[kappa]) kappa++;
+
+    uint64_t rest, unit;
+    for (;;) {
+        if (kappa > 0) {
+            uint32_t d = p1 / sdsPow10U32[kappa-1];
+            p1 %= sdsPow10U32[kappa-1];
+            if (d || len) digits[len++] = '0'+d;
+            kappa--;
+            rest = ((uint64_t)p1 << -one.e) + p2;
+            if (rest <= delta) {
+                unit = (uint64_t)sdsPow10U32[kappa] << -one.e;
+                break;
+            }
+        } else {
+            p2 *= 10;
+            delta *= 10;
+            char d = (char)(p2 >> -one.e);
+            if (d || len) digits[len++] = '0'+d;
+            p2 &= one.f - 1;
+            kappa--;
+            if (p2 < delta) {
+                rest = p2;
+                unit = one.f;
+                wpw *= sdsPow10U32[-kappa];
+                break;
+            }
+        }
+    }
+    *K += kappa;
+
+    /* Round the last digit down towards 'value' as long as the result stays
+     * in the interval and gets closer. */
+    while (rest < wpw && delta - rest >= unit &&
+           (rest + unit < wpw || wpw - rest > rest + unit - wpw)) {
+        digits[len-1]--;
+        rest += unit;
+    }
+    return len;
+}
+
+/* Convert a double to the shortest string that reads back as the same
+ * double. 's' must have room for at least SDS_DOUBLESTR_SIZE bytes.
+ *
+ * The format follows printf's "%.17g": plain decimal notation when the
+ * decimal exponent is in [-4, 17), exponential notation otherwise, e.g.
+ * "0.1", "-1234.5", "1e+21" and "5e-324". Infinities and NaN are written as
+ * "inf", "-inf" and "nan".
+ *
+ * The function returns the length of the null-terminated string
+ * representation stored at 's'. */
+int sdsd2str(char *s, double value) {
+    char digits[20], *p = s;
+    uint64_t bits;
+    int len, K, exp10, i;
+
+    memcpy(&bits,&value,sizeof(bits));
+    if ((bits & SDS_DP_EXPONENT_MASK) == SDS_DP_EXPONENT_MASK) {
+        if (bits & SDS_DP_SIGNIFICAND_MASK) {
+            memcpy(s,"nan",4);
+            return 3;
+        }
+        if (bits >> 63) *p++ = '-';
+        memcpy(p,"inf",4);
+        return p-s+3;
+    }
+    if (bits >> 63) *p++ = '-';
+    bits &= ~(1ULL << 63);
+    if (bits == 0) {
+        memcpy(p,"0",2);
+        return p-s+1;
+    }
+
+    len = sdsGrisu2(bits,digits,&K);
+    exp10 = len + K - 1;
+
+    if (exp10 >= -4 && exp10 < 17) {
+        if (K >= 0) {
+            /* An integer: the digits followed by K zeros. */
+            memcpy(p,digits,len);
+            p += len;
+            for (i = 0; i < K; i++) *p++ = '0';
+        } else if (exp10 >= 0) {
+            memcpy(p,digits,exp10+1);
+            p += exp10+1;
+            *p++ = '.';
+            memcpy(p,digits+exp10+1,len-exp10-1);
+            p += len-exp10-1;
+        } else {
+            *p++ = '0';
+            *p++ = '.';
+            for (i = 0; i < -exp10-1; i++) *p++ = '0';
+            memcpy(p,digits,len);
+            p += len;
+        }
+    } else {
+        *p++ = digits[0];
+        if (len > 1) {
+            *p++ = '.';
+            memcpy(p,digits+1,len-1);
+            p += len-1;
+        }
+        *p++ = 'e';
+        *p++ = exp10 < 0 ? '-' : '+';
+        if (exp10 < 0) exp10 = -exp10;
+        if (exp10 < 10) *p++ = '0';
+        p += sdsull2str(p,exp10);
+    }
+    *p = '\0';
+    return p-s;
+}
+
+/* Append the shortest representation of a double that reads back as the
+ * same double to the sds string 's', see sdsd2str(). It is much faster than
+ * sdscatprintf(s,"%.17g",value), which also often produces more digits than
+ * needed, e.g. "0.10000000000000001" for 0.1.
+ *
+ * After the call, the passed sds string is no longer valid and all the
+ * references must be substituted with the new pointer returned by the call. */
+sds sdscatdouble(sds s, double value) {
+    size_t len;
+
+    s = sdsMakeRoomFor(s,SDS_DOUBLESTR_SIZE);
+    if (s == NULL) return NULL;
+    len = sdslen(s);
+    sdssetlen(s, len+sdsd2str(s+len,value));
+    return s;
+}
+
+/* Parse the sds string 's' as a long long. Only the canonical representation
+ * of a number is accepted, as Redis does: an optional minus sign and digits,
+ * without leading zeros, spaces or a plus sign.
+ *
+ * On success 1 is returned and the number is stored at 'value', otherwise 0
+ * is returned and 'value' is left untouched. */
+int sdstoll(const sds s, long long *value) {
+    const char *p = s, *end = s+sdslen(s);
+    unsigned long long v = 0;
+    int negative = 0;
+
+    if (p == end || end-p > 20) return 0;
+    if (end-p == 1 && p[0] == '0') {
+        *value = 0;
+        return 1;
+    }
+    if (*p == '-') {
+        negative = 1;
+        p++;
+    }
+    if (p == end || *p < '1' || *p > '9') return 0;
+
+    for (; p < end; p++) {
+        unsigned d = *p - '0';
+        if (d > 9) return 0;
+        if (v > (ULLONG_MAX - d) / 10) return 0;
+        v = v*10 + d;
+    }
+
+    if (negative) {
+        if (v > (unsigned long long)LLONG_MAX + 1) return 0;
+        *value = v == (unsigned long long)LLONG_MAX + 1 ? LLONG_MIN : -(long long)v;
+    } else {
+        if (v > LLONG_MAX) return 0;
+        *value = v;
+    }
+    return 1;
+}
+
+/* The powers of ten that are exactly representable as doubles. */
+static const double sdsPow10Exact[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/* Parse the sds string 's' as a double, with the same rules as Redis: what
+ * strtod() accepts, without leading spaces, trailing characters or NaN, and
+ * failing on overflow and underflow.
+ *
+ * Decimal numbers whose significand fits in 53 bits and with a decimal
+ * exponent within 22 of it, which covers the vast majority of the numbers
+ * found in practice, are converted with a single exact multiplication or
+ * division (Clinger's fast path). Other numbers go through strtod().
+ *
+ * On success 1 is returned and the number is stored at 'value', otherwise 0
+ * is returned and 'value' is left untouched. */
+int sdstod(const sds s, double *value) {
+    const char *p = s, *end = s+sdslen(s);
+    char *eptr;
+    double d;
+
+    if (p == end || isspace((unsigned char)*p)) return 0;
+
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+    {
+        uint64_t m = 0;
+        int negative = 0, ndigits = 0, nsig = 0, exp10 = 0, e = 0, eneg = 0;
+
+        if (*p == '-' || *p == '+') negative = *p++ == '-';
+        for (; p < end && isdigit((unsigned char)*p); p++, ndigits++) {
+            if (m == 0 && *p == '0') continue;
+            if (++nsig > 19) goto slow;
+            m = m*10 + (*p - '0');
+        }
+        if (p < end && *p == '.') {
+            for (p++; p < end && isdigit((unsigned char)*p); p++, ndigits++) {
+                exp10--;
+                if (m == 0 && *p == '0') continue;
+                if (++nsig > 19) goto slow;
+                m = m*10 + (*p - '0');
+            }
+        }
+        if (ndigits == 0) goto slow;
+        if (p < end && (*p == 'e' || *p == 'E')) {
+            p++;
+            if (p < end && (*p == '-' || *p == '+')) eneg = *p++ == '-';
+            if (p == end || !isdigit((unsigned char)*p)) goto slow;
+            for (; p < end && isdigit((unsigned char)*p); p++) {
+                if (e > 10000) goto slow;
+                e = e*10 + (*p - '0');
+            }
+            exp10 += eneg ? -e : e;
+        }
+        if (p != end || m > (1ULL << 53)) goto slow;
+
+        if (m == 0) {
+            d = 0;
+        } else if (exp10 < -22 || exp10 > 22) {
+            goto slow;
+        } else if (exp10 < 0) {
+            d = (double)m / sdsPow10Exact[-exp10];
+        } else {
+            d = (double)m * sdsPow10Exact[exp10];
+        }
+        *value = negative ? -d : d;
+        return 1;
+    }
+slow:
+#endif
+    errno = 0;
+    d = strtod(s,&eptr);
+    if (eptr != end || isnan(d) ||
+        (errno == ERANGE && (d == HUGE_VAL || d == -HUGE_VAL || d == 0)))
+        return 0;
+    *value = d;
+    return 1;
+}
+
 /* Like sdscatprintf() but gets va_list instead of being variadic. */
 sds sdscatvprintf(sds s, const char *fmt, va_list ap) {
     va_list cpy;
@@ -849,6 +1285,92 @@ void sdsfreesplitres(sds *tokens, int count) {
     s_free(tokens);
 }
 
+/* Split 's' like sdssplitlen(), but instead of allocating a string for every
+ * token, store the offset and length of the tokens in the 'spans' array
+ * provided by the caller, so nothing is allocated or copied.
+ *
+ * The input is processed in batches of up to 'maxspans' tokens. The scan
+ * starts at offset *pos, 0 for the first call, and *pos is updated so that
+ * the next call continues with the next token. Once the last token has been
+ * stored *pos is set past 'len', e.g:
+ *
+ *   sdsspan spans[64];
+ *   size_t pos = 0, n;
+ *   while (pos <= len) {
+ *       n = sdssplitspans(s,len,",",1,spans,64,&pos);
+ *       for (size_t i = 0; i < n; i++) use(s+spans[i].start,spans[i].len);
+ *   }
+ *
+ * Single byte separators are found 16 bytes at a time with SSE2 when it is
+ * available, and with memchr() otherwise. Longer separators are found with
+ * memchr() on their first byte.
+ *
+ * The function returns the number of spans stored. As with sdssplitlen(),
+ * an empty string has no tokens, and 0 is returned with a zero length
+ * separator or maxspans. */
+size_t sdssplitspans(const char *s, size_t len, const char *sep, size_t seplen,
+                     sdsspan *spans, size_t maxspans, size_t *pos) {
+    size_t start = *pos, j = *pos, n = 0;
+    const char *p;
+
+    if (seplen == 0 || maxspans == 0 || start > len) return 0;
+    if (len == 0) {
+        *pos = 1;
+        return 0;
+    }
+
+/* Store the token ending at 'end' and start the next one after the
+ * separator, returning if the batch is full. */
+#define SDS_SPAN_EMIT(end) do { \
+    spans[n].start = start; \
+    spans[n].len = (end)-start; \
+    n++; \
+    start = (end)+seplen; \
+    if (n == maxspans) { \
+        *pos = start; \
+        return n; \
+    } \
+} while(0)
+
+    if (seplen == 1) {
+#ifdef __SSE2__
+        __m128i vsep = _mm_set1_epi8(sep[0]);
+        for (; j+16 <= len; j += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(s+j));
+            unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v,vsep));
+            while (mask) {
+                SDS_SPAN_EMIT(j+__builtin_ctz(mask));
+                mask &= mask-1;
+            }
+        }
+#endif
+        while ((p = memchr(s+j,sep[0],len-j)) != NULL) {
+            j = p-s;
+            SDS_SPAN_EMIT(j);
+            j++;
+        }
+    } else {
+        while (j+seplen <= len &&
+               (p = memchr(s+j,sep[0],len-j-seplen+1)) != NULL) {
+            j = p-s;
+            if (memcmp(p,sep,seplen) == 0) {
+                SDS_SPAN_EMIT(j);
+                j += seplen;
+            } else {
+                j++;
+            }
+        }
+    }
+#undef SDS_SPAN_EMIT
+
+    /* Add the final token. There is room for it, as the batch is not full. */
+    spans[n].start = start;
+    spans[n].len = len-start;
+    n++;
+    *pos = len+1;
+    return n;
+}
+
 /* Append to the sds string "s" an escaped string representation where
  * all the non-printable characters (tested with isprint()) are turned into
  * escapes in the form "\n\r\a...." or "\x<hex-number>".
@@ -1040,6 +1562,108 @@ err:
     return NULL;
 }
 
+/* Split a line into arguments like sdssplitargs(), but without allocating:
+ * the unquoted and unescaped arguments are written one after the other to
+ * 'out', and their offsets and lengths in 'out' are stored in 'spans'.
+ *
+ * 'out' must have room for 'len' bytes, as arguments never get longer than
+ * they are in the line. It may be the line itself to unescape in place. At
+ * most (len+1)/2 arguments fit in a line, so that many spans are always
+ * enough. The line is binary safe: it ends after 'len' bytes, and null
+ * bytes are part of the arguments.
+ *
+ * The function returns the number of arguments, or -1 if the line contains
+ * unbalanced quotes or closed quotes followed by non space characters, or
+ * if it has more than 'maxspans' arguments. */
+int sdssplitargsspans(const char *line, size_t len, char *out, sdsspan *spans, int maxspans) {
+    const char *p = line, *end = line+len;
+    char *o = out;
+    int argc = 0;
+
+    while(1) {
+        /* skip blanks */
+        while(p < end && isspace((unsigned char)*p)) p++;
+        if (p == end) return argc;
+        if (argc == maxspans) return -1;
+
+        /* get a token */
+        int inq=0;  /* set to 1 if we are in "quotes" */
+        int insq=0; /* set to 1 if we are in 'single quotes' */
+        int done=0;
+
+        spans[argc].start = o-out;
+        while(!done) {
+            /* the end of the line is handled as a null term would be */
+            int c = p < end ? (unsigned char)*p : -1;
+            if (inq) {
+                if (c == '\\' && end-p >= 4 && p[1] == 'x' &&
+                    is_hex_digit(p[2]) && is_hex_digit(p[3]))
+                {
+                    *o++ = (hex_digit_to_int(p[2])*16)+hex_digit_to_int(p[3]);
+                    p += 3;
+                } else if (c == '\\' && end-p >= 2) {
+                    p++;
+                    switch(*p) {
+                    case 'n': *o++ = '\n'; break;
+                    case 'r': *o++ = '\r'; break;
+                    case 't': *o++ = '\t'; break;
+                    case 'b': *o++ = '\b'; break;
+                    case 'a': *o++ = '\a'; break;
+                    default: *o++ = *p; break;
+                    }
+                } else if (c == '"') {
+                    /* closing quote must be followed by a space or
+                     * nothing at all. */
+                    if (p+1 < end && !isspace((unsigned char)p[1])) return -1;
+                    done=1;
+                } else if (c == -1) {
+                    /* unterminated quotes */
+                    return -1;
+                } else {
+                    *o++ = c;
+                }
+            } else if (insq) {
+                if (c == '\\' && end-p >= 2 && p[1] == '\'') {
+                    p++;
+                    *o++ = '\'';
+                } else if (c == '\'') {
+                    /* closing quote must be followed by a space or
+                     * nothing at all. */
+                    if (p+1 < end && !isspace((unsigned char)p[1])) return -1;
+                    done=1;
+                } else if (c == -1) {
+                    /* unterminated quotes */
+                    return -1;
+                } else {
+                    *o++ = c;
+                }
+            } else {
+                switch(c) {
+                case ' ':
+                case '\n':
+                case '\r':
+                case '\t':
+                case -1:
+                    done=1;
+                    break;
+                case '"':
+                    inq=1;
+                    break;
+                case '\'':
+                    insq=1;
+                    break;
+                default:
+                    *o++ = c;
+                    break;
+                }
+            }
+            if (p < end) p++;
+        }
+        spans[argc].len = (o-out)-spans[argc].start;
+        argc++;
+    }
+}
+
 /* Modify the string substituting all the occurrences of the set of
  * characters specified in the 'from' string to the corresponding character
  * in the 'to' array.
@@ -245,8 +245,33 @@ void sdsfreesplitres(sds *tokens, int count);
 void sdstolower(sds s);
 void sdstoupper(sds s);
 sds sdsfromlonglong(long long value);
+/* Low level number to string conversions, writing to a buffer with room for
+ * at least SDS_LLSTR_SIZE / SDS_DOUBLESTR_SIZE bytes and returning the length
+ * of the null-terminated result. */
+#define SDS_LLSTR_SIZE 21
+#define SDS_DOUBLESTR_SIZE 32
+int sdsll2str(char *s, long long value);
+int sdsull2str(char *s, unsigned long long v);
+int sdsd2str(char *s, double value);
+
+sds sdscatll(sds s, long long value);
+sds sdscatull(sds s, unsigned long long value);
+sds sdscatdouble(sds s, double value);
+int sdstoll(const sds s, long long *value);
+int sdstod(const sds s, double *value);
 sds sdscatrepr(sds s, const char *p, size_t len);
 sds *sdssplitargs(const char *line, int *argc);
+
+/* A token found by the span splitting functions: 'len' bytes at offset
+ * 'start' of the buffer that was split. */
+typedef struct {
+    size_t start;
+    size_t len;
+} sdsspan;
+
+size_t sdssplitspans(const char *s, size_t len, const char *sep, size_t seplen,
+                     sdsspan *spans, size_t maxspans, size_t *pos);
+int sdssplitargsspans(const char *line, size_t len, char *out, sdsspan *spans, int maxspans);
 sds sdsmapchars(sds s, const char *from, const char *to, size_t setlen);
 sds sdsjoin(char **argv, int argc, char *sep);
 sds sdsjoinsds(sds *argv, int argc, const char *sep, size_t seplen);
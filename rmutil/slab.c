@@ -0,0 +1,419 @@
+#define REDISMODULE_EXPERIMENTAL_API
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "slab.h"
+#include "alloc.h"
+
+/* redismodule.h has RedisModule_DefragAlloc from the version where the type methods are at 4 */
+#if defined(REDISMODULE_TYPE_METHOD_VERSION) && REDISMODULE_TYPE_METHOD_VERSION >= 4
+#define RMUTIL_HAVE_DEFRAG 1
+#endif
+
+// A page of objects of a single size class. The objects follow the header
+typedef struct slabPage {
+  char *objs;
+  char *end;
+  uint32_t objSize;
+  uint32_t numObjs;
+
+  // maintained only while defragging
+  uint32_t live;
+  int evacuating;
+  void *freeList;
+} slabPage;
+
+typedef struct {
+  void *freeList;
+  // the remainder of the newest page, not carved into objects yet
+  char *bump;
+  char *bumpEnd;
+  slabPage *bumpPage;
+} slabClass;
+
+typedef struct {
+  void *objs[RMUTIL_SLAB_TCACHE_SIZE];
+  int n;
+} tcacheClass;
+
+typedef struct {
+  RMUtilSlab *slab;
+  tcacheClass classes[RMUTIL_SLAB_NUM_CLASSES];
+} slabThreadCache;
+
+struct RMUtilSlab {
+  int flags;
+  int defragging;
+  pthread_mutex_t lock;
+  pthread_key_t tcacheKey;
+
+  slabClass classes[RMUTIL_SLAB_NUM_CLASSES];
+
+  // all the pages, sorted by address to find the page of an object while defragging
+  slabPage **pages;
+  size_t numPages;
+  size_t capPages;
+
+  size_t liveObjects;
+  size_t liveBytes;
+  size_t largeBytes;
+};
+
+#define SLAB_HEADER_SIZE ((sizeof(slabPage) + 15) & ~(size_t)15)
+
+static inline int slab_Class(size_t size) {
+  return size ? (int)((size - 1) / RMUTIL_SLAB_QUANTUM) : 0;
+}
+
+static inline size_t slab_ClassSize(int c) {
+  return (size_t)(c + 1) * RMUTIL_SLAB_QUANTUM;
+}
+
+size_t RMUtilSlab_UsableSize(size_t size) {
+  return size <= RMUTIL_SLAB_MAX_SIZE ? slab_ClassSize(slab_Class(size)) : size;
+}
+
+static inline void slab_Lock(RMUtilSlab *s) {
+  if (s->flags & RMUTIL_SLAB_THREADSAFE) pthread_mutex_lock(&s->lock);
+}
+
+static inline void slab_Unlock(RMUtilSlab *s) {
+  if (s->flags & RMUTIL_SLAB_THREADSAFE) pthread_mutex_unlock(&s->lock);
+}
+
+// Find the page holding p by binary search. Returns NULL if p is not in any page
+static slabPage *slab_FindPage(RMUtilSlab *s, void *p) {
+  size_t lo = 0, hi = s->numPages;
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    if ((char *)s->pages[mid] <= (char *)p) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  if (lo == 0) return NULL;
+  slabPage *pg = s->pages[lo - 1];
+  return (char *)p < pg->end ? pg : NULL;
+}
+
+static slabPage *slab_NewPage(RMUtilSlab *s, int c) {
+  slabPage *pg = malloc(RMUTIL_SLAB_PAGE_SIZE);
+  memset(pg, 0, sizeof(*pg));
+  pg->objSize = slab_ClassSize(c);
+  pg->objs = (char *)pg + SLAB_HEADER_SIZE;
+  pg->numObjs = (RMUTIL_SLAB_PAGE_SIZE - SLAB_HEADER_SIZE) / pg->objSize;
+  pg->end = pg->objs + (size_t)pg->numObjs * pg->objSize;
+
+  if (s->numPages == s->capPages) {
+    s->capPages = s->capPages ? s->capPages * 2 : 16;
+    s->pages = realloc(s->pages, s->capPages * sizeof(slabPage *));
+  }
+  size_t i = s->numPages;
+  while (i > 0 && (char *)s->pages[i - 1] > (char *)pg) {
+    s->pages[i] = s->pages[i - 1];
+    i--;
+  }
+  s->pages[i] = pg;
+  s->numPages++;
+  return pg;
+}
+
+static void *slab_AllocLocked(RMUtilSlab *s, int c) {
+  slabClass *cls = &s->classes[c];
+  void *p = cls->freeList;
+  if (p) {
+    cls->freeList = *(void **)p;
+  } else {
+    if (cls->bump == cls->bumpEnd) {
+      slabPage *pg = slab_NewPage(s, c);
+      cls->bumpPage = pg;
+      cls->bump = pg->objs;
+      cls->bumpEnd = pg->end;
+    }
+    p = cls->bump;
+    cls->bump += slab_ClassSize(c);
+  }
+  s->liveObjects++;
+  s->liveBytes += slab_ClassSize(c);
+  if (s->defragging) {
+    slabPage *pg = slab_FindPage(s, p);
+    pg->live++;
+  }
+  return p;
+}
+
+static void slab_DeallocLocked(RMUtilSlab *s, void *p, int c) {
+  s->liveObjects--;
+  s->liveBytes -= slab_ClassSize(c);
+  if (s->defragging) {
+    // objects freed on pages being evacuated are kept aside
+    slabPage *pg = slab_FindPage(s, p);
+    pg->live--;
+    if (pg->evacuating) {
+      *(void **)p = pg->freeList;
+      pg->freeList = p;
+      return;
+    }
+  }
+  slabClass *cls = &s->classes[c];
+  *(void **)p = cls->freeList;
+  cls->freeList = p;
+}
+
+static void slab_FlushThreadCache(void *ptr) {
+  slabThreadCache *tc = ptr;
+  RMUtilSlab *s = tc->slab;
+  slab_Lock(s);
+  for (int c = 0; c < RMUTIL_SLAB_NUM_CLASSES; c++) {
+    tcacheClass *tcc = &tc->classes[c];
+    while (tcc->n > 0) {
+      slab_DeallocLocked(s, tcc->objs[--tcc->n], c);
+    }
+  }
+  slab_Unlock(s);
+  free(tc);
+}
+
+static slabThreadCache *slab_GetThreadCache(RMUtilSlab *s) {
+  slabThreadCache *tc = pthread_getspecific(s->tcacheKey);
+  if (!tc) {
+    tc = calloc(1, sizeof(*tc));
+    tc->slab = s;
+    pthread_setspecific(s->tcacheKey, tc);
+  }
+  return tc;
+}
+
+RMUtilSlab *RMUtil_NewSlab(int flags) {
+  RMUtilSlab *s = calloc(1, sizeof(*s));
+  if (flags & RMUTIL_SLAB_THREAD_CACHE) {
+    flags |= RMUTIL_SLAB_THREADSAFE;
+    pthread_key_create(&s->tcacheKey, slab_FlushThreadCache);
+  }
+  s->flags = flags;
+  pthread_mutex_init(&s->lock, NULL);
+  return s;
+}
+
+void *RMUtilSlab_Alloc(RMUtilSlab *s, size_t size) {
+  if (size > RMUTIL_SLAB_MAX_SIZE) {
+    slab_Lock(s);
+    s->largeBytes += size;
+    slab_Unlock(s);
+    return malloc(size);
+  }
+
+  int c = slab_Class(size);
+  if (s->flags & RMUTIL_SLAB_THREAD_CACHE) {
+    tcacheClass *tcc = &slab_GetThreadCache(s)->classes[c];
+    if (tcc->n == 0) {
+      // refill half of the cache
+      slab_Lock(s);
+      while (tcc->n < RMUTIL_SLAB_TCACHE_SIZE / 2) {
+        tcc->objs[tcc->n++] = slab_AllocLocked(s, c);
+      }
+      slab_Unlock(s);
+    }
+    return tcc->objs[--tcc->n];
+  }
+
+  slab_Lock(s);
+  void *p = slab_AllocLocked(s, c);
+  slab_Unlock(s);
+  return p;
+}
+
+void RMUtilSlab_Dealloc(RMUtilSlab *s, void *p, size_t size) {
+  if (!p) return;
+  if (size > RMUTIL_SLAB_MAX_SIZE) {
+    slab_Lock(s);
+    s->largeBytes -= size;
+    slab_Unlock(s);
+    free(p);
+    return;
+  }
+
+  int c = slab_Class(size);
+  if (s->flags & RMUTIL_SLAB_THREAD_CACHE) {
+    tcacheClass *tcc = &slab_GetThreadCache(s)->classes[c];
+    if (tcc->n == RMUTIL_SLAB_TCACHE_SIZE) {
+      // drain half of the cache
+      slab_Lock(s);
+      while (tcc->n > RMUTIL_SLAB_TCACHE_SIZE / 2) {
+        slab_DeallocLocked(s, tcc->objs[--tcc->n], c);
+      }
+      slab_Unlock(s);
+    }
+    tcc->objs[tcc->n++] = p;
+    return;
+  }
+
+  slab_Lock(s);
+  slab_DeallocLocked(s, p, c);
+  slab_Unlock(s);
+}
+
+void RMUtilSlab_GetStats(RMUtilSlab *s, RMUtilSlabStats *stats) {
+  slab_Lock(s);
+  stats->numPages = s->numPages;
+  stats->pageBytes = s->numPages * RMUTIL_SLAB_PAGE_SIZE;
+  stats->liveObjects = s->liveObjects;
+  stats->liveBytes = s->liveBytes;
+  stats->largeBytes = s->largeBytes;
+  slab_Unlock(s);
+}
+
+static int cmpLive(const void *a, const void *b) {
+  const slabPage *x = *(const slabPage **)a, *y = *(const slabPage **)b;
+  return (x->live > y->live) - (x->live < y->live);
+}
+
+void RMUtilSlab_DefragBegin(RMUtilSlab *s, double threshold) {
+  slab_Lock(s);
+  if (s->defragging) {
+    slab_Unlock(s);
+    return;
+  }
+  s->defragging = 1;
+
+  // count the live objects of every page: everything that's not free or still to be carved
+  for (size_t i = 0; i < s->numPages; i++) {
+    s->pages[i]->live = s->pages[i]->numObjs;
+    s->pages[i]->evacuating = 0;
+    s->pages[i]->freeList = NULL;
+  }
+  for (int c = 0; c < RMUTIL_SLAB_NUM_CLASSES; c++) {
+    slabClass *cls = &s->classes[c];
+    if (cls->bumpPage) {
+      cls->bumpPage->live -= (cls->bumpEnd - cls->bump) / cls->bumpPage->objSize;
+    }
+    for (void *p = cls->freeList; p; p = *(void **)p) {
+      slab_FindPage(s, p)->live--;
+    }
+  }
+
+  slabPage **byLive = malloc((s->numPages ? s->numPages : 1) * sizeof(slabPage *));
+  for (int c = 0; c < RMUTIL_SLAB_NUM_CLASSES; c++) {
+    slabClass *cls = &s->classes[c];
+    size_t n = 0;
+    // the free slots on the pages that are kept, less the objects to be moved there
+    long long freeSlots = 0;
+    for (size_t i = 0; i < s->numPages; i++) {
+      slabPage *pg = s->pages[i];
+      if (pg->objSize != slab_ClassSize(c)) continue;
+      byLive[n++] = pg;
+      freeSlots += pg->numObjs - pg->live;
+    }
+    if (n < 2) continue;
+
+    // evacuate the sparsest pages first, as long as the rest of the pages can take their objects
+    qsort(byLive, n, sizeof(slabPage *), cmpLive);
+    int any = 0;
+    for (size_t i = 0; i < n; i++) {
+      slabPage *pg = byLive[i];
+      long long pgFree = pg->numObjs - pg->live;
+      if (pg->live >= threshold * pg->numObjs || pg->live > freeSlots - pgFree) break;
+      pg->evacuating = 1;
+      freeSlots -= pgFree + pg->live;
+      any = 1;
+    }
+    if (!any) continue;
+
+    // move the free objects of evacuated pages aside, so they are not allocated again
+    void **link = &cls->freeList;
+    while (*link) {
+      void *p = *link;
+      slabPage *pg = slab_FindPage(s, p);
+      if (pg->evacuating) {
+        *link = *(void **)p;
+        *(void **)p = pg->freeList;
+        pg->freeList = p;
+      } else {
+        link = (void **)p;
+      }
+    }
+    if (cls->bumpPage && cls->bumpPage->evacuating) {
+      for (; cls->bump < cls->bumpEnd; cls->bump += cls->bumpPage->objSize) {
+        *(void **)cls->bump = cls->bumpPage->freeList;
+        cls->bumpPage->freeList = cls->bump;
+      }
+      cls->bump = cls->bumpEnd = NULL;
+      cls->bumpPage = NULL;
+    }
+  }
+  free(byLive);
+  slab_Unlock(s);
+}
+
+void *RMUtilSlab_DefragAlloc(RMUtilSlab *s, struct RedisModuleDefragCtx *ctx, void *p,
+                              size_t size) {
+  if (size > RMUTIL_SLAB_MAX_SIZE) {
+#ifdef RMUTIL_HAVE_DEFRAG
+    if (ctx && RedisModule_DefragAlloc) {
+      return RedisModule_DefragAlloc(ctx, p);
+    }
+#endif
+    return NULL;
+  }
+
+  slab_Lock(s);
+  slabPage *pg = s->defragging ? slab_FindPage(s, p) : NULL;
+  if (!pg || !pg->evacuating) {
+    slab_Unlock(s);
+    return NULL;
+  }
+  int c = slab_Class(size);
+  void *np = slab_AllocLocked(s, c);
+  memcpy(np, p, slab_ClassSize(c));
+  slab_DeallocLocked(s, p, c);
+  slab_Unlock(s);
+  return np;
+}
+
+size_t RMUtilSlab_DefragEnd(RMUtilSlab *s) {
+  slab_Lock(s);
+  size_t freed = 0, n = 0;
+  for (size_t i = 0; i < s->numPages; i++) {
+    slabPage *pg = s->pages[i];
+    if (pg->evacuating && pg->live == 0) {
+      free(pg);
+      freed++;
+      continue;
+    }
+    if (pg->evacuating) {
+      // objects that were not moved keep the page alive, so its free objects can be used again
+      slabClass *cls = &s->classes[slab_Class(pg->objSize)];
+      while (pg->freeList) {
+        void *p = pg->freeList;
+        pg->freeList = *(void **)p;
+        *(void **)p = cls->freeList;
+        cls->freeList = p;
+      }
+      pg->evacuating = 0;
+    }
+    s->pages[n++] = pg;
+  }
+  s->numPages = n;
+  s->defragging = 0;
+  slab_Unlock(s);
+  return freed;
+}
+
+void RMUtilSlab_Free(RMUtilSlab *s) {
+  if (s->flags & RMUTIL_SLAB_THREAD_CACHE) {
+    // only the calling thread's cache can be reached, the other threads' caches must be gone
+    slabThreadCache *tc = pthread_getspecific(s->tcacheKey);
+    if (tc) {
+      pthread_setspecific(s->tcacheKey, NULL);
+      free(tc);
+    }
+    pthread_key_delete(s->tcacheKey);
+  }
+  for (size_t i = 0; i < s->numPages; i++) {
+    free(s->pages[i]);
+  }
+  free(s->pages);
+  pthread_mutex_destroy(&s->lock);
+  free(s);
+}
@@ -0,0 +1,101 @@
+#ifndef RMUTIL_SLAB_H_
+#define RMUTIL_SLAB_H_
+#include <stddef.h>
+#include <redismodule.h>
+
+/** slab.h - A slab allocator for the small fixed size nodes of module data types.
+ *
+ * Objects up to RMUTIL_SLAB_MAX_SIZE bytes are rounded up to a multiple of RMUTIL_SLAB_QUANTUM and
+ * carved out of RMUTIL_SLAB_PAGE_SIZE pages holding objects of a single size class. Freed objects
+ * go on their class' free list, so allocating and freeing is a pointer swap, and nodes of the same
+ * type share pages instead of being spread over the allocator's arenas. Larger objects are passed
+ * through to malloc.
+ *
+ * Objects carry no header, so the size of an object must be given when freeing it, as when
+ * allocating it.
+ *
+ * Slabs can be compacted during active defrag: RMUtilSlab_DefragBegin picks sparse pages to be
+ * emptied, RMUtilSlab_DefragAlloc moves the objects off them as the module walks its data, and
+ * RMUtilSlab_DefragEnd frees the pages that were emptied, e.g:
+ *
+ *   int MyDefrag(RedisModuleDefragCtx *ctx) {
+ *     RMUtilSlab_DefragBegin(nodeSlab, 0.5);
+ *     for (each node pointer `n` in the module's data) {
+ *       Node *moved = RMUtilSlab_DefragAlloc(nodeSlab, ctx, n, sizeof(Node));
+ *       if (moved) n = moved;
+ *     }
+ *     RMUtilSlab_DefragEnd(nodeSlab);
+ *     return 0;
+ *   }
+ *
+ *   // in RedisModule_OnLoad:
+ *   RedisModule_RegisterDefragFunc(ctx, MyDefrag);
+ */
+
+#define RMUTIL_SLAB_QUANTUM 8
+#define RMUTIL_SLAB_MAX_SIZE 256
+#define RMUTIL_SLAB_NUM_CLASSES (RMUTIL_SLAB_MAX_SIZE / RMUTIL_SLAB_QUANTUM)
+#define RMUTIL_SLAB_PAGE_SIZE (64 * 1024)
+
+/* The number of objects per size class a thread cache holds before returning half of them */
+#define RMUTIL_SLAB_TCACHE_SIZE 64
+
+typedef enum {
+  // protect the slab with a lock so it can be used from several threads
+  RMUTIL_SLAB_THREADSAFE = 0x01,
+  // give each thread a cache of free objects, taking the lock only to refill or drain it. Implies
+  // RMUTIL_SLAB_THREADSAFE
+  RMUTIL_SLAB_THREAD_CACHE = 0x02,
+} RMUtilSlabFlags;
+
+typedef struct RMUtilSlab RMUtilSlab;
+
+// RedisModuleDefragCtx, when redismodule.h has it
+struct RedisModuleDefragCtx;
+
+typedef struct {
+  // pages allocated for small objects, and the memory they take
+  size_t numPages;
+  size_t pageBytes;
+  // objects handed out and not freed, including the ones in thread caches
+  size_t liveObjects;
+  size_t liveBytes;
+  // memory of the objects larger than RMUTIL_SLAB_MAX_SIZE
+  size_t largeBytes;
+} RMUtilSlabStats;
+
+/* Create a new slab allocator with a combination of RMUtilSlabFlags */
+RMUtilSlab *RMUtil_NewSlab(int flags);
+
+/* Allocate an object of `size` bytes */
+void *RMUtilSlab_Alloc(RMUtilSlab *s, size_t size);
+
+/* Free an object allocated with RMUtilSlab_Alloc for the same `size` */
+void RMUtilSlab_Dealloc(RMUtilSlab *s, void *p, size_t size);
+
+/* The memory an object of `size` bytes actually takes. Use it where RedisModule_MallocSize would be
+ * used for an object allocated with RedisModule_Alloc, e.g. in a type's mem_usage callback */
+size_t RMUtilSlab_UsableSize(size_t size);
+
+/* Get the slab's memory statistics */
+void RMUtilSlab_GetStats(RMUtilSlab *s, RMUtilSlabStats *stats);
+
+/* Start compacting the slab. Pages whose fraction of live objects is below `threshold` are marked
+ * for evacuation, as long as the other pages of their size class have room for their objects. No
+ * new objects are allocated on marked pages until RMUtilSlab_DefragEnd */
+void RMUtilSlab_DefragBegin(RMUtilSlab *s, double threshold);
+
+/* Move an object off a page marked for evacuation. Returns the new location of the object, or NULL
+ * if it was not moved, in which case `p` is still valid. Objects larger than RMUTIL_SLAB_MAX_SIZE
+ * are passed to RedisModule_DefragAlloc when it's available and `ctx` is not NULL */
+void *RMUtilSlab_DefragAlloc(RMUtilSlab *s, struct RedisModuleDefragCtx *ctx, void *p,
+                              size_t size);
+
+/* Finish compacting the slab, freeing the pages that were emptied. Returns the number of pages
+ * freed */
+size_t RMUtilSlab_DefragEnd(RMUtilSlab *s);
+
+/* Free the slab and all its pages. Objects larger than RMUTIL_SLAB_MAX_SIZE are not freed */
+void RMUtilSlab_Free(RMUtilSlab *s);
+
+#endif
@@ -0,0 +1,170 @@
+#include <stdio.h>
+#include <string.h>
+#include "smallstr.h"
+#include "alloc.h"
+
+_Static_assert(sizeof(RMUtilSmallStr) == RMUTIL_SMALLSTR_INLINE + 2,
+               "RMUtilSmallStr must fit the inline buffer and its length");
+
+void RMUtilSmallStr_Init(RMUtilSmallStr *s) {
+  s->in.buf[0] = '\0';
+  s->in.meta = 0;
+}
+
+int RMUtilSmallStr_InitLen(RMUtilSmallStr *s, const void *init, size_t len) {
+  RMUtilSmallStr_Init(s);
+  return RMUtilSmallStr_CatLen(s, init, len);
+}
+
+void RMUtilSmallStr_Free(RMUtilSmallStr *s) {
+  if (!RMUtilSmallStr_IsInline(s)) {
+    free(s->heap.ptr);
+  }
+  RMUtilSmallStr_Init(s);
+}
+
+void RMUtilSmallStr_Clear(RMUtilSmallStr *s) {
+  if (RMUtilSmallStr_IsInline(s)) {
+    s->in.meta = 0;
+    s->in.buf[0] = '\0';
+  } else {
+    s->heap.len = 0;
+    s->heap.ptr[0] = '\0';
+  }
+}
+
+int RMUtilSmallStr_MakeRoomFor(RMUtilSmallStr *s, size_t addlen) {
+  if (RMUtilSmallStr_Avail(s) >= addlen) return REDISMODULE_OK;
+
+  size_t len = RMUtilSmallStr_Len(s);
+  if (addlen > UINT32_MAX - len) return REDISMODULE_ERR;
+
+  // grow like sdsMakeRoomFor, doubling up to SDS_MAX_PREALLOC
+  size_t newlen = len + addlen;
+  if (newlen < SDS_MAX_PREALLOC) {
+    newlen *= 2;
+  } else {
+    newlen += SDS_MAX_PREALLOC;
+  }
+  if (newlen > UINT32_MAX) newlen = UINT32_MAX;
+
+  if (RMUtilSmallStr_IsInline(s)) {
+    char *ptr = malloc(newlen + 1);
+    memcpy(ptr, s->in.buf, len + 1);
+    s->heap.ptr = ptr;
+    s->heap.len = len;
+    s->in.meta = RMUTIL_SMALLSTR_HEAP;
+  } else {
+    s->heap.ptr = realloc(s->heap.ptr, newlen + 1);
+  }
+  s->heap.cap = newlen;
+  return REDISMODULE_OK;
+}
+
+void RMUtilSmallStr_IncrLen(RMUtilSmallStr *s, ssize_t incr) {
+  if (RMUtilSmallStr_IsInline(s)) {
+    s->in.meta += incr;
+    s->in.buf[s->in.meta] = '\0';
+  } else {
+    s->heap.len += incr;
+    s->heap.ptr[s->heap.len] = '\0';
+  }
+}
+
+int RMUtilSmallStr_RemoveFreeSpace(RMUtilSmallStr *s) {
+  if (RMUtilSmallStr_IsInline(s)) return REDISMODULE_OK;
+
+  char *ptr = s->heap.ptr;
+  size_t len = s->heap.len;
+  if (len <= RMUTIL_SMALLSTR_INLINE) {
+    memcpy(s->in.buf, ptr, len + 1);
+    s->in.meta = len;
+    free(ptr);
+  } else if (s->heap.cap > len) {
+    s->heap.ptr = realloc(ptr, len + 1);
+    s->heap.cap = len;
+  }
+  return REDISMODULE_OK;
+}
+
+size_t RMUtilSmallStr_AllocSize(const RMUtilSmallStr *s) {
+  return RMUtilSmallStr_IsInline(s) ? 0 : s->heap.cap + 1;
+}
+
+int RMUtilSmallStr_CatLen(RMUtilSmallStr *s, const void *t, size_t len) {
+  if (RMUtilSmallStr_MakeRoomFor(s, len) != REDISMODULE_OK) return REDISMODULE_ERR;
+  memcpy(RMUtilSmallStr_Data(s) + RMUtilSmallStr_Len(s), t, len);
+  RMUtilSmallStr_IncrLen(s, len);
+  return REDISMODULE_OK;
+}
+
+int RMUtilSmallStr_Cat(RMUtilSmallStr *s, const char *t) {
+  return RMUtilSmallStr_CatLen(s, t, strlen(t));
+}
+
+int RMUtilSmallStr_CatSds(RMUtilSmallStr *s, const sds t) {
+  return RMUtilSmallStr_CatLen(s, t, sdslen(t));
+}
+
+int RMUtilSmallStr_CatLongLong(RMUtilSmallStr *s, long long value) {
+  char buf[SDS_LLSTR_SIZE];
+  return RMUtilSmallStr_CatLen(s, buf, sdsll2str(buf, value));
+}
+
+int RMUtilSmallStr_CatDouble(RMUtilSmallStr *s, double value) {
+  char buf[SDS_DOUBLESTR_SIZE];
+  return RMUtilSmallStr_CatLen(s, buf, sdsd2str(buf, value));
+}
+
+int RMUtilSmallStr_CatVPrintf(RMUtilSmallStr *s, const char *fmt, va_list ap) {
+  va_list cpy;
+  size_t len = RMUtilSmallStr_Len(s);
+
+  // try formatting into the free space first, which is enough for short strings
+  va_copy(cpy, ap);
+  int n = vsnprintf(RMUtilSmallStr_Data(s) + len, RMUtilSmallStr_Avail(s) + 1, fmt, cpy);
+  va_end(cpy);
+  if (n < 0) {
+    RMUtilSmallStr_Data(s)[len] = '\0';
+    return REDISMODULE_ERR;
+  }
+  if ((size_t)n > RMUtilSmallStr_Avail(s)) {
+    if (RMUtilSmallStr_MakeRoomFor(s, n) != REDISMODULE_OK) {
+      RMUtilSmallStr_Data(s)[len] = '\0';
+      return REDISMODULE_ERR;
+    }
+    va_copy(cpy, ap);
+    vsnprintf(RMUtilSmallStr_Data(s) + len, n + 1, fmt, cpy);
+    va_end(cpy);
+  }
+  RMUtilSmallStr_IncrLen(s, n);
+  return REDISMODULE_OK;
+}
+
+int RMUtilSmallStr_CatPrintf(RMUtilSmallStr *s, const char *fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  int rc = RMUtilSmallStr_CatVPrintf(s, fmt, ap);
+  va_end(ap);
+  return rc;
+}
+
+int RMUtilSmallStr_CpyLen(RMUtilSmallStr *s, const void *t, size_t len) {
+  RMUtilSmallStr_Clear(s);
+  return RMUtilSmallStr_CatLen(s, t, len);
+}
+
+int RMUtilSmallStr_Cpy(RMUtilSmallStr *s, const char *t) {
+  return RMUtilSmallStr_CpyLen(s, t, strlen(t));
+}
+
+int RMUtilSmallStr_Cmp(const RMUtilSmallStr *a, const RMUtilSmallStr *b) {
+  size_t l1 = RMUtilSmallStr_Len(a), l2 = RMUtilSmallStr_Len(b);
+  int cmp = memcmp(RMUtilSmallStr_Ptr(a), RMUtilSmallStr_Ptr(b), l1 < l2 ? l1 : l2);
+  if (cmp == 0) return l1 > l2 ? 1 : (l1 < l2 ? -1 : 0);
+  return cmp;
+}
+
+sds RMUtilSmallStr_ToSds(const RMUtilSmallStr *s) {
+  return sdsnewlen(RMUtilSmallStr_Ptr(s), RMUtilSmallStr_Len(s));
+}
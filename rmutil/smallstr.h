@@ -0,0 +1,127 @@
+#ifndef RMUTIL_SMALLSTR_H_
+#define RMUTIL_SMALLSTR_H_
+#include <stddef.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <redismodule.h>
+#include "sds.h"
+
+/** smallstr.h - A string type stored inline when it is short.
+ *
+ * An RMUtilSmallStr takes 24 bytes, and holds strings of up to RMUTIL_SMALLSTR_INLINE bytes in
+ * place, without any allocation. Longer strings move to a heap buffer, grown like an sds string.
+ * A module storing millions of short fields in structs saves an allocation, and the allocator's
+ * overhead, for each of them:
+ *
+ *   typedef struct {
+ *     RMUtilSmallStr name;
+ *     double score;
+ *   } Field;
+ *
+ *   RMUtilSmallStr_InitLen(&f->name, buf, len);
+ *   RMUtilSmallStr_CatLongLong(&f->name, id);
+ *   ...
+ *   RMUtilSmallStr_Free(&f->name);
+ *
+ * The API follows sds, but works in place on a pointer to the string rather than returning a new
+ * string. Strings are always NULL terminated, binary safe, and limited to UINT32_MAX bytes: the
+ * functions that grow a string return REDISMODULE_ERR rather than going past that, leaving the
+ * string unchanged.
+ */
+
+/* The longest string stored inline */
+#define RMUTIL_SMALLSTR_INLINE 22
+
+typedef union {
+  struct {
+    char buf[RMUTIL_SMALLSTR_INLINE + 1];
+    // the length of an inline string, or RMUTIL_SMALLSTR_HEAP
+    unsigned char meta;
+  } in;
+  struct {
+    char *ptr;
+    uint32_t len;
+    uint32_t cap;
+  } heap;
+} RMUtilSmallStr;
+
+#define RMUTIL_SMALLSTR_HEAP 0x80
+
+/* An empty string, e.g. `RMUtilSmallStr s = RMUTIL_SMALLSTR_INIT;`. Zeroed memory is an empty
+ * string too */
+#define RMUTIL_SMALLSTR_INIT \
+  {                          \
+    .in = {.meta = 0 }       \
+  }
+
+static inline int RMUtilSmallStr_IsInline(const RMUtilSmallStr *s) {
+  return !(s->in.meta & RMUTIL_SMALLSTR_HEAP);
+}
+
+static inline size_t RMUtilSmallStr_Len(const RMUtilSmallStr *s) {
+  return RMUtilSmallStr_IsInline(s) ? s->in.meta : s->heap.len;
+}
+
+/* The NULL terminated content of the string. The pointer is invalidated by the functions that
+ * change the string */
+static inline const char *RMUtilSmallStr_Ptr(const RMUtilSmallStr *s) {
+  return RMUtilSmallStr_IsInline(s) ? s->in.buf : s->heap.ptr;
+}
+
+/* The content of the string, for changing it in place */
+static inline char *RMUtilSmallStr_Data(RMUtilSmallStr *s) {
+  return RMUtilSmallStr_IsInline(s) ? s->in.buf : s->heap.ptr;
+}
+
+/* The number of bytes that can be appended without allocating */
+static inline size_t RMUtilSmallStr_Avail(const RMUtilSmallStr *s) {
+  return RMUtilSmallStr_IsInline(s) ? RMUTIL_SMALLSTR_INLINE - s->in.meta
+                                    : s->heap.cap - s->heap.len;
+}
+
+/* Initialize an empty string */
+void RMUtilSmallStr_Init(RMUtilSmallStr *s);
+
+/* Initialize a string with `len` bytes of `init` */
+int RMUtilSmallStr_InitLen(RMUtilSmallStr *s, const void *init, size_t len);
+
+/* Free the heap buffer of the string, if any, leaving it empty */
+void RMUtilSmallStr_Free(RMUtilSmallStr *s);
+
+/* Make the string empty, keeping its buffer */
+void RMUtilSmallStr_Clear(RMUtilSmallStr *s);
+
+/* Make sure that `addlen` bytes can be appended without allocating */
+int RMUtilSmallStr_MakeRoomFor(RMUtilSmallStr *s, size_t addlen);
+
+/* Set the length of the string after writing to RMUtilSmallStr_Data directly, as sdsIncrLen.
+ * `incr` may be negative to truncate the string */
+void RMUtilSmallStr_IncrLen(RMUtilSmallStr *s, ssize_t incr);
+
+/* Move the string back inline if it fits, or shrink its heap buffer to its length */
+int RMUtilSmallStr_RemoveFreeSpace(RMUtilSmallStr *s);
+
+/* The heap memory used by the string, 0 for inline strings */
+size_t RMUtilSmallStr_AllocSize(const RMUtilSmallStr *s);
+
+/* Append to the string */
+int RMUtilSmallStr_CatLen(RMUtilSmallStr *s, const void *t, size_t len);
+int RMUtilSmallStr_Cat(RMUtilSmallStr *s, const char *t);
+int RMUtilSmallStr_CatSds(RMUtilSmallStr *s, const sds t);
+int RMUtilSmallStr_CatLongLong(RMUtilSmallStr *s, long long value);
+int RMUtilSmallStr_CatDouble(RMUtilSmallStr *s, double value);
+int RMUtilSmallStr_CatVPrintf(RMUtilSmallStr *s, const char *fmt, va_list ap);
+int RMUtilSmallStr_CatPrintf(RMUtilSmallStr *s, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+
+/* Replace the content of the string */
+int RMUtilSmallStr_CpyLen(RMUtilSmallStr *s, const void *t, size_t len);
+int RMUtilSmallStr_Cpy(RMUtilSmallStr *s, const char *t);
+
+/* Compare two strings like sdscmp */
+int RMUtilSmallStr_Cmp(const RMUtilSmallStr *a, const RMUtilSmallStr *b);
+
+/* Copy the string to a new sds string */
+sds RMUtilSmallStr_ToSds(const RMUtilSmallStr *s);
+
+#endif
@@ -1,6 +1,15 @@
 #include <string.h>
+#include <stdint.h>
 #include <sys/param.h>
 #include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#include <immintrin.h>
+#define RMUTIL_STRINGS_X86 1
+#endif
 #include "strings.h"
 #include "alloc.h"
 
@@ -27,46 +36,264 @@ int RMUtil_StringEquals(RedisModuleString *s1, RedisModuleString *s2) {
   c2 = RedisModule_StringPtrLen(s2, &l2);
   if (l1 != l2) return 0;
 
-  return strncmp(c1, c2, l1) == 0;
+  return memcmp(c1, c2, l1) == 0;
 }
 
 int RMUtil_StringEqualsC(RedisModuleString *s1, const char *s2) {
 
   const char *c1;
-  size_t l1, l2 = strlen(s2);
+  size_t l1;
   c1 = RedisModule_StringPtrLen(s1, &l1);
-  if (l1 != l2) return 0;
+  // no need to measure s2 further than one byte past the length of s1
+  if (strnlen(s2, l1 + 1) != l1) return 0;
 
-  return strncmp(c1, s2, l1) == 0;
+  return memcmp(c1, s2, l1) == 0;
 }
 int RMUtil_StringEqualsCaseC(RedisModuleString *s1, const char *s2) {
 
   const char *c1;
-  size_t l1, l2 = strlen(s2);
+  size_t l1;
   c1 = RedisModule_StringPtrLen(s1, &l1);
-  if (l1 != l2) return 0;
+  // no need to measure s2 further than one byte past the length of s1
+  if (strnlen(s2, l1 + 1) != l1) return 0;
 
-  return strncasecmp(c1, s2, l1) == 0;
+  return RMUtil_StrCaseEqual(c1, s2, l1);
 }
 
-void RMUtil_StringToLower(RedisModuleString *s) {
+/* ASCII case folding and comparison.
+ *
+ * Each operation has a scalar, an SSE2 and an AVX2 implementation. The best one supported by the
+ * CPU is picked on first use, and can be overridden with RMUtil_SetStringSIMD. Only ASCII letters
+ * are changed, regardless of the locale.
+ */
+
+static inline char ascii_Lower(char c) {
+  return c + (((unsigned char)(c - 'A') < 26) << 5);
+}
+
+static inline char ascii_Upper(char c) {
+  return c - (((unsigned char)(c - 'a') < 26) << 5);
+}
+
+static void scalar_ToLower(char *s, size_t len) {
+  for (size_t i = 0; i < len; i++) s[i] = ascii_Lower(s[i]);
+}
+
+static void scalar_ToUpper(char *s, size_t len) {
+  for (size_t i = 0; i < len; i++) s[i] = ascii_Upper(s[i]);
+}
+
+/* Lower the ASCII letters of 8 bytes at once. Bytes with the high bit set are left alone */
+static inline uint64_t swar_Lower(uint64_t x) {
+  const uint64_t ones = 0x0101010101010101ULL;
+  uint64_t low7 = x & (0x7f * ones);
+  uint64_t geA = low7 + (0x80 - 'A') * ones;
+  uint64_t gtZ = low7 + (0x7f - 'Z') * ones;
+  uint64_t upper = (geA ^ gtZ) & ~x & (0x80 * ones);
+  return x | (upper >> 2);
+}
+
+static inline uint64_t swar_Load(const char *p) {
+  uint64_t x;
+  memcpy(&x, p, sizeof(x));
+  return x;
+}
+
+static int scalar_CaseEqual(const char *a, const char *b, size_t len) {
+  if (len < 8) {
+    uint64_t x = 0, y = 0;
+    memcpy(&x, a, len);
+    memcpy(&y, b, len);
+    return swar_Lower(x) == swar_Lower(y);
+  }
+  // the last word overlaps the one before it, as in the vector loops below
+  for (size_t i = 0;; i += 8) {
+    if (i + 8 > len) i = len - 8;
+    if (swar_Lower(swar_Load(a + i)) != swar_Lower(swar_Load(b + i))) return 0;
+    if (i + 8 == len) return 1;
+  }
+}
+
+#ifdef RMUTIL_STRINGS_X86
+/* Add `delta` to the bytes between `first` and `first` + 25. Shifting that range to start at -128
+ * lets a single signed comparison find the bytes in it */
+static inline __m128i sse2_ShiftRange(__m128i v, char first, char delta) {
+  __m128i shifted = _mm_add_epi8(v, _mm_set1_epi8((char)(128 - first)));
+  __m128i inRange = _mm_cmplt_epi8(shifted, _mm_set1_epi8(-128 + 26));
+  return _mm_add_epi8(v, _mm_and_si128(inRange, _mm_set1_epi8(delta)));
+}
+
+/* Strings of at least one vector are processed a vector at a time, with the last vector loaded at
+ * the end of the string, overlapping the one before it. Case folding is idempotent, so the bytes
+ * that are processed twice come out the same. Shorter strings go to the scalar code */
+static void sse2_ToLower(char *s, size_t len) {
+  if (len < 16) return scalar_ToLower(s, len);
+  for (size_t i = 0;; i += 16) {
+    if (i + 16 > len) i = len - 16;
+    __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+    _mm_storeu_si128((__m128i *)(s + i), sse2_ShiftRange(v, 'A', 0x20));
+    if (i + 16 == len) break;
+  }
+}
+
+static void sse2_ToUpper(char *s, size_t len) {
+  if (len < 16) return scalar_ToUpper(s, len);
+  for (size_t i = 0;; i += 16) {
+    if (i + 16 > len) i = len - 16;
+    __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+    _mm_storeu_si128((__m128i *)(s + i), sse2_ShiftRange(v, 'a', -0x20));
+    if (i + 16 == len) break;
+  }
+}
+
+static int sse2_CaseEqual(const char *a, const char *b, size_t len) {
+  if (len < 16) return scalar_CaseEqual(a, b, len);
+  for (size_t i = 0;; i += 16) {
+    if (i + 16 > len) i = len - 16;
+    __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+    __m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+    __m128i eq = _mm_cmpeq_epi8(sse2_ShiftRange(va, 'A', 0x20),
+                                 sse2_ShiftRange(vb, 'A', 0x20));
+    if (_mm_movemask_epi8(eq) != 0xffff) return 0;
+    if (i + 16 == len) return 1;
+  }
+}
 
+/* The AVX2 functions hand short strings to the SSE2 ones before touching any 256 bit register, as
+ * running legacy SSE code with the upper halves of the registers dirty is very slow on some CPUs */
+__attribute__((target("avx2"))) static inline __m256i avx2_ShiftRange(__m256i v, char first,
+                                                                      char delta) {
+  __m256i shifted = _mm256_add_epi8(v, _mm256_set1_epi8((char)(128 - first)));
+  __m256i inRange = _mm256_cmpgt_epi8(_mm256_set1_epi8(-128 + 26), shifted);
+  return _mm256_add_epi8(v, _mm256_and_si256(inRange, _mm256_set1_epi8(delta)));
+}
+
+__attribute__((target("avx2"))) static void avx2_ToLower(char *s, size_t len) {
+  if (len < 32) return sse2_ToLower(s, len);
+  for (size_t i = 0;; i += 32) {
+    if (i + 32 > len) i = len - 32;
+    __m256i v = _mm256_loadu_si256((const __m256i *)(s + i));
+    _mm256_storeu_si256((__m256i *)(s + i), avx2_ShiftRange(v, 'A', 0x20));
+    if (i + 32 == len) break;
+  }
+}
+
+__attribute__((target("avx2"))) static void avx2_ToUpper(char *s, size_t len) {
+  if (len < 32) return sse2_ToUpper(s, len);
+  for (size_t i = 0;; i += 32) {
+    if (i + 32 > len) i = len - 32;
+    __m256i v = _mm256_loadu_si256((const __m256i *)(s + i));
+    _mm256_storeu_si256((__m256i *)(s + i), avx2_ShiftRange(v, 'a', -0x20));
+    if (i + 32 == len) break;
+  }
+}
+
+__attribute__((target("avx2"))) static int avx2_CaseEqual(const char *a, const char *b,
+                                                          size_t len) {
+  if (len < 32) return sse2_CaseEqual(a, b, len);
+  for (size_t i = 0;; i += 32) {
+    if (i + 32 > len) i = len - 32;
+    __m256i va = _mm256_loadu_si256((const __m256i *)(a + i));
+    __m256i vb = _mm256_loadu_si256((const __m256i *)(b + i));
+    __m256i eq = _mm256_cmpeq_epi8(avx2_ShiftRange(va, 'A', 0x20),
+                                    avx2_ShiftRange(vb, 'A', 0x20));
+    if ((unsigned)_mm256_movemask_epi8(eq) != 0xffffffffu) return 0;
+    if (i + 32 == len) return 1;
+  }
+}
+#endif
+
+static struct {
+  int level;
+  void (*toLower)(char *, size_t);
+  void (*toUpper)(char *, size_t);
+  int (*caseEqual)(const char *, const char *, size_t);
+} stringsImpl = {-1};
+
+static int strings_MaxSIMD(void) {
+#ifdef RMUTIL_STRINGS_X86
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") ? RMUTIL_SIMD_AVX2 : RMUTIL_SIMD_SSE2;
+#else
+  return RMUTIL_SIMD_NONE;
+#endif
+}
+
+int RMUtil_SetStringSIMD(int level) {
+  int max = strings_MaxSIMD();
+  if (level < 0 || level > max) level = max;
+
+  switch (level) {
+#ifdef RMUTIL_STRINGS_X86
+    case RMUTIL_SIMD_AVX2:
+      stringsImpl.toLower = avx2_ToLower;
+      stringsImpl.toUpper = avx2_ToUpper;
+      stringsImpl.caseEqual = avx2_CaseEqual;
+      break;
+    case RMUTIL_SIMD_SSE2:
+      stringsImpl.toLower = sse2_ToLower;
+      stringsImpl.toUpper = sse2_ToUpper;
+      stringsImpl.caseEqual = sse2_CaseEqual;
+      break;
+#endif
+    default:
+      stringsImpl.toLower = scalar_ToLower;
+      stringsImpl.toUpper = scalar_ToUpper;
+      stringsImpl.caseEqual = scalar_CaseEqual;
+      level = RMUTIL_SIMD_NONE;
+  }
+  __atomic_store_n(&stringsImpl.level, level, __ATOMIC_RELEASE);
+  return level;
+}
+
+static inline void strings_Init(void) {
+  if (__builtin_expect(__atomic_load_n(&stringsImpl.level, __ATOMIC_ACQUIRE) < 0, 0)) {
+    RMUtil_SetStringSIMD(-1);
+  }
+}
+
+void RMUtil_StrToLower(char *s, size_t len) {
+  strings_Init();
+  stringsImpl.toLower(s, len);
+}
+
+void RMUtil_StrToUpper(char *s, size_t len) {
+  strings_Init();
+  stringsImpl.toUpper(s, len);
+}
+
+int RMUtil_StrCaseEqual(const char *a, const char *b, size_t len) {
+  strings_Init();
+  return stringsImpl.caseEqual(a, b, len);
+}
+
+void RMUtil_StringToLower(RedisModuleString *s) {
   size_t l;
   char *c = (char *)RedisModule_StringPtrLen(s, &l);
-  size_t i;
-  for (i = 0; i < l; i++) {
-    *c = tolower(*c);
-    ++c;
-  }
+  RMUtil_StrToLower(c, l);
 }
 
 void RMUtil_StringToUpper(RedisModuleString *s) {
   size_t l;
   char *c = (char *)RedisModule_StringPtrLen(s, &l);
-  size_t i;
-  for (i = 0; i < l; i++) {
-    *c = toupper(*c);
-    ++c;
+  RMUtil_StrToUpper(c, l);
+}
+
+void RMUtil_StringsToLower(RedisModuleString **strs, size_t n) {
+  strings_Init();
+  for (size_t i = 0; i < n; i++) {
+    size_t l;
+    char *c = (char *)RedisModule_StringPtrLen(strs[i], &l);
+    stringsImpl.toLower(c, l);
+  }
+}
+
+void RMUtil_StringsToUpper(RedisModuleString **strs, size_t n) {
+  strings_Init();
+  for (size_t i = 0; i < n; i++) {
+    size_t l;
+    char *c = (char *)RedisModule_StringPtrLen(strs[i], &l);
+    stringsImpl.toUpper(c, l);
   }
 }
 
@@ -74,8 +301,163 @@ void RMUtil_StringConvert(RedisModuleString **rs, const char **ss, size_t n, int
   for (size_t ii = 0; ii < n; ++ii) {
     const char *p = RedisModule_StringPtrLen(rs[ii], NULL);
     if (options & RMUTIL_STRINGCONVERT_COPY) {
-      p = strdup(p);
+      p = RMUTIL_TMPSTRDUP(p);
     }
     ss[ii] = p;
   }
-}
\ No newline at end of file
+}
+RMUtilStrView RMUtil_StrView(RedisModuleString *s) {
+  RMUtilStrView v;
+  v.p = RedisModule_StringPtrLen(s, &v.len);
+  return v;
+}
+
+RMUtilStrView RMUtil_StrViewC(const char *s) {
+  return (RMUtilStrView){s, strlen(s)};
+}
+
+void RMUtil_StrViews(RedisModuleString **rs, RMUtilStrView *views, size_t n) {
+  for (size_t ii = 0; ii < n; ++ii) {
+    views[ii].p = RedisModule_StringPtrLen(rs[ii], &views[ii].len);
+  }
+}
+
+int RMUtilStrView_Equals(RMUtilStrView a, RMUtilStrView b) {
+  return a.len == b.len && memcmp(a.p, b.p, a.len) == 0;
+}
+
+int RMUtilStrView_EqualsCase(RMUtilStrView a, RMUtilStrView b) {
+  return a.len == b.len && RMUtil_StrCaseEqual(a.p, b.p, a.len);
+}
+
+int RMUtilStrView_Compare(RMUtilStrView a, RMUtilStrView b) {
+  int rc = memcmp(a.p, b.p, MIN(a.len, b.len));
+  if (rc) return rc;
+  return a.len < b.len ? -1 : a.len > b.len;
+}
+
+int RMUtilStrView_HasPrefix(RMUtilStrView v, RMUtilStrView prefix) {
+  return v.len >= prefix.len && memcmp(v.p, prefix.p, prefix.len) == 0;
+}
+
+#define FNV64_OFFSET 14695981039346656037ULL
+#define FNV64_PRIME 1099511628211ULL
+
+uint64_t RMUtilStrView_Hash(RMUtilStrView v) {
+  uint64_t h = FNV64_OFFSET;
+  for (size_t i = 0; i < v.len; i++) {
+    h = (h ^ (unsigned char)v.p[i]) * FNV64_PRIME;
+  }
+  return h;
+}
+
+uint64_t RMUtilStrView_HashCase(RMUtilStrView v) {
+  uint64_t h = FNV64_OFFSET;
+  for (size_t i = 0; i < v.len; i++) {
+    h = (h ^ (unsigned char)ascii_Lower(v.p[i])) * FNV64_PRIME;
+  }
+  return h;
+}
+
+RMUtilStrView RMUtilStrView_Sub(RMUtilStrView v, size_t offset, size_t len) {
+  if (offset > v.len) offset = v.len;
+  return (RMUtilStrView){v.p + offset, MIN(len, v.len - offset)};
+}
+
+static inline int ascii_IsSpace(char c) {
+  return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+RMUtilStrView RMUtilStrView_Trim(RMUtilStrView v) {
+  while (v.len && ascii_IsSpace(v.p[0])) {
+    v.p++;
+    v.len--;
+  }
+  while (v.len && ascii_IsSpace(v.p[v.len - 1])) v.len--;
+  return v;
+}
+
+int RMUtilStrView_NextToken(RMUtilStrView *rest, char sep, RMUtilStrView *tok) {
+  if (!rest->p) return 0;
+
+  const char *end = memchr(rest->p, sep, rest->len);
+  if (!end) {
+    *tok = *rest;
+    rest->p = NULL;
+    rest->len = 0;
+    return 1;
+  }
+  tok->p = rest->p;
+  tok->len = end - rest->p;
+  rest->len -= tok->len + 1;
+  rest->p = end + 1;
+  return 1;
+}
+
+/* Integers are parsed like redis does: an optional minus sign and digits, without leading zeros,
+ * spaces or a plus sign, so that only the canonical representation of a number is accepted */
+int RMUtilStrView_ToLongLong(RMUtilStrView v, long long *out) {
+  const char *p = v.p, *end = v.p + v.len;
+  int negative = 0;
+
+  if (v.len == 0 || v.len > 20) return REDISMODULE_ERR;
+  if (v.len == 1 && p[0] == '0') {
+    *out = 0;
+    return REDISMODULE_OK;
+  }
+  if (*p == '-') {
+    negative = 1;
+    p++;
+  }
+  if (p == end || *p < '1' || *p > '9') return REDISMODULE_ERR;
+
+  unsigned long long n = 0;
+  for (; p < end; p++) {
+    if (*p < '0' || *p > '9') return REDISMODULE_ERR;
+    unsigned d = *p - '0';
+    if (n > (ULLONG_MAX - d) / 10) return REDISMODULE_ERR;
+    n = n * 10 + d;
+  }
+
+  if (negative) {
+    if (n > (unsigned long long)LLONG_MAX + 1) return REDISMODULE_ERR;
+    *out = n == (unsigned long long)LLONG_MAX + 1 ? LLONG_MIN : -(long long)n;
+  } else {
+    if (n > LLONG_MAX) return REDISMODULE_ERR;
+    *out = n;
+  }
+  return REDISMODULE_OK;
+}
+
+// views are not NULL terminated, so doubles are copied to a buffer on the stack for strtod
+#define STRVIEW_MAX_DOUBLE_CHARS 128
+
+int RMUtilStrView_ToDouble(RMUtilStrView v, double *out) {
+  char buf[STRVIEW_MAX_DOUBLE_CHARS];
+  if (v.len == 0 || v.len >= sizeof(buf) || ascii_IsSpace(v.p[0])) return REDISMODULE_ERR;
+  memcpy(buf, v.p, v.len);
+  buf[v.len] = '\0';
+
+  char *eptr;
+  errno = 0;
+  double d = strtod(buf, &eptr);
+  if (eptr != buf + v.len || isnan(d) ||
+      (errno == ERANGE && (d == HUGE_VAL || d == -HUGE_VAL || d == 0))) {
+    return REDISMODULE_ERR;
+  }
+  *out = d;
+  return REDISMODULE_OK;
+}
+
+RMUtilOwnedStrView RMUtil_RetainStrView(RedisModuleCtx *ctx, RedisModuleString *s) {
+  RedisModule_RetainString(ctx, s);
+  return (RMUtilOwnedStrView){RMUtil_StrView(s), s};
+}
+
+void RMUtil_ReleaseStrView(RedisModuleCtx *ctx, RMUtilOwnedStrView *o) {
+  if (o->str) {
+    RedisModule_FreeString(ctx, o->str);
+  }
+  o->str = NULL;
+  o->view = (RMUtilStrView){NULL, 0};
+}
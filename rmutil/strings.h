@@ -1,6 +1,7 @@
 #ifndef __RMUTIL_STRINGS_H__
 #define __RMUTIL_STRINGS_H__
 
+#include <stdint.h>
 #include <redismodule.h>
 
 /*
@@ -20,19 +21,126 @@ int RMUtil_StringEqualsC(RedisModuleString *s1, const char *s2);
 /* Return 1 if the string is equal to a C NULL terminated string. Case *insensitive* */
 int RMUtil_StringEqualsCaseC(RedisModuleString *s1, const char *s2);
 
-/* Converts a redis string to lowercase in place without reallocating anything */
+/* Converts a redis string to lowercase in place without reallocating anything. Only ASCII letters
+ * are converted */
 void RMUtil_StringToLower(RedisModuleString *s);
 
-/* Converts a redis string to uppercase in place without reallocating anything */
+/* Converts a redis string to uppercase in place without reallocating anything. Only ASCII letters
+ * are converted */
 void RMUtil_StringToUpper(RedisModuleString *s);
 
-// If set, copy the strings using strdup rather than simply storing pointers.
+/* Convert an array of `n` redis strings to lowercase / uppercase in place */
+void RMUtil_StringsToLower(RedisModuleString **strs, size_t n);
+void RMUtil_StringsToUpper(RedisModuleString **strs, size_t n);
+
+/* Convert `len` bytes of a buffer to lowercase / uppercase in place. Only ASCII letters are
+ * converted */
+void RMUtil_StrToLower(char *s, size_t len);
+void RMUtil_StrToUpper(char *s, size_t len);
+
+/* Return 1 if the first `len` bytes of two buffers are equal, ignoring the case of ASCII letters */
+int RMUtil_StrCaseEqual(const char *a, const char *b, size_t len);
+
+/* The implementations of the case functions. They use SSE2 or AVX2 when the CPU supports them */
+#define RMUTIL_SIMD_NONE 0
+#define RMUTIL_SIMD_SSE2 1
+#define RMUTIL_SIMD_AVX2 2
+
+/* Choose the implementation of the case functions, e.g. to compare them. Levels the CPU does not
+ * support, or -1, select the best supported one. Returns the level selected */
+int RMUtil_SetStringSIMD(int level);
+
+/**
+ * String views.
+ *
+ * An RMUtilStrView is a pointer and a length into memory owned by someone else, usually a
+ * RedisModuleString of the command's argv. Views are passed by value, and none of the functions
+ * below allocate. Views over a RedisModuleString are valid as long as the string is: use
+ * RMUtil_RetainStrView for views that must outlive the command.
+ *
+ *   RMUtilStrView arg = RMUtil_StrView(argv[1]);
+ *   if (RMUtilStrView_EqualsCase(arg, RMUTIL_STRVIEW_LIT("LIMIT"))) ...
+ */
+typedef struct {
+  const char *p;
+  size_t len;
+} RMUtilStrView;
+
+/* A view over a string literal, with its length computed at compile time */
+#define RMUTIL_STRVIEW_LIT(lit) ((RMUtilStrView){"" lit, sizeof(lit) - 1})
+
+/* A view over a redis string */
+RMUtilStrView RMUtil_StrView(RedisModuleString *s);
+
+/* A view over a NULL terminated C string */
+RMUtilStrView RMUtil_StrViewC(const char *s);
+
+/* Fill `views` with views over the `n` strings of `rs`. Unlike RMUtil_StringConvert with
+ * RMUTIL_STRINGCONVERT_COPY, nothing is copied, and the lengths are kept */
+void RMUtil_StrViews(RedisModuleString **rs, RMUtilStrView *views, size_t n);
+
+/* Return 1 if the two views hold the same bytes. Case *sensitive* */
+int RMUtilStrView_Equals(RMUtilStrView a, RMUtilStrView b);
+
+/* Return 1 if the two views hold the same bytes, ignoring the case of ASCII letters */
+int RMUtilStrView_EqualsCase(RMUtilStrView a, RMUtilStrView b);
+
+/* Compare two views like memcmp, a view sorting before the longer views it is a prefix of */
+int RMUtilStrView_Compare(RMUtilStrView a, RMUtilStrView b);
+
+/* Return 1 if the view starts with `prefix` */
+int RMUtilStrView_HasPrefix(RMUtilStrView v, RMUtilStrView prefix);
+
+/* A 64 bit FNV-1a hash of the view's bytes. The Case version ignores the case of ASCII letters, so
+ * views that are EqualsCase hash the same */
+uint64_t RMUtilStrView_Hash(RMUtilStrView v);
+uint64_t RMUtilStrView_HashCase(RMUtilStrView v);
+
+/* The part of the view starting at `offset`, at most `len` bytes long. Out of range offsets give an
+ * empty view */
+RMUtilStrView RMUtilStrView_Sub(RMUtilStrView v, size_t offset, size_t len);
+
+/* The view without the ASCII whitespace at its ends */
+RMUtilStrView RMUtilStrView_Trim(RMUtilStrView v);
+
+/* Take the next token delimited by `sep` off the front of `*rest`, e.g:
+ *
+ *   RMUtilStrView rest = RMUtil_StrView(argv[1]), tok;
+ *   while (RMUtilStrView_NextToken(&rest, ',', &tok)) { ... }
+ *
+ * A view with n separators gives n + 1 tokens, some of which may be empty. After the last token
+ * `rest->p` is set to NULL, and the function returns 0 */
+int RMUtilStrView_NextToken(RMUtilStrView *rest, char sep, RMUtilStrView *tok);
+
+/* Parse the view as a number, with the same rules as RedisModule_StringToLongLong and
+ * RedisModule_StringToDouble. Return REDISMODULE_OK, or REDISMODULE_ERR if the view is not a valid
+ * number or does not fit, in which case `*out` is not changed. Doubles are parsed from a copy on
+ * the stack, and views longer than 127 bytes are rejected */
+int RMUtilStrView_ToLongLong(RMUtilStrView v, long long *out);
+int RMUtilStrView_ToDouble(RMUtilStrView v, double *out);
+
+/* A view that keeps the redis string it points into alive */
+typedef struct {
+  RMUtilStrView view;
+  RedisModuleString *str;
+} RMUtilOwnedStrView;
+
+/* Retain `s` with RedisModule_RetainString and return a view over it that stays valid after the
+ * command returns, until it is released with RMUtil_ReleaseStrView */
+RMUtilOwnedStrView RMUtil_RetainStrView(RedisModuleCtx *ctx, RedisModuleString *s);
+
+/* Release the string behind an owned view. `ctx` may be NULL outside of a command */
+void RMUtil_ReleaseStrView(RedisModuleCtx *ctx, RMUtilOwnedStrView *o);
+
+// If set, copy the strings rather than simply storing pointers. The copies are made with
+// RMUTIL_TMPSTRDUP, and should be freed with RMUTIL_TMPFREE (see alloc.h).
 #define RMUTIL_STRINGCONVERT_COPY 1
 
 /**
  * Convert one or more RedisModuleString objects into `const char*`.
  * Both rs and ss are arrays, and should be of <n> length.
- * Options may be 0 or `RMUTIL_STRINGCONVERT_COPY`
+ * Options may be 0 or `RMUTIL_STRINGCONVERT_COPY`. See RMUtil_StrViews for a conversion that
+ * keeps the lengths and never copies
  */
 void RMUtil_StringConvert(RedisModuleString **rs, const char **ss, size_t n, int options);
 #endif
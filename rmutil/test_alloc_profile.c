@@ -0,0 +1,201 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+// define the module API pointers here, they are left NULL outside of redis
+#define REDISMODULE_MAIN
+#define REDISMODULE_EXPERIMENTAL_API
+#include <redismodule.h>
+#include "test.h"
+#define RMUTIL_ALLOC_PROFILE
+#include "alloc.h"
+
+static RMUtilAllocSiteStats *findSite(RMUtilAllocSiteStats *sites, size_t n, int line) {
+  for (size_t i = 0; i < n; i++) {
+    if (sites[i].line == line && strstr(sites[i].file, "test_alloc_profile.c")) return &sites[i];
+  }
+  return NULL;
+}
+
+static int allocLine;
+
+static void *allocSomething(size_t size) {
+  allocLine = __LINE__ + 1;
+  return malloc(size);
+}
+
+int testSites() {
+  RMUtilAllocSiteStats sites[RMUTIL_ALLOC_MAX_SITES];
+  void *ptrs[10];
+  for (int i = 0; i < 10; i++) {
+    ptrs[i] = allocSomething(100);
+    memset(ptrs[i], i, 100);
+  }
+  int callocLine = __LINE__ + 1;
+  char *zeroed = calloc(10, 50);
+  ASSERT_EQUAL(0, zeroed[499]);
+  // an overflowing size fails without being accounted
+  ASSERT(calloc(SIZE_MAX / 8, 16) == NULL);
+  int strdupLine = __LINE__ + 1;
+  char *copy = strdup("hello");
+  ASSERT_STRING_EQ("hello", copy);
+
+  size_t n = RMUtil_AllocProfileSites(sites, RMUTIL_ALLOC_MAX_SITES);
+  RMUtilAllocSiteStats *s = findSite(sites, n, allocLine);
+  ASSERT(s != NULL);
+  ASSERT_EQUAL(10, s->allocs);
+  ASSERT_EQUAL(0, s->frees);
+  ASSERT_EQUAL(1000, s->liveBytes);
+  // sites are sorted by live bytes
+  ASSERT(s == &sites[0]);
+  s = findSite(sites, n, callocLine);
+  ASSERT(s != NULL);
+  ASSERT_EQUAL(500, s->liveBytes);
+  s = findSite(sites, n, strdupLine);
+  ASSERT(s != NULL);
+  ASSERT_EQUAL(6, s->liveBytes);
+
+  for (int i = 0; i < 5; i++) {
+    free(ptrs[i]);
+  }
+  n = RMUtil_AllocProfileSites(sites, RMUTIL_ALLOC_MAX_SITES);
+  s = findSite(sites, n, allocLine);
+  ASSERT_EQUAL(5, s->frees);
+  ASSERT_EQUAL(500, s->liveBytes);
+  ASSERT_EQUAL(1000, s->totalBytes);
+
+  // a reallocation moves the bytes to the realloc site
+  int reallocLine = __LINE__ + 1;
+  ptrs[5] = realloc(ptrs[5], 1000);
+  ASSERT_EQUAL(5, ((char *)ptrs[5])[99]);
+  n = RMUtil_AllocProfileSites(sites, RMUTIL_ALLOC_MAX_SITES);
+  ASSERT_EQUAL(400, findSite(sites, n, allocLine)->liveBytes);
+  ASSERT_EQUAL(1000, findSite(sites, n, reallocLine)->liveBytes);
+
+  for (int i = 5; i < 10; i++) {
+    free(ptrs[i]);
+  }
+  free(zeroed);
+  free(copy);
+  n = RMUtil_AllocProfileSites(sites, RMUTIL_ALLOC_MAX_SITES);
+  for (size_t i = 0; i < n; i++) {
+    ASSERT_EQUAL(0, sites[i].liveBytes);
+  }
+  return 0;
+}
+
+int testBuckets() {
+  RMUtilAllocBucketStats before[RMUTIL_ALLOC_NUM_BUCKETS], after[RMUTIL_ALLOC_NUM_BUCKETS];
+  RMUtil_AllocProfileBuckets(before);
+  void *a = malloc(64), *b = malloc(65), *c = malloc(1);
+  RMUtil_AllocProfileBuckets(after);
+  ASSERT_EQUAL(64, after[6].maxSize);
+  ASSERT_EQUAL(before[6].allocs + 1, after[6].allocs);
+  ASSERT_EQUAL(before[7].allocs + 1, after[7].allocs);
+  ASSERT_EQUAL(before[0].allocs + 1, after[0].allocs);
+  ASSERT_EQUAL(before[7].liveBytes + 65, after[7].liveBytes);
+  free(a);
+  free(b);
+  free(c);
+  RMUtil_AllocProfileBuckets(after);
+  ASSERT_EQUAL(before[7].liveBytes, after[7].liveBytes);
+  return 0;
+}
+
+static int threadLine;
+
+static void *threadAlloc(void *arg) {
+  void **out = arg;
+  for (int i = 0; i < 1000; i++) {
+    threadLine = __LINE__ + 1;
+    void *p = malloc(16);
+    if (i == 999) {
+      *out = p;
+    } else {
+      free(p);
+    }
+  }
+  return NULL;
+}
+
+int testThreads() {
+  void *leftover[4];
+  pthread_t threads[4];
+  for (int i = 0; i < 4; i++) {
+    pthread_create(&threads[i], NULL, threadAlloc, &leftover[i]);
+  }
+  for (int i = 0; i < 4; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  // the counters of exited threads are kept
+  RMUtilAllocSiteStats sites[RMUTIL_ALLOC_MAX_SITES];
+  size_t n = RMUtil_AllocProfileSites(sites, RMUTIL_ALLOC_MAX_SITES);
+  RMUtilAllocSiteStats *s = findSite(sites, n, threadLine);
+  ASSERT(s != NULL);
+  ASSERT_EQUAL(4000, s->allocs);
+  ASSERT_EQUAL(64, s->liveBytes);
+
+  // memory freed by another thread is accounted to the site that allocated it
+  for (int i = 0; i < 4; i++) {
+    free(leftover[i]);
+  }
+  n = RMUtil_AllocProfileSites(sites, RMUTIL_ALLOC_MAX_SITES);
+  ASSERT_EQUAL(0, findSite(sites, n, threadLine)->liveBytes);
+  return 0;
+}
+
+static int numSections, numDictFields;
+static char lastSection[64];
+
+static int stubInfoAddSection(RedisModuleInfoCtx *ctx, char *name) {
+  numSections++;
+  strcpy(lastSection, name);
+  return REDISMODULE_OK;
+}
+
+static int stubInfoBeginDictField(RedisModuleInfoCtx *ctx, char *name) {
+  numDictFields++;
+  return REDISMODULE_OK;
+}
+
+static int stubInfoEndDictField(RedisModuleInfoCtx *ctx) {
+  return REDISMODULE_OK;
+}
+
+static int stubInfoAddFieldLongLong(RedisModuleInfoCtx *ctx, char *field, long long value) {
+  return REDISMODULE_OK;
+}
+
+static int stubInfoAddFieldULongLong(RedisModuleInfoCtx *ctx, char *field,
+                                     unsigned long long value) {
+  return REDISMODULE_OK;
+}
+
+static int stubInfoAddFieldCString(RedisModuleInfoCtx *ctx, char *field, char *value) {
+  return REDISMODULE_OK;
+}
+
+int testInfo() {
+  RedisModule_InfoAddSection = (void *)stubInfoAddSection;
+  RedisModule_InfoBeginDictField = (void *)stubInfoBeginDictField;
+  RedisModule_InfoEndDictField = stubInfoEndDictField;
+  RedisModule_InfoAddFieldLongLong = (void *)stubInfoAddFieldLongLong;
+  RedisModule_InfoAddFieldULongLong = (void *)stubInfoAddFieldULongLong;
+  RedisModule_InfoAddFieldCString = (void *)stubInfoAddFieldCString;
+
+  void *p = malloc(100);
+  RMUtil_AllocProfileInfo(NULL, 0);
+  ASSERT_EQUAL(1, numSections);
+  ASSERT_STRING_EQ("allocprofile", lastSection);
+  ASSERT(numDictFields >= 2);
+  free(p);
+  return 0;
+}
+
+TEST_MAIN({
+  TESTFUNC(testSites);
+  TESTFUNC(testBuckets);
+  TESTFUNC(testThreads);
+  TESTFUNC(testInfo);
+});
@@ -0,0 +1,226 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+// define the module API pointers here, they are left NULL outside of redis
+#define REDISMODULE_MAIN
+#define REDISMODULE_EXPERIMENTAL_API
+#define RMUTIL_ARENA_TMPALLOC
+#include "arena.h"
+#include "alloc.h"
+#include "test.h"
+
+int testAlloc() {
+  RMUtilArena a;
+  RMUtilArena_Init(&a, 256);
+
+  char *prev = NULL;
+  for (int i = 1; i < 100; i++) {
+    char *p = RMUtilArena_Alloc(&a, i);
+    ASSERT_EQUAL(0, ((uintptr_t)p % RMUTIL_ARENA_ALIGN));
+    ASSERT(p != prev);
+    memset(p, i, i);
+    prev = p;
+  }
+  ASSERT_EQUAL(99, a.numAllocs);
+  size_t chunks = a.numChunkAllocs;
+  ASSERT(chunks > 1);
+
+  char *s = RMUtilArena_Strdup(&a, "hello world");
+  ASSERT_STRING_EQ("hello world", s);
+  s = RMUtilArena_Strndup(&a, "hello world", 5);
+  ASSERT_STRING_EQ("hello", s);
+
+  int *z = RMUtilArena_Calloc(&a, 10, sizeof(int));
+  for (int i = 0; i < 10; i++) {
+    ASSERT_EQUAL(0, z[i]);
+  }
+
+  // a reset arena reuses its chunks
+  RMUtilArena_Reset(&a);
+  chunks = a.numChunkAllocs;
+  for (int i = 1; i < 100; i++) {
+    RMUtilArena_Alloc(&a, i);
+  }
+  ASSERT(a.numChunkAllocs <= chunks);
+
+  // oversized allocations get their own chunk, which is not kept
+  chunks = a.numChunkAllocs;
+  char *big = RMUtilArena_Alloc(&a, 10000);
+  memset(big, 1, 10000);
+  ASSERT_EQUAL(chunks + 1, a.numChunkAllocs);
+  RMUtilArena_Reset(&a);
+  for (RMUtilArenaChunk *c = a.freeChunks; c; c = c->next) {
+    ASSERT_EQUAL(256, c->size);
+  }
+
+  RMUtilArena_Destroy(&a);
+  return 0;
+}
+
+int testRealloc() {
+  RMUtilArena a;
+  RMUtilArena_Init(&a, 1024);
+
+  // the last allocation grows in place
+  char *p = RMUtilArena_Alloc(&a, 10);
+  strcpy(p, "abcdefghi");
+  char *p2 = RMUtilArena_Realloc(&a, p, 10, 100);
+  ASSERT(p == p2);
+  ASSERT_STRING_EQ("abcdefghi", p2);
+
+  // other allocations are copied
+  RMUtilArena_Alloc(&a, 10);
+  char *p3 = RMUtilArena_Realloc(&a, p2, 100, 200);
+  ASSERT(p3 != p2);
+  ASSERT_STRING_EQ("abcdefghi", p3);
+
+  // growing past the chunk moves the allocation to a new one
+  char *p4 = RMUtilArena_Realloc(&a, p3, 200, 2000);
+  ASSERT(p4 != p3);
+  ASSERT_STRING_EQ("abcdefghi", p4);
+  RMUtilArena_Destroy(&a);
+
+  // growing in place up to the end of a chunk whose size is not a multiple of the alignment never
+  // leaves the current pointer past it
+  RMUtilArena_Init(&a, 1000);
+  p = RMUtilArena_Alloc(&a, 16);
+  p2 = RMUtilArena_Realloc(&a, p, 16, 995);
+  ASSERT(p2 != p);
+  ASSERT(a.ptr <= a.end);
+  p = RMUtilArena_Alloc(&a, 16);
+  p2 = RMUtilArena_Realloc(&a, p, 16, 990);
+  ASSERT(p2 == p);
+  ASSERT(a.ptr <= a.end);
+  p3 = RMUtilArena_Alloc(&a, 16);
+  ASSERT(p3 < p || p3 >= p + 990);
+  RMUtilArena_Destroy(&a);
+  return 0;
+}
+
+int testOverflow() {
+  RMUtilArena a;
+  RMUtilArena_Init(&a, 256);
+  char *p = RMUtilArena_Alloc(&a, 10);
+  strcpy(p, "abcdefghi");
+
+  // sizes that wrap when multiplied, aligned or given a chunk header fail instead of returning a
+  // small buffer
+  ASSERT(RMUtilArena_Calloc(&a, SIZE_MAX / 8, 16) == NULL);
+  ASSERT(RMUtilArena_Calloc(&a, 2, SIZE_MAX / 2 + 1) == NULL);
+  ASSERT(RMUtilArena_Alloc(&a, SIZE_MAX) == NULL);
+  ASSERT(RMUtilArena_Alloc(&a, SIZE_MAX - RMUTIL_ARENA_ALIGN + 2) == NULL);
+  ASSERT(RMUtilArena_Alloc(&a, SIZE_MAX - sizeof(RMUtilArenaChunk)) == NULL);
+  ASSERT(RMUtilArena_Realloc(&a, p, 10, SIZE_MAX - 4) == NULL);
+  ASSERT_STRING_EQ("abcdefghi", p);
+
+  // the arena is still usable
+  char *p2 = RMUtilArena_Realloc(&a, p, 10, 20);
+  ASSERT(p2 == p);
+  ASSERT(RMUtilArena_Calloc(&a, 0, SIZE_MAX) != NULL);
+  RMUtilArena_Destroy(&a);
+
+  // the temporary allocations of commands go through the same checks
+  RMUtilArena *ca = RMUtilArena_EnterCommand();
+  ASSERT(ca != NULL);
+  ASSERT(RMUTIL_TMPCALLOC(SIZE_MAX / 4, 8) == NULL);
+  RMUtilArena_LeaveCommand();
+  return 0;
+}
+
+static int poolAllocs;
+
+static void *stubPoolAlloc(RedisModuleCtx *ctx, size_t bytes) {
+  static char pool[64 * 1024] __attribute__((aligned(16)));
+  static size_t used;
+  poolAllocs++;
+  void *p = pool + used;
+  used += (bytes + 15) & ~15;
+  return p;
+}
+
+int testPool() {
+  RedisModule_PoolAlloc = stubPoolAlloc;
+  int fakeCtx;
+  RMUtilArena a;
+  RMUtilArena_InitPool(&a, (RedisModuleCtx *)&fakeCtx, 512);
+  for (int i = 0; i < 100; i++) {
+    char *p = RMUtilArena_Alloc(&a, 20);
+    memset(p, 0, 20);
+  }
+  ASSERT(poolAllocs > 0);
+  ASSERT_EQUAL(poolAllocs, a.numChunkAllocs);
+  RMUtilArena_Reset(&a);
+  ASSERT(a.freeChunks == NULL);
+  RMUtilArena_Destroy(&a);
+  return 0;
+}
+
+static int innerCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+  RMUtilArena *a = RMUtil_CommandArena();
+  if (!a || a->chunks == NULL) return REDISMODULE_ERR;
+  RMUtilArena_Alloc(a, 8);
+  return REDISMODULE_OK;
+}
+RMUTIL_ARENA_CMD(innerCommand_Arena, innerCommand)
+
+static int outerCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+  char *s = RMUTIL_TMPSTRDUP("temporary");
+  int rc = innerCommand_Arena(ctx, argv, argc);
+  // the nested command left the outer allocations alone
+  if (strcmp(s, "temporary")) return REDISMODULE_ERR;
+  RMUTIL_TMPFREE(s);
+  return rc;
+}
+RMUTIL_ARENA_CMD(outerCommand_Arena, outerCommand)
+
+int testCommandArena() {
+  ASSERT(RMUtil_CommandArena() == NULL);
+  ASSERT_EQUAL(REDISMODULE_OK, outerCommand_Arena(NULL, NULL, 0));
+  ASSERT(RMUtil_CommandArena() == NULL);
+
+  // the arena was reset when the outer command returned, keeping its chunks
+  RMUtilArena *a = RMUtilArena_EnterCommand();
+  ASSERT(a->chunks == NULL);
+  ASSERT(a->freeChunks != NULL);
+  size_t chunks = a->numChunkAllocs;
+  int *p = RMUTIL_TMPCALLOC(4, sizeof(int));
+  ASSERT_EQUAL(0, p[3]);
+  ASSERT_EQUAL(chunks, a->numChunkAllocs);
+  RMUtilArena_LeaveCommand();
+
+  // outside of a command, temporary allocations use malloc
+  p = RMUTIL_TMPALLOC(16);
+  RMUTIL_TMPFREE(p);
+  return 0;
+}
+
+static void *threadCommand(void *arg) {
+  RMUtilArena *a = RMUtilArena_EnterCommand();
+  *(RMUtilArena **)arg = a;
+  RMUtilArena_Alloc(a, 100);
+  RMUtilArena_LeaveCommand();
+  return NULL;
+}
+
+int testThreadArena() {
+  RMUtilArena *mine = RMUtilArena_EnterCommand();
+  RMUtilArena *other = NULL;
+  pthread_t t;
+  pthread_create(&t, NULL, threadCommand, &other);
+  pthread_join(t, NULL);
+  // each thread has its own command arena, freed when the thread exits
+  ASSERT(other != NULL);
+  ASSERT(other != mine);
+  RMUtilArena_LeaveCommand();
+  return 0;
+}
+
+TEST_MAIN({
+  TESTFUNC(testAlloc);
+  TESTFUNC(testRealloc);
+  TESTFUNC(testOverflow);
+  TESTFUNC(testPool);
+  TESTFUNC(testCommandArena);
+  TESTFUNC(testThreadArena);
+});
@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+// define the module API pointers here, they are left NULL outside of redis
+#define REDISMODULE_MAIN
+#define REDISMODULE_EXPERIMENTAL_API
+#include <redismodule.h>
+#include "util.h"
+#include "test.h"
+
+/* Outside of redis, RedisModuleString objects are stubbed by plain C strings */
+static const char *stubStringPtrLen(const RedisModuleString *str, size_t *len) {
+  if (len) *len = strlen((const char *)str);
+  return (const char *)str;
+}
+
+static int stubStringToLongLong(const RedisModuleString *str, long long *ll) {
+  char *end;
+  *ll = strtoll((const char *)str, &end, 10);
+  return *end ? REDISMODULE_ERR : REDISMODULE_OK;
+}
+
+#define ARGV(...) ((RedisModuleString **)(const char *[]){__VA_ARGS__})
+
+int testArgSchema() {
+  RedisModule_StringPtrLen = stubStringPtrLen;
+  RedisModule_StringToLongLong = stubStringToLongLong;
+
+  enum { KW_LIMIT, KW_WITHSCORES, KW_FILTER, KW_SORTBY, KW_ASC, KW_DESC, KW_NUM };
+  const char *keywords[] = {"LIMIT", "WITHSCORES", "FILTER", "SORTBY", "ASC", "DESC"};
+  RMUtilArgSchema *schema = RMUtil_NewArgSchema(keywords, KW_NUM);
+  ASSERT(schema != NULL);
+
+  for (int i = 0; i < KW_NUM; i++) {
+    ASSERT_EQUAL(i, RMUtilArgSchema_Lookup(schema, keywords[i], strlen(keywords[i])));
+  }
+  ASSERT_EQUAL(KW_WITHSCORES, RMUtilArgSchema_Lookup(schema, "withScores", 10));
+  ASSERT_EQUAL(-1, RMUtilArgSchema_Lookup(schema, "LIMITS", 6));
+  ASSERT_EQUAL(-1, RMUtilArgSchema_Lookup(schema, "LIM", 3));
+  ASSERT_EQUAL(-1, RMUtilArgSchema_Lookup(schema, "x", 1));
+
+  RedisModuleString **argv =
+      ARGV("CMD", "key", "limit", "0", "10", "SortBy", "score", "LIMIT", "5", "5", "desc");
+  int argc = 11;
+  int pos[KW_NUM];
+  ASSERT_EQUAL(3, RMUtilArgSchema_Parse(schema, argv, argc, 2, pos));
+  ASSERT_EQUAL(2, pos[KW_LIMIT]);
+  ASSERT_EQUAL(5, pos[KW_SORTBY]);
+  ASSERT_EQUAL(10, pos[KW_DESC]);
+  ASSERT_EQUAL(-1, pos[KW_WITHSCORES]);
+  ASSERT_EQUAL(-1, pos[KW_FILTER]);
+  ASSERT_EQUAL(-1, pos[KW_ASC]);
+
+  // the positions are usable with the regular parsing functions
+  long long offset, num;
+  ASSERT_EQUAL(REDISMODULE_OK,
+               RMUtil_ParseArgs(argv, argc, pos[KW_LIMIT] + 1, "ll", &offset, &num));
+  ASSERT_EQUAL(0, offset);
+  ASSERT_EQUAL(10, num);
+
+  // offset is respected
+  ASSERT_EQUAL(2, RMUtilArgSchema_Parse(schema, argv, argc, 6, pos));
+  ASSERT_EQUAL(7, pos[KW_LIMIT]);
+
+  RMUtilArgSchema_Free(schema);
+
+  // duplicate keywords are rejected
+  const char *dups[] = {"LIMIT", "limit"};
+  ASSERT(RMUtil_NewArgSchema(dups, 2) == NULL);
+  return 0;
+}
+
+int testLargeSchema() {
+  // a perfect hash is found for larger keyword sets too
+  static char buf[200][16];
+  const char *keywords[200];
+  for (int i = 0; i < 200; i++) {
+    snprintf(buf[i], sizeof(buf[i]), "KW%d", i);
+    keywords[i] = buf[i];
+  }
+  RMUtilArgSchema *schema = RMUtil_NewArgSchema(keywords, 200);
+  ASSERT(schema != NULL);
+  for (int i = 0; i < 200; i++) {
+    ASSERT_EQUAL(i, RMUtilArgSchema_Lookup(schema, keywords[i], strlen(keywords[i])));
+  }
+  ASSERT_EQUAL(-1, RMUtilArgSchema_Lookup(schema, "KW200", 5));
+  RMUtilArgSchema_Free(schema);
+  return 0;
+}
+
+TEST_MAIN({
+  TESTFUNC(testArgSchema);
+  TESTFUNC(testLargeSchema);
+});
@@ -0,0 +1,252 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "hashmap.h"
+#include "test.h"
+
+RMUTIL_HASHMAP_DECLARE(IdMap, uint64_t, uint64_t, RMUtil_HashU64(k), a == b)
+RMUTIL_HASHMAP_DECLARE(StrMap, const char *, int, RMUtil_HashBytes(k, strlen(k)), !strcmp(a, b))
+// every key lands on one of 3 groups with the same control byte, so lookups have to probe
+RMUTIL_HASHMAP_DECLARE(CollideMap, uint64_t, uint64_t, (k % 3) << 7, a == b)
+
+static uint64_t rnd = 88172645463325252ULL;
+static uint64_t nextRand() {
+  rnd ^= rnd << 13;
+  rnd ^= rnd >> 7;
+  rnd ^= rnd << 17;
+  return rnd;
+}
+
+int testBasic() {
+  IdMap m;
+  IdMap_Init(&m, 0);
+  ASSERT_EQUAL(0, IdMap_Size(&m));
+  ASSERT(IdMap_Get(&m, 1) == NULL);
+  ASSERT(!IdMap_Del(&m, 1, NULL));
+
+  ASSERT_EQUAL(1, IdMap_Put(&m, 1, 100));
+  ASSERT_EQUAL(1, IdMap_Put(&m, 2, 200));
+  ASSERT_EQUAL(0, IdMap_Put(&m, 1, 101));
+  ASSERT_EQUAL(2, IdMap_Size(&m));
+  ASSERT_EQUAL(101, *IdMap_Get(&m, 1));
+  ASSERT_EQUAL(200, *IdMap_Get(&m, 2));
+
+  int isNew;
+  uint64_t *v = IdMap_Insert(&m, 3, &isNew);
+  ASSERT(isNew);
+  *v = 300;
+  v = IdMap_Insert(&m, 3, &isNew);
+  ASSERT(!isNew);
+  ASSERT_EQUAL(300, *v);
+
+  uint64_t removed = 0;
+  ASSERT(IdMap_Del(&m, 2, &removed));
+  ASSERT_EQUAL(200, removed);
+  ASSERT(IdMap_Get(&m, 2) == NULL);
+  ASSERT_EQUAL(2, IdMap_Size(&m));
+  IdMap_Free(&m);
+
+  StrMap s;
+  StrMap_Init(&s, 4);
+  StrMap_Put(&s, "foo", 1);
+  StrMap_Put(&s, "bar", 2);
+  char key[] = "foo";
+  ASSERT_EQUAL(1, *StrMap_Get(&s, key));
+  ASSERT(StrMap_Get(&s, "baz") == NULL);
+  StrMap_Free(&s);
+  return 0;
+}
+
+int testIncrementalGrowth() {
+  IdMap m;
+  IdMap_Init(&m, 0);
+  int sawRehash = 0;
+  for (uint64_t i = 0; i < 100000; i++) {
+    IdMap_Put(&m, i, i * 2);
+    if (IdMap_IsRehashing(&m)) {
+      sawRehash = 1;
+      // entries still in the old table are found while moving them
+      ASSERT(m.old.used > 0);
+      ASSERT_EQUAL(0, *IdMap_Get(&m, 0));
+      ASSERT_EQUAL(i * 2, *IdMap_Get(&m, i));
+    }
+  }
+  ASSERT(sawRehash);
+  ASSERT_EQUAL(100000, IdMap_Size(&m));
+  // growing only moves a few groups per insert, the old table is released when it's empty
+  while (IdMap_RehashStep(&m, 1))
+    ;
+  ASSERT(!IdMap_IsRehashing(&m));
+  ASSERT(m.old.ctrl == NULL);
+  ASSERT(m.cur.used == 100000);
+  for (uint64_t i = 0; i < 100000; i++) {
+    ASSERT_EQUAL(i * 2, *IdMap_Get(&m, i));
+  }
+
+  // reserving ahead never grows on insert
+  IdMap r;
+  IdMap_Init(&r, 5000);
+  size_t cap = r.cur.cap;
+  for (uint64_t i = 0; i < 5000; i++) IdMap_Put(&r, i, i);
+  ASSERT_EQUAL(cap, r.cur.cap);
+  ASSERT(!IdMap_IsRehashing(&r));
+  IdMap_Free(&r);
+  IdMap_Free(&m);
+  return 0;
+}
+
+int testRandomOps() {
+  enum { KEYS = 5000 };
+  static uint64_t ref[KEYS];
+  static char present[KEYS];
+  IdMap m;
+  IdMap_Init(&m, 0);
+  size_t size = 0;
+
+  for (int op = 0; op < 500000; op++) {
+    uint64_t k = nextRand() % KEYS, r = nextRand();
+    switch (r % 4) {
+      case 0:
+      case 1:
+        ASSERT_EQUAL((!present[k]), IdMap_Put(&m, k, r));
+        size += !present[k];
+        present[k] = 1;
+        ref[k] = r;
+        break;
+      case 2: {
+        uint64_t v;
+        ASSERT_EQUAL(present[k], IdMap_Del(&m, k, &v));
+        if (present[k]) {
+          ASSERT_EQUAL(ref[k], v);
+        }
+        size -= present[k];
+        present[k] = 0;
+        break;
+      }
+      case 3: {
+        uint64_t *v = IdMap_Get(&m, k);
+        ASSERT_EQUAL(present[k], (v != NULL));
+        if (v) {
+          ASSERT_EQUAL(ref[k], *v);
+        }
+        break;
+      }
+    }
+    ASSERT_EQUAL(size, IdMap_Size(&m));
+
+    if (op % 50000 == 0) {
+      // iterating visits every entry once, including the ones left in the old table
+      IdMap_Iterator it = {0};
+      uint64_t key, *val;
+      size_t n = 0;
+      while (IdMap_Next(&m, &it, &key, &val)) {
+        ASSERT(present[key]);
+        ASSERT_EQUAL(ref[key], *val);
+        n++;
+      }
+      ASSERT_EQUAL(size, n);
+    }
+  }
+  IdMap_Free(&m);
+  return 0;
+}
+
+int testOpsWhileRehashing() {
+  // deleting, looking up, inserting and iterating between the steps that move entries
+  enum { KEYS = 4096 };
+  static char present[KEYS];
+  IdMap m;
+  IdMap_Init(&m, 0);
+  size_t size = 0;
+  uint64_t n = 0;
+  while (size <= 1000 || !IdMap_IsRehashing(&m)) {
+    IdMap_Put(&m, n, n);
+    present[n++] = 1;
+    size++;
+  }
+
+  int ops = 0;
+  while (IdMap_IsRehashing(&m)) {
+    uint64_t k = nextRand() % n, *v;
+    if (present[k]) {
+      ASSERT_EQUAL(1, IdMap_Del(&m, k, NULL));
+      present[k] = 0;
+      size--;
+    }
+    // a deleted key stays deleted, wherever it was
+    ASSERT(IdMap_Get(&m, k) == NULL);
+    ASSERT_EQUAL(0, IdMap_Del(&m, k, NULL));
+
+    k = nextRand() % KEYS;
+    ASSERT_EQUAL((!present[k]), IdMap_Put(&m, k, k));
+    size += !present[k];
+    present[k] = 1;
+    n = k >= n ? k + 1 : n;
+    v = IdMap_Get(&m, k);
+    ASSERT(v && *v == k);
+    ASSERT_EQUAL(size, IdMap_Size(&m));
+
+    IdMap_Iterator it = {0};
+    uint64_t key;
+    size_t seen = 0;
+    while (IdMap_Next(&m, &it, &key, NULL)) {
+      ASSERT(present[key]);
+      seen++;
+    }
+    ASSERT_EQUAL(size, seen);
+    ops++;
+  }
+  ASSERT(ops > 10);
+  for (uint64_t k = 0; k < KEYS; k++) {
+    ASSERT_EQUAL(present[k], (IdMap_Get(&m, k) != NULL));
+  }
+  IdMap_Free(&m);
+  return 0;
+}
+
+int testTombstones() {
+  // churning through keys with a steady size reuses deleted slots instead of growing forever
+  IdMap m;
+  IdMap_Init(&m, 0);
+  for (uint64_t i = 0; i < 1000; i++) IdMap_Put(&m, i, i);
+  for (uint64_t i = 1000; i < 1000000; i++) {
+    IdMap_Put(&m, i, i);
+    ASSERT(IdMap_Del(&m, i - 1000, NULL));
+  }
+  ASSERT_EQUAL(1000, IdMap_Size(&m));
+  ASSERT(m.cur.cap <= 4096);
+  for (uint64_t i = 999000; i < 1000000; i++) {
+    ASSERT_EQUAL(i, *IdMap_Get(&m, i));
+  }
+  IdMap_Free(&m);
+
+  // long probe sequences, with deleted slots in the middle of them
+  CollideMap c;
+  CollideMap_Init(&c, 0);
+  for (uint64_t i = 0; i < 300; i++) CollideMap_Put(&c, i, i + 1);
+  for (uint64_t i = 0; i < 300; i += 2) {
+    ASSERT(CollideMap_Del(&c, i, NULL));
+  }
+  for (uint64_t i = 0; i < 300; i++) {
+    uint64_t *v = CollideMap_Get(&c, i);
+    if (i % 2) {
+      ASSERT(v && *v == i + 1);
+    } else {
+      ASSERT(v == NULL);
+    }
+  }
+  for (uint64_t i = 0; i < 300; i += 2) {
+    ASSERT_EQUAL(1, CollideMap_Put(&c, i, i));
+  }
+  ASSERT_EQUAL(300, CollideMap_Size(&c));
+  CollideMap_Free(&c);
+  return 0;
+}
+
+TEST_MAIN({
+  TESTFUNC(testBasic);
+  TESTFUNC(testIncrementalGrowth);
+  TESTFUNC(testRandomOps);
+  TESTFUNC(testOpsWhileRehashing);
+  TESTFUNC(testTombstones);
+});
@@ -8,6 +8,60 @@ int cmp(void *a, void *b) {
     return *__a - *__b;
 }
 
+RMUTIL_HEAP_DECLARE(IntHeap, int, a - b)
+RMUTIL_HEAP_DECLARE_ARY(BinaryIntHeap, int, 2, a - b)
+
+typedef struct {
+    double score;
+    int id;
+} ScoredId;
+
+RMUTIL_HEAP_DECLARE(MinScoreHeap, ScoredId, (a.score < b.score) - (a.score > b.score))
+
+static void testTypedHeap() {
+    int myints[] = {10, 20, 30, 5, 15};
+    IntHeap_Make(myints, 5);
+    assert(30 == myints[0]);
+
+    IntHeap_Pop(myints, 5);
+    assert(30 == myints[4]);
+    assert(20 == myints[0]);
+
+    myints[4] = 99;
+    IntHeap_Push(myints, 5);
+    assert(99 == myints[0]);
+
+    // heap sort a pseudo-random sequence with both arities
+    int a[1000], b[1000];
+    unsigned x = 12345;
+    for (int i = 0; i < 1000; i++) {
+        x = x * 1103515245 + 12345;
+        a[i] = b[i] = (x >> 8) % 500;
+    }
+    for (size_t n = 1; n <= 1000; n++) {
+        IntHeap_Push(a, n);
+    }
+    BinaryIntHeap_Make(b, 1000);
+    for (size_t n = 1000; n > 0; n--) {
+        IntHeap_Pop(a, n);
+        BinaryIntHeap_Pop(b, n);
+    }
+    for (int i = 1; i < 1000; i++) {
+        assert(a[i - 1] <= a[i]);
+        assert(a[i] == b[i]);
+    }
+
+    // a min-heap of structs
+    ScoredId s[4] = {{3.5, 1}, {1.5, 2}, {2.5, 3}, {0.5, 4}};
+    MinScoreHeap_Make(s, 4);
+    assert(4 == s[0].id);
+    MinScoreHeap_Pop(s, 4);
+    assert(2 == s[0].id);
+    s[0].score = 10;
+    MinScoreHeap_SiftDown(s, 3, 0);
+    assert(3 == s[0].id);
+}
+
 int main(int argc, char **argv) {
     int myints[] = {10, 20, 30, 5, 15};
     Vector *v = NewVector(int, 5);
@@ -32,6 +86,8 @@ int main(int argc, char **argv) {
     assert(99 == n);
 
     Vector_Free(v);
+
+    testTypedHeap();
     printf("PASS!\n");
     return 0;
 }
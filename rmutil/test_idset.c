@@ -0,0 +1,338 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+// define the module API pointers here, they are left NULL outside of redis
+#define REDISMODULE_MAIN
+#include "idset.h"
+#include "test.h"
+
+static uint64_t rnd = 88172645463325252ULL;
+static uint64_t nextRand() {
+  rnd ^= rnd << 13;
+  rnd ^= rnd >> 7;
+  rnd ^= rnd << 17;
+  return rnd;
+}
+
+/* Fill ids with n ascending IDs with random gaps below maxGap */
+static void randomIds(uint64_t *ids, size_t n, uint64_t start, uint64_t maxGap) {
+  uint64_t id = start;
+  for (size_t i = 0; i < n; i++) {
+    ids[i] = id;
+    id += 1 + nextRand() % maxGap;
+  }
+}
+
+/* The plain merges the set operations are checked against */
+static size_t refIntersect(const uint64_t *a, size_t na, const uint64_t *b, size_t nb,
+                           uint64_t *out) {
+  size_t i = 0, j = 0, k = 0;
+  while (i < na && j < nb) {
+    if (a[i] < b[j]) {
+      i++;
+    } else if (b[j] < a[i]) {
+      j++;
+    } else {
+      out[k++] = a[i++];
+      j++;
+    }
+  }
+  return k;
+}
+
+static size_t refUnion(const uint64_t *a, size_t na, const uint64_t *b, size_t nb,
+                       uint64_t *out) {
+  size_t i = 0, j = 0, k = 0;
+  while (i < na || j < nb) {
+    if (j == nb || (i < na && a[i] < b[j])) {
+      out[k++] = a[i++];
+    } else if (i == na || b[j] < a[i]) {
+      out[k++] = b[j++];
+    } else {
+      out[k++] = a[i++];
+      j++;
+    }
+  }
+  return k;
+}
+
+/* Check the set holds exactly ids[0..n) */
+static int checkSet(const RMUtilIdSet *s, const uint64_t *ids, size_t n) {
+  ASSERT_EQUAL(n, RMUtilIdSet_Size(s));
+  uint64_t *out = malloc((n + 1) * sizeof(*out));
+  ASSERT_EQUAL(n, RMUtilIdSet_Decode(s, out));
+  ASSERT(n == 0 || !memcmp(ids, out, n * sizeof(*ids)));
+  free(out);
+  return 0;
+}
+
+int testBuild() {
+  // gaps of every width, up to the 64 bits between 0 and UINT64_MAX
+  uint64_t ids[] = {0, 1, 2, 3, 10, 1000, 1ULL << 40, (1ULL << 40) + 1, UINT64_MAX - 1, UINT64_MAX};
+  size_t n = sizeof(ids) / sizeof(ids[0]);
+  RMUtilIdSet *s = RMUtil_NewIdSet(ids, n);
+  if (checkSet(s, ids, n)) return -1;
+  for (size_t i = 0; i < n; i++) {
+    ASSERT(RMUtilIdSet_Contains(s, ids[i]));
+  }
+  ASSERT(!RMUtilIdSet_Contains(s, 4));
+  ASSERT(!RMUtilIdSet_Contains(s, UINT64_MAX - 2));
+  RMUtilIdSet_Free(s);
+
+  uint64_t wide[] = {0, UINT64_MAX};
+  s = RMUtil_NewIdSet(wide, 2);
+  if (checkSet(s, wide, 2)) return -1;
+  RMUtilIdSet_Free(s);
+
+  // repeats are kept once, unsorted input is refused
+  uint64_t repeats[] = {5, 5, 6, 6, 6, 9};
+  uint64_t unique[] = {5, 6, 9};
+  s = RMUtil_NewIdSet(repeats, 6);
+  if (checkSet(s, unique, 3)) return -1;
+  RMUtilIdSet_Free(s);
+  uint64_t unsorted[] = {1, 3, 2};
+  ASSERT(RMUtil_NewIdSet(unsorted, 3) == NULL);
+
+  s = RMUtil_NewIdSet(NULL, 0);
+  if (checkSet(s, NULL, 0)) return -1;
+  ASSERT(!RMUtilIdSet_Contains(s, 0));
+  RMUtilIdSet_Free(s);
+
+  // many blocks, built ID by ID
+  size_t big = 100000;
+  uint64_t *many = malloc(big * sizeof(*many));
+  randomIds(many, big, 1000, 20);
+  RMUtilIdSetBuilder *b = RMUtil_NewIdSetBuilder();
+  for (size_t i = 0; i < big; i++) {
+    ASSERT_EQUAL(REDISMODULE_OK, RMUtilIdSetBuilder_Add(b, many[i]));
+  }
+  ASSERT_EQUAL(REDISMODULE_OK, RMUtilIdSetBuilder_Add(b, many[big - 1]));
+  ASSERT_EQUAL(REDISMODULE_ERR, RMUtilIdSetBuilder_Add(b, many[big - 1] - 1));
+  s = RMUtilIdSetBuilder_Finish(b);
+  if (checkSet(s, many, big)) return -1;
+  for (size_t i = 0; i < big; i++) {
+    ASSERT(RMUtilIdSet_Contains(s, many[i]));
+    if (i + 1 < big && many[i] + 1 < many[i + 1]) {
+      ASSERT(!RMUtilIdSet_Contains(s, many[i] + 1));
+    }
+  }
+  ASSERT(!RMUtilIdSet_Contains(s, 999));
+  // gaps below 20 take 5 bits
+  ASSERT(RMUtilIdSet_MemUsage(s) < big);
+  RMUtilIdSet_Free(s);
+  free(many);
+  return 0;
+}
+
+int testIterator() {
+  size_t n = 10000;
+  uint64_t *ids = malloc(n * sizeof(*ids));
+  randomIds(ids, n, 7, 100);
+  RMUtilIdSet *s = RMUtil_NewIdSet(ids, n);
+
+  RMUtilIdSetIterator it;
+  RMUtilIdSet_Iterate(s, &it);
+  uint64_t id;
+  for (size_t i = 0; i < n; i++) {
+    ASSERT(RMUtilIdSetIterator_Next(&it, &id));
+    ASSERT_EQUAL(ids[i], id);
+  }
+  ASSERT(!RMUtilIdSetIterator_Next(&it, &id));
+
+  // skipping within a block, to an ID not in the set, across blocks and past the end
+  RMUtilIdSet_Iterate(s, &it);
+  ASSERT(RMUtilIdSetIterator_SkipTo(&it, ids[3], &id));
+  ASSERT_EQUAL(ids[3], id);
+  ASSERT(RMUtilIdSetIterator_SkipTo(&it, ids[10] - 1, &id));
+  ASSERT_EQUAL(ids[10], id);
+  ASSERT(RMUtilIdSetIterator_Next(&it, &id));
+  ASSERT_EQUAL(ids[11], id);
+  ASSERT(RMUtilIdSetIterator_SkipTo(&it, ids[5000], &id));
+  ASSERT_EQUAL(ids[5000], id);
+  // skipping backwards does not move
+  ASSERT(RMUtilIdSetIterator_SkipTo(&it, ids[0], &id));
+  ASSERT_EQUAL(ids[5001], id);
+  ASSERT(RMUtilIdSetIterator_SkipTo(&it, ids[n - 1], &id));
+  ASSERT_EQUAL(ids[n - 1], id);
+  ASSERT(!RMUtilIdSetIterator_SkipTo(&it, ids[n - 1] + 1, &id));
+  ASSERT(!RMUtilIdSetIterator_Next(&it, &id));
+
+  RMUtilIdSet_Free(s);
+  free(ids);
+  return 0;
+}
+
+int testKernels() {
+  size_t sizes[] = {0, 1, 3, 4, 5, 17, 100, 1000, 5000};
+  size_t numSizes = sizeof(sizes) / sizeof(sizes[0]);
+  uint64_t *a = malloc(5000 * sizeof(*a)), *b = malloc(5000 * sizeof(*b));
+  uint64_t *out = malloc(10000 * sizeof(*out)), *ref = malloc(10000 * sizeof(*ref));
+
+  for (int level = RMUTIL_IDSET_SCALAR; level <= RMUTIL_IDSET_AVX2; level++) {
+    RMUtil_SetIdSetSIMD(level);
+    for (size_t x = 0; x < numSizes; x++) {
+      for (size_t y = 0; y < numSizes; y++) {
+        size_t na = sizes[x], nb = sizes[y];
+        // dense and sparse overlaps
+        for (uint64_t gap = 2; gap <= 64; gap *= 8) {
+          randomIds(a, na, nextRand() % 4, gap);
+          randomIds(b, nb, nextRand() % 4, gap);
+          size_t n = refIntersect(a, na, b, nb, ref);
+          ASSERT_EQUAL(n, RMUtil_IntersectSorted(a, na, b, nb, out));
+          ASSERT(!memcmp(ref, out, n * sizeof(*out)));
+          n = refUnion(a, na, b, nb, ref);
+          ASSERT_EQUAL(n, RMUtil_UnionSorted(a, na, b, nb, out));
+          ASSERT(!memcmp(ref, out, n * sizeof(*out)));
+        }
+        // identical arrays match entirely
+        memcpy(b, a, na * sizeof(*a));
+        ASSERT_EQUAL(na, RMUtil_IntersectSorted(a, na, a, na, out));
+        ASSERT(!memcmp(a, out, na * sizeof(*out)));
+      }
+    }
+  }
+  RMUtil_SetIdSetSIMD(-1);
+  free(a);
+  free(b);
+  free(out);
+  free(ref);
+  return 0;
+}
+
+int testSetAlgebra() {
+  size_t n = 50000;
+  uint64_t *a = malloc(n * sizeof(*a)), *b = malloc(n * sizeof(*b));
+  uint64_t *ref = malloc(2 * n * sizeof(*ref));
+
+  // similar sets, a sparse set, and sets overlapping on a few blocks only
+  struct {
+    size_t na, nb;
+    uint64_t startA, gapA, startB, gapB;
+  } cases[] = {
+      {n, n, 0, 4, 0, 4},
+      {n, 200, 0, 4, 1000, 1000},
+      {n, n, 0, 3, 140000, 3},
+      {n, 0, 0, 3, 0, 1},
+  };
+  for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+    randomIds(a, cases[c].na, cases[c].startA, cases[c].gapA);
+    randomIds(b, cases[c].nb, cases[c].startB, cases[c].gapB);
+    RMUtilIdSet *sa = RMUtil_NewIdSet(a, cases[c].na), *sb = RMUtil_NewIdSet(b, cases[c].nb);
+
+    size_t k = refIntersect(a, cases[c].na, b, cases[c].nb, ref);
+    RMUtilIdSet *both = RMUtilIdSet_Intersect(sa, sb);
+    if (checkSet(both, ref, k)) return -1;
+    RMUtilIdSet_Free(both);
+    both = RMUtilIdSet_Intersect(sb, sa);
+    if (checkSet(both, ref, k)) return -1;
+    RMUtilIdSet_Free(both);
+
+    k = refUnion(a, cases[c].na, b, cases[c].nb, ref);
+    RMUtilIdSet *either = RMUtilIdSet_Union(sa, sb);
+    if (checkSet(either, ref, k)) return -1;
+    RMUtilIdSet_Free(either);
+    either = RMUtilIdSet_Union(sb, sa);
+    if (checkSet(either, ref, k)) return -1;
+    RMUtilIdSet_Free(either);
+
+    RMUtilIdSet_Free(sa);
+    RMUtilIdSet_Free(sb);
+  }
+  free(a);
+  free(b);
+  free(ref);
+  return 0;
+}
+
+/* An RDB stream in memory, read back in order */
+static struct {
+  uint64_t nums[4];
+  char *bufs[4];
+  size_t lens[4];
+  int numNums, numBufs, readNums, readBufs;
+} rdb;
+
+static void fakeSaveUnsigned(RedisModuleIO *io, uint64_t value) {
+  rdb.nums[rdb.numNums++] = value;
+}
+
+static void fakeSaveStringBuffer(RedisModuleIO *io, const char *str, size_t len) {
+  rdb.bufs[rdb.numBufs] = malloc(len + 1);
+  memcpy(rdb.bufs[rdb.numBufs], str, len);
+  rdb.lens[rdb.numBufs++] = len;
+}
+
+static uint64_t fakeLoadUnsigned(RedisModuleIO *io) {
+  return rdb.nums[rdb.readNums++];
+}
+
+static char *fakeLoadStringBuffer(RedisModuleIO *io, size_t *len) {
+  *len = rdb.lens[rdb.readBufs];
+  char *p = malloc(*len + 1);
+  memcpy(p, rdb.bufs[rdb.readBufs++], *len);
+  return p;
+}
+
+static void rdbRewind() {
+  rdb.readNums = rdb.readBufs = 0;
+}
+
+int testRDB() {
+  RedisModule_SaveUnsigned = fakeSaveUnsigned;
+  RedisModule_SaveStringBuffer = fakeSaveStringBuffer;
+  RedisModule_LoadUnsigned = fakeLoadUnsigned;
+  RedisModule_LoadStringBuffer = fakeLoadStringBuffer;
+  RedisModule_Free = free;
+
+  size_t n = 3000;
+  uint64_t *ids = malloc(n * sizeof(*ids));
+  randomIds(ids, n, 1ULL << 50, 1 << 20);
+  RMUtilIdSet *s = RMUtil_NewIdSet(ids, n);
+  RMUtilIdSet_Save(NULL, s);
+  RMUtilIdSet_Free(s);
+
+  s = RMUtilIdSet_Load(NULL);
+  ASSERT(s != NULL);
+  if (checkSet(s, ids, n)) return -1;
+  ASSERT(RMUtilIdSet_Contains(s, ids[n / 2]));
+  RMUtilIdSet_Free(s);
+
+  // a wrong size, a header out of order, and packed gaps cut short are refused
+  rdbRewind();
+  rdb.nums[0]++;
+  ASSERT(RMUtilIdSet_Load(NULL) == NULL);
+  rdb.nums[0]--;
+
+  rdbRewind();
+  rdb.bufs[0][8]++;
+  ASSERT(RMUtilIdSet_Load(NULL) == NULL);
+  rdb.bufs[0][8]--;
+
+  rdbRewind();
+  rdb.lens[1]--;
+  ASSERT(RMUtilIdSet_Load(NULL) == NULL);
+  rdb.lens[1]++;
+
+  rdbRewind();
+  rdb.lens[0]--;
+  ASSERT(RMUtilIdSet_Load(NULL) == NULL);
+  rdb.lens[0]++;
+
+  rdbRewind();
+  s = RMUtilIdSet_Load(NULL);
+  ASSERT(s != NULL);
+  RMUtilIdSet_Free(s);
+
+  free(rdb.bufs[0]);
+  free(rdb.bufs[1]);
+  free(ids);
+  return 0;
+}
+
+TEST_MAIN({
+  TESTFUNC(testBuild);
+  TESTFUNC(testIterator);
+  TESTFUNC(testKernels);
+  TESTFUNC(testSetAlgebra);
+  TESTFUNC(testRDB);
+});
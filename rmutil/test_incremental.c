@@ -0,0 +1,129 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+// define the module API pointers here, they are left NULL outside of redis
+#define REDISMODULE_MAIN
+#define REDISMODULE_EXPERIMENTAL_API
+#include "incremental.h"
+#include "priority_queue.h"
+#include "test.h"
+
+static const char *lastEvent;
+static mstime_t lastLatency;
+static int numSamples;
+
+static void fakeLatencyAddSample(const char *event, mstime_t latency) {
+  lastEvent = event;
+  lastLatency = latency;
+  numSamples++;
+}
+
+static RedisModuleTimerProc timerProc;
+static void *timerData;
+static int numTimers, numStopped;
+
+static RedisModuleTimerID fakeCreateTimer(RedisModuleCtx *ctx, mstime_t period,
+                                          RedisModuleTimerProc cb, void *data) {
+  timerProc = cb;
+  timerData = data;
+  return ++numTimers;
+}
+
+static int fakeStopTimer(RedisModuleCtx *ctx, RedisModuleTimerID id, void **data) {
+  numStopped++;
+  return id == (RedisModuleTimerID)numTimers ? REDISMODULE_OK : REDISMODULE_ERR;
+}
+
+/* A container with `left` units of work that take 100us each */
+typedef struct {
+  int left;
+  int calls;
+} slowWork;
+
+static int stepSlow(void *p, size_t budget) {
+  slowWork *w = p;
+  w->calls++;
+  for (size_t i = 0; i < budget && w->left > 0; i++, w->left--) {
+    struct timespec ts = {0, 100000};
+    nanosleep(&ts, NULL);
+  }
+  return w->left > 0;
+}
+
+static int stepQueue(void *pq, size_t budget) {
+  return Priority_Queue_Step(pq, budget);
+}
+
+static int cmpInt(void *a, void *b) {
+  int x = *(int *)a, y = *(int *)b;
+  return (x > y) - (x < y);
+}
+
+int testStepFor() {
+  RedisModule_LatencyAddSample = fakeLatencyAddSample;
+
+  // the time budget stops the steps, and the time taken is reported
+  slowWork w = {.left = 100};
+  ASSERT_EQUAL(1, RMUtil_StepFor(stepSlow, &w, 5, 2000, "slow-event"));
+  ASSERT(w.left > 0 && w.left < 100);
+  ASSERT_EQUAL(1, numSamples);
+  ASSERT_STRING_EQ("slow-event", lastEvent);
+  ASSERT(lastLatency >= 2);
+
+  // finishing stops right away
+  while (RMUtil_StepFor(stepSlow, &w, 5, 100000, "slow-event"))
+    ;
+  ASSERT_EQUAL(0, w.left);
+  int calls = w.calls;
+  ASSERT_EQUAL(0, RMUtil_StepFor(stepSlow, &w, 5, 100000, "slow-event"));
+  ASSERT_EQUAL(calls + 1, w.calls);
+
+  // nothing to do is not reported
+  numSamples = 0;
+  ASSERT_EQUAL(0, RMUtil_StepFor(stepSlow, &w, 5, 100000, "slow-event"));
+  ASSERT_EQUAL(0, numSamples);
+  RedisModule_LatencyAddSample = NULL;
+  return 0;
+}
+
+int testStepper() {
+  ASSERT(RMUtil_NewStepper(NULL, stepQueue, NULL, 1, 1, 1, NULL) == NULL);
+  RedisModule_CreateTimer = fakeCreateTimer;
+  RedisModule_StopTimer = fakeStopTimer;
+
+  PriorityQueue *pq = NewPriorityQueue(int, 0, cmpInt);
+  Vector_SetIncremental(pq->v, 1024);
+  // growing to 128K elements leaves most of the 64K elements to move
+  for (int i = 0; i < 65537; i++) {
+    Priority_Queue_Push(pq, (i * 7919) % 65537);
+  }
+  ASSERT(Vector_IsMigrating(pq->v));
+
+  RMUtilStepper *st = RMUtil_NewStepper(NULL, stepQueue, pq, 4096, 1000000, 10, "queue-grow");
+  ASSERT(st != NULL);
+  ASSERT_EQUAL(1, numTimers);
+  // each run schedules the next one
+  timerProc(NULL, timerData);
+  ASSERT_EQUAL(2, numTimers);
+  ASSERT(!Vector_IsMigrating(pq->v));
+  timerProc(NULL, timerData);
+  ASSERT_EQUAL(3, numTimers);
+
+  int top;
+  for (int i = 65536; i >= 0; i--) {
+    ASSERT(Priority_Queue_Top(pq, &top));
+    ASSERT_EQUAL(i, top);
+    Priority_Queue_Pop(pq);
+  }
+  RMUtilStepper_Stop(NULL, st);
+  ASSERT_EQUAL(1, numStopped);
+  Priority_Queue_Free(pq);
+  RedisModule_CreateTimer = NULL;
+  RedisModule_StopTimer = NULL;
+  return 0;
+}
+
+TEST_MAIN({
+  TESTFUNC(testStepFor);
+  TESTFUNC(testStepper);
+});
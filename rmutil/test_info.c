@@ -0,0 +1,238 @@
+#include <stdio.h>
+#include <string.h>
+// define the module API pointers here, they are left NULL outside of redis
+#define REDISMODULE_MAIN
+#define REDISMODULE_EXPERIMENTAL_API
+#include <redismodule.h>
+// test both ways of reading INFO, util.c is built with the same option
+#define RMUTIL_USE_SERVER_INFO
+#include "util.h"
+#include "test.h"
+
+static const char *infoText =
+    "# Server\r\n"
+    "redis_version:6.2.6\r\n"
+    "redis_mode:standalone\r\n"
+    "uptime_in_seconds:12345\r\n"
+    "\r\n"
+    "# Memory\r\n"
+    "used_memory:1048576\r\n"
+    "used_memory_human:1.00M\r\n"
+    "mem_fragmentation_ratio:1.25\r\n"
+    "maxmemory_policy:noeviction\r\n"
+    "empty_field:\r\n"
+    "\r\n"
+    "# Keyspace\r\n"
+    "db0:keys=10,expires=0,avg_ttl=0\r\n";
+
+int testParseInfo() {
+  RMUtilInfo *info = RMUtil_ParseRedisInfo(infoText, strlen(infoText));
+  ASSERT(info != NULL);
+  ASSERT_EQUAL(9, info->numEntries);
+
+  const char *str;
+  ASSERT(RMUtilInfo_GetString(info, "redis_version", &str));
+  ASSERT_STRING_EQ("6.2.6", str);
+  ASSERT(RMUtilInfo_GetString(info, "maxmemory_policy", &str));
+  ASSERT_STRING_EQ("noeviction", str);
+  ASSERT(RMUtilInfo_GetString(info, "db0", &str));
+  ASSERT_STRING_EQ("keys=10,expires=0,avg_ttl=0", str);
+  ASSERT(RMUtilInfo_GetString(info, "empty_field", &str));
+  ASSERT_STRING_EQ("", str);
+  ASSERT(!RMUtilInfo_GetString(info, "used_memory_peak", &str));
+  ASSERT(!RMUtilInfo_GetString(info, "used_memor", &str));
+  ASSERT(!RMUtilInfo_GetString(info, "Memory", &str));
+
+  long long ll;
+  ASSERT(RMUtilInfo_GetInt(info, "used_memory", &ll));
+  ASSERT_EQUAL(1048576, ll);
+  ASSERT(RMUtilInfo_GetInt(info, "uptime_in_seconds", &ll));
+  ASSERT_EQUAL(12345, ll);
+  ASSERT(!RMUtilInfo_GetInt(info, "maxmemory_policy", &ll));
+  ASSERT(!RMUtilInfo_GetInt(info, "nosuchfield", &ll));
+
+  double d;
+  ASSERT(RMUtilInfo_GetDouble(info, "mem_fragmentation_ratio", &d));
+  ASSERT_EQUAL(1.25, d);
+  ASSERT(!RMUtilInfo_GetDouble(info, "empty_field", &d));
+
+  // the source text is left untouched
+  ASSERT(strstr(infoText, "redis_version:6.2.6\r\n") != NULL);
+
+  RMUtilRedisInfo_Free(info);
+  return 0;
+}
+
+int testParseInfoEdges() {
+  // no trailing newline, bare \n line endings
+  const char *text = "a:1\nb:2\nc:3";
+  RMUtilInfo *info = RMUtil_ParseRedisInfo(text, strlen(text));
+  ASSERT_EQUAL(3, info->numEntries);
+  long long ll;
+  ASSERT(RMUtilInfo_GetInt(info, "c", &ll));
+  ASSERT_EQUAL(3, ll);
+  RMUtilRedisInfo_Free(info);
+
+  info = RMUtil_ParseRedisInfo("", 0);
+  ASSERT_EQUAL(0, info->numEntries);
+  ASSERT(!RMUtilInfo_GetInt(info, "a", &ll));
+  RMUtilRedisInfo_Free(info);
+
+  // many fields force probing in the index
+  char buf[64 * 1024];
+  size_t len = 0;
+  for (int i = 0; i < 2000; i++) {
+    len += sprintf(buf + len, "field_%d:%d\r\n", i, i * 3);
+  }
+  info = RMUtil_ParseRedisInfo(buf, len);
+  ASSERT_EQUAL(2000, info->numEntries);
+  for (int i = 0; i < 2000; i++) {
+    char key[32];
+    sprintf(key, "field_%d", i);
+    ASSERT(RMUtilInfo_GetInt(info, key, &ll));
+    ASSERT_EQUAL(i * 3, ll);
+  }
+  ASSERT(!RMUtilInfo_GetInt(info, "field_2000", &ll));
+  RMUtilRedisInfo_Free(info);
+  return 0;
+}
+
+/* Outside of redis, the server info API is stubbed by an RMUtilInfo parsed from infoText, and INFO
+ * calls reply with infoText */
+static int serverInfoCalls, infoCommandCalls, freed;
+static long long nowMs;
+
+static RedisModuleServerInfoData *stubGetServerInfo(RedisModuleCtx *ctx, const char *section) {
+  serverInfoCalls++;
+  return (RedisModuleServerInfoData *)RMUtil_ParseRedisInfo(infoText, strlen(infoText));
+}
+
+static void stubFreeServerInfo(RedisModuleCtx *ctx, RedisModuleServerInfoData *data) {
+  freed++;
+  RMUtilRedisInfo_Free((RMUtilInfo *)data);
+}
+
+static const char *stubServerInfoGetFieldC(RedisModuleServerInfoData *data, const char *field) {
+  const char *str;
+  return RMUtilInfo_GetString((RMUtilInfo *)data, field, &str) ? str : NULL;
+}
+
+static long long stubServerInfoGetFieldSigned(RedisModuleServerInfoData *data, const char *field,
+                                              int *err) {
+  long long ll;
+  *err = !RMUtilInfo_GetInt((RMUtilInfo *)data, field, &ll);
+  return ll;
+}
+
+static double stubServerInfoGetFieldDouble(RedisModuleServerInfoData *data, const char *field,
+                                           int *err) {
+  double d;
+  *err = !RMUtilInfo_GetDouble((RMUtilInfo *)data, field, &d);
+  return d;
+}
+
+static RedisModuleCallReply *stubCall(RedisModuleCtx *ctx, const char *cmd, const char *fmt, ...) {
+  infoCommandCalls++;
+  return (RedisModuleCallReply *)infoText;
+}
+
+static int stubCallReplyType(RedisModuleCallReply *reply) {
+  return REDISMODULE_REPLY_STRING;
+}
+
+static const char *stubCallReplyStringPtr(RedisModuleCallReply *reply, size_t *len) {
+  *len = strlen((const char *)reply);
+  return (const char *)reply;
+}
+
+static void stubFreeCallReply(RedisModuleCallReply *reply) {
+}
+
+static long long stubMilliseconds(void) {
+  return nowMs;
+}
+
+int testServerInfo() {
+  RedisModule_GetServerInfo = stubGetServerInfo;
+  RedisModule_FreeServerInfo = stubFreeServerInfo;
+  RedisModule_ServerInfoGetFieldC = stubServerInfoGetFieldC;
+  RedisModule_ServerInfoGetFieldSigned = stubServerInfoGetFieldSigned;
+  RedisModule_ServerInfoGetFieldDouble = stubServerInfoGetFieldDouble;
+  RedisModule_Call = stubCall;
+  RedisModule_CallReplyType = stubCallReplyType;
+  RedisModule_CallReplyStringPtr = stubCallReplyStringPtr;
+  RedisModule_FreeCallReply = stubFreeCallReply;
+  serverInfoCalls = infoCommandCalls = freed = 0;
+
+  // the native API is used when the server has it
+  RMUtilInfo *info = RMUtil_GetRedisInfoSection(NULL, "memory");
+  ASSERT(info != NULL);
+  ASSERT_EQUAL(1, serverInfoCalls);
+  ASSERT_EQUAL(0, infoCommandCalls);
+
+  long long ll;
+  double d;
+  const char *str;
+  ASSERT(RMUtilInfo_GetInt(info, "used_memory", &ll));
+  ASSERT_EQUAL(1048576, ll);
+  ASSERT(!RMUtilInfo_GetInt(info, "maxmemory_policy", &ll));
+  ASSERT(RMUtilInfo_GetDouble(info, "mem_fragmentation_ratio", &d));
+  ASSERT_EQUAL(1.25, d);
+  ASSERT(RMUtilInfo_GetString(info, "maxmemory_policy", &str));
+  ASSERT_STRING_EQ("noeviction", str);
+  ASSERT(!RMUtilInfo_GetString(info, "nosuchfield", &str));
+  // the server info API can't list the fields
+  ASSERT_EQUAL(0, info->numEntries);
+  RMUtilRedisInfo_Free(info);
+  ASSERT_EQUAL(1, freed);
+
+  // and INFO is called on servers that do not have it
+  RedisModule_GetServerInfo = NULL;
+  info = RMUtil_GetRedisInfo(NULL);
+  ASSERT(info != NULL);
+  ASSERT_EQUAL(1, infoCommandCalls);
+  ASSERT(RMUtilInfo_GetInt(info, "used_memory", &ll));
+  ASSERT_EQUAL(1048576, ll);
+  ASSERT_EQUAL(9, info->numEntries);
+  RMUtilRedisInfo_Free(info);
+  ASSERT_EQUAL(1, freed);
+  return 0;
+}
+
+int testInfoCache() {
+  RedisModule_GetServerInfo = stubGetServerInfo;
+  RedisModule_Milliseconds = stubMilliseconds;
+  serverInfoCalls = freed = 0;
+  nowMs = 1000;
+
+  RMUtilInfoCache *cache = RMUtil_NewInfoCache("memory", 10);
+  RMUtilInfo *info = RMUtilInfoCache_Get(cache, NULL);
+  ASSERT(info != NULL);
+  ASSERT_EQUAL(1, serverInfoCalls);
+
+  // reads within the ttl reuse the snapshot
+  nowMs = 1009;
+  ASSERT(RMUtilInfoCache_Get(cache, NULL) == info);
+  ASSERT_EQUAL(1, serverInfoCalls);
+
+  nowMs = 1010;
+  info = RMUtilInfoCache_Get(cache, NULL);
+  ASSERT_EQUAL(2, serverInfoCalls);
+  ASSERT_EQUAL(1, freed);
+
+  RMUtilInfoCache_Invalidate(cache);
+  ASSERT_EQUAL(2, freed);
+  RMUtilInfoCache_Get(cache, NULL);
+  ASSERT_EQUAL(3, serverInfoCalls);
+
+  RMUtilInfoCache_Free(cache);
+  ASSERT_EQUAL(3, freed);
+  return 0;
+}
+
+TEST_MAIN({
+  TESTFUNC(testParseInfo);
+  TESTFUNC(testParseInfoEdges);
+  TESTFUNC(testServerInfo);
+  TESTFUNC(testInfoCache);
+});
@@ -1,4 +1,7 @@
 #include <stdio.h>
+// define the module API pointers here, they are left NULL outside of redis
+#define REDISMODULE_MAIN
+#define REDISMODULE_EXPERIMENTAL_API
 #include <redismodule.h>
 #include <unistd.h>
 #include "periodic.h"
@@ -11,10 +14,16 @@ void timerCb(RedisModuleCtx *ctx, void *p) {
 }
 
 int testPeriodic() {
+  // the number of worker threads can only be set before the first timer is created
+  ASSERT_EQUAL(REDISMODULE_ERR, RMUtilTimer_SetNumThreads(0));
+  ASSERT_EQUAL(REDISMODULE_OK, RMUtilTimer_SetNumThreads(2));
+
   int x = 0;
   struct RMUtilTimer *tm = RMUtil_NewPeriodicTimer(
       timerCb, NULL, &x, (struct timespec){.tv_sec = 0, .tv_nsec = 10000000});
 
+  ASSERT_EQUAL(REDISMODULE_ERR, RMUtilTimer_SetNumThreads(4));
+
   sleep(1);
 
   ASSERT_EQUAL(0, RMUtilTimer_Terminate(tm));
@@ -23,4 +32,233 @@ int testPeriodic() {
   return 0;
 }
 
-TEST_MAIN({ TESTFUNC(testPeriodic); });
+#define NUM_TIMERS 200
+
+static int terminated = 0;
+
+void timerTerm(void *p) {
+  __atomic_fetch_add(&terminated, 1, __ATOMIC_SEQ_CST);
+}
+
+int testManyTimers() {
+  static int counters[NUM_TIMERS];
+  struct RMUtilTimer *timers[NUM_TIMERS];
+  for (int i = 0; i < NUM_TIMERS; i++) {
+    // spread the timers between 5ms and 50ms intervals
+    long ns = (5 + (i % 10) * 5) * 1000000L;
+    timers[i] = RMUtil_NewPeriodicTimer(timerCb, timerTerm, &counters[i],
+                                        (struct timespec){.tv_sec = 0, .tv_nsec = ns});
+  }
+  // a timer far in the future is never fired, but can still be terminated
+  int never = 0;
+  struct RMUtilTimer *far =
+      RMUtil_NewPeriodicTimer(timerCb, timerTerm, &never, (struct timespec){.tv_sec = 100000});
+
+  usleep(500000);
+
+  for (int i = 0; i < NUM_TIMERS; i++) {
+    ASSERT_EQUAL(0, RMUtilTimer_Terminate(timers[i]));
+  }
+  ASSERT_EQUAL(0, RMUtilTimer_Terminate(far));
+  usleep(100000);
+
+  ASSERT_EQUAL(NUM_TIMERS + 1, __atomic_load_n(&terminated, __ATOMIC_SEQ_CST));
+  ASSERT_EQUAL(0, never);
+  for (int i = 0; i < NUM_TIMERS; i++) {
+    int expected = 500 / (5 + (i % 10) * 5);
+    ASSERT(counters[i] > expected / 2);
+    ASSERT(counters[i] <= expected);
+  }
+  return 0;
+}
+
+int testSetInterval() {
+  int x = 0;
+  struct RMUtilTimer *tm = RMUtil_NewPeriodicTimer(
+      timerCb, NULL, &x, (struct timespec){.tv_sec = 0, .tv_nsec = 100000000});
+  RMUtilTimer_SetInterval(tm, (struct timespec){.tv_sec = 0, .tv_nsec = 5000000});
+  usleep(500000);
+  ASSERT_EQUAL(0, RMUtilTimer_Terminate(tm));
+  // the first trigger is after 100ms, then every 5ms
+  ASSERT(x > 40);
+  ASSERT(x <= 81);
+  return 0;
+}
+
+void slowTimerCb(RedisModuleCtx *ctx, void *p) {
+  int *x = p;
+  (*x)++;
+  // take 3ms out of a 10ms period
+  usleep(3000);
+}
+
+void stallingTimerCb(RedisModuleCtx *ctx, void *p) {
+  int *x = p;
+  // stall for 5 periods on the first run
+  if ((*x)++ == 0) usleep(50000);
+}
+
+int testFixedRate() {
+  struct timespec interval = {.tv_sec = 0, .tv_nsec = 10000000};
+  RMUtilTimerOptions rate = {.mode = RMUTIL_TIMER_FIXED_RATE};
+  int x = 0, y = 0;
+  struct RMUtilTimer *fixedRate = RMUtil_NewPeriodicTimerEx(slowTimerCb, NULL, &x, interval, &rate);
+  usleep(505000);
+
+  RMUtilTimerStats stats;
+  RMUtilTimer_GetStats(fixedRate, &stats);
+  ASSERT_EQUAL(0, RMUtilTimer_Terminate(fixedRate));
+  ASSERT(stats.runs > 0 && stats.runs <= 50);
+  ASSERT(stats.maxDurationNs >= 3000000);
+  ASSERT(stats.totalDurationNs >= stats.runs * 3000000ULL);
+  // the fixed rate timer keeps its period even if runs were skipped because the callback ran late
+  ASSERT(stats.runs + stats.missed >= 49 && stats.runs + stats.missed <= 50);
+
+  struct RMUtilTimer *fixedDelay = RMUtil_NewPeriodicTimerEx(slowTimerCb, NULL, &y, interval, NULL);
+  usleep(505000);
+  RMUtilTimer_GetStats(fixedDelay, &stats);
+  ASSERT_EQUAL(0, RMUtilTimer_Terminate(fixedDelay));
+  // while the fixed delay one drifts by the callback time
+  ASSERT(stats.runs <= 40);
+  ASSERT_EQUAL(0, stats.missed);
+  return 0;
+}
+
+int testCatchup() {
+  struct timespec interval = {.tv_sec = 0, .tv_nsec = 10000000};
+  RMUtilTimerOptions skip = {.mode = RMUTIL_TIMER_FIXED_RATE, .catchup = RMUTIL_TIMER_CATCHUP_SKIP};
+  RMUtilTimerOptions burst = {.mode = RMUTIL_TIMER_FIXED_RATE,
+                              .catchup = RMUTIL_TIMER_CATCHUP_BURST};
+  int x = 0, y = 0;
+  struct RMUtilTimer *skipping = RMUtil_NewPeriodicTimerEx(stallingTimerCb, NULL, &x, interval, &skip);
+  usleep(205000);
+  RMUtilTimerStats stats;
+  RMUtilTimer_GetStats(skipping, &stats);
+  ASSERT_EQUAL(0, RMUtilTimer_Terminate(skipping));
+  ASSERT(stats.missed >= 4);
+  ASSERT(x + stats.missed >= 19 && x + stats.missed <= 20);
+
+  struct RMUtilTimer *bursting =
+      RMUtil_NewPeriodicTimerEx(stallingTimerCb, NULL, &y, interval, &burst);
+  usleep(205000);
+  RMUtilTimer_GetStats(bursting, &stats);
+  ASSERT_EQUAL(0, RMUtilTimer_Terminate(bursting));
+  ASSERT_EQUAL(0, stats.missed);
+  ASSERT(y >= 18 && y <= 20);
+  // the runs made up for after the stall started late
+  ASSERT(stats.maxLatenessNs >= 30000000);
+  return 0;
+}
+
+/* Stubs of the thread safe context API, counting lock acquisitions */
+int testCascadeWakeup() {
+  // timers waiting in the upper levels of the wheel are not held back by shorter timers due after
+  // them: with 2 threads, each of the 40ms timers shares a thread with some of the 65ms ones
+  struct timespec longInterval = {.tv_sec = 0, .tv_nsec = 65000000};
+  struct timespec shortInterval = {.tv_sec = 0, .tv_nsec = 40000000};
+  int counters[6] = {0};
+  struct RMUtilTimer *timers[6];
+  for (int i = 0; i < 4; i++) {
+    timers[i] = RMUtil_NewPeriodicTimer(timerCb, NULL, &counters[i], longInterval);
+  }
+  usleep(58000);
+  for (int i = 4; i < 6; i++) {
+    timers[i] = RMUtil_NewPeriodicTimer(timerCb, NULL, &counters[i], shortInterval);
+  }
+  usleep(400000);
+
+  for (int i = 0; i < 6; i++) {
+    RMUtilTimerStats stats;
+    RMUtilTimer_GetStats(timers[i], &stats);
+    ASSERT_EQUAL(0, RMUtilTimer_Terminate(timers[i]));
+    ASSERT(stats.runs > 0);
+    ASSERT(stats.maxLatenessNs < 15000000);
+  }
+  return 0;
+}
+
+static int gilHeld = 0, gilAcquisitions = 0;
+
+static RedisModuleCtx *stubGetThreadSafeContext(RedisModuleBlockedClient *bc) {
+  return (RedisModuleCtx *)&gilHeld;
+}
+static void stubFreeThreadSafeContext(RedisModuleCtx *ctx) {
+}
+static void stubLock(RedisModuleCtx *ctx) {
+  __atomic_store_n(&gilHeld, 1, __ATOMIC_SEQ_CST);
+  __atomic_fetch_add(&gilAcquisitions, 1, __ATOMIC_SEQ_CST);
+}
+static void stubUnlock(RedisModuleCtx *ctx) {
+  __atomic_store_n(&gilHeld, 0, __ATOMIC_SEQ_CST);
+}
+
+void lockedTimerCb(RedisModuleCtx *ctx, void *p) {
+  int *x = p;
+  // count only the runs where the scheduler held the lock for us
+  if (ctx && __atomic_load_n(&gilHeld, __ATOMIC_SEQ_CST)) (*x)++;
+}
+
+void slowLockedTimerCb(RedisModuleCtx *ctx, void *p) {
+  lockedTimerCb(ctx, p);
+  usleep(1000);
+}
+
+int testLockedBatch() {
+  RedisModule_GetThreadSafeContext = stubGetThreadSafeContext;
+  RedisModule_FreeThreadSafeContext = stubFreeThreadSafeContext;
+  RedisModule_ThreadSafeContextLock = stubLock;
+  RedisModule_ThreadSafeContextUnlock = stubUnlock;
+
+  // timers due in the same tick share a single lock acquisition
+  static int counters[NUM_TIMERS];
+  struct RMUtilTimer *timers[NUM_TIMERS];
+  RMUtilTimerOptions opts = {.mode = RMUTIL_TIMER_FIXED_RATE, .lock = 1};
+  RMUtilTimer_SetLockBudget((struct timespec){.tv_sec = 1});
+  for (int i = 0; i < NUM_TIMERS; i++) {
+    timers[i] = RMUtil_NewPeriodicTimerEx(lockedTimerCb, NULL, &counters[i],
+                                          (struct timespec){.tv_sec = 0, .tv_nsec = 50000000}, &opts);
+  }
+  usleep(260000);
+  for (int i = 0; i < NUM_TIMERS; i++) {
+    ASSERT_EQUAL(0, RMUtilTimer_Terminate(timers[i]));
+  }
+  int runs = 0;
+  for (int i = 0; i < NUM_TIMERS; i++) {
+    runs += counters[i];
+  }
+  ASSERT(runs >= 4 * NUM_TIMERS);
+  ASSERT(__atomic_load_n(&gilAcquisitions, __ATOMIC_SEQ_CST) < runs / 10);
+
+  // a tight budget makes the scheduler yield the lock between slow callbacks
+  int x = 0, y = 0;
+  RMUtilTimer_SetLockBudget((struct timespec){.tv_sec = 0, .tv_nsec = 1});
+  __atomic_store_n(&gilAcquisitions, 0, __ATOMIC_SEQ_CST);
+  struct RMUtilTimer *t1 = RMUtil_NewPeriodicTimerEx(
+      slowLockedTimerCb, NULL, &x, (struct timespec){.tv_sec = 0, .tv_nsec = 20000000}, &opts);
+  struct RMUtilTimer *t2 = RMUtil_NewPeriodicTimerEx(
+      slowLockedTimerCb, NULL, &y, (struct timespec){.tv_sec = 0, .tv_nsec = 20000000}, &opts);
+  usleep(110000);
+  ASSERT_EQUAL(0, RMUtilTimer_Terminate(t1));
+  ASSERT_EQUAL(0, RMUtilTimer_Terminate(t2));
+  usleep(50000);
+  ASSERT(x > 0 && y > 0);
+  ASSERT_EQUAL(x + y, __atomic_load_n(&gilAcquisitions, __ATOMIC_SEQ_CST));
+  ASSERT_EQUAL(0, __atomic_load_n(&gilHeld, __ATOMIC_SEQ_CST));
+
+  RMUtilTimer_SetLockBudget((struct timespec){.tv_sec = 0, .tv_nsec = 1000000});
+  RedisModule_GetThreadSafeContext = NULL;
+  RedisModule_FreeThreadSafeContext = NULL;
+  RedisModule_ThreadSafeContextLock = NULL;
+  RedisModule_ThreadSafeContextUnlock = NULL;
+  return 0;
+}
+
+TEST_MAIN({
+  TESTFUNC(testPeriodic);
+  TESTFUNC(testManyTimers);
+  TESTFUNC(testSetInterval);
+  TESTFUNC(testFixedRate);
+  TESTFUNC(testCatchup);
+  TESTFUNC(testCascadeWakeup);
+  TESTFUNC(testLockedBatch);
+});
@@ -8,6 +8,108 @@ int cmp(void* i1, void* i2) {
     return *__i1 - *__i2;
 }
 
+static void testBatch() {
+    PriorityQueue *pq = NewPriorityQueue(int, 0, cmp);
+
+    // a small batch into a large queue is sifted up, a large batch is heapified
+    int batch[1000];
+    for (int i = 0; i < 1000; i++) {
+        batch[i] = (i * 7919) % 1000;
+    }
+    Priority_Queue_PushMany(pq, batch, 1000);
+    assert(1000 == Priority_Queue_Size(pq));
+    Priority_Queue_PushMany(pq, batch, 3);
+    assert(1003 == Priority_Queue_Size(pq));
+    Priority_Queue_PushMany(pq, NULL, 0);
+    assert(1003 == Priority_Queue_Size(pq));
+
+    int out[600];
+    assert(600 == Priority_Queue_PopMany(pq, out, 600));
+    for (int i = 1; i < 600; i++) {
+        assert(out[i - 1] >= out[i]);
+    }
+    assert(999 == out[0]);
+    assert(403 == Priority_Queue_Size(pq));
+
+    int n;
+    Priority_Queue_Top(pq, &n);
+    assert(n <= out[599]);
+    assert(3 == Priority_Queue_PopMany(pq, NULL, 3));
+    assert(400 == Priority_Queue_PopMany(pq, out, 600));
+    for (int i = 1; i < 400; i++) {
+        assert(out[i - 1] >= out[i]);
+    }
+    assert(0 == Priority_Queue_Size(pq));
+
+    Priority_Queue_Free(pq);
+}
+
+static void testIndexedPriorityQueue() {
+    IndexedPriorityQueue *pq = NewIndexedPriorityQueue(int, 2, cmp);
+    assert(0 == Indexed_Priority_Queue_Size(pq));
+    assert(0 == Indexed_Priority_Queue_Top(pq, NULL, NULL));
+
+    PriorityQueueHandle handles[100];
+    for (int i = 0; i < 100; i++) {
+        handles[i] = Indexed_Priority_Queue_Push(pq, i);
+    }
+    assert(100 == Indexed_Priority_Queue_Size(pq));
+
+    int n;
+    PriorityQueueHandle h;
+    Indexed_Priority_Queue_Top(pq, &n, &h);
+    assert(99 == n);
+    assert(handles[99] == h);
+
+    // decrease the top, increase a low element
+    assert(1 == Indexed_Priority_Queue_UpdatePriority(pq, handles[99], -1));
+    assert(1 == Indexed_Priority_Queue_UpdatePriority(pq, handles[10], 1000));
+    Indexed_Priority_Queue_Top(pq, &n, &h);
+    assert(1000 == n);
+    assert(handles[10] == h);
+
+    // remove from the middle
+    assert(1 == Indexed_Priority_Queue_Remove(pq, handles[50], &n));
+    assert(50 == n);
+    assert(0 == Indexed_Priority_Queue_Contains(pq, handles[50]));
+    assert(0 == Indexed_Priority_Queue_Remove(pq, handles[50], NULL));
+    assert(0 == Indexed_Priority_Queue_UpdatePriority(pq, handles[50], 5));
+    assert(99 == Indexed_Priority_Queue_Size(pq));
+
+    Indexed_Priority_Queue_Pop(pq);
+    assert(0 == Indexed_Priority_Queue_Contains(pq, handles[10]));
+    assert(1 == Indexed_Priority_Queue_Contains(pq, handles[99]));
+    assert(1 == Indexed_Priority_Queue_Get(pq, handles[99], &n));
+    assert(-1 == n);
+
+    // the remaining elements come out in order
+    int prev = 1 << 30, count = 0;
+    while (Indexed_Priority_Queue_Top(pq, &n, &h)) {
+        assert(n <= prev);
+        assert(1 == Indexed_Priority_Queue_Contains(pq, h));
+        prev = n;
+        count++;
+        Indexed_Priority_Queue_Pop(pq);
+        assert(0 == Indexed_Priority_Queue_Contains(pq, h));
+    }
+    assert(98 == count);
+    assert(-1 == prev);
+
+    // slots are reused after being released, but stale handles stay invalid
+    h = Indexed_Priority_Queue_Push(pq, 7);
+    assert((uint32_t)h < 100);
+    for (int i = 0; i < 100; i++) {
+        assert(h != handles[i]);
+        assert(0 == Indexed_Priority_Queue_Contains(pq, handles[i]));
+        assert(0 == Indexed_Priority_Queue_Remove(pq, handles[i], NULL));
+        assert(0 == Indexed_Priority_Queue_UpdatePriority(pq, handles[i], 3));
+    }
+    assert(1 == Indexed_Priority_Queue_Contains(pq, h));
+    assert(1 == Indexed_Priority_Queue_Get(pq, h, &n));
+    assert(7 == n);
+    Indexed_Priority_Queue_Free(pq);
+}
+
 int main(int argc, char **argv) {
     PriorityQueue *pq = NewPriorityQueue(int, 10, cmp);
     assert(0 == Priority_Queue_Size(pq));
@@ -32,6 +134,9 @@ int main(int argc, char **argv) {
     assert(15 == n);
 
     Priority_Queue_Free(pq);
+
+    testBatch();
+    testIndexedPriorityQueue();
     printf("PASS!\n");
     return 0;
 }
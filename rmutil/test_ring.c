@@ -0,0 +1,254 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <poll.h>
+#include <sched.h>
+#include <unistd.h>
+// define the module API pointers here, they are left NULL outside of redis
+#define REDISMODULE_MAIN
+#include "ring.h"
+#include "test.h"
+
+#define PRODUCERS 4
+#define CONSUMERS 4
+#define PER_PRODUCER 100000
+
+/* Items are the producer number in the high bits and a counter in the low ones, plus 1 so none
+ * is NULL */
+#define ITEM(p, i) ((void *)(uintptr_t)(((uint64_t)(p) << 32 | (i)) + 1))
+#define ITEM_PRODUCER(it) (((uintptr_t)(it)-1) >> 32)
+#define ITEM_INDEX(it) (((uintptr_t)(it)-1) & 0xffffffff)
+
+typedef struct {
+  RMUtilRing *r;
+  int id;
+  int batch;
+} producerArgs;
+
+static void *producer(void *p) {
+  producerArgs *a = p;
+  void *items[8];
+  for (uint32_t i = 0; i < PER_PRODUCER;) {
+    size_t n = a->batch ? 1 + i % 8 : 1;
+    if (n > PER_PRODUCER - i) n = PER_PRODUCER - i;
+    for (size_t j = 0; j < n; j++) items[j] = ITEM(a->id, i + j);
+    size_t pushed = RMUtilRing_PushMany(a->r, items, n);
+    // partial batches push the first items
+    if (!pushed) sched_yield();
+    i += pushed;
+  }
+  return NULL;
+}
+
+typedef struct {
+  RMUtilRing *r;
+  uint8_t *seen;
+  size_t *popped;
+} consumerArgs;
+
+static void *consumer(void *p) {
+  consumerArgs *a = p;
+  void *items[16];
+  while (__atomic_load_n(a->popped, __ATOMIC_RELAXED) < PRODUCERS * PER_PRODUCER) {
+    size_t n = RMUtilRing_PopMany(a->r, items, 1 + rand() % 16);
+    if (!n) sched_yield();
+    for (size_t i = 0; i < n; i++) {
+      __atomic_fetch_add(&a->seen[ITEM_PRODUCER(items[i]) * PER_PRODUCER + ITEM_INDEX(items[i])],
+                         1, __ATOMIC_RELAXED);
+    }
+    __atomic_fetch_add(a->popped, n, __ATOMIC_RELAXED);
+  }
+  return NULL;
+}
+
+int testSingleThread() {
+  RMUtilRing *r = RMUtil_NewRing(RMUTIL_RING_SPSC, 100, 0);
+  ASSERT_EQUAL(128, RMUtilRing_Cap(r));
+  ASSERT_EQUAL(-1, RMUtilRing_Fd(r));
+  void *item;
+  ASSERT_EQUAL(0, RMUtilRing_Pop(r, &item));
+  ASSERT_EQUAL(0, RMUtilRing_Wait(r, 10));
+
+  // fill it up, then go around a few times in batches
+  for (uintptr_t i = 0; i < 128; i++) {
+    ASSERT_EQUAL(REDISMODULE_OK, RMUtilRing_Push(r, (void *)i));
+  }
+  ASSERT_EQUAL(REDISMODULE_ERR, RMUtilRing_Push(r, (void *)1));
+  ASSERT_EQUAL(128, RMUtilRing_Size(r));
+  ASSERT_EQUAL(1, RMUtilRing_Wait(r, 10));
+
+  uintptr_t next = 0, last = 128;
+  void *items[100];
+  for (int round = 0; round < 100; round++) {
+    size_t n = RMUtilRing_PopMany(r, items, 1 + round % 100);
+    ASSERT_EQUAL(n, (size_t)(1 + round % 100));
+    for (size_t i = 0; i < n; i++) {
+      ASSERT_EQUAL(next, (uintptr_t)items[i]);
+      next++;
+    }
+    // pushing more than there is room for pushes the first items
+    for (size_t i = 0; i < 100; i++) items[i] = (void *)(last + i);
+    size_t pushed = RMUtilRing_PushMany(r, items, 100);
+    ASSERT_EQUAL(n, pushed);
+    last += pushed;
+    ASSERT_EQUAL(last - next, RMUtilRing_Size(r));
+  }
+  while (RMUtilRing_Pop(r, &item)) {
+    ASSERT_EQUAL(next, (uintptr_t)item);
+    next++;
+  }
+  ASSERT_EQUAL(last, next);
+  ASSERT_EQUAL(0, RMUtilRing_Size(r));
+  ASSERT_EQUAL(0, RMUtilRing_PopMany(r, items, 100));
+  RMUtilRing_Free(r);
+
+  // the smallest ring still tells full from empty
+  r = RMUtil_NewRing(RMUTIL_RING_MPMC, 0, 0);
+  ASSERT_EQUAL(2, RMUtilRing_Cap(r));
+  for (uintptr_t i = 0; i < 10; i++) {
+    ASSERT_EQUAL(REDISMODULE_OK, RMUtilRing_Push(r, (void *)i));
+    ASSERT_EQUAL(REDISMODULE_OK, RMUtilRing_Push(r, (void *)(i + 1)));
+    ASSERT_EQUAL(REDISMODULE_ERR, RMUtilRing_Push(r, (void *)i));
+    ASSERT_EQUAL(1, RMUtilRing_Pop(r, &item));
+    ASSERT_EQUAL(i, (uintptr_t)item);
+    ASSERT_EQUAL(1, RMUtilRing_Pop(r, &item));
+    ASSERT_EQUAL(i + 1, (uintptr_t)item);
+    ASSERT_EQUAL(0, RMUtilRing_Pop(r, &item));
+  }
+  RMUtilRing_Free(r);
+  return 0;
+}
+
+/* Run `nproducers` producers into a ring drained by one consumer, checking the order of each */
+static int checkProducers(RMUtilRingMode mode, int nproducers, int batch) {
+  RMUtilRing *r = RMUtil_NewRing(mode, 64, 0);
+  pthread_t threads[PRODUCERS];
+  producerArgs args[PRODUCERS];
+  for (int i = 0; i < nproducers; i++) {
+    args[i] = (producerArgs){r, i, batch};
+    pthread_create(&threads[i], NULL, producer, &args[i]);
+  }
+
+  uint32_t next[PRODUCERS] = {0};
+  void *items[32];
+  for (size_t total = 0; total < (size_t)nproducers * PER_PRODUCER;) {
+    size_t n = batch ? RMUtilRing_PopMany(r, items, 32) : RMUtilRing_Pop(r, items);
+    if (!n) sched_yield();
+    for (size_t i = 0; i < n; i++) {
+      uint32_t p = ITEM_PRODUCER(items[i]);
+      ASSERT(p < (uint32_t)nproducers);
+      ASSERT_EQUAL(next[p], ITEM_INDEX(items[i]));
+      next[p]++;
+    }
+    total += n;
+  }
+  for (int i = 0; i < nproducers; i++) pthread_join(threads[i], NULL);
+  ASSERT_EQUAL(0, RMUtilRing_Size(r));
+  RMUtilRing_Free(r);
+  return 0;
+}
+
+int testSPSC() {
+  if (checkProducers(RMUTIL_RING_SPSC, 1, 0)) return -1;
+  return checkProducers(RMUTIL_RING_SPSC, 1, 1);
+}
+
+int testMPSC() {
+  if (checkProducers(RMUTIL_RING_MPSC, PRODUCERS, 0)) return -1;
+  return checkProducers(RMUTIL_RING_MPSC, PRODUCERS, 1);
+}
+
+int testMPMC() {
+  RMUtilRing *r = RMUtil_NewRing(RMUTIL_RING_MPMC, 64, 0);
+  uint8_t *seen = calloc(PRODUCERS * PER_PRODUCER, 1);
+  size_t popped = 0;
+  pthread_t threads[PRODUCERS + CONSUMERS];
+  producerArgs pargs[PRODUCERS];
+  consumerArgs cargs = {r, seen, &popped};
+  for (int i = 0; i < PRODUCERS; i++) {
+    pargs[i] = (producerArgs){r, i, i % 2};
+    pthread_create(&threads[i], NULL, producer, &pargs[i]);
+  }
+  for (int i = 0; i < CONSUMERS; i++) {
+    pthread_create(&threads[PRODUCERS + i], NULL, consumer, &cargs);
+  }
+  for (int i = 0; i < PRODUCERS + CONSUMERS; i++) pthread_join(threads[i], NULL);
+
+  // every item was popped exactly once
+  ASSERT_EQUAL(PRODUCERS * PER_PRODUCER, popped);
+  for (size_t i = 0; i < PRODUCERS * PER_PRODUCER; i++) {
+    ASSERT_EQUAL(1, seen[i]);
+  }
+  ASSERT_EQUAL(0, RMUtilRing_Size(r));
+  free(seen);
+  RMUtilRing_Free(r);
+  return 0;
+}
+
+static void *delayedPush(void *p) {
+  usleep(20000);
+  RMUtilRing_Push(p, (void *)1);
+  return NULL;
+}
+
+static void *producerPacer(void *p) {
+  // push in bursts with pauses, so the consumer keeps draining the ring and going to sleep
+  for (uintptr_t i = 1; i <= 2000; i++) {
+    while (RMUtilRing_Push(p, (void *)i) != REDISMODULE_OK) sched_yield();
+    if (i % 16 == 0) usleep(50);
+  }
+  return NULL;
+}
+
+int testWakeup() {
+  RMUtilRing *r = RMUtil_NewRing(RMUTIL_RING_MPSC, 16, RMUTIL_RING_WAKEUP);
+  ASSERT(r != NULL);
+  int fd = RMUtilRing_Fd(r);
+  ASSERT(fd >= 0);
+  struct pollfd p = {.fd = fd, .events = POLLIN};
+  ASSERT_EQUAL(0, poll(&p, 1, 0));
+  ASSERT_EQUAL(0, RMUtilRing_Wait(r, 10));
+
+  // pushing to the drained ring makes the descriptor readable, Wait clears it
+  ASSERT_EQUAL(REDISMODULE_OK, RMUtilRing_Push(r, (void *)1));
+  ASSERT_EQUAL(1, poll(&p, 1, 0));
+  ASSERT_EQUAL(1, RMUtilRing_Wait(r, -1));
+  ASSERT_EQUAL(0, poll(&p, 1, 0));
+  // the ring was not drained, so this push does not signal
+  ASSERT_EQUAL(REDISMODULE_OK, RMUtilRing_Push(r, (void *)2));
+  ASSERT_EQUAL(0, poll(&p, 1, 0));
+  void *item;
+  ASSERT_EQUAL(1, RMUtilRing_Pop(r, &item));
+  ASSERT_EQUAL(1, RMUtilRing_Pop(r, &item));
+  ASSERT_EQUAL(0, RMUtilRing_Pop(r, &item));
+
+  // a sleeping consumer is woken by another thread
+  pthread_t t;
+  pthread_create(&t, NULL, delayedPush, r);
+  ASSERT_EQUAL(1, RMUtilRing_Wait(r, -1));
+  ASSERT_EQUAL(1, RMUtilRing_Pop(r, &item));
+  pthread_join(t, NULL);
+
+  // no wakeup is lost: the consumer only ever sleeps in Wait, without a timeout
+  pthread_create(&t, NULL, producerPacer, r);
+  uintptr_t next = 1;
+  while (next <= 2000 && RMUtilRing_Wait(r, -1)) {
+    while (RMUtilRing_Pop(r, &item)) {
+      ASSERT_EQUAL(next, (uintptr_t)item);
+      next++;
+    }
+  }
+  pthread_join(t, NULL);
+  RMUtilRing_Free(r);
+  return 0;
+}
+
+TEST_MAIN({
+  TESTFUNC(testSingleThread);
+  TESTFUNC(testSPSC);
+  TESTFUNC(testMPSC);
+  TESTFUNC(testMPMC);
+  TESTFUNC(testWakeup);
+});
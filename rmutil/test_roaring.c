@@ -0,0 +1,330 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+// define the module API pointers here, they are left NULL outside of redis
+#define REDISMODULE_MAIN
+#include "roaring.h"
+#include "test.h"
+
+/* The IDs the tests use, over 6 containers */
+#define U (6 << 16)
+
+static uint64_t rnd = 88172645463325252ULL;
+static uint64_t nextRand() {
+  rnd ^= rnd << 13;
+  rnd ^= rnd >> 7;
+  rnd ^= rnd << 17;
+  return rnd;
+}
+
+/* Check the bitmap holds exactly the IDs set in ref */
+static int checkBitmap(const RMUtilRoaring *r, const uint8_t *ref) {
+  uint64_t card = 0;
+  for (uint32_t i = 0; i < U; i++) card += ref[i];
+  ASSERT_EQUAL(card, RMUtilRoaring_Cardinality(r));
+
+  RMUtilRoaringIterator it;
+  RMUtilRoaring_Iterate(r, &it);
+  uint32_t id, n = 0;
+  int64_t last = -1;
+  while (RMUtilRoaringIterator_Next(&it, &id)) {
+    ASSERT((int64_t)id > last);
+    ASSERT(id < U);
+    ASSERT(ref[id]);
+    last = id;
+    n++;
+  }
+  ASSERT_EQUAL(card, n);
+  return 0;
+}
+
+/* Fill a bitmap and its reference with containers of every kind: sparse, dense, a few ranges, a
+ * container of 4096 IDs and one of long ranges turned to runs */
+static RMUtilRoaring *randomBitmap(uint8_t *ref) {
+  RMUtilRoaring *r = RMUtil_NewRoaring();
+  memset(ref, 0, U);
+  for (int i = 0; i < 300; i++) {
+    uint32_t id = nextRand() % 65536;
+    RMUtilRoaring_Add(r, id);
+    ref[id] = 1;
+  }
+  for (int i = 0; i < 40000; i++) {
+    uint32_t id = (1 << 16) + nextRand() % 65536;
+    RMUtilRoaring_Add(r, id);
+    ref[id] = 1;
+  }
+  for (int i = 0; i < 5; i++) {
+    uint32_t start = (2 << 16) + nextRand() % 60000, len = nextRand() % 2000;
+    RMUtilRoaring_AddRange(r, start, start + len);
+    memset(ref + start, 1, len + 1);
+  }
+  for (uint32_t i = 0; i < 4096; i++) {
+    RMUtilRoaring_Add(r, (4 << 16) + i * 16);
+    ref[(4 << 16) + i * 16] = 1;
+  }
+  for (uint32_t i = 0; i < 65536; i++) {
+    if ((i / 1000) % 3 != 0) {
+      RMUtilRoaring_Add(r, (5 << 16) + i);
+      ref[(5 << 16) + i] = 1;
+    }
+  }
+  return r;
+}
+
+int testAddRemove() {
+  uint8_t *ref = calloc(U, 1);
+  RMUtilRoaring *r = RMUtil_NewRoaring();
+  ASSERT_EQUAL(0, RMUtilRoaring_Cardinality(r));
+  ASSERT(!RMUtilRoaring_Contains(r, 0));
+  ASSERT(!RMUtilRoaring_Remove(r, 0));
+
+  // an array growing into a bitmap, and back
+  for (int i = 0; i < 10000; i++) {
+    uint32_t id = nextRand() % (2 << 16);
+    ASSERT_EQUAL((!ref[id]), RMUtilRoaring_Add(r, id));
+    ref[id] = 1;
+  }
+  if (checkBitmap(r, ref)) return -1;
+  size_t dense = RMUtilRoaring_MemUsage(r);
+  for (uint32_t id = 0; id < (2 << 16); id++) {
+    if (id % 7 == 0) {
+      ASSERT_EQUAL(ref[id], RMUtilRoaring_Remove(r, id));
+      ref[id] = 0;
+    }
+  }
+  for (uint32_t id = 0; id < (2 << 16); id++) {
+    if (nextRand() % 4 == 0) {
+      RMUtilRoaring_Remove(r, id);
+      ref[id] = 0;
+    }
+  }
+  if (checkBitmap(r, ref)) return -1;
+  for (uint32_t id = 0; id < U; id++) {
+    ASSERT_EQUAL(ref[id], RMUtilRoaring_Contains(r, id));
+  }
+  ASSERT(RMUtilRoaring_MemUsage(r) <= dense);
+  // emptying the bitmap drops its containers
+  for (uint32_t id = 0; id < U; id++) {
+    RMUtilRoaring_Remove(r, id);
+  }
+  ASSERT_EQUAL(0, RMUtilRoaring_Cardinality(r));
+  RMUtilRoaring_Free(r);
+
+  // the highest IDs
+  r = RMUtil_NewRoaring();
+  ASSERT(RMUtilRoaring_Add(r, UINT32_MAX));
+  RMUtilRoaring_AddRange(r, UINT32_MAX - 70000, UINT32_MAX - 1);
+  ASSERT_EQUAL(70001, RMUtilRoaring_Cardinality(r));
+  ASSERT(RMUtilRoaring_Contains(r, UINT32_MAX - 65536));
+  ASSERT(!RMUtilRoaring_Contains(r, UINT32_MAX - 70001));
+  uint32_t id;
+  ASSERT(RMUtilRoaring_Select(r, 70000, &id));
+  ASSERT_EQUAL(UINT32_MAX, id);
+  RMUtilRoaring_Free(r);
+  free(ref);
+  return 0;
+}
+
+int testRuns() {
+  uint8_t *ref = calloc(U, 1);
+  RMUtilRoaring *r = RMUtil_NewRoaring();
+  // an inverted range adds nothing
+  RMUtilRoaring_AddRange(r, 5, 3);
+  RMUtilRoaring_AddRange(r, 1 << 16, 100);
+  ASSERT_EQUAL(0, RMUtilRoaring_Cardinality(r));
+  ASSERT(!RMUtilRoaring_Contains(r, 100));
+  // a full container and partial ones
+  RMUtilRoaring_AddRange(r, 100, (3 << 16) + 99);
+  memset(ref + 100, 1, 3 << 16);
+  if (checkBitmap(r, ref)) return -1;
+  ASSERT(RMUtilRoaring_MemUsage(r) < 1024);
+
+  // runs split, shrink, join and grow in place
+  uint32_t removed[] = {100, 101, 500, 502, 65535, 65536, (3 << 16) + 99, 1000};
+  for (int i = 0; i < 8; i++) {
+    ASSERT(RMUtilRoaring_Remove(r, removed[i]));
+    ASSERT(!RMUtilRoaring_Remove(r, removed[i]));
+    ref[removed[i]] = 0;
+  }
+  if (checkBitmap(r, ref)) return -1;
+  uint32_t added[] = {501, 502, 500, 1000, 5, 65536, 99, 7, 6};
+  for (int i = 0; i < 9; i++) {
+    ASSERT_EQUAL((!ref[added[i]]), RMUtilRoaring_Add(r, added[i]));
+    ref[added[i]] = 1;
+  }
+  if (checkBitmap(r, ref)) return -1;
+  for (uint32_t id = 0; id < U; id++) {
+    ASSERT_EQUAL(ref[id], RMUtilRoaring_Contains(r, id));
+  }
+
+  // too many runs turn into a bitmap
+  for (uint32_t id = 2000; id < 60000; id += 2) {
+    RMUtilRoaring_Remove(r, id);
+    ref[id] = 0;
+  }
+  if (checkBitmap(r, ref)) return -1;
+  RMUtilRoaring_Free(r);
+
+  // run optimizing saves memory on ranges, and does not lose IDs
+  r = randomBitmap(ref);
+  size_t before = RMUtilRoaring_MemUsage(r);
+  RMUtilRoaring_RunOptimize(r);
+  ASSERT(RMUtilRoaring_MemUsage(r) < before);
+  if (checkBitmap(r, ref)) return -1;
+  RMUtilRoaring_RunOptimize(r);
+  if (checkBitmap(r, ref)) return -1;
+  RMUtilRoaring_Free(r);
+  free(ref);
+  return 0;
+}
+
+int testOps() {
+  uint8_t *refA = malloc(U), *refB = malloc(U), *ref = malloc(U);
+  for (int round = 0; round < 4; round++) {
+    RMUtilRoaring *a = randomBitmap(refA), *b = randomBitmap(refB);
+    // every pair of container kinds
+    if (round & 1) RMUtilRoaring_RunOptimize(a);
+    if (round & 2) RMUtilRoaring_RunOptimize(b);
+
+    RMUtilRoaring *res = RMUtilRoaring_And(a, b);
+    for (int i = 0; i < U; i++) ref[i] = refA[i] & refB[i];
+    if (checkBitmap(res, ref)) return -1;
+    RMUtilRoaring_Free(res);
+
+    res = RMUtilRoaring_Or(a, b);
+    for (int i = 0; i < U; i++) ref[i] = refA[i] | refB[i];
+    if (checkBitmap(res, ref)) return -1;
+    RMUtilRoaring_Free(res);
+
+    res = RMUtilRoaring_Xor(a, b);
+    for (int i = 0; i < U; i++) ref[i] = refA[i] ^ refB[i];
+    if (checkBitmap(res, ref)) return -1;
+    RMUtilRoaring_Free(res);
+
+    res = RMUtilRoaring_AndNot(a, b);
+    for (int i = 0; i < U; i++) ref[i] = refA[i] & !refB[i];
+    if (checkBitmap(res, ref)) return -1;
+    RMUtilRoaring_Free(res);
+
+    // a bitmap with itself
+    res = RMUtilRoaring_Xor(a, a);
+    ASSERT_EQUAL(0, RMUtilRoaring_Cardinality(res));
+    RMUtilRoaring_Free(res);
+    res = RMUtilRoaring_And(a, a);
+    if (checkBitmap(res, refA)) return -1;
+    RMUtilRoaring_Free(res);
+
+    RMUtilRoaring_Free(a);
+    RMUtilRoaring_Free(b);
+  }
+  free(refA);
+  free(refB);
+  free(ref);
+  return 0;
+}
+
+int testRankSelect() {
+  uint8_t *ref = malloc(U);
+  for (int round = 0; round < 2; round++) {
+    RMUtilRoaring *r = randomBitmap(ref);
+    if (round) RMUtilRoaring_RunOptimize(r);
+    uint64_t rank = 0;
+    for (uint32_t id = 0; id < U; id++) {
+      rank += ref[id];
+      ASSERT_EQUAL(rank, RMUtilRoaring_Rank(r, id));
+      if (ref[id]) {
+        uint32_t found;
+        ASSERT(RMUtilRoaring_Select(r, rank - 1, &found));
+        ASSERT_EQUAL(id, found);
+      }
+    }
+    uint32_t found;
+    ASSERT(!RMUtilRoaring_Select(r, rank, &found));
+    ASSERT_EQUAL(rank, RMUtilRoaring_Rank(r, UINT32_MAX));
+    RMUtilRoaring_Free(r);
+  }
+  free(ref);
+  return 0;
+}
+
+/* An RDB stream in memory, read back in order */
+static struct {
+  uint64_t num;
+  char *buf;
+  size_t len;
+} rdb;
+
+static void fakeSaveUnsigned(RedisModuleIO *io, uint64_t value) {
+  rdb.num = value;
+}
+
+static void fakeSaveStringBuffer(RedisModuleIO *io, const char *str, size_t len) {
+  rdb.buf = malloc(len + 1);
+  memcpy(rdb.buf, str, len);
+  rdb.len = len;
+}
+
+static uint64_t fakeLoadUnsigned(RedisModuleIO *io) {
+  return rdb.num;
+}
+
+static char *fakeLoadStringBuffer(RedisModuleIO *io, size_t *len) {
+  *len = rdb.len;
+  char *p = malloc(rdb.len + 1);
+  memcpy(p, rdb.buf, rdb.len);
+  return p;
+}
+
+int testRDB() {
+  RedisModule_SaveUnsigned = fakeSaveUnsigned;
+  RedisModule_SaveStringBuffer = fakeSaveStringBuffer;
+  RedisModule_LoadUnsigned = fakeLoadUnsigned;
+  RedisModule_LoadStringBuffer = fakeLoadStringBuffer;
+  RedisModule_Free = free;
+
+  uint8_t *ref = malloc(U);
+  RMUtilRoaring *r = randomBitmap(ref);
+  RMUtilRoaring_AddRange(r, 3 << 16, (4 << 16) - 1);
+  memset(ref + (3 << 16), 1, 1 << 16);
+  RMUtilRoaring_RunOptimize(r);
+  RMUtilRoaring_Save(NULL, r);
+  RMUtilRoaring_Free(r);
+
+  r = RMUtilRoaring_Load(NULL);
+  ASSERT(r != NULL);
+  if (checkBitmap(r, ref)) return -1;
+  RMUtilRoaring_Free(r);
+
+  // a missing container, a truncated buffer and containers out of order are refused
+  rdb.num++;
+  ASSERT(RMUtilRoaring_Load(NULL) == NULL);
+  rdb.num--;
+  rdb.len--;
+  ASSERT(RMUtilRoaring_Load(NULL) == NULL);
+  rdb.len++;
+  rdb.buf[0] = 9;
+  ASSERT(RMUtilRoaring_Load(NULL) == NULL);
+  rdb.buf[0] = 0;
+  // an array entry out of order
+  uint16_t first;
+  memcpy(&first, rdb.buf + 7, 2);
+  rdb.buf[7] = rdb.buf[9];
+  rdb.buf[8] = rdb.buf[10];
+  ASSERT(RMUtilRoaring_Load(NULL) == NULL);
+  memcpy(rdb.buf + 7, &first, 2);
+
+  r = RMUtilRoaring_Load(NULL);
+  ASSERT(r != NULL);
+  RMUtilRoaring_Free(r);
+  free(rdb.buf);
+  free(ref);
+  return 0;
+}
+
+TEST_MAIN({
+  TESTFUNC(testAddRemove);
+  TESTFUNC(testRuns);
+  TESTFUNC(testOps);
+  TESTFUNC(testRankSelect);
+  TESTFUNC(testRDB);
+});
@@ -0,0 +1,351 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <float.h>
+#include <math.h>
+#include "sds.h"
+#include "test.h"
+
+static uint64_t rnd = 88172645463325252ULL;
+static uint64_t nextRand() {
+  rnd ^= rnd << 13;
+  rnd ^= rnd >> 7;
+  rnd ^= rnd << 17;
+  return rnd;
+}
+
+int testCatLongLong() {
+  static const long long values[] = {0,         1,         -1,       9,        10,       99,
+                                     100,       -100,      12345,    1000000,  -9999999,
+                                     LLONG_MAX, LLONG_MIN, INT_MAX,  INT_MIN};
+  char buf[32];
+  sds s = sdsempty();
+  for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+    sdsclear(s);
+    s = sdscatll(s, values[i]);
+    snprintf(buf, sizeof(buf), "%lld", values[i]);
+    ASSERT_STRING_EQ(buf, s);
+    ASSERT_EQUAL(strlen(buf), sdslen(s));
+  }
+  for (int i = 0; i < 100000; i++) {
+    // random magnitudes, so that every number of digits is covered
+    unsigned long long u = nextRand() >> (nextRand() % 64);
+    sdsclear(s);
+    s = sdscatull(s, u);
+    snprintf(buf, sizeof(buf), "%llu", u);
+    ASSERT_STRING_EQ(buf, s);
+
+    long long v = (long long)nextRand() >> (nextRand() % 64);
+    sdsclear(s);
+    s = sdscatll(s, v);
+    snprintf(buf, sizeof(buf), "%lld", v);
+    ASSERT_STRING_EQ(buf, s);
+    long long parsed = 0;
+    ASSERT(sdstoll(s, &parsed));
+    ASSERT(parsed == v);
+  }
+
+  sdsclear(s);
+  s = sdscatull(s, ULLONG_MAX);
+  ASSERT_STRING_EQ("18446744073709551615", s);
+  // appends to the existing content
+  s = sdscat(s, ":");
+  s = sdscatll(s, -42);
+  ASSERT_STRING_EQ("18446744073709551615:-42", s);
+
+  sds f = sdsfromlonglong(LLONG_MIN);
+  ASSERT_STRING_EQ("-9223372036854775808", f);
+  sdsfree(f);
+  f = sdscatfmt(sdsempty(), "%I/%U", (long long)-5, (unsigned long long)7);
+  ASSERT_STRING_EQ("-5/7", f);
+  sdsfree(f);
+  sdsfree(s);
+  return 0;
+}
+
+int testCatDouble() {
+  static const struct {
+    double d;
+    const char *s;
+  } values[] = {
+      {0.0, "0"},
+      {-0.0, "-0"},
+      {1.0, "1"},
+      {-1.5, "-1.5"},
+      {0.1, "0.1"},
+      {0.3, "0.3"},
+      {1.0 / 3, "0.3333333333333333"},
+      {123456.789, "123456.789"},
+      {0.0001, "0.0001"},
+      {0.00001, "1e-05"},
+      {1e16, "10000000000000000"},
+      {1e17, "1e+17"},
+      {1.5e300, "1.5e+300"},
+      {5e-324, "5e-324"},
+      {DBL_MAX, "1.7976931348623157e+308"},
+      {DBL_MIN, "2.2250738585072014e-308"},
+      {9007199254740993.0, "9007199254740992"},
+      {INFINITY, "inf"},
+      {-INFINITY, "-inf"},
+      {NAN, "nan"},
+  };
+  sds s = sdsempty();
+  for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+    sdsclear(s);
+    s = sdscatdouble(s, values[i].d);
+    ASSERT_STRING_EQ(values[i].s, s);
+  }
+
+  char buf[64];
+  int longer = 0;
+  for (int i = 0; i < 100000; i++) {
+    // random bit patterns cover every exponent, random integers the usual values
+    uint64_t bits = nextRand();
+    double d;
+    memcpy(&d, &bits, sizeof(d));
+    if (i % 2) d = (double)(long long)(nextRand() >> (nextRand() % 64)) / 1000;
+    if (isnan(d) || isinf(d) || d == 0) continue;
+
+    sdsclear(s);
+    s = sdscatdouble(s, d);
+    // reads back as the same double
+    double back = strtod(s, NULL);
+    ASSERT(!memcmp(&back, &d, sizeof(d)));
+    double parsed;
+    ASSERT(sdstod(s, &parsed));
+    ASSERT(!memcmp(&parsed, &d, sizeof(d)));
+
+    // no more digits than the shortest %g precision that reads back
+    int prec = 1;
+    for (; prec < 17; prec++) {
+      snprintf(buf, sizeof(buf), "%.*g", prec, d);
+      if (strtod(buf, NULL) == d) break;
+    }
+    int digits = 0;
+    for (const char *p = s; *p && *p != 'e'; p++) digits += *p >= '0' && *p <= '9';
+    // leading and trailing zeros of the plain notation are not significant
+    const char *p = s + (s[0] == '-');
+    while (*p == '0' || *p == '.') digits -= *p++ == '0';
+    if (!strchr(s, 'e') && !strchr(s, '.')) {
+      for (p = s + sdslen(s) - 1; *p == '0'; p--) digits--;
+    }
+    ASSERT(digits >= prec);
+    ASSERT(digits <= 17);
+    longer += digits > prec;
+  }
+  // Grisu2 only rarely misses the shortest digits
+  ASSERT(longer < 100);
+  sdsfree(s);
+  return 0;
+}
+
+int testParse() {
+  static const struct {
+    const char *s;
+    int ok;
+    long long n;
+  } ints[] = {
+      {"0", 1, 0},
+      {"-42", 1, -42},
+      {"9223372036854775807", 1, LLONG_MAX},
+      {"-9223372036854775808", 1, LLONG_MIN},
+      {"9223372036854775808", 0},
+      {"18446744073709551616", 0},
+      {"", 0},
+      {"-", 0},
+      {"-0", 0},
+      {"007", 0},
+      {"+7", 0},
+      {" 7", 0},
+      {"7a", 0},
+  };
+  for (size_t i = 0; i < sizeof(ints) / sizeof(ints[0]); i++) {
+    sds s = sdsnew(ints[i].s);
+    long long n = 12345;
+    ASSERT_EQUAL(ints[i].ok, sdstoll(s, &n));
+    ASSERT(n == (ints[i].ok ? ints[i].n : 12345));
+    sdsfree(s);
+  }
+
+  static const char *doubles[] = {"0",      "-0",        "1",       "+1.5",       "-2.25",
+                                  ".5",     "5.",        "1e10",    "1E-10",      "3.14159",
+                                  "1e22",   "1e23",      "1e-22",   "1e-23",      "0.1e-300",
+                                  "1e308",  "4.9e-324",  "inf",     "-Infinity",  "0x1p3",
+                                  "123456789012345678901234567890", "9007199254740993",
+                                  "0.000000000000000000000000000001",
+                                  "2.2250738585072011e-308"};
+  for (size_t i = 0; i < sizeof(doubles) / sizeof(doubles[0]); i++) {
+    sds s = sdsnew(doubles[i]);
+    double d = 0, expected = strtod(doubles[i], NULL);
+    ASSERT(sdstod(s, &d));
+    ASSERT(!memcmp(&d, &expected, sizeof(d)));
+    sdsfree(s);
+  }
+  static const char *bad[] = {"", " 1", "1 ", "1x", "-", ".", "e5", "1e", "1e+", "nan",
+                              "1e400", "1e-400"};
+  for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+    sds s = sdsnew(bad[i]);
+    double d = 12345;
+    ASSERT_EQUAL(0, sdstod(s, &d));
+    ASSERT_EQUAL(12345, d);
+    sdsfree(s);
+  }
+  // binary safe: an embedded NULL is not the end of the number
+  sds s = sdsnewlen("1\0", 2);
+  double d;
+  ASSERT_EQUAL(0, sdstod(s, &d));
+  sdsfree(s);
+
+  // the fast path rounds like strtod
+  char buf[64];
+  for (int i = 0; i < 100000; i++) {
+    snprintf(buf, sizeof(buf), "%llu.%llue%d", (unsigned long long)nextRand() % 100000000,
+             (unsigned long long)nextRand() % 10000000,
+             (int)(nextRand() % 40) - 20);
+    double expected = strtod(buf, NULL);
+    s = sdsnew(buf);
+    ASSERT(sdstod(s, &d));
+    ASSERT(!memcmp(&d, &expected, sizeof(d)));
+    sdsfree(s);
+  }
+  return 0;
+}
+
+int testHeaderTypes() {
+  // the smallest header holding the length is used, including at the limits of each type
+  static const struct {
+    size_t len;
+    int type;
+  } sizes[] = {{1, SDS_TYPE_5},     {31, SDS_TYPE_5},    {32, SDS_TYPE_8},
+               {255, SDS_TYPE_8},   {256, SDS_TYPE_16},  {65535, SDS_TYPE_16},
+               {65536, SDS_TYPE_32}};
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    sds s = sdsnewlen(NULL, sizes[i].len);
+    ASSERT_EQUAL(sizes[i].type, (s[-1] & SDS_TYPE_MASK));
+    ASSERT_EQUAL(sizes[i].len, sdslen(s));
+    sdsfree(s);
+  }
+
+  // shrinking keeps working across header types
+  sds s = sdsnewlen(NULL, 1000);
+  s = sdsMakeRoomFor(s, 100000);
+  ASSERT(sdsavail(s) >= 100000);
+  // a large header is kept when one is needed anyway, saving the copy
+  sdsrange(s, 0, 299);
+  s = sdsRemoveFreeSpace(s);
+  ASSERT_EQUAL(300, sdslen(s));
+  ASSERT_EQUAL(0, sdsavail(s));
+  ASSERT_EQUAL(SDS_TYPE_32, (s[-1] & SDS_TYPE_MASK));
+  sdsrange(s, 0, 9);
+  s = sdsRemoveFreeSpace(s);
+  ASSERT_EQUAL(10, sdslen(s));
+  ASSERT_EQUAL(0, sdsavail(s));
+  ASSERT_EQUAL(SDS_TYPE_5, (s[-1] & SDS_TYPE_MASK));
+  s = sdscat(s, "x");
+  ASSERT_EQUAL(11, sdslen(s));
+  sdsfree(s);
+  return 0;
+}
+
+int testSplitSpans() {
+  static const char *seps[] = {",", "_-_", "ab"};
+  char buf[300];
+  sdsspan spans[400];
+  for (int i = 0; i < 3000; i++) {
+    const char *sep = seps[i % 3];
+    size_t seplen = strlen(sep);
+    // random strings over a small alphabet, so separators and partial matches are frequent
+    size_t len = nextRand() % sizeof(buf);
+    for (size_t j = 0; j < len; j++) buf[j] = ",_-ab"[nextRand() % 5];
+
+    int count;
+    sds *tokens = sdssplitlen(buf, len, sep, seplen, &count);
+    // batches of every size give the same tokens
+    size_t batch = 1 + i % 70, pos = 0, n = 0;
+    while (pos <= len) {
+      size_t got = sdssplitspans(buf, len, sep, seplen, spans + n, batch, &pos);
+      ASSERT(got <= batch);
+      ASSERT(got > 0 || len == 0);
+      n += got;
+    }
+    ASSERT_EQUAL(count, n);
+    for (size_t j = 0; j < n; j++) {
+      ASSERT_EQUAL(sdslen(tokens[j]), spans[j].len);
+      ASSERT(!memcmp(tokens[j], buf + spans[j].start, spans[j].len));
+    }
+    sdsfreesplitres(tokens, count);
+  }
+
+  size_t pos = 0;
+  ASSERT_EQUAL(0, sdssplitspans("", 0, ",", 1, spans, 10, &pos));
+  ASSERT(pos > 0);
+  pos = 0;
+  ASSERT_EQUAL(3, sdssplitspans("a,,", 3, ",", 1, spans, 10, &pos));
+  ASSERT_EQUAL(4, pos);
+  ASSERT(spans[0].len == 1 && spans[1].len == 0 && spans[2].len == 0 && spans[2].start == 3);
+  pos = 0;
+  ASSERT_EQUAL(0, sdssplitspans("a,b", 3, "", 0, spans, 10, &pos));
+  return 0;
+}
+
+int testSplitArgsSpans() {
+  static const char *lines[] = {
+      "",
+      "   ",
+      "set key value",
+      "  set\tkey   \"quoted value\"  'single \\' quoted'  ",
+      "\"\\x41\\x4a\\n\\\"\" \"\\xZZ\" last",
+      "''  \"\"",
+  };
+  char out[200];
+  sdsspan spans[100];
+  for (size_t i = 0; i < sizeof(lines) / sizeof(lines[0]); i++) {
+    size_t len = strlen(lines[i]);
+    int argc;
+    sds *args = sdssplitargs(lines[i], &argc);
+    ASSERT(args != NULL);
+    int n = sdssplitargsspans(lines[i], len, out, spans, 100);
+    ASSERT_EQUAL(argc, n);
+    for (int j = 0; j < n; j++) {
+      ASSERT_EQUAL(sdslen(args[j]), spans[j].len);
+      ASSERT(!memcmp(args[j], out + spans[j].start, spans[j].len));
+    }
+
+    // unescaping in place
+    char line[200];
+    memcpy(line, lines[i], len);
+    ASSERT_EQUAL(argc, sdssplitargsspans(line, len, line, spans, 100));
+    for (int j = 0; j < n; j++) {
+      ASSERT(!memcmp(args[j], line + spans[j].start, spans[j].len));
+    }
+    // too many arguments for the spans
+    if (argc > 0) {
+      ASSERT_EQUAL(-1, sdssplitargsspans(lines[i], len, out, spans, argc - 1));
+    }
+    sdsfreesplitres(args, argc);
+  }
+
+  static const char *bad[] = {"\"unterminated", "'unterminated", "\"a\"b", "'a'b", "\"a\\"};
+  for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+    int argc;
+    ASSERT(sdssplitargs(bad[i], &argc) == NULL);
+    ASSERT_EQUAL(-1, sdssplitargsspans(bad[i], strlen(bad[i]), out, spans, 100));
+  }
+
+  // the line ends at its length, not at a null byte
+  ASSERT_EQUAL(2, sdssplitargsspans("a\0b c", 5, out, spans, 100));
+  ASSERT_EQUAL(3, spans[0].len);
+  ASSERT_EQUAL(1, sdssplitargsspans("abc def", 3, out, spans, 100));
+  return 0;
+}
+
+TEST_MAIN({
+  TESTFUNC(testHeaderTypes);
+  TESTFUNC(testSplitSpans);
+  TESTFUNC(testSplitArgsSpans);
+  TESTFUNC(testCatLongLong);
+  TESTFUNC(testCatDouble);
+  TESTFUNC(testParse);
+});
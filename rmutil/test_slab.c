@@ -0,0 +1,176 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+// define the module API pointers here, they are left NULL outside of redis
+#define REDISMODULE_MAIN
+#define REDISMODULE_EXPERIMENTAL_API
+#include "slab.h"
+#include "test.h"
+
+typedef struct {
+  long long id;
+  double score;
+  void *next;
+  char pad[24];
+} node;  // 48 bytes
+
+int testSlabAlloc() {
+  RMUtilSlab *s = RMUtil_NewSlab(0);
+
+  ASSERT_EQUAL(48, RMUtilSlab_UsableSize(sizeof(node)));
+  ASSERT_EQUAL(8, RMUtilSlab_UsableSize(1));
+  ASSERT_EQUAL(16, RMUtilSlab_UsableSize(9));
+  ASSERT_EQUAL(1000, RMUtilSlab_UsableSize(1000));
+
+  node *nodes[1000];
+  for (int i = 0; i < 1000; i++) {
+    nodes[i] = RMUtilSlab_Alloc(s, sizeof(node));
+    ASSERT_EQUAL(0, ((uintptr_t)nodes[i] % RMUTIL_SLAB_QUANTUM));
+    nodes[i]->id = i;
+  }
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_EQUAL(i, nodes[i]->id);
+  }
+
+  RMUtilSlabStats st;
+  RMUtilSlab_GetStats(s, &st);
+  ASSERT_EQUAL(1000, st.liveObjects);
+  ASSERT_EQUAL(48000, st.liveBytes);
+  ASSERT_EQUAL(1, st.numPages);
+
+  // freed objects are reused
+  RMUtilSlab_Dealloc(s, nodes[10], sizeof(node));
+  ASSERT(RMUtilSlab_Alloc(s, sizeof(node)) == nodes[10]);
+
+  // other sizes use pages of their own
+  void *small = RMUtilSlab_Alloc(s, 12);
+  void *large = RMUtilSlab_Alloc(s, 4096);
+  memset(large, 0, 4096);
+  RMUtilSlab_GetStats(s, &st);
+  ASSERT_EQUAL(2, st.numPages);
+  ASSERT_EQUAL(4096, st.largeBytes);
+  RMUtilSlab_Dealloc(s, small, 12);
+  RMUtilSlab_Dealloc(s, large, 4096);
+  RMUtilSlab_GetStats(s, &st);
+  ASSERT_EQUAL(0, st.largeBytes);
+  ASSERT_EQUAL(1000, st.liveObjects);
+
+  RMUtilSlab_Free(s);
+  return 0;
+}
+
+int testSlabDefrag() {
+  RMUtilSlab *s = RMUtil_NewSlab(0);
+  int n = 10000;
+  node **nodes = malloc(n * sizeof(node *));
+  for (int i = 0; i < n; i++) {
+    nodes[i] = RMUtilSlab_Alloc(s, sizeof(node));
+    nodes[i]->id = i;
+  }
+  RMUtilSlabStats before;
+  RMUtilSlab_GetStats(s, &before);
+  ASSERT(before.numPages >= 7);
+
+  // keep every 10th node, leaving all the pages sparse
+  for (int i = 0; i < n; i++) {
+    if (i % 10) {
+      RMUtilSlab_Dealloc(s, nodes[i], sizeof(node));
+      nodes[i] = NULL;
+    }
+  }
+
+  RMUtilSlab_DefragBegin(s, 0.5);
+  // allocations made during defrag do not land on evacuated pages
+  node *extra = RMUtilSlab_Alloc(s, sizeof(node));
+  extra->id = -1;
+  int moved = 0;
+  for (int i = 0; i < n; i++) {
+    if (!nodes[i]) continue;
+    node *np = RMUtilSlab_DefragAlloc(s, NULL, nodes[i], sizeof(node));
+    if (np) {
+      nodes[i] = np;
+      moved++;
+    }
+  }
+  ASSERT(RMUtilSlab_DefragAlloc(s, NULL, extra, sizeof(node)) == NULL);
+  size_t freed = RMUtilSlab_DefragEnd(s);
+  ASSERT(moved > 0);
+  ASSERT(freed > 0);
+
+  RMUtilSlabStats after;
+  RMUtilSlab_GetStats(s, &after);
+  ASSERT_EQUAL(before.numPages - freed, after.numPages);
+  ASSERT_EQUAL(n / 10 + 1, after.liveObjects);
+  ASSERT(after.numPages <= 2);
+  for (int i = 0; i < n; i += 10) {
+    ASSERT_EQUAL(i, nodes[i]->id);
+  }
+  ASSERT_EQUAL(-1, extra->id);
+
+  // the slab keeps working after compaction
+  for (int i = 0; i < n; i++) {
+    if (!nodes[i]) {
+      nodes[i] = RMUtilSlab_Alloc(s, sizeof(node));
+      nodes[i]->id = i;
+    }
+  }
+  for (int i = 0; i < n; i++) {
+    ASSERT_EQUAL(i, nodes[i]->id);
+  }
+  RMUtilSlab_GetStats(s, &after);
+  ASSERT_EQUAL(n + 1, after.liveObjects);
+
+  free(nodes);
+  RMUtilSlab_Free(s);
+  return 0;
+}
+
+#define THREADS 4
+#define PER_THREAD 20000
+
+static void *threadWork(void *arg) {
+  RMUtilSlab *s = arg;
+  node **nodes = malloc(PER_THREAD * sizeof(node *));
+  for (int round = 0; round < 5; round++) {
+    for (int i = 0; i < PER_THREAD; i++) {
+      nodes[i] = RMUtilSlab_Alloc(s, sizeof(node));
+      nodes[i]->id = i;
+    }
+    for (int i = 0; i < PER_THREAD; i++) {
+      if (nodes[i]->id != i) abort();
+      RMUtilSlab_Dealloc(s, nodes[i], sizeof(node));
+    }
+  }
+  free(nodes);
+  return NULL;
+}
+
+int testThreadCache() {
+  RMUtilSlab *s = RMUtil_NewSlab(RMUTIL_SLAB_THREAD_CACHE);
+  pthread_t threads[THREADS];
+  for (int i = 0; i < THREADS; i++) {
+    pthread_create(&threads[i], NULL, threadWork, s);
+  }
+  for (int i = 0; i < THREADS; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  // the caches of the exited threads were returned to the slab
+  RMUtilSlabStats st;
+  RMUtilSlab_GetStats(s, &st);
+  ASSERT_EQUAL(0, st.liveObjects);
+
+  void *p = RMUtilSlab_Alloc(s, 20);
+  RMUtilSlab_GetStats(s, &st);
+  ASSERT_EQUAL(RMUTIL_SLAB_TCACHE_SIZE / 2, st.liveObjects);
+  RMUtilSlab_Dealloc(s, p, 20);
+  RMUtilSlab_Free(s);
+  return 0;
+}
+
+TEST_MAIN({
+  TESTFUNC(testSlabAlloc);
+  TESTFUNC(testSlabDefrag);
+  TESTFUNC(testThreadCache);
+});
@@ -0,0 +1,114 @@
+#include <stdio.h>
+#include <string.h>
+#include <float.h>
+#include "smallstr.h"
+#include "test.h"
+
+int testInline() {
+  RMUtilSmallStr s = RMUTIL_SMALLSTR_INIT;
+  ASSERT(RMUtilSmallStr_IsInline(&s));
+  ASSERT_EQUAL(0, RMUtilSmallStr_Len(&s));
+  ASSERT_STRING_EQ("", RMUtilSmallStr_Ptr(&s));
+  ASSERT_EQUAL(RMUTIL_SMALLSTR_INLINE, RMUtilSmallStr_Avail(&s));
+
+  ASSERT_EQUAL(REDISMODULE_OK, RMUtilSmallStr_Cat(&s, "user:"));
+  ASSERT_EQUAL(REDISMODULE_OK, RMUtilSmallStr_CatLongLong(&s, -1234));
+  ASSERT_EQUAL(REDISMODULE_OK, RMUtilSmallStr_CatLen(&s, ":", 1));
+  ASSERT_EQUAL(REDISMODULE_OK, RMUtilSmallStr_CatDouble(&s, 0.5));
+  ASSERT_STRING_EQ("user:-1234:0.5", RMUtilSmallStr_Ptr(&s));
+  ASSERT_EQUAL(14, RMUtilSmallStr_Len(&s));
+  ASSERT(RMUtilSmallStr_IsInline(&s));
+  ASSERT_EQUAL(0, RMUtilSmallStr_AllocSize(&s));
+
+  // exactly RMUTIL_SMALLSTR_INLINE bytes still fit inline
+  ASSERT_EQUAL(REDISMODULE_OK, RMUtilSmallStr_CatPrintf(&s, "%08d", 42));
+  ASSERT_EQUAL(RMUTIL_SMALLSTR_INLINE, RMUtilSmallStr_Len(&s));
+  ASSERT(RMUtilSmallStr_IsInline(&s));
+  ASSERT_STRING_EQ("user:-1234:0.500000042", RMUtilSmallStr_Ptr(&s));
+  ASSERT_EQUAL(0, RMUtilSmallStr_Avail(&s));
+
+  // binary safe
+  RMUtilSmallStr_Clear(&s);
+  ASSERT_EQUAL(REDISMODULE_OK, RMUtilSmallStr_CatLen(&s, "a\0b", 3));
+  ASSERT_EQUAL(3, RMUtilSmallStr_Len(&s));
+  ASSERT(!memcmp(RMUtilSmallStr_Ptr(&s), "a\0b", 4));
+
+  sds copy = RMUtilSmallStr_ToSds(&s);
+  ASSERT_EQUAL(3, sdslen(copy));
+  sdsfree(copy);
+  RMUtilSmallStr_Free(&s);
+  return 0;
+}
+
+int testHeap() {
+  RMUtilSmallStr s;
+  RMUtilSmallStr_InitLen(&s, "0123456789", 10);
+  char expected[1000];
+  strcpy(expected, "0123456789");
+  for (int i = 0; i < 50; i++) {
+    // printf to the heap when the inline buffer is too small
+    ASSERT_EQUAL(REDISMODULE_OK, RMUtilSmallStr_CatPrintf(&s, "-%d-", i));
+    sprintf(expected + strlen(expected), "-%d-", i);
+    ASSERT_STRING_EQ(expected, RMUtilSmallStr_Ptr(&s));
+    ASSERT_EQUAL(strlen(expected), RMUtilSmallStr_Len(&s));
+  }
+  ASSERT(!RMUtilSmallStr_IsInline(&s));
+  ASSERT(RMUtilSmallStr_AllocSize(&s) > RMUtilSmallStr_Len(&s));
+
+  RMUtilSmallStr_RemoveFreeSpace(&s);
+  ASSERT_EQUAL(0, RMUtilSmallStr_Avail(&s));
+  ASSERT_EQUAL(RMUtilSmallStr_Len(&s) + 1, RMUtilSmallStr_AllocSize(&s));
+  ASSERT_STRING_EQ(expected, RMUtilSmallStr_Ptr(&s));
+
+  // clearing keeps the heap buffer, shrinking moves short strings back inline
+  RMUtilSmallStr_Cpy(&s, "short");
+  ASSERT(!RMUtilSmallStr_IsInline(&s));
+  ASSERT_STRING_EQ("short", RMUtilSmallStr_Ptr(&s));
+  RMUtilSmallStr_RemoveFreeSpace(&s);
+  ASSERT(RMUtilSmallStr_IsInline(&s));
+  ASSERT_STRING_EQ("short", RMUtilSmallStr_Ptr(&s));
+  ASSERT_EQUAL(5, RMUtilSmallStr_Len(&s));
+
+  // writing to the buffer directly
+  ASSERT_EQUAL(REDISMODULE_OK, RMUtilSmallStr_MakeRoomFor(&s, 100));
+  ASSERT(RMUtilSmallStr_Avail(&s) >= 100);
+  memset(RMUtilSmallStr_Data(&s) + 5, 'x', 100);
+  RMUtilSmallStr_IncrLen(&s, 100);
+  ASSERT_EQUAL(105, RMUtilSmallStr_Len(&s));
+  RMUtilSmallStr_IncrLen(&s, -99);
+  ASSERT_STRING_EQ("shortx", RMUtilSmallStr_Ptr(&s));
+
+  // strings do not grow past UINT32_MAX bytes
+  ASSERT_EQUAL(REDISMODULE_ERR, RMUtilSmallStr_MakeRoomFor(&s, UINT32_MAX));
+  ASSERT_STRING_EQ("shortx", RMUtilSmallStr_Ptr(&s));
+
+  RMUtilSmallStr_Free(&s);
+  ASSERT(RMUtilSmallStr_IsInline(&s));
+  ASSERT_EQUAL(0, RMUtilSmallStr_Len(&s));
+  return 0;
+}
+
+int testCmp() {
+  RMUtilSmallStr a, b;
+  RMUtilSmallStr_InitLen(&a, "abc", 3);
+  RMUtilSmallStr_InitLen(&b, "abc", 3);
+  ASSERT_EQUAL(0, RMUtilSmallStr_Cmp(&a, &b));
+  RMUtilSmallStr_Cat(&b, "d");
+  ASSERT(RMUtilSmallStr_Cmp(&a, &b) < 0);
+  ASSERT(RMUtilSmallStr_Cmp(&b, &a) > 0);
+  // inline and heap strings compare by content
+  RMUtilSmallStr_Cpy(&a, "abcdefghijklmnopqrstuvwxyz");
+  RMUtilSmallStr_Cpy(&b, "abcdefghijklmnopqrstuvwxyz");
+  ASSERT_EQUAL(0, RMUtilSmallStr_Cmp(&a, &b));
+  RMUtilSmallStr_Cpy(&b, "b");
+  ASSERT(RMUtilSmallStr_Cmp(&a, &b) < 0);
+  RMUtilSmallStr_Free(&a);
+  RMUtilSmallStr_Free(&b);
+  return 0;
+}
+
+TEST_MAIN({
+  TESTFUNC(testInline);
+  TESTFUNC(testHeap);
+  TESTFUNC(testCmp);
+});
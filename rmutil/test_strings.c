@@ -0,0 +1,249 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include <math.h>
+// define the module API pointers here, they are left NULL outside of redis
+#define REDISMODULE_MAIN
+#define REDISMODULE_EXPERIMENTAL_API
+#include <redismodule.h>
+#include "strings.h"
+#include "test.h"
+
+/* Outside of redis, RedisModuleString objects are stubbed by a buffer and its length */
+typedef struct {
+  char *str;
+  size_t len;
+} stubString;
+
+static const char *stubStringPtrLen(const RedisModuleString *str, size_t *len) {
+  const stubString *s = (const stubString *)str;
+  if (len) *len = s->len;
+  return s->str;
+}
+
+static uint64_t rnd = 88172645463325252ULL;
+static unsigned char nextByte() {
+  rnd ^= rnd << 13;
+  rnd ^= rnd >> 7;
+  rnd ^= rnd << 17;
+  return rnd & 0xff;
+}
+
+int testCase() {
+  char buf[200], lower[200], upper[200];
+  for (int level = RMUTIL_SIMD_NONE; level <= RMUTIL_SIMD_AVX2; level++) {
+    RMUtil_SetStringSIMD(level);
+    for (int iter = 0; iter < 2000; iter++) {
+      size_t len = iter % 150;
+      for (size_t i = 0; i < len; i++) {
+        buf[i] = nextByte();
+      }
+      for (size_t i = 0; i < len; i++) {
+        unsigned char c = buf[i];
+        lower[i] = c < 128 ? tolower(c) : c;
+        upper[i] = c < 128 ? toupper(c) : c;
+      }
+      // the bytes past len are not touched
+      buf[len] = 'X';
+      char tmp[200];
+      memcpy(tmp, buf, len + 1);
+      RMUtil_StrToLower(tmp, len);
+      ASSERT(!memcmp(tmp, lower, len));
+      ASSERT_EQUAL('X', tmp[len]);
+      memcpy(tmp, buf, len + 1);
+      RMUtil_StrToUpper(tmp, len);
+      ASSERT(!memcmp(tmp, upper, len));
+      ASSERT_EQUAL('X', tmp[len]);
+
+      ASSERT(RMUtil_StrCaseEqual(lower, upper, len));
+      ASSERT(RMUtil_StrCaseEqual(buf, lower, len));
+      if (len > 0) {
+        // a difference anywhere is found
+        size_t pos = nextByte() % len;
+        memcpy(tmp, upper, len);
+        tmp[pos] ^= 0x01;
+        int expected = !memcmp(tmp, upper, len);
+        ASSERT_EQUAL(expected, RMUtil_StrCaseEqual(tmp, upper, len));
+        memcpy(tmp, upper, len);
+        tmp[pos] ^= 0x20;
+        int same = isalpha((unsigned char)upper[pos]) && (unsigned char)upper[pos] < 128;
+        ASSERT_EQUAL(same, RMUtil_StrCaseEqual(tmp, upper, len));
+      }
+    }
+  }
+  RMUtil_SetStringSIMD(-1);
+  return 0;
+}
+
+int testRedisStrings() {
+  RedisModule_StringPtrLen = stubStringPtrLen;
+  char a[] = "Hello World", b[] = "SOME-Key:42", c[] = "";
+  stubString strs[] = {{a, sizeof(a) - 1}, {b, sizeof(b) - 1}, {c, 0}};
+  RedisModuleString *argv[] = {(RedisModuleString *)&strs[0], (RedisModuleString *)&strs[1],
+                               (RedisModuleString *)&strs[2]};
+
+  RMUtil_StringsToLower(argv, 3);
+  ASSERT_STRING_EQ("hello world", a);
+  ASSERT_STRING_EQ("some-key:42", b);
+  RMUtil_StringsToUpper(argv, 2);
+  ASSERT_STRING_EQ("HELLO WORLD", a);
+  ASSERT_STRING_EQ("SOME-KEY:42", b);
+  RMUtil_StringToLower(argv[0]);
+  ASSERT_STRING_EQ("hello world", a);
+  RMUtil_StringToUpper(argv[0]);
+  ASSERT_STRING_EQ("HELLO WORLD", a);
+
+  ASSERT(RMUtil_StringEqualsCaseC(argv[0], "hello WORLD"));
+  ASSERT(!RMUtil_StringEqualsCaseC(argv[0], "hello WORLD!"));
+  ASSERT(!RMUtil_StringEqualsCaseC(argv[0], "hello"));
+  ASSERT(RMUtil_StringEqualsCaseC(argv[2], ""));
+  ASSERT(!RMUtil_StringEqualsCaseC(argv[2], "a"));
+  return 0;
+}
+
+static int retained, freed;
+static void stubRetainString(RedisModuleCtx *ctx, RedisModuleString *str) {
+  retained++;
+}
+static void stubFreeString(RedisModuleCtx *ctx, RedisModuleString *str) {
+  freed++;
+}
+
+int testStrView() {
+  RedisModule_StringPtrLen = stubStringPtrLen;
+  RedisModule_RetainString = stubRetainString;
+  RedisModule_FreeString = stubFreeString;
+  // binary safe: the embedded NULL is part of the string
+  char a[] = "LIMIT", b[] = "a,b,,c", c[] = "ab\0cd";
+  stubString strs[] = {{a, sizeof(a) - 1}, {b, sizeof(b) - 1}, {c, sizeof(c) - 1}};
+  RedisModuleString *argv[] = {(RedisModuleString *)&strs[0], (RedisModuleString *)&strs[1],
+                               (RedisModuleString *)&strs[2]};
+
+  RMUtilStrView views[3];
+  RMUtil_StrViews(argv, views, 3);
+  ASSERT(views[0].p == a && views[0].len == 5);
+  ASSERT_EQUAL(5, views[2].len);
+  ASSERT(RMUtilStrView_Equals(RMUtil_StrView(argv[0]), RMUTIL_STRVIEW_LIT("LIMIT")));
+  ASSERT(!RMUtilStrView_Equals(views[0], RMUTIL_STRVIEW_LIT("limit")));
+  ASSERT(RMUtilStrView_EqualsCase(views[0], RMUTIL_STRVIEW_LIT("limit")));
+  ASSERT(!RMUtilStrView_EqualsCase(views[0], RMUTIL_STRVIEW_LIT("limits")));
+  ASSERT(RMUtilStrView_Equals(views[2], RMUTIL_STRVIEW_LIT("ab\0cd")));
+  ASSERT(!RMUtilStrView_Equals(views[2], RMUTIL_STRVIEW_LIT("ab\0ce")));
+  ASSERT(RMUtilStrView_Equals(RMUtil_StrViewC("LIMIT"), views[0]));
+  ASSERT(RMUtil_StringEqualsC(argv[0], "LIMIT"));
+  ASSERT(!RMUtil_StringEqualsC(argv[0], "LIMITS"));
+  ASSERT(!RMUtil_StringEqualsC(argv[0], "LIM"));
+  ASSERT(!RMUtil_StringEquals(argv[2], argv[0]));
+
+  ASSERT((RMUtilStrView_Compare(RMUTIL_STRVIEW_LIT("ab"), RMUTIL_STRVIEW_LIT("abc")) < 0));
+  ASSERT((RMUtilStrView_Compare(RMUTIL_STRVIEW_LIT("b"), RMUTIL_STRVIEW_LIT("abc")) > 0));
+  ASSERT_EQUAL(0, RMUtilStrView_Compare(RMUTIL_STRVIEW_LIT("abc"), RMUTIL_STRVIEW_LIT("abc")));
+  ASSERT(RMUtilStrView_HasPrefix(views[0], RMUTIL_STRVIEW_LIT("LIM")));
+  ASSERT(!RMUtilStrView_HasPrefix(RMUTIL_STRVIEW_LIT("LIM"), views[0]));
+
+  ASSERT(RMUtilStrView_Hash(views[0]) == RMUtilStrView_Hash(RMUTIL_STRVIEW_LIT("LIMIT")));
+  ASSERT(RMUtilStrView_Hash(views[0]) != RMUtilStrView_Hash(RMUTIL_STRVIEW_LIT("limit")));
+  ASSERT(RMUtilStrView_HashCase(views[0]) == RMUtilStrView_HashCase(RMUTIL_STRVIEW_LIT("limit")));
+
+  RMUtilStrView sub = RMUtilStrView_Sub(views[0], 1, 3);
+  ASSERT(RMUtilStrView_Equals(sub, RMUTIL_STRVIEW_LIT("IMI")));
+  sub = RMUtilStrView_Sub(views[0], 3, 100);
+  ASSERT(RMUtilStrView_Equals(sub, RMUTIL_STRVIEW_LIT("IT")));
+  ASSERT_EQUAL(0, RMUtilStrView_Sub(views[0], 6, 1).len);
+  ASSERT(RMUtilStrView_Equals(RMUtilStrView_Trim(RMUTIL_STRVIEW_LIT(" \t x y\r\n")),
+                              RMUTIL_STRVIEW_LIT("x y")));
+  ASSERT_EQUAL(0, RMUtilStrView_Trim(RMUTIL_STRVIEW_LIT("  ")).len);
+
+  const char *expected[] = {"a", "b", "", "c"};
+  RMUtilStrView rest = views[1], tok;
+  int n = 0;
+  while (RMUtilStrView_NextToken(&rest, ',', &tok)) {
+    ASSERT(n < 4);
+    ASSERT(RMUtilStrView_Equals(tok, RMUtil_StrViewC(expected[n])));
+    n++;
+  }
+  ASSERT_EQUAL(4, n);
+  // n separators give n + 1 tokens
+  rest = RMUTIL_STRVIEW_LIT(",");
+  n = 0;
+  while (RMUtilStrView_NextToken(&rest, ',', &tok)) {
+    ASSERT_EQUAL(0, tok.len);
+    n++;
+  }
+  ASSERT_EQUAL(2, n);
+
+  RMUtilOwnedStrView o = RMUtil_RetainStrView(NULL, argv[0]);
+  ASSERT_EQUAL(1, retained);
+  ASSERT(RMUtilStrView_Equals(o.view, views[0]));
+  RMUtil_ReleaseStrView(NULL, &o);
+  RMUtil_ReleaseStrView(NULL, &o);
+  ASSERT_EQUAL(1, freed);
+  ASSERT(o.view.p == NULL);
+  return 0;
+}
+
+int testStrViewNumbers() {
+  static const struct {
+    const char *s;
+    int ok;
+    long long n;
+  } ints[] = {
+      {"0", 1, 0},
+      {"42", 1, 42},
+      {"-42", 1, -42},
+      {"9223372036854775807", 1, LLONG_MAX},
+      {"-9223372036854775808", 1, LLONG_MIN},
+      {"9223372036854775808", 0},
+      {"-9223372036854775809", 0},
+      {"99999999999999999999", 0},
+      {"", 0},
+      {"-", 0},
+      {"-0", 0},
+      {"01", 0},
+      {"+1", 0},
+      {" 1", 0},
+      {"1 ", 0},
+      {"1x", 0},
+  };
+  for (size_t i = 0; i < sizeof(ints) / sizeof(ints[0]); i++) {
+    long long n = 12345;
+    int rc = RMUtilStrView_ToLongLong(RMUtil_StrViewC(ints[i].s), &n);
+    int expected = ints[i].ok ? REDISMODULE_OK : REDISMODULE_ERR;
+    ASSERT_EQUAL(expected, rc);
+    ASSERT(n == (ints[i].ok ? ints[i].n : 12345));
+  }
+  // the view ends before the next digit
+  long long n;
+  ASSERT_EQUAL(REDISMODULE_OK, RMUtilStrView_ToLongLong((RMUtilStrView){"1234", 2}, &n));
+  ASSERT_EQUAL(12, n);
+
+  static const struct {
+    const char *s;
+    int ok;
+    double d;
+  } doubles[] = {
+      {"0", 1, 0},       {"1.5", 1, 1.5}, {"-2e3", 1, -2000}, {"inf", 1, INFINITY},
+      {"1e-400", 0},     {"1e400", 0},    {"nan", 0},         {" 1", 0},
+      {"1.5x", 0},       {"", 0},
+  };
+  for (size_t i = 0; i < sizeof(doubles) / sizeof(doubles[0]); i++) {
+    double d = 12345;
+    int rc = RMUtilStrView_ToDouble(RMUtil_StrViewC(doubles[i].s), &d);
+    int expected = doubles[i].ok ? REDISMODULE_OK : REDISMODULE_ERR;
+    ASSERT_EQUAL(expected, rc);
+    ASSERT(d == (doubles[i].ok ? doubles[i].d : 12345));
+  }
+  double d;
+  ASSERT_EQUAL(REDISMODULE_OK, RMUtilStrView_ToDouble((RMUtilStrView){"2.5e10", 3}, &d));
+  ASSERT_EQUAL(2.5, d);
+  return 0;
+}
+
+TEST_MAIN({
+  TESTFUNC(testCase);
+  TESTFUNC(testRedisStrings);
+  TESTFUNC(testStrView);
+  TESTFUNC(testStrViewNumbers);
+});
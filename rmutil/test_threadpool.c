@@ -0,0 +1,113 @@
+#include <stdio.h>
+// define the module API pointers here, they are left NULL outside of redis
+#define REDISMODULE_MAIN
+#define REDISMODULE_EXPERIMENTAL_API
+#include <redismodule.h>
+#include <unistd.h>
+#include "threadpool.h"
+#include "test.h"
+
+static void incrJob(void *p) {
+  __atomic_fetch_add((int *)p, 1, __ATOMIC_SEQ_CST);
+}
+
+static void waitJob(void *p) {
+  while (!__atomic_load_n((int *)p, __ATOMIC_SEQ_CST)) usleep(1000);
+}
+
+int testThreadPool() {
+  struct RMUtilThreadPool *p = RMUtil_NewThreadPool(4, 1024);
+  ASSERT(p != NULL);
+
+  int counter = 0;
+  for (int round = 0; round < 10; round++) {
+    for (int i = 0; i < 1000; i++) {
+      // the queues may fill up, in which case we wait for them to drain
+      while (RMUtilThreadPool_Submit(p, incrJob, &counter) != REDISMODULE_OK) {
+        usleep(100);
+      }
+    }
+    RMUtilThreadPool_Wait(p);
+    ASSERT_EQUAL((round + 1) * 1000, __atomic_load_n(&counter, __ATOMIC_SEQ_CST));
+  }
+
+  RMUtilThreadPool_Free(p);
+  return 0;
+}
+
+int testQueueFull() {
+  struct RMUtilThreadPool *p = RMUtil_NewThreadPool(2, 4);
+  int release = 0, counter = 0;
+
+  // occupy both workers, then fill the queues up
+  ASSERT_EQUAL(REDISMODULE_OK, RMUtilThreadPool_Submit(p, waitJob, &release));
+  ASSERT_EQUAL(REDISMODULE_OK, RMUtilThreadPool_Submit(p, waitJob, &release));
+  usleep(50000);
+  for (int i = 0; i < 4; i++) {
+    ASSERT_EQUAL(REDISMODULE_OK, RMUtilThreadPool_Submit(p, incrJob, &counter));
+  }
+  ASSERT_EQUAL(REDISMODULE_ERR, RMUtilThreadPool_Submit(p, incrJob, &counter));
+  ASSERT_EQUAL(0, __atomic_load_n(&counter, __ATOMIC_SEQ_CST));
+
+  __atomic_store_n(&release, 1, __ATOMIC_SEQ_CST);
+  // freeing the pool runs the pending jobs first
+  RMUtilThreadPool_Free(p);
+  ASSERT_EQUAL(4, counter);
+  return 0;
+}
+
+/* Stubs of the blocked client API */
+static int blockedClient, unblocked = 0, aborted = 0;
+static void *unblockedPrivdata = NULL;
+
+static RedisModuleBlockedClient *stubBlockClient(RedisModuleCtx *ctx, RedisModuleCmdFunc reply,
+                                                 RedisModuleCmdFunc timeout,
+                                                 void (*free_privdata)(RedisModuleCtx *, void *),
+                                                 long long timeout_ms) {
+  return (RedisModuleBlockedClient *)&blockedClient;
+}
+
+static int stubUnblockClient(RedisModuleBlockedClient *bc, void *privdata) {
+  unblockedPrivdata = privdata;
+  __atomic_fetch_add(&unblocked, 1, __ATOMIC_SEQ_CST);
+  return REDISMODULE_OK;
+}
+
+static int stubAbortBlock(RedisModuleBlockedClient *bc) {
+  aborted++;
+  return REDISMODULE_OK;
+}
+
+int testBlockAndRun() {
+  RedisModule_BlockClient = stubBlockClient;
+  RedisModule_UnblockClient = stubUnblockClient;
+  RedisModule_AbortBlock = stubAbortBlock;
+
+  struct RMUtilThreadPool *p = RMUtil_NewThreadPool(1, 1);
+  int counter = 0, release = 0;
+  ASSERT_EQUAL(REDISMODULE_OK,
+               RMUtilThreadPool_BlockAndRun(p, NULL, incrJob, &counter, NULL, NULL, NULL, 0));
+  RMUtilThreadPool_Wait(p);
+  ASSERT_EQUAL(1, counter);
+  ASSERT_EQUAL(1, unblocked);
+  ASSERT(unblockedPrivdata == &counter);
+
+  // when the job can't be queued the client is unblocked right away
+  ASSERT_EQUAL(REDISMODULE_OK, RMUtilThreadPool_Submit(p, waitJob, &release));
+  usleep(50000);
+  ASSERT_EQUAL(REDISMODULE_OK, RMUtilThreadPool_Submit(p, waitJob, &release));
+  ASSERT_EQUAL(REDISMODULE_ERR,
+               RMUtilThreadPool_BlockAndRun(p, NULL, incrJob, &counter, NULL, NULL, NULL, 0));
+  ASSERT_EQUAL(1, aborted);
+
+  __atomic_store_n(&release, 1, __ATOMIC_SEQ_CST);
+  RMUtilThreadPool_Free(p);
+  ASSERT_EQUAL(1, counter);
+  return 0;
+}
+
+TEST_MAIN({
+  TESTFUNC(testThreadPool);
+  TESTFUNC(testQueueFull);
+  TESTFUNC(testBlockAndRun);
+});
@@ -5,6 +5,7 @@
 #include <stdarg.h>
 #include <stdlib.h>
 #include <string.h>
+#include "alloc.h"
 
 
 #define RMUtil_Test(f) \
@@ -36,13 +37,14 @@
 *
 *  Example:  RMUtil_MakeArgs(ctx, &argc, "clc", "hello", 1337, "world");
 *
-*  Returns an array of RedisModuleString pointers. The size of the array is store in argcp
+*  Returns an array of RedisModuleString pointers. The size of the array is store in argcp.
+*  The array is allocated with RMUTIL_TMPCALLOC, and should be freed with RMUTIL_TMPFREE
 */
 RedisModuleString **RMUtil_MakeArgs(RedisModuleCtx *ctx, int *argcp, const char *fmt, ...) {
     
     va_list ap;
     va_start(ap, fmt);
-    RedisModuleString **argv = calloc(strlen(fmt), sizeof(RedisModuleString*));
+    RedisModuleString **argv = RMUTIL_TMPCALLOC(strlen(fmt), sizeof(RedisModuleString*));
     int argc = 0;
     const char *p = fmt;
     while(*p) {
@@ -63,7 +65,7 @@ RedisModuleString **RMUtil_MakeArgs(RedisModuleCtx *ctx, int *argcp, const char
     
     return argv;
 fmterr:
-    free(argv);
+    RMUTIL_TMPFREE(argv);
     return NULL;
 }
 
@@ -2,6 +2,9 @@
 #include <stdio.h>
 #include "test.h"
 
+RMUTIL_VECTOR_DECLARE(LongVector, long long)
+RMUTIL_VECTOR_DECLARE(StringVector, const char *)
+
 int testVector() {
 
   Vector *v = NewVector(int, 1);
@@ -55,4 +58,188 @@ int testVector() {
   // printf("rc: %d got %s\n", rc, x);
 }
 
-TEST_MAIN({ TESTFUNC(testVector); });
+int testTypedVector() {
+  LongVector lv;
+  LongVector_Init(&lv, 1);
+  ASSERT_EQUAL(0, LongVector_Size(&lv));
+
+  for (long long i = 0; i < 1000; i++) {
+    ASSERT_EQUAL(i + 1, LongVector_Push(&lv, i * 1000000000LL));
+  }
+  ASSERT_EQUAL(1000, LongVector_Size(&lv));
+  ASSERT(lv.cap >= 1000);
+
+  for (size_t i = 0; i < LongVector_Size(&lv); i++) {
+    long long n;
+    ASSERT_EQUAL(1, LongVector_Get(&lv, i, &n));
+    ASSERT(n == (long long)i * 1000000000LL);
+    ASSERT(*LongVector_At(&lv, i) == n);
+  }
+
+  long long n = 0;
+  ASSERT_EQUAL(0, LongVector_Get(&lv, 1000, &n));
+  ASSERT_EQUAL(1, LongVector_Pop(&lv, &n));
+  ASSERT(n == 999 * 1000000000LL);
+  ASSERT_EQUAL(1, LongVector_Pop(&lv, NULL));
+  ASSERT_EQUAL(998, LongVector_Size(&lv));
+
+  LongVector_Clear(&lv);
+  ASSERT_EQUAL(0, LongVector_Pop(&lv, &n));
+  LongVector_Free(&lv);
+
+  StringVector sv;
+  StringVector_Init(&sv, 0);
+  const char *strings[4] = {"hello", "world", "foo", "bar"};
+  for (int i = 0; i < 4; i++) {
+    StringVector_Push(&sv, strings[i]);
+  }
+  for (int i = 3; i >= 0; i--) {
+    const char *x;
+    ASSERT_EQUAL(1, StringVector_Pop(&sv, &x));
+    ASSERT_STRING_EQ(x, strings[i]);
+  }
+  StringVector_Free(&sv);
+
+  return 0;
+}
+
+int testGrowth() {
+  Vector *v = NewVector(long long, 0);
+  Vector_SetGrowth(v, VECTOR_GROW_1_5X, 8);
+
+  // sequential puts at increasing positions should grow geometrically rather than one by one
+  size_t reallocs = 0, lastCap = Vector_Cap(v);
+  for (long long i = 0; i < 10000; i++) {
+    Vector_Put(v, i, i);
+    if (Vector_Cap(v) != lastCap) {
+      reallocs++;
+      lastCap = Vector_Cap(v);
+    }
+  }
+  ASSERT_EQUAL(10000, Vector_Size(v));
+  ASSERT(reallocs < 30);
+  for (int i = 0; i < Vector_Size(v); i++) {
+    long long n;
+    ASSERT_EQUAL(1, Vector_Get(v, i, &n));
+    ASSERT_EQUAL(i, n);
+  }
+
+  // putting past the end zeroes the gap
+  Vector_Pop(v, NULL);
+  Vector_Pop(v, NULL);
+  Vector_Put(v, 10005, 42LL);
+  ASSERT_EQUAL(10006, Vector_Size(v));
+  for (int i = 9998; i < 10005; i++) {
+    long long n = -1;
+    ASSERT_EQUAL(1, Vector_Get(v, i, &n));
+    ASSERT_EQUAL(0, n);
+  }
+
+  // reserving less than the current capacity is a no-op
+  ASSERT(Vector_Reserve(v, 100) >= 10006);
+  ASSERT(Vector_Reserve(v, 50000) == 50000);
+  ASSERT_EQUAL(50000, Vector_Cap(v));
+  ASSERT_EQUAL(10006, Vector_Size(v));
+
+  Vector_ShrinkToFit(v);
+  ASSERT_EQUAL(10006, Vector_Cap(v));
+  long long n;
+  ASSERT_EQUAL(1, Vector_Get(v, 10005, &n));
+  ASSERT_EQUAL(42, n);
+
+  while (Vector_Pop(v, NULL))
+    ;
+  Vector_ShrinkToFit(v);
+  ASSERT_EQUAL(0, Vector_Cap(v));
+  Vector_Push(v, 7LL);
+  ASSERT_EQUAL(1, Vector_Size(v));
+  ASSERT(Vector_Cap(v) >= 8);
+
+  Vector_Free(v);
+  return 0;
+}
+
+int testIncremental() {
+  enum { MAX = 200000 };
+  static long long ref[MAX];
+  size_t size = 0, migrations = 0;
+  unsigned long long rnd = 88172645463325252ULL;
+  Vector *v = NewVector(long long, 0);
+  Vector_SetIncremental(v, 1024);
+  Vector_SetGrowth(v, VECTOR_GROW_1_5X, 0);
+
+  for (int op = 0; op < 1000000; op++) {
+    rnd ^= rnd << 13;
+    rnd ^= rnd >> 7;
+    rnd ^= rnd << 17;
+    int wasMigrating = Vector_IsMigrating(v);
+    switch (rnd % 8) {
+      case 0:
+        // pop, mostly below the part of the old buffer that is yet to move
+        if (size) {
+          long long n;
+          ASSERT_EQUAL(1, Vector_Pop(v, &n));
+          ASSERT_EQUAL(ref[size - 1], n);
+          size--;
+        }
+        break;
+      case 1: {
+        // overwrite an element wherever it is, or put one a little past the end
+        size_t pos = size ? (rnd >> 8) % (size + 3) : 0;
+        if (pos >= MAX) break;
+        Vector_Put(v, pos, (long long)rnd);
+        for (; size < pos; size++) ref[size] = 0;
+        ref[pos] = rnd;
+        if (pos == size) size++;
+        break;
+      }
+      default:
+        if (size < MAX) {
+          Vector_Push(v, (long long)rnd);
+          ref[size++] = rnd;
+        }
+    }
+    migrations += !wasMigrating && Vector_IsMigrating(v);
+    ASSERT_EQUAL(size, Vector_Size(v));
+    if (op % 10007 == 0) {
+      for (size_t i = 0; i < size; i++) {
+        long long n;
+        ASSERT_EQUAL(1, Vector_Get(v, i, &n));
+        ASSERT_EQUAL(ref[i], n);
+      }
+    }
+  }
+  ASSERT(migrations > 5);
+
+  // growing keeps the elements in the previous buffer until they are moved
+  while (Vector_Step(v, 1 << 20))
+    ;
+  char *data = v->data;
+  Vector_Reserve(v, Vector_Cap(v) * 4);
+  ASSERT(Vector_IsMigrating(v));
+  ASSERT(v->old == data);
+  ASSERT_EQUAL(1, Vector_Step(v, 8));
+  ASSERT_EQUAL(1, v->migrated);
+  // a resize is zeroed past the end, and shrinking finishes the move first
+  Vector_Resize(v, Vector_Cap(v) * 2);
+  ASSERT(Vector_IsMigrating(v));
+  Vector_Put(v, size + 10, 1LL);
+  long long n = -1;
+  ASSERT_EQUAL(1, Vector_Get(v, size + 5, &n));
+  ASSERT_EQUAL(0, n);
+  Vector_ShrinkToFit(v);
+  ASSERT(!Vector_IsMigrating(v));
+  for (size_t i = 0; i < size; i++) {
+    ASSERT_EQUAL(1, Vector_Get(v, i, &n));
+    ASSERT_EQUAL(ref[i], n);
+  }
+  Vector_Free(v);
+  return 0;
+}
+
+TEST_MAIN({
+  TESTFUNC(testVector);
+  TESTFUNC(testTypedVector);
+  TESTFUNC(testGrowth);
+  TESTFUNC(testIncremental);
+});
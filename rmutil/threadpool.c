@@ -0,0 +1,224 @@
+#define REDISMODULE_EXPERIMENTAL_API
+#include "threadpool.h"
+#include <pthread.h>
+#include <stdlib.h>
+
+typedef struct {
+  RMUtilThreadPoolJob job;
+  void *privdata;
+} poolJob;
+
+/* A bounded ring of jobs. Jobs are pushed by any thread, and popped by the owning worker or stolen
+ * by other workers */
+typedef struct {
+  pthread_mutex_t lock;
+  poolJob *jobs;
+  size_t cap;
+  size_t head;
+  size_t len;
+} poolQueue;
+
+typedef struct RMUtilThreadPool {
+  int numThreads;
+  pthread_t *threads;
+  poolQueue *queues;
+  unsigned nextQueue;
+
+  // workers sleep on cond while there are no queued jobs, and Wait() sleeps on done while there
+  // are unfinished jobs. unfinished is protected by lock. queued is counted up under lock, and
+  // atomically counted down by the workers once they have taken a job, so it can briefly lag
+  // behind the queues either way
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  pthread_cond_t done;
+  size_t queued;
+  size_t unfinished;
+  int stop;
+} RMUtilThreadPool;
+
+typedef struct {
+  RMUtilThreadPool *pool;
+  int id;
+} poolWorker;
+
+static int poolQueue_Push(poolQueue *q, RMUtilThreadPoolJob job, void *privdata) {
+  int rc = 0;
+  pthread_mutex_lock(&q->lock);
+  if (q->len < q->cap) {
+    q->jobs[(q->head + q->len) % q->cap] = (poolJob){.job = job, .privdata = privdata};
+    q->len++;
+    rc = 1;
+  }
+  pthread_mutex_unlock(&q->lock);
+  return rc;
+}
+
+static int poolQueue_Pop(poolQueue *q, poolJob *job) {
+  int rc = 0;
+  pthread_mutex_lock(&q->lock);
+  if (q->len) {
+    *job = q->jobs[q->head];
+    q->head = (q->head + 1) % q->cap;
+    q->len--;
+    rc = 1;
+  }
+  pthread_mutex_unlock(&q->lock);
+  return rc;
+}
+
+/* Take a job from the worker's own queue, or steal one from the other workers' queues */
+static int pool_TakeJob(RMUtilThreadPool *p, int id, poolJob *job) {
+  for (int i = 0; i < p->numThreads; i++) {
+    if (poolQueue_Pop(&p->queues[(id + i) % p->numThreads], job)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static void *rmutilThreadPool_Loop(void *arg) {
+  poolWorker *w = arg;
+  RMUtilThreadPool *p = w->pool;
+  int id = w->id;
+  free(w);
+
+  for (;;) {
+    poolJob job;
+    if (pool_TakeJob(p, id, &job)) {
+      __atomic_fetch_sub(&p->queued, 1, __ATOMIC_RELAXED);
+      job.job(job.privdata);
+
+      pthread_mutex_lock(&p->lock);
+      if (--p->unfinished == 0) {
+        pthread_cond_broadcast(&p->done);
+      }
+      pthread_mutex_unlock(&p->lock);
+      continue;
+    }
+
+    // a full scan found nothing, sleep until a job is submitted. Submit counts the job under the
+    // lock after queueing it, so it is either counted here or wakes us up. A count left by a job
+    // another worker has taken but not yet uncounted only costs another scan
+    pthread_mutex_lock(&p->lock);
+    while (!__atomic_load_n(&p->queued, __ATOMIC_RELAXED) && !p->stop) {
+      pthread_cond_wait(&p->cond, &p->lock);
+    }
+    int stop = p->stop && !__atomic_load_n(&p->queued, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&p->lock);
+    if (stop) break;
+  }
+  return NULL;
+}
+
+RMUtilThreadPool *RMUtil_NewThreadPool(int numThreads, size_t queueSize) {
+  if (numThreads < 1) numThreads = 1;
+  size_t perQueue = (queueSize + numThreads - 1) / numThreads;
+  if (perQueue < 1) perQueue = 1;
+
+  RMUtilThreadPool *p = calloc(1, sizeof(*p));
+  p->numThreads = numThreads;
+  p->threads = calloc(numThreads, sizeof(pthread_t));
+  p->queues = calloc(numThreads, sizeof(poolQueue));
+  pthread_mutex_init(&p->lock, NULL);
+  pthread_cond_init(&p->cond, NULL);
+  pthread_cond_init(&p->done, NULL);
+
+  for (int i = 0; i < numThreads; i++) {
+    pthread_mutex_init(&p->queues[i].lock, NULL);
+    p->queues[i].jobs = calloc(perQueue, sizeof(poolJob));
+    p->queues[i].cap = perQueue;
+  }
+
+  for (int i = 0; i < numThreads; i++) {
+    poolWorker *w = malloc(sizeof(*w));
+    *w = (poolWorker){.pool = p, .id = i};
+    if (pthread_create(&p->threads[i], NULL, rmutilThreadPool_Loop, w) != 0) {
+      free(w);
+      p->numThreads = i;
+      RMUtilThreadPool_Free(p);
+      return NULL;
+    }
+  }
+  return p;
+}
+
+int RMUtilThreadPool_Submit(RMUtilThreadPool *p, RMUtilThreadPoolJob job, void *privdata) {
+  unsigned start = __atomic_fetch_add(&p->nextQueue, 1, __ATOMIC_RELAXED);
+  int i;
+  for (i = 0; i < p->numThreads; i++) {
+    if (poolQueue_Push(&p->queues[(start + i) % p->numThreads], job, privdata)) break;
+  }
+  if (i == p->numThreads) {
+    return REDISMODULE_ERR;
+  }
+
+  pthread_mutex_lock(&p->lock);
+  __atomic_fetch_add(&p->queued, 1, __ATOMIC_RELAXED);
+  p->unfinished++;
+  pthread_cond_signal(&p->cond);
+  pthread_mutex_unlock(&p->lock);
+  return REDISMODULE_OK;
+}
+
+void RMUtilThreadPool_Wait(RMUtilThreadPool *p) {
+  pthread_mutex_lock(&p->lock);
+  while (p->unfinished) {
+    pthread_cond_wait(&p->done, &p->lock);
+  }
+  pthread_mutex_unlock(&p->lock);
+}
+
+void RMUtilThreadPool_Free(RMUtilThreadPool *p) {
+  pthread_mutex_lock(&p->lock);
+  p->stop = 1;
+  pthread_cond_broadcast(&p->cond);
+  pthread_mutex_unlock(&p->lock);
+
+  for (int i = 0; i < p->numThreads; i++) {
+    pthread_join(p->threads[i], NULL);
+  }
+  for (int i = 0; i < p->numThreads; i++) {
+    free(p->queues[i].jobs);
+    pthread_mutex_destroy(&p->queues[i].lock);
+  }
+  pthread_cond_destroy(&p->cond);
+  pthread_cond_destroy(&p->done);
+  pthread_mutex_destroy(&p->lock);
+  free(p->queues);
+  free(p->threads);
+  free(p);
+}
+
+typedef struct {
+  RedisModuleBlockedClient *bc;
+  RMUtilThreadPoolJob job;
+  void *privdata;
+} blockedJob;
+
+static void rmutilThreadPool_RunBlocked(void *arg) {
+  blockedJob *bj = arg;
+  bj->job(bj->privdata);
+  RedisModule_UnblockClient(bj->bc, bj->privdata);
+  free(bj);
+}
+
+int RMUtilThreadPool_BlockAndRun(RMUtilThreadPool *p, RedisModuleCtx *ctx, RMUtilThreadPoolJob job,
+                                 void *privdata, RedisModuleCmdFunc reply,
+                                 RedisModuleCmdFunc timeout,
+                                 void (*freePrivdata)(RedisModuleCtx *, void *), long long timeoutMs) {
+  blockedJob *bj = malloc(sizeof(*bj));
+  bj->job = job;
+  bj->privdata = privdata;
+  bj->bc = RedisModule_BlockClient(ctx, reply, timeout, freePrivdata, timeoutMs);
+  if (bj->bc == NULL) {
+    free(bj);
+    return REDISMODULE_ERR;
+  }
+
+  if (RMUtilThreadPool_Submit(p, rmutilThreadPool_RunBlocked, bj) == REDISMODULE_ERR) {
+    RedisModule_AbortBlock(bj->bc);
+    free(bj);
+    return REDISMODULE_ERR;
+  }
+  return REDISMODULE_OK;
+}
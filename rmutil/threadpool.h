@@ -0,0 +1,50 @@
+#ifndef RMUTIL_THREADPOOL_H_
+#define RMUTIL_THREADPOOL_H_
+#include <stddef.h>
+#include <redismodule.h>
+
+/** threadpool.h - A fixed size pool of worker threads for offloading work from the main thread */
+
+/* RMUtilThreadPool - opaque context for the thread pool */
+struct RMUtilThreadPool;
+
+/* RMUtilThreadPoolJob - a job to run on a worker thread, with its private data */
+typedef void (*RMUtilThreadPoolJob)(void *privdata);
+
+/* Create a thread pool with `numThreads` worker threads, holding up to `queueSize` pending jobs.
+ * Each worker has a bounded queue of its own. Jobs are spread between the queues round robin, and
+ * idle workers steal jobs from the queues of busy ones. Returns NULL if the threads could not be
+ * started */
+struct RMUtilThreadPool *RMUtil_NewThreadPool(int numThreads, size_t queueSize);
+
+/* Queue `job` to run with `privdata` on one of the pool's workers. Returns REDISMODULE_ERR without
+ * queueing the job if all the queues are full, REDISMODULE_OK otherwise */
+int RMUtilThreadPool_Submit(struct RMUtilThreadPool *p, RMUtilThreadPoolJob job, void *privdata);
+
+/* Wait until all the jobs submitted so far have finished running */
+void RMUtilThreadPool_Wait(struct RMUtilThreadPool *p);
+
+/* Run all pending jobs, stop the workers and free the pool */
+void RMUtilThreadPool_Free(struct RMUtilThreadPool *p);
+
+/* Block the client calling the current command, run `job` with `privdata` on the pool, and unblock
+ * the client when it's done. `reply` is then called on the main thread to reply to the client, and
+ * may get privdata using RedisModule_GetBlockedClientPrivateData. `timeout`, `freePrivdata` and
+ * `timeoutMs` are passed to RedisModule_BlockClient as is.
+ *
+ * If the job could not be queued the client is unblocked without calling `reply`, and
+ * REDISMODULE_ERR is returned, so the command can reply with an error itself. e.g:
+ *
+ *   if (RMUtilThreadPool_BlockAndRun(pool, ctx, heavyJob, job, heavyReply, NULL, freeJob, 0) ==
+ *       REDISMODULE_ERR) {
+ *     freeJob(ctx, job);
+ *     return RedisModule_ReplyWithError(ctx, "ERR server busy");
+ *   }
+ *   return REDISMODULE_OK;
+ */
+int RMUtilThreadPool_BlockAndRun(struct RMUtilThreadPool *p, RedisModuleCtx *ctx,
+                                 RMUtilThreadPoolJob job, void *privdata, RedisModuleCmdFunc reply,
+                                 RedisModuleCmdFunc timeout,
+                                 void (*freePrivdata)(RedisModuleCtx *, void *), long long timeoutMs);
+
+#endif
@@ -6,6 +6,7 @@
 #include <stdarg.h>
 #include <limits.h>
 #include <string.h>
+#include <stdint.h>
 #define REDISMODULE_EXPERIMENTAL_API
 #include <redismodule.h>
 #include "util.h"
@@ -46,61 +47,249 @@ int RMUtil_ArgIndex(const char *arg, RedisModuleString **argv, int argc) {
   return -1;
 }
 
-RMUtilInfo *RMUtil_GetRedisInfo(RedisModuleCtx *ctx) {
+struct RMUtilArgSchema {
+  const char **keywords;
+  size_t *lens;
+  int numKeywords;
+  size_t minLen, maxLen;
+
+  // perfect hash table of keyword indexes, -1 for empty buckets
+  int *table;
+  uint32_t mask;
+  uint32_t seed;
+};
+
+static inline uint32_t argSchema_Hash(uint32_t seed, const char *s, size_t len) {
+  // FNV-1a over the ASCII lowercase bytes, with a seed mixed into the offset basis
+  uint32_t h = 2166136261u ^ seed;
+  for (size_t i = 0; i < len; i++) {
+    unsigned char c = s[i];
+    if (c >= 'A' && c <= 'Z') c |= 0x20;
+    h = (h ^ c) * 16777619u;
+  }
+  return h ^ (h >> 15);
+}
 
-  RedisModuleCallReply *r = RedisModule_Call(ctx, "INFO", "c", "all");
-  if (r == NULL || RedisModule_CallReplyType(r) == REDISMODULE_REPLY_ERROR) {
-    return NULL;
+/* Try to place all keywords in distinct buckets with the given seed and table size */
+static int argSchema_TryBuild(RMUtilArgSchema *s, uint32_t seed, uint32_t size) {
+  s->table = realloc(s->table, size * sizeof(int));
+  for (uint32_t i = 0; i < size; i++) {
+    s->table[i] = -1;
   }
+  s->mask = size - 1;
+  s->seed = seed;
 
-  int cap = 100;  // rough estimate of info lines
-  RMUtilInfo *info = malloc(sizeof(RMUtilInfo));
-  info->entries = calloc(cap, sizeof(RMUtilInfoEntry));
+  for (int i = 0; i < s->numKeywords; i++) {
+    uint32_t b = argSchema_Hash(seed, s->keywords[i], s->lens[i]) & s->mask;
+    if (s->table[b] != -1) return 0;
+    s->table[b] = i;
+  }
+  return 1;
+}
 
-  int i = 0;
-  size_t sz;
-  char *text = (char *)RedisModule_CallReplyStringPtr(r, &sz);
+RMUtilArgSchema *RMUtil_NewArgSchema(const char **keywords, int n) {
+  if (n <= 0) return NULL;
+  for (int i = 0; i < n; i++) {
+    for (int j = i + 1; j < n; j++) {
+      if (!strcasecmp(keywords[i], keywords[j])) return NULL;
+    }
+  }
 
-  char *line = text;
-  while (line && line < text + sz) {
-    char *line = strsep(&text, "\r\n");
-    if (line == NULL) break;
+  RMUtilArgSchema *s = calloc(1, sizeof(*s));
+  s->keywords = keywords;
+  s->numKeywords = n;
+  s->lens = calloc((size_t)n, sizeof(size_t));
+  s->minLen = (size_t)-1;
+  for (int i = 0; i < n; i++) {
+    s->lens[i] = strlen(keywords[i]);
+    if (s->lens[i] < s->minLen) s->minLen = s->lens[i];
+    if (s->lens[i] > s->maxLen) s->maxLen = s->lens[i];
+  }
 
-    if (!(*line >= 'a' && *line <= 'z')) {  // skip non entry lines
-      continue;
+  // start with a table at least twice the number of keywords, and grow it until we find a seed
+  // that maps every keyword to its own bucket
+  uint32_t size = 8;
+  while (size < 2 * (uint32_t)n) size <<= 1;
+  for (;; size <<= 1) {
+    for (uint32_t seed = 0; seed < 256; seed++) {
+      if (argSchema_TryBuild(s, seed * 0x9e3779b9u, size)) return s;
     }
+  }
+}
 
-    char *key = strsep(&line, ":");
-    info->entries[i].key = strdup(key);
-    info->entries[i].val = strdup(line);
-    i++;
-    if (i >= cap) {
-      cap *= 2;
-      info->entries = realloc(info->entries, cap * sizeof(RMUtilInfoEntry));
+void RMUtilArgSchema_Free(RMUtilArgSchema *s) {
+  free(s->table);
+  free(s->lens);
+  free(s);
+}
+
+int RMUtilArgSchema_Lookup(const RMUtilArgSchema *s, const char *arg, size_t len) {
+  if (len < s->minLen || len > s->maxLen) return -1;
+
+  int i = s->table[argSchema_Hash(s->seed, arg, len) & s->mask];
+  if (i < 0 || s->lens[i] != len || strncasecmp(arg, s->keywords[i], len) != 0) {
+    return -1;
+  }
+  return i;
+}
+
+int RMUtilArgSchema_Parse(const RMUtilArgSchema *s, RedisModuleString **argv, int argc, int offset,
+                          int *positions) {
+  for (int i = 0; i < s->numKeywords; i++) {
+    positions[i] = -1;
+  }
+
+  int found = 0;
+  for (int i = offset; i < argc && found < s->numKeywords; i++) {
+    size_t len;
+    const char *arg = RedisModule_StringPtrLen(argv[i], &len);
+    int kw = RMUtilArgSchema_Lookup(s, arg, len);
+    if (kw >= 0 && positions[kw] < 0) {
+      positions[kw] = i;
+      found++;
     }
   }
-  info->numEntries = i;
+  return found;
+}
+
+static uint32_t info_HashKey(const char *key, size_t len) {
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < len; i++) {
+    h = (h ^ (unsigned char)key[i]) * 16777619u;
+  }
+  return h;
+}
+
+RMUtilInfo *RMUtil_ParseRedisInfo(const char *text, size_t len) {
+
+  // count the lines first so the entries array is allocated once
+  size_t cap = 1;
+  for (const char *p = text; (p = memchr(p, '\n', text + len - p)) != NULL; p++) {
+    cap++;
+  }
+
+  size_t tableSize = 16;
+  while (tableSize < 2 * cap) tableSize <<= 1;
+
+  // the entries, the index and a copy of the text share a single allocation
+  size_t entriesSz = cap * sizeof(RMUtilInfoEntry);
+  size_t tableSz = tableSize * sizeof(int);
+  RMUtilInfo *info = malloc(sizeof(RMUtilInfo));
+  info->entries = malloc(entriesSz + tableSz + len + 1);
+  info->table = (int *)((char *)info->entries + entriesSz);
+  info->buf = (char *)info->table + tableSz;
+  info->mask = tableSize - 1;
+  info->serverInfo = NULL;
+  memset(info->table, 0, tableSz);
+  memcpy(info->buf, text, len);
+  info->buf[len] = '\0';
+
+  int n = 0;
+  char *end = info->buf + len;
+  for (char *line = info->buf; line < end;) {
+    char *eol = memchr(line, '\n', end - line);
+    if (!eol) eol = end;
+    char *next = eol + 1;
+    if (eol > line && eol[-1] == '\r') eol--;
+    *eol = '\0';
+
+    char *sep;
+    if (*line >= 'a' && *line <= 'z' &&  // skip non entry lines
+        (sep = memchr(line, ':', eol - line)) != NULL) {
+      *sep = '\0';
+      RMUtilInfoEntry *e = &info->entries[n];
+      e->key = line;
+      e->keyLen = sep - line;
+      e->val = sep + 1;
+      e->valLen = eol - e->val;
+
+      // index the entry, keeping the first occurrence of a key
+      size_t b = info_HashKey(e->key, e->keyLen) & info->mask;
+      for (;;) {
+        int j = info->table[b] - 1;
+        if (j < 0) {
+          info->table[b] = n + 1;
+          n++;
+          break;
+        }
+        RMUtilInfoEntry *o = &info->entries[j];
+        if (o->keyLen == e->keyLen && !memcmp(o->key, e->key, e->keyLen)) {
+          break;
+        }
+        b = (b + 1) & info->mask;
+      }
+    }
+    line = next;
+  }
+  info->numEntries = n;
+  return info;
+}
+
+RMUtilInfo *RMUtil_GetRedisInfoSection(RedisModuleCtx *ctx, const char *section) {
+
+#ifdef RMUTIL_HAVE_SERVER_INFO
+  // the server may be older than the headers we were built with
+  if (RedisModule_GetServerInfo) {
+    // the data is not tied to ctx so that it can outlive it, e.g. in an RMUtilInfoCache
+    RedisModuleServerInfoData *data = RedisModule_GetServerInfo(NULL, section);
+    if (data == NULL) {
+      return NULL;
+    }
+    RMUtilInfo *info = calloc(1, sizeof(RMUtilInfo));
+    info->serverInfo = data;
+    return info;
+  }
+#endif
+
+  RedisModuleCallReply *r = RedisModule_Call(ctx, "INFO", "c", section);
+  if (r == NULL || RedisModule_CallReplyType(r) == REDISMODULE_REPLY_ERROR) {
+    return NULL;
+  }
+
+  size_t sz;
+  const char *text = RedisModule_CallReplyStringPtr(r, &sz);
+  RMUtilInfo *info = text ? RMUtil_ParseRedisInfo(text, sz) : NULL;
   RedisModule_FreeCallReply(r);
   return info;
 }
+
+RMUtilInfo *RMUtil_GetRedisInfo(RedisModuleCtx *ctx) {
+  return RMUtil_GetRedisInfoSection(ctx, "all");
+}
+
 void RMUtilRedisInfo_Free(RMUtilInfo *info) {
-  for (int i = 0; i < info->numEntries; i++) {
-    free(info->entries[i].key);
-    free(info->entries[i].val);
+#ifdef RMUTIL_HAVE_SERVER_INFO
+  if (info->serverInfo) {
+    RedisModule_FreeServerInfo(NULL, info->serverInfo);
   }
+#endif
   free(info->entries);
   free(info);
 }
 
 int RMUtilInfo_GetInt(RMUtilInfo *info, const char *key, long long *val) {
 
+#ifdef RMUTIL_HAVE_SERVER_INFO
+  if (info->serverInfo) {
+    int err;
+    *val = RedisModule_ServerInfoGetFieldSigned(info->serverInfo, key, &err);
+    if (err) {
+      *val = -1;
+      return 0;
+    }
+    return 1;
+  }
+#endif
+
   const char *p = NULL;
   if (!RMUtilInfo_GetString(info, key, &p)) {
     return 0;
   }
 
-  *val = strtoll(p, NULL, 10);
-  if ((errno == ERANGE && (*val == LONG_MAX || *val == LONG_MIN)) || (errno != 0 && *val == 0)) {
+  char *e;
+  errno = 0;
+  *val = strtoll(p, &e, 10);
+  if (errno != 0 || e == p) {
     *val = -1;
     return 0;
   }
@@ -109,31 +298,95 @@ int RMUtilInfo_GetInt(RMUtilInfo *info, const char *key, long long *val) {
 }
 
 int RMUtilInfo_GetString(RMUtilInfo *info, const char *key, const char **str) {
-  int i;
-  for (i = 0; i < info->numEntries; i++) {
-    if (!strcmp(key, info->entries[i].key)) {
-      *str = info->entries[i].val;
+
+#ifdef RMUTIL_HAVE_SERVER_INFO
+  if (info->serverInfo) {
+    const char *p = RedisModule_ServerInfoGetFieldC(info->serverInfo, key);
+    if (p == NULL) {
+      return 0;
+    }
+    *str = p;
+    return 1;
+  }
+#endif
+
+  size_t len = strlen(key);
+  size_t b = info_HashKey(key, len) & info->mask;
+  int j;
+  while ((j = info->table[b] - 1) >= 0) {
+    if (info->entries[j].keyLen == len && !memcmp(info->entries[j].key, key, len)) {
+      *str = info->entries[j].val;
       return 1;
     }
+    b = (b + 1) & info->mask;
   }
   return 0;
 }
 
 int RMUtilInfo_GetDouble(RMUtilInfo *info, const char *key, double *d) {
+
+#ifdef RMUTIL_HAVE_SERVER_INFO
+  if (info->serverInfo) {
+    int err;
+    *d = RedisModule_ServerInfoGetFieldDouble(info->serverInfo, key, &err);
+    return !err;
+  }
+#endif
+
   const char *p = NULL;
   if (!RMUtilInfo_GetString(info, key, &p)) {
-    printf("not found %s\n", key);
     return 0;
   }
 
-  *d = strtod(p, NULL);
-  if ((errno == ERANGE && (*d == HUGE_VAL || *d == -HUGE_VAL)) || (errno != 0 && *d == 0)) {
+  char *e;
+  errno = 0;
+  *d = strtod(p, &e);
+  if (errno != 0 || e == p) {
     return 0;
   }
 
   return 1;
 }
 
+struct RMUtilInfoCache {
+  char *section;
+  long long ttlMs;
+  long long takenAt;
+  RMUtilInfo *info;
+};
+
+RMUtilInfoCache *RMUtil_NewInfoCache(const char *section, long long ttlMs) {
+  RMUtilInfoCache *c = calloc(1, sizeof(*c));
+  c->section = strdup(section);
+  c->ttlMs = ttlMs;
+  return c;
+}
+
+RMUtilInfo *RMUtilInfoCache_Get(RMUtilInfoCache *c, RedisModuleCtx *ctx) {
+  long long now = RedisModule_Milliseconds();
+  if (c->info && now - c->takenAt < c->ttlMs) {
+    return c->info;
+  }
+
+  RMUtilInfoCache_Invalidate(c);
+  c->info = RMUtil_GetRedisInfoSection(ctx, c->section);
+  c->takenAt = now;
+  return c->info;
+}
+
+void RMUtilInfoCache_Invalidate(RMUtilInfoCache *c) {
+  if (c->info) {
+    RMUtilRedisInfo_Free(c->info);
+    c->info = NULL;
+  }
+}
+
+void RMUtilInfoCache_Free(RMUtilInfoCache *c) {
+  RMUtilInfoCache_Invalidate(c);
+  free(c->section);
+  free(c);
+}
+
 /*
 c -- pointer to a Null terminated C string pointer.
 b -- pointer to a C buffer, followed by pointer to a size_t for its length
@@ -72,6 +72,58 @@ int rmutil_vparseArgs(RedisModuleString **argv, int argc, int offset, const char
 RedisModuleString **RMUtil_ParseVarArgs(RedisModuleString **argv, int argc, int offset,
                                         const char *keyword, size_t *nargs);
 
+/**
+ * Compiled argument schema, for commands with many optional keyword clauses.
+ *
+ * Calling RMUtil_ParseArgsAfter once per keyword scans the whole argument list for every keyword.
+ * Instead, declare the command's keywords once at module load, and locate all of them in a single
+ * pass over argv. The keywords are matched case insensitively using a perfect hash built when the
+ * schema is compiled, so each argument costs one hash and at most one comparison.
+ *
+ * Example:
+ *
+ *   enum { KW_LIMIT, KW_WITHSCORES, KW_FILTER, KW_NUM };
+ *   static const char *keywords[] = {"LIMIT", "WITHSCORES", "FILTER"};
+ *   static RMUtilArgSchema *schema;
+ *
+ *   // in RedisModule_OnLoad:
+ *   schema = RMUtil_NewArgSchema(keywords, KW_NUM);
+ *
+ *   // in the command handler:
+ *   int pos[KW_NUM];
+ *   RMUtilArgSchema_Parse(schema, argv, argc, 2, pos);
+ *   if (pos[KW_LIMIT] >= 0 &&
+ *       RMUtil_ParseArgs(argv, argc, pos[KW_LIMIT] + 1, "ll", &offset, &num) != REDISMODULE_OK) {
+ *     return RedisModule_ReplyWithError(ctx, "ERR bad LIMIT");
+ *   }
+ */
+typedef struct RMUtilArgSchema RMUtilArgSchema;
+
+/**
+ * Compile a schema from an array of `n` keywords. The keyword strings must outlive the schema.
+ * Returns NULL if there are no keywords or if there are duplicate keywords.
+ */
+RMUtilArgSchema *RMUtil_NewArgSchema(const char **keywords, int n);
+
+/**
+ * Free a compiled schema
+ */
+void RMUtilArgSchema_Free(RMUtilArgSchema *schema);
+
+/**
+ * Return the index of the keyword matching the buffer `arg` of length `len` (case insensitive), or
+ * -1 if it's not a keyword of the schema.
+ */
+int RMUtilArgSchema_Lookup(const RMUtilArgSchema *schema, const char *arg, size_t len);
+
+/**
+ * Locate the schema's keywords in argv, starting at offset, in a single pass. For each keyword
+ * i, positions[i] is set to the index in argv of its first occurrence, or -1 if it is not present.
+ * `positions` must have room for all the schema's keywords. Returns the number of keywords found.
+ */
+int RMUtilArgSchema_Parse(const RMUtilArgSchema *schema, RedisModuleString **argv, int argc,
+                          int offset, int *positions);
+
 /**
  * Default implementation of an AoF rewrite function that simply calls DUMP/RESTORE
  * internally. To use this function, pass it as the .aof_rewrite value in
@@ -79,16 +131,43 @@ RedisModuleString **RMUtil_ParseVarArgs(RedisModuleString **argv, int argc, int
  */
 void RMUtil_DefaultAofRewrite(RedisModuleIO *aof, RedisModuleString *key, void *value);
 
-// A single key/value entry in a redis info map
+// A single key/value entry in a redis info map. Both strings point into the info object's buffer
 typedef struct {
   char *key;
   char *val;
+  size_t keyLen;
+  size_t valLen;
 } RMUtilInfoEntry;
 
-// Representation of INFO command response, as a list of k/v pairs
+/* redismodule.h exposes RedisModule_GetServerInfo from 6.0 on, which we detect by the server event
+ * definitions introduced in the same version. Reading INFO through it is opt-in with
+ * RMUTIL_USE_SERVER_INFO, as it leaves the entries of RMUtilInfo empty */
+#if defined(REDISMODULE_EVENT_FLUSHDB) && defined(RMUTIL_USE_SERVER_INFO)
+#define RMUTIL_HAVE_SERVER_INFO 1
+#endif
+
+/**
+ * Representation of INFO command response, as a list of k/v pairs.
+ *
+ * The INFO reply text is copied once into a single buffer that the entries point into, and the
+ * entries are indexed by an open-addressing hash table of their keys, so building the object costs
+ * two allocations regardless of the number of fields and lookups do not scan the entries.
+ *
+ * When built with RMUTIL_USE_SERVER_INFO against headers that have RedisModule_GetServerInfo, and
+ * the server provides it, fields are read through the native server info API instead. That API
+ * can't list the fields, so `entries` is then left empty and fields can only be read with the
+ * RMUtilInfo_Get* functions. Either way, values are only converted to numbers when requested.
+ */
 typedef struct {
+  // empty when read with the server info API, see above
   RMUtilInfoEntry *entries;
   int numEntries;
+
+  // private
+  char *buf;
+  int *table;
+  size_t mask;
+  void *serverInfo;  // RedisModuleServerInfoData, when read with the native API
 } RMUtilInfo;
 
 /**
@@ -98,6 +177,18 @@ typedef struct {
 */
 RMUtilInfo *RMUtil_GetRedisInfo(RedisModuleCtx *ctx);
 
+/**
+* Same as RMUtil_GetRedisInfo, but only requests a single section (e.g. "memory") from redis,
+* which is considerably cheaper than "all" when only a few fields are needed.
+*/
+RMUtilInfo *RMUtil_GetRedisInfoSection(RedisModuleCtx *ctx, const char *section);
+
+/**
+* Parse raw INFO text of length `len` as RMUtilInfo. The text is copied and not modified.
+* The resulting object needs to be freed with RMUtilRedisInfo_Free
+*/
+RMUtilInfo *RMUtil_ParseRedisInfo(const char *text, size_t len);
+
 /**
 * Free an RMUtilInfo object and its entries
 */
@@ -121,6 +212,45 @@ int RMUtilInfo_GetString(RMUtilInfo *info, const char *key, const char **str);
 */
 int RMUtilInfo_GetDouble(RMUtilInfo *info, const char *key, double *d);
 
+/**
+ * A cache of INFO snapshots for code that reads several fields repeatedly, e.g. from a monitoring
+ * timer. A snapshot is reused as long as less than `ttlMs` milliseconds have passed since it was
+ * taken, so a ttl of 1 shares one snapshot between all reads done within the same millisecond.
+ * The cache is not thread safe, and like all the INFO functions must be used with the GIL held.
+ *
+ * Example:
+ *
+ *   static RMUtilInfoCache *memInfo;
+ *   memInfo = RMUtil_NewInfoCache("memory", 1000);
+ *
+ *   RMUtilInfo *info = RMUtilInfoCache_Get(memInfo, ctx);
+ *   long long used;
+ *   if (info && RMUtilInfo_GetInt(info, "used_memory", &used)) { ... }
+ */
+typedef struct RMUtilInfoCache RMUtilInfoCache;
+
+/**
+ * Create a cache for the given INFO section ("all", "memory" etc.). The section string is copied
+ */
+RMUtilInfoCache *RMUtil_NewInfoCache(const char *section, long long ttlMs);
+
+/**
+ * Get a snapshot from the cache, refreshing it if it has expired. The snapshot belongs to the
+ * cache and stays valid until the next call to RMUtilInfoCache_Get or RMUtilInfoCache_Free.
+ * Returns NULL if INFO could not be read.
+ */
+RMUtilInfo *RMUtilInfoCache_Get(RMUtilInfoCache *cache, RedisModuleCtx *ctx);
+
+/**
+ * Drop the cached snapshot, so the next RMUtilInfoCache_Get reads INFO again
+ */
+void RMUtilInfoCache_Invalidate(RMUtilInfoCache *cache);
+
+/**
+ * Free the cache and its snapshot
+ */
+void RMUtilInfoCache_Free(RMUtilInfoCache *cache);
+
 /*
 * Returns a call reply array's element given by a space-delimited path. E.g.,
 * the path "1 2 3" will return the 3rd element from the 2 element of the 1st
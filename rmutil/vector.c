@@ -1,9 +1,64 @@
 #include "vector.h"
 #include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+/* The pages of the previous buffer of a vector growing incrementally are given back to the system
+ * whenever this many bytes were moved, rather than all at once by the final free. It is the size
+ * of a transparent huge page, releasing less would split the huge pages, which is slower still */
+#define VECTOR_RELEASE_BYTES (2 * 1024 * 1024)
+
+/* Give back the pages of the previous buffer that are entirely within the elements moved from
+ * offset `from` to `to`, rounded down to VECTOR_RELEASE_BYTES */
+static void __vector_ReleaseMoved(Vector *v, size_t from, size_t to) {
+#ifdef MADV_DONTNEED
+  from -= from % VECTOR_RELEASE_BYTES;
+  to -= to % VECTOR_RELEASE_BYTES;
+  if (to == from) return;
+  uintptr_t page = sysconf(_SC_PAGESIZE);
+  uintptr_t start = ((uintptr_t)v->old + from + page - 1) & ~(page - 1);
+  uintptr_t end = ((uintptr_t)v->old + to) & ~(page - 1);
+  if (end > start) madvise((void *)start, end - start, MADV_DONTNEED);
+#endif
+}
+
+/* Move some elements of a vector growing incrementally, as part of a change to it. At least two
+ * elements are moved, so a vector growing by 1.5X is done moving before it is full again */
+static inline void __vector_Migrate(Vector *v) {
+  if (__builtin_expect(v->old != NULL, 0)) {
+    Vector_Step(v, VECTOR_MIGRATE_BYTES > 2 * v->elemSize ? VECTOR_MIGRATE_BYTES : 2 * v->elemSize);
+  }
+}
+
+/* Switch v to a new buffer of cap elements, leaving the current ones to be moved by Vector_Step */
+static void __vector_GrowIncremental(Vector *v, size_t cap, int zero) {
+  Vector_Step(v, SIZE_MAX);
+  char *data = zero ? calloc(cap, v->elemSize) : malloc(cap * v->elemSize);
+  if (v->top) {
+    v->old = v->data;
+    v->oldTop = v->top;
+    v->migrated = 0;
+  } else {
+    free(v->data);
+  }
+  v->data = data;
+  v->cap = cap;
+}
+
+static inline int __vector_IsIncremental(Vector *v) {
+  return v->incrementalBytes && v->top * v->elemSize >= v->incrementalBytes;
+}
+
+/* Grow the capacity of v according to its growth policy so it can hold at least `needed`
+ * elements. Unlike Vector_Resize, the new capacity is not zeroed */
+static void __vector_Grow(Vector *v, size_t needed) {
+  Vector_Reserve(v, __vector_GrowCap(v->cap, needed, v->growth, v->minChunk));
+}
 
 inline int __vector_PushPtr(Vector *v, void *elem) {
   if (v->top == v->cap) {
-    Vector_Resize(v, v->cap ? v->cap * 2 : 1);
+    __vector_Grow(v, v->top + 1);
   }
 
   __vector_PutPtr(v, v->top, elem);
@@ -16,7 +71,7 @@ inline int Vector_Get(Vector *v, size_t pos, void *ptr) {
     return 0;
   }
 
-  memcpy(ptr, v->data + (pos * v->elemSize), v->elemSize);
+  __vector_CopyElem(ptr, __vector_ElemPtr(v, pos), v->elemSize);
   return 1;
 }
 
@@ -24,33 +79,48 @@ inline int Vector_Get(Vector *v, size_t pos, void *ptr) {
 inline int Vector_Pop(Vector *v, void *ptr) {
   if (v->top > 0) {
     if (ptr != NULL) {
-      Vector_Get(v, v->top - 1, ptr);
+      __vector_CopyElem(ptr, __vector_ElemPtr(v, v->top - 1), v->elemSize);
     }
     v->top--;
+    __vector_TrimMigration(v);
+    __vector_Migrate(v);
     return 1;
   }
   return 0;
 }
 
 inline int __vector_PutPtr(Vector *v, size_t pos, void *elem) {
-  // resize if pos is out of bounds
+  __vector_TrimMigration(v);
+  // grow if pos is out of bounds
   if (pos >= v->cap) {
-    Vector_Resize(v, pos + 1);
+    __vector_Grow(v, pos + 1);
+  }
+  // zero the gap between the current end and pos, if we skipped over it
+  if (pos > v->top) {
+    memset(v->data + v->top * v->elemSize, 0, (pos - v->top) * v->elemSize);
   }
 
   if (elem) {
-    memcpy(v->data + pos * v->elemSize, elem, v->elemSize);
+    __vector_CopyElem(__vector_ElemPtr(v, pos), elem, v->elemSize);
   } else {
-    memset(v->data + pos * v->elemSize, 0, v->elemSize);
+    memset(__vector_ElemPtr(v, pos), 0, v->elemSize);
   }
   // move the end offset to pos if we grew
   if (pos >= v->top) {
     v->top = pos + 1;
   }
+  __vector_Migrate(v);
   return 1;
 }
 
 int Vector_Resize(Vector *v, size_t newcap) {
+  if (newcap > v->cap && __vector_IsIncremental(v)) {
+    // the new buffer is zeroed by calloc, for free when the allocator maps new pages
+    __vector_GrowIncremental(v, newcap, 1);
+    return v->cap;
+  }
+  Vector_Step(v, SIZE_MAX);
+
   int oldcap = v->cap;
   v->cap = newcap;
 
@@ -62,20 +132,86 @@ int Vector_Resize(Vector *v, size_t newcap) {
     int offset = oldcap * v->elemSize;
     memset(v->data + offset, 0, v->cap * v->elemSize - offset);
   }
+  // If we shrank below the used size, drop the elements that no longer fit
+  if (v->top > v->cap) {
+    v->top = v->cap;
+  }
   return v->cap;
 }
 
+void Vector_SetGrowth(Vector *v, VectorGrowth growth, size_t minChunk) {
+  v->growth = growth;
+  v->minChunk = minChunk;
+}
+
+size_t Vector_Reserve(Vector *v, size_t cap) {
+  if (cap > v->cap) {
+    if (__vector_IsIncremental(v)) {
+      __vector_GrowIncremental(v, cap, 0);
+    } else {
+      Vector_Step(v, SIZE_MAX);
+      v->data = realloc(v->data, cap * v->elemSize);
+      v->cap = cap;
+    }
+  }
+  return v->cap;
+}
+
+void Vector_SetIncremental(Vector *v, size_t minBytes) {
+  v->incrementalBytes = minBytes;
+}
+
+int Vector_Step(Vector *v, size_t budget) {
+  if (!v->old) return 0;
+  if (v->migrated < v->oldTop) {
+    size_t n = budget / v->elemSize;
+    if (n == 0) n = 1;
+    if (n > v->oldTop - v->migrated) n = v->oldTop - v->migrated;
+    size_t offset = v->migrated * v->elemSize;
+    memcpy(v->data + offset, v->old + offset, n * v->elemSize);
+    v->migrated += n;
+    __vector_ReleaseMoved(v, offset, offset + n * v->elemSize);
+  }
+  if (v->migrated >= v->oldTop) {
+    free(v->old);
+    v->old = NULL;
+    v->oldTop = v->migrated = 0;
+    return 0;
+  }
+  return 1;
+}
+
+void Vector_ShrinkToFit(Vector *v) {
+  Vector_Step(v, SIZE_MAX);
+  if (v->top == v->cap) {
+    return;
+  }
+  if (v->top == 0) {
+    free(v->data);
+    v->data = NULL;
+  } else {
+    v->data = realloc(v->data, v->top * v->elemSize);
+  }
+  v->cap = v->top;
+}
+
 Vector *__newVectorSize(size_t elemSize, size_t cap) {
   Vector *vec = malloc(sizeof(Vector));
   vec->data = calloc(cap, elemSize);
   vec->top = 0;
   vec->elemSize = elemSize;
   vec->cap = cap;
+  vec->growth = VECTOR_GROW_2X;
+  vec->minChunk = 0;
+  vec->incrementalBytes = 0;
+  vec->old = NULL;
+  vec->oldTop = vec->migrated = 0;
 
   return vec;
 }
 
 void Vector_Free(Vector *v) {
+  free(v->old);
   free(v->data);
   free(v);
 }
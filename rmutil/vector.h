@@ -9,14 +9,58 @@
 * temporarily.
 * Works like C++ std::vector with an underlying resizable buffer
 */
+/* Growth factor applied to the capacity of a vector whenever it needs to grow */
+typedef enum {
+  VECTOR_GROW_2X = 0,
+  VECTOR_GROW_1_5X = 1,
+} VectorGrowth;
+
 typedef struct {
     char *data;
     size_t elemSize;
     size_t cap;
     size_t top;
 
+    // growth policy, see Vector_SetGrowth
+    VectorGrowth growth;
+    size_t minChunk;
+
+    // incremental growth, see Vector_SetIncremental. While the elements are moved to data after
+    // growing, the ones in [migrated, oldTop) are still in the previous buffer, old
+    size_t incrementalBytes;
+    char *old;
+    size_t oldTop;
+    size_t migrated;
 } Vector;
 
+/* The number of bytes moved to the new buffer by each change to a vector growing incrementally */
+#define VECTOR_MIGRATE_BYTES 4096
+
+/* Stop moving the elements of the previous buffer that are past the end of the vector, after it
+ * shrank. Code changing `top` directly must call it before writing past the end */
+static inline void __vector_TrimMigration(Vector *v) {
+  if (__builtin_expect(v->old != NULL, 0) && v->oldTop > v->top) v->oldTop = v->top;
+}
+
+/* Pointer to the element at pos, in whichever buffer holds it */
+static inline char *__vector_ElemPtr(const Vector *v, size_t pos) {
+  if (__builtin_expect(v->old != NULL, 0) && pos >= v->migrated && pos < v->oldTop) {
+    return v->old + pos * v->elemSize;
+  }
+  return v->data + pos * v->elemSize;
+}
+
+/* Compute the capacity to grow to in order to hold at least `needed` elements. The capacity is
+ * multiplied by the growth factor but grows by at least `minChunk` elements, so that sequential
+ * puts and pushes are amortized O(1) */
+static inline size_t __vector_GrowCap(size_t cap, size_t needed, VectorGrowth growth,
+                                      size_t minChunk) {
+  size_t newcap = growth == VECTOR_GROW_1_5X ? cap + cap / 2 : cap * 2;
+  if (newcap < cap + minChunk) newcap = cap + minChunk;
+  if (newcap < needed) newcap = needed;
+  return newcap;
+}
+
 /* Create a new vector with element size. This should generally be used
  * internall by the NewVector macro */
 Vector *__newVectorSize(size_t elemSize, size_t cap);
@@ -55,9 +99,39 @@ int Vector_Pop(Vector *v, void *ptr);
 
 int __vector_PushPtr(Vector *v, void *elem);
 
-/* resize capacity of v */
+/* resize capacity of v. If the vector grows, the newly added part is zeroed */
 int Vector_Resize(Vector *v, size_t newcap);
 
+/* Set the growth policy of v. Whenever a push or a put needs more room, the capacity is grown by
+ * the given factor, and by at least minChunk elements. The default is VECTOR_GROW_2X with no
+ * minimum chunk */
+void Vector_SetGrowth(Vector *v, VectorGrowth growth, size_t minChunk);
+
+/* Make sure v has capacity for at least cap elements, without changing its size. Unlike
+ * Vector_Resize this never shrinks the vector and does not zero the added capacity. Use it before
+ * bulk loading a known number of elements. Returns the capacity */
+size_t Vector_Reserve(Vector *v, size_t cap);
+
+/* Release any unused capacity, reducing the capacity to the used size of v */
+void Vector_ShrinkToFit(Vector *v);
+
+/* Make v grow incrementally once it holds at least minBytes of elements, or never if minBytes is
+ * 0, which is the default. Growing then allocates the new buffer without copying anything, and
+ * each following push, put or pop moves VECTOR_MIGRATE_BYTES of elements to it, so growing a
+ * vector of millions of elements does not stall the command that triggered it. Growing by 1.5X or
+ * more moves everything before the vector needs to grow again. Shrinking, and growing again
+ * before the move is over, finish it first */
+void Vector_SetIncremental(Vector *v, size_t minBytes);
+
+/* Move up to `budget` bytes of elements, and at least one element, to the new buffer of a vector
+ * growing incrementally. Returns 1 while there are elements left to move, 0 otherwise */
+int Vector_Step(Vector *v, size_t budget);
+
+/* Return 1 if some of the elements of v are still in its previous buffer */
+static inline int Vector_IsMigrating(const Vector *v) {
+  return v->old != NULL;
+}
+
 /* return the used size of the vector, regardless of capacity */
 int Vector_Size(Vector *v);
 
@@ -70,4 +144,130 @@ void Vector_Free(Vector *v);
 
 int __vecotr_PutPtr(Vector *v, size_t pos, void *elem);
 
+/* Copy a single element of size `size`. For the common scalar/pointer sizes the copy is done with
+ * a fixed-size memcpy that the compiler lowers into a single load and store */
+static inline void __vector_CopyElem(void *dst, const void *src, size_t size) {
+  switch (size) {
+    case 1:
+      memcpy(dst, src, 1);
+      break;
+    case 2:
+      memcpy(dst, src, 2);
+      break;
+    case 4:
+      memcpy(dst, src, 4);
+      break;
+    case 8:
+      memcpy(dst, src, 8);
+      break;
+    case 16:
+      memcpy(dst, src, 16);
+      break;
+    default:
+      memcpy(dst, src, size);
+  }
+}
+
+/*
+* Typed vector template.
+* RMUTIL_VECTOR_DECLARE(name, T) declares a vector struct called `name` holding elements of type T,
+* and static inline functions operating on it, prefixed with `name_`. Since the element size is
+* known at compile time, push/get/pop compile into plain loads and stores with no memcpy or
+* compound literals involved. The struct is meant to be embedded or kept on the stack, e.g.:
+*
+*   RMUTIL_VECTOR_DECLARE(ScoreVector, double)
+*
+*   ScoreVector sv;
+*   ScoreVector_Init(&sv, 0);
+*   ScoreVector_Push(&sv, 3.14);
+*   double d;
+*   ScoreVector_Pop(&sv, &d);
+*   ScoreVector_Free(&sv);
+*
+* The generated functions are:
+*   void   name_Init(name *v, size_t cap)        - initialize an empty vector with capacity cap
+*   size_t name_Reserve(name *v, size_t cap)     - make sure the capacity is at least cap
+*   size_t name_Push(name *v, T elem)            - push elem at the end, returns the new size
+*   int    name_Get(const name *v, size_t pos, T *ptr) - copy the element at pos to ptr, 0 if out of
+*                                                  bounds, 1 otherwise
+*   T     *name_At(name *v, size_t pos)          - unchecked pointer to the element at pos
+*   int    name_Pop(name *v, T *ptr)             - pop the last element into ptr (which may be NULL)
+*   size_t name_Size(const name *v)              - number of elements in the vector
+*   void   name_Clear(name *v)                   - drop all elements, keeping the capacity
+*   void   name_ShrinkToFit(name *v)             - release any unused capacity
+*   void   name_Free(name *v)                    - release the underlying buffer
+*/
+#define RMUTIL_VECTOR_DECLARE(name, T)                                         \
+  typedef struct {                                                             \
+    T *data;                                                                   \
+    size_t cap;                                                                \
+    size_t top;                                                                \
+  } name;                                                                      \
+                                                                               \
+  static inline size_t name##_Reserve(name *v, size_t cap) {                   \
+    if (cap > v->cap) {                                                        \
+      v->data = (T *)realloc(v->data, cap * sizeof(T));                        \
+      v->cap = cap;                                                            \
+    }                                                                          \
+    return v->cap;                                                             \
+  }                                                                            \
+                                                                               \
+  static inline void name##_Init(name *v, size_t cap) {                        \
+    v->data = NULL;                                                            \
+    v->cap = 0;                                                                \
+    v->top = 0;                                                                \
+    if (cap) name##_Reserve(v, cap);                                           \
+  }                                                                            \
+                                                                               \
+  static inline size_t name##_Push(name *v, T elem) {                          \
+    if (__builtin_expect(v->top == v->cap, 0)) {                               \
+      size_t cap = __vector_GrowCap(v->cap, v->top + 1, VECTOR_GROW_2X, 0);     \
+      name##_Reserve(v, cap);                                                  \
+    }                                                                          \
+    v->data[v->top++] = elem;                                                  \
+    return v->top;                                                             \
+  }                                                                            \
+                                                                               \
+  static inline int name##_Get(const name *v, size_t pos, T *ptr) {            \
+    if (pos >= v->top) return 0;                                               \
+    *ptr = v->data[pos];                                                       \
+    return 1;                                                                  \
+  }                                                                            \
+                                                                               \
+  static inline T *name##_At(name *v, size_t pos) {                            \
+    return v->data + pos;                                                      \
+  }                                                                            \
+                                                                               \
+  static inline int name##_Pop(name *v, T *ptr) {                              \
+    if (v->top == 0) return 0;                                                 \
+    --v->top;                                                                  \
+    if (ptr) *ptr = v->data[v->top];                                           \
+    return 1;                                                                  \
+  }                                                                            \
+                                                                               \
+  static inline size_t name##_Size(const name *v) {                            \
+    return v->top;                                                             \
+  }                                                                            \
+                                                                               \
+  static inline void name##_Clear(name *v) {                                   \
+    v->top = 0;                                                                \
+  }                                                                            \
+                                                                               \
+  static inline void name##_ShrinkToFit(name *v) {                             \
+    if (v->top == v->cap) return;                                              \
+    if (v->top == 0) {                                                         \
+      free(v->data);                                                           \
+      v->data = NULL;                                                          \
+    } else {                                                                   \
+      v->data = (T *)realloc(v->data, v->top * sizeof(T));                     \
+    }                                                                          \
+    v->cap = v->top;                                                           \
+  }                                                                            \
+                                                                               \
+  static inline void name##_Free(name *v) {                                    \
+    free(v->data);                                                             \
+    v->data = NULL;                                                            \
+    v->cap = v->top = 0;                                                       \
+  }
+
 #endif
\ No newline at end of file